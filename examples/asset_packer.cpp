@@ -0,0 +1,161 @@
+#include <render-internal/resource-loaders/asset_pack.h>
+#include <render-internal/resource-loaders/pool_manager.h>
+#include <graphics/logger.h>
+#include <iostream>
+#include <iomanip>
+#include <string>
+#include <vector>
+#include <algorithm>
+#include <cctype>
+
+// A tool for making asset packs (see ResourcePool::loadPack)
+// Runs on the cpu only, so doesn't need a window or gpu.
+//
+// Loads the files into a pool like a program would, then saves everything
+// that was staged, in the form it gets copied to the gpu in, to the pack file.
+// Images are loaded as textures, .ttf and .otf files as fonts, and anything else
+// as a model, with vertex::Anim3D if it has animations or vertex::v3D if not.
+// Models look for their textures in textures/ like ModelLoader does.
+//
+// usage: asset_packer [options] <pack file> <files...>
+//   --mips        make mip maps for the textures (see RenderConfig::mip_mapping)
+//   --srgb        textures without a colour space in their file are srgb (see RenderConfig::srgb)
+//   --compressed  use the block compressed version of textures made by texture_compressor
+//   --atlas       put small textures into atlases (see TextureLoader::loadToAtlas)
+//   --optimise    optimise meshes, make their levels of detail and meshlets
+//   --compact     use vertex::Compact3D and vertex::CompactAnim3D
+//
+// The pack keeps the vertex types, texture formats and colour spaces it was made with,
+// so the config of the pool loading it doesn't change them.
+
+const std::vector<std::string> TEXTURE_EXTENSIONS = {
+    "png", "jpg", "jpeg", "bmp", "tga", "gif", "psd", "hdr", "ktx2", "dds",
+};
+const std::vector<std::string> FONT_EXTENSIONS = { "ttf", "otf" };
+
+bool hasExtension(std::string path, const std::vector<std::string> &extensions) {
+    size_t dot = path.find_last_of('.');
+    if(dot == std::string::npos)
+	return false;
+    std::string ext = path.substr(dot + 1);
+    std::transform(ext.begin(), ext.end(), ext.begin(), ::tolower);
+    return std::find(extensions.begin(), extensions.end(), ext) != extensions.end();
+}
+
+// only needs the staging of the internal loader
+class PackModelLoader : public InternalModelLoader {
+public:
+    PackModelLoader(BasePoolManager* pools, RenderConfig conf)
+	: InternalModelLoader(Resource::Pool(0), pools, conf) {}
+    void loadGPU() override {}
+    void appendGPU() override {}
+    void clearGPU() override {}
+    Resource::ModelAnimation getAnimation(Resource::Model model, std::string animation) override {
+	return Resource::ModelAnimation();
+    }
+    Resource::ModelAnimation getAnimation(Resource::Model model, int index) override {
+	return Resource::ModelAnimation();
+    }
+
+    // stage the model with its path, so it is named in the pack
+    void loadFile(std::string path, bool compact) {
+	ModelInfo::Model model = loadModelData(path);
+	Resource::Model loaded;
+	if(model.animations.empty())
+	    loaded = compact ? load(vertex::Compact3D, model) : load(vertex::v3D, model);
+	else
+	    loaded = compact ? load(vertex::CompactAnim3D, model) : load(vertex::Anim3D, model);
+	loadedFromFile(loaded, path, nullptr);
+    }
+};
+
+struct PackPool {
+    PackPool(BasePoolManager* pools, RenderConfig conf) {
+	texLoader = new InternalTexLoader(Resource::Pool(0), conf, &pools->texCache);
+	modelLoader = new PackModelLoader(pools, conf);
+	fontLoader = new InternalFontLoader(Resource::Pool(0), texLoader);
+    }
+    ~PackPool() {
+	delete fontLoader;
+	delete modelLoader;
+	delete texLoader;
+    }
+    InternalTexLoader* texLoader;
+    PackModelLoader* modelLoader;
+    InternalFontLoader* fontLoader;
+};
+
+MAKE_POOL_MANAGER(PackPoolManager, PackPool)
+
+int main(int argc, char** argv) {
+    RenderConfig conf;
+    bool atlas = false, compact = false;
+    std::vector<std::string> files;
+    for(int i = 1; i < argc; i++) {
+	std::string arg = argv[i];
+	if(arg == "--mips") {
+	    conf.mip_mapping = true;
+	} else if(arg == "--srgb") {
+	    conf.srgb = true;
+	} else if(arg == "--compressed") {
+	    conf.use_compressed_textures = true;
+	} else if(arg == "--atlas") {
+	    atlas = true;
+	} else if(arg == "--optimise") {
+	    conf.optimise_meshes = true;
+	    conf.generate_lods = true;
+	    conf.meshlet_culling = true;
+	} else if(arg == "--compact") {
+	    compact = true;
+	} else {
+	    files.push_back(arg);
+	}
+    }
+    if(files.size() < 2) {
+	std::cout << "usage: asset_packer [--mips] [--srgb] [--compressed] [--atlas]"
+	    " [--optimise] [--compact] <pack file> <files...>\n";
+	return 1;
+    }
+    std::string packPath = files[0];
+    files.erase(files.begin());
+
+    PackPoolManager pools;
+    PackPool* pool = pools.AddPool(new PackPool(&pools, conf), pools.NextPoolIndex());
+    try {
+	for(auto &path: files) {
+	    if(hasExtension(path, TEXTURE_EXTENSIONS)) {
+		if(atlas)
+		    pool->texLoader->loadToAtlas(path);
+		else
+		    pool->texLoader->load(path);
+	    } else if(hasExtension(path, FONT_EXTENSIONS)) {
+		pool->fontLoader->load(path);
+	    } else {
+		pool->modelLoader->loadFile(path, compact);
+	    }
+	}
+    } catch(std::exception &e) {
+	std::cout << "failed to load - " << e.what() << "\n";
+	return 1;
+    }
+
+    assetpack::Contents contents = assetpack::pack(
+	    pool->texLoader, pool->modelLoader, pool->fontLoader);
+    if(!assetpack::write(contents, packPath)) {
+	std::cout << "failed to write " << packPath << "\n";
+	return 1;
+    }
+    size_t textureBytes = 0, vertexBytes = 0;
+    for(auto &tex: contents.textures)
+	textureBytes += tex.pixels.size();
+    for(auto &model: contents.models)
+	for(auto &mesh: model.meshes)
+	    vertexBytes += mesh.vertexData.size();
+    std::cout << std::fixed << std::setprecision(2)
+	      << packPath
+	      << " - textures: " << contents.textures.size()
+	      << " (" << textureBytes / 1024.0 << "KB)"
+	      << " - models: " << contents.models.size()
+	      << " (" << vertexBytes / 1024.0 << "KB of vertices)"
+	      << " - fonts: " << contents.fonts.size() << "\n";
+}
@@ -0,0 +1,125 @@
+#include <render-internal/resource-loaders/model_loader.h>
+#include <render-internal/resource-loaders/mesh_optimiser.h>
+#include <render-internal/resource-loaders/mesh_simplifier.h>
+#include <iostream>
+#include <iomanip>
+#include <string>
+#include <vector>
+
+// A tool for checking the mesh optimiser (see RenderConfig::optimise_meshes)
+// Runs on the cpu only, so doesn't need a window or gpu.
+//
+// Reports the vertex cache ACMR and ATVR for each model,
+// as loaded and after optimising, for a simulated FIFO cache of 16 and 32 entries.
+// Also lists the triangle counts of the generated levels of detail
+// (see RenderConfig::generate_lods)
+//
+// usage: mesh_report [model files...]
+// with no args, reports on the models in resources/models
+
+// only need the model file loading of the internal loader
+class CpuModelLoader : public InternalModelLoader {
+public:
+    CpuModelLoader() : InternalModelLoader(Resource::Pool(0), nullptr, RenderConfig()) {}
+    void loadGPU() override {}
+    void appendGPU() override {}
+    void clearGPU() override {}
+    Resource::ModelAnimation getAnimation(Resource::Model model, std::string animation) override {
+	return Resource::ModelAnimation();
+    }
+    Resource::ModelAnimation getAnimation(Resource::Model model, int index) override {
+	return Resource::ModelAnimation();
+    }
+};
+
+const std::vector<std::string> DEFAULT_MODELS = {
+    "models/ROOM.fbx",
+    "models/coloured_cube_test.fbx",
+    "models/monkey.obj",
+    "models/robot.gltf",
+    "models/sphere.obj",
+    "models/teapot.obj",
+    "models/testScene.fbx",
+    "models/wolf.fbx",
+};
+
+struct Report {
+    size_t tris = 0;
+    size_t verts = 0;
+    size_t transforms16 = 0;
+    size_t transforms32 = 0;
+
+    void add(ModelInfo::Mesh &mesh) {
+	tris += mesh.indices.size() / 3;
+	verts += mesh.verticies.size();
+	transforms16 += meshopt::analyseVertexCache(
+		mesh.indices, mesh.verticies.size(), 16).transforms;
+	transforms32 += meshopt::analyseVertexCache(
+		mesh.indices, mesh.verticies.size(), 32).transforms;
+    }
+
+    void print(std::string label) {
+	std::cout << "  " << std::left << std::setw(12) << label << std::right
+		  << std::setw(10) << (tris ? (float)transforms16 / tris : 0)
+		  << std::setw(10) << (verts ? (float)transforms16 / verts : 0)
+		  << std::setw(10) << (tris ? (float)transforms32 / tris : 0)
+		  << std::setw(10) << (verts ? (float)transforms32 / verts : 0) << "\n";
+    }
+};
+
+int main(int argc, char** argv) {
+    std::vector<std::string> models(argv + 1, argv + argc);
+    if(models.size() == 0)
+	models = DEFAULT_MODELS;
+
+    CpuModelLoader loader;
+    std::cout << std::fixed << std::setprecision(3);
+    Report totalBefore, totalAfter;
+    for(auto &path: models) {
+	ModelInfo::Model model;
+	try {
+	    model = loader.loadModelData(path);
+	} catch(std::exception &e) {
+	    std::cout << "failed to load " << path << " - " << e.what() << "\n";
+	    continue;
+	}
+	Report before, after;
+	for(auto &mesh: model.meshes) {
+	    before.add(mesh);
+	    meshopt::optimiseMesh(mesh);
+	    after.add(mesh);
+	}
+	std::cout << path << " - meshes: " << model.meshes.size()
+		  << " - triangles: " << before.tris
+		  << " - vertices: " << before.verts << "\n";
+	std::cout << "  " << std::left << std::setw(12) << "" << std::right
+		  << std::setw(10) << "ACMR 16" << std::setw(10) << "ATVR 16"
+		  << std::setw(10) << "ACMR 32" << std::setw(10) << "ATVR 32" << "\n";
+	before.print("loaded");
+	after.print("optimised");
+	size_t lodTris[MAX_MODEL_LODS] = { 0 };
+	for(auto &mesh: model.meshes) {
+	    auto lods = meshopt::generateLods(mesh, MAX_MODEL_LODS - 1);
+	    // meshes with fewer lods get drawn at their lowest one
+	    std::vector<unsigned int>* lod = &mesh.indices;
+	    for(unsigned int i = 0; i < MAX_MODEL_LODS; i++) {
+		if(i > 0 && i - 1 < lods.size())
+		    lod = &lods[i - 1];
+		lodTris[i] += lod->size() / 3;
+	    }
+	}
+	std::cout << "  lod triangles:";
+	for(unsigned int i = 0; i < MAX_MODEL_LODS; i++)
+	    std::cout << " " << lodTris[i];
+	std::cout << "\n";
+	for(auto &mesh: model.meshes)
+	    totalAfter.add(mesh);
+	totalBefore.tris += before.tris;
+	totalBefore.verts += before.verts;
+	totalBefore.transforms16 += before.transforms16;
+	totalBefore.transforms32 += before.transforms32;
+    }
+    std::cout << "all models\n";
+    totalBefore.print("loaded");
+    totalAfter.print("optimised");
+}
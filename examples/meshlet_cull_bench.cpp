@@ -0,0 +1,144 @@
+#include <render-internal/resource-loaders/model_loader.h>
+#include <render-internal/resource-loaders/mesh_optimiser.h>
+#include <render-internal/resource-loaders/meshlets.h>
+#include <glm/gtc/matrix_transform.hpp>
+#include <chrono>
+#include <cmath>
+#include <iostream>
+#include <iomanip>
+#include <string>
+#include <vector>
+
+// A benchmark for meshlet culling (see RenderConfig::meshlet_culling)
+// Runs on the cpu only, so doesn't need a window or gpu.
+//
+// Places a grid of instances of each model and orbits a camera through them,
+// reporting how many triangles would be submitted and culled each frame,
+// with frustum culling only and with cone culling as well,
+// and how long the culling took.
+//
+// usage: meshlet_cull_bench [model files...]
+// with no args, uses testScene.fbx and ROOM.fbx from resources/models
+
+// only need the model file loading of the internal loader
+class CpuModelLoader : public InternalModelLoader {
+public:
+    CpuModelLoader() : InternalModelLoader(Resource::Pool(0), nullptr, RenderConfig()) {}
+    void loadGPU() override {}
+    void appendGPU() override {}
+    void clearGPU() override {}
+    Resource::ModelAnimation getAnimation(Resource::Model model, std::string animation) override {
+	return Resource::ModelAnimation();
+    }
+    Resource::ModelAnimation getAnimation(Resource::Model model, int index) override {
+	return Resource::ModelAnimation();
+    }
+};
+
+const std::vector<std::string> DEFAULT_MODELS = {
+    "models/testScene.fbx",
+    "models/ROOM.fbx",
+};
+
+const int GRID_SIZE = 4;
+const int FRAMES = 64;
+
+struct BenchResult {
+    uint64_t drawn = 0;
+    uint64_t culled = 0;
+    double ms = 0;
+};
+
+BenchResult runBench(ModelInfo::Model &model,
+		     std::vector<std::vector<meshopt::Meshlet>> &meshlets,
+		     std::vector<glm::mat4> &instances,
+		     glm::vec3 centre, float radius, bool coneCulling) {
+    meshopt::MeshletCuller culler(coneCulling);
+    glm::mat4 proj = glm::perspective(glm::radians(45.0f), 16.0f / 9.0f, 0.1f, radius * 10.0f);
+    BenchResult result;
+    for(int frame = 0; frame < FRAMES; frame++) {
+	// orbit inside the grid, so some instances are behind the camera
+	float angle = frame * 2.0f * 3.14159265f / FRAMES;
+	glm::vec3 camPos = centre + glm::vec3(std::cos(angle), 0.3f, std::sin(angle)) * radius * 0.6f;
+	culler.setCamera(glm::lookAt(camPos, centre, glm::vec3(0, 1, 0)), proj);
+	auto start = std::chrono::high_resolution_clock::now();
+	for(size_t i = 0; i < meshlets.size(); i++) {
+	    if(meshlets[i].empty()) {
+		// too small to split, always submitted
+		culler.trianglesDrawn += model.meshes[i].indices.size() / 3 * instances.size();
+		continue;
+	    }
+	    culler.cull(meshlets[i], instances.data(), sizeof(glm::mat4), instances.size(), false);
+	}
+	result.ms += std::chrono::duration<double, std::milli>(
+		std::chrono::high_resolution_clock::now() - start).count();
+    }
+    result.drawn = culler.trianglesDrawn / FRAMES;
+    result.culled = culler.trianglesCulled / FRAMES;
+    result.ms /= FRAMES;
+    return result;
+}
+
+void printResult(std::string label, BenchResult result) {
+    uint64_t total = result.drawn + result.culled;
+    std::cout << "  " << std::left << std::setw(16) << label << std::right
+	      << std::setw(12) << result.drawn
+	      << std::setw(12) << result.culled
+	      << std::setw(10) << (total ? 100.0f * result.culled / total : 0) << "%"
+	      << std::setw(10) << result.ms << "\n";
+}
+
+int main(int argc, char** argv) {
+    std::vector<std::string> models(argv + 1, argv + argc);
+    if(models.size() == 0)
+	models = DEFAULT_MODELS;
+
+    CpuModelLoader loader;
+    std::cout << std::fixed << std::setprecision(3);
+    for(auto &path: models) {
+	ModelInfo::Model model;
+	try {
+	    model = loader.loadModelData(path);
+	} catch(std::exception &e) {
+	    std::cout << "failed to load " << path << " - " << e.what() << "\n";
+	    continue;
+	}
+	std::vector<std::vector<meshopt::Meshlet>> meshlets(model.meshes.size());
+	size_t meshletCount = 0;
+	glm::vec3 minPos(0), maxPos(0);
+	bool first = true;
+	for(size_t i = 0; i < model.meshes.size(); i++) {
+	    ModelInfo::Mesh &mesh = model.meshes[i];
+	    meshopt::optimiseMesh(mesh);
+	    meshlets[i] = meshopt::buildMeshlets(mesh);
+	    meshletCount += meshlets[i].size();
+	    for(auto &v: mesh.verticies) {
+		glm::vec3 p = mesh.bindTransform * glm::vec4(v.Position, 1.0f);
+		minPos = first ? p : glm::min(minPos, p);
+		maxPos = first ? p : glm::max(maxPos, p);
+		first = false;
+	    }
+	}
+	float size = glm::length(maxPos - minPos);
+	if(size == 0)
+	    size = 1.0f;
+	std::vector<glm::mat4> instances;
+	for(int x = 0; x < GRID_SIZE; x++)
+	    for(int z = 0; z < GRID_SIZE; z++)
+		instances.push_back(glm::translate(
+					    glm::mat4(1.0f),
+					    glm::vec3(x, 0, z) * size * 1.5f));
+	glm::vec3 centre = (minPos + maxPos) * 0.5f +
+	    glm::vec3(GRID_SIZE - 1, 0, GRID_SIZE - 1) * size * 0.75f;
+	float radius = size * 1.5f * GRID_SIZE * 0.5f;
+
+	std::cout << path << " - meshes: " << model.meshes.size()
+		  << " - meshlets: " << meshletCount
+		  << " - instances: " << instances.size() << "\n";
+	std::cout << "  " << std::left << std::setw(16) << "per frame" << std::right
+		  << std::setw(12) << "submitted" << std::setw(12) << "culled"
+		  << std::setw(11) << "culled" << std::setw(10) << "ms" << "\n";
+	printResult("frustum", runBench(model, meshlets, instances, centre, radius, false));
+	printResult("frustum + cone", runBench(model, meshlets, instances, centre, radius, true));
+    }
+}
@@ -0,0 +1,107 @@
+#include <graphics/manager.h>
+#include <chrono>
+#include <cstdio>
+#include <iostream>
+#include <iomanip>
+#include <string>
+#include <vector>
+
+#include "helper.h"
+
+// This example benchmarks loading models with assimp against
+// loading the cooked version of the model (see RenderConfig::cook_models)
+//
+// For every model in resources/models it times
+//   - the first assimp import of the file in this process
+//   - later assimp imports, once assimp and the file are warm
+//   - cooking the model (an assimp import plus writing the cooked file)
+//   - loading the cooked file, which was just written so is warm too
+// and prints the results, then exits.
+// The speedup compares the warm imports with the cooked loads, so both read
+// from the page cache. The page cache isn't dropped, so the first import
+// can still be warm if the files were read recently.
+
+const char* MODELS[] = {
+    "models/ROOM.fbx",
+    "models/coloured_cube_test.fbx",
+    "models/monkey.fbx",
+    "models/monkey.glb",
+    "models/monkey.obj",
+    "models/robot.gltf",
+    "models/sphere.obj",
+    "models/teapot.obj",
+    "models/testScene.fbx",
+    "models/wolf.dae",
+    "models/wolf.fbx",
+};
+
+const int RUNS = 5;
+
+// average time in ms to get the model data with the given pool
+template <typename Fn>
+double timeLoad(Fn fn, int runs) {
+    auto start = std::chrono::high_resolution_clock::now();
+    for(int i = 0; i < runs; i++)
+	fn();
+    std::chrono::duration<double, std::milli> elapsed =
+	std::chrono::high_resolution_clock::now() - start;
+    return elapsed.count() / runs;
+}
+
+int main(int argc, char** argv) {
+    ManagerState state;
+    state.windowTitle = "model cooking benchmark";
+    state.hideWindowOnCreate = true;
+    parseArgs(argc, argv, &state);
+    Manager manager(state);
+
+    // default pool was made without cooking
+    ResourcePool* assimpPool = manager.render->pool();
+
+    RenderConfig conf = manager.render->getRenderConf();
+    conf.cook_models = true;
+    manager.render->setRenderConf(conf);
+    ResourcePool* cookedPool = manager.render->CreateResourcePool();
+
+    std::cout << std::left << std::setw(32) << "model"
+	      << std::right << std::setw(12) << "first ms"
+	      << std::setw(12) << "assimp ms"
+	      << std::setw(12) << "cook ms"
+	      << std::setw(12) << "cooked ms"
+	      << std::setw(10) << "speedup" << "\n";
+    std::cout << std::fixed << std::setprecision(2);
+
+    double assimpTotal = 0, cookedTotal = 0;
+    for(const char* path: MODELS) {
+	std::string cooked = std::string(path) + ".cooked";
+	std::remove(cooked.c_str());
+
+	double firstTime = timeLoad([&]{
+	    assimpPool->model()->loadModelData(path);
+	}, 1);
+	double assimpTime = timeLoad([&]{
+	    assimpPool->model()->loadModelData(path);
+	}, RUNS);
+	double cookTime = timeLoad([&]{
+	    cookedPool->model()->loadModelData(path);
+	}, 1);
+	double cookedTime = timeLoad([&]{
+	    cookedPool->model()->loadModelData(path);
+	}, RUNS);
+
+	assimpTotal += assimpTime;
+	cookedTotal += cookedTime;
+	std::cout << std::left << std::setw(32) << path
+		  << std::right << std::setw(12) << firstTime
+		  << std::setw(12) << assimpTime
+		  << std::setw(12) << cookTime
+		  << std::setw(12) << cookedTime
+		  << std::setw(9) << assimpTime / cookedTime << "x\n";
+    }
+    std::cout << std::left << std::setw(32) << "total"
+	      << std::right << std::setw(12) << ""
+	      << std::setw(12) << assimpTotal
+	      << std::setw(12) << ""
+	      << std::setw(12) << cookedTotal
+	      << std::setw(9) << assimpTotal / cookedTotal << "x\n";
+}
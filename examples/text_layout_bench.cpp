@@ -0,0 +1,120 @@
+#include <render-internal/resource-loaders/font_loader.h>
+#include <render-internal/resource-loaders/texture_loader.h>
+#include <atomic>
+#include <chrono>
+#include <cstdlib>
+#include <iostream>
+#include <iomanip>
+#include <new>
+#include <string>
+#include <vector>
+
+// A benchmark for laying out text (see Render::DrawString)
+// Runs on the cpu only, so doesn't need a window or gpu.
+//
+// Lays out STRINGS_PER_FRAME strings a frame the way a renderer does,
+// reusing one buffer for the quads, and reports how long the layout
+// and measuring took, and how many heap allocations each frame made.
+//
+// usage: text_layout_bench [font file]
+// with no args, uses textures/Roboto-Black.ttf from resources
+
+// every allocation in the program is counted
+std::atomic<uint64_t> allocations(0);
+
+void* operator new(size_t size) {
+    allocations++;
+    void* p = std::malloc(size == 0 ? 1 : size);
+    if(p == nullptr)
+	throw std::bad_alloc();
+    return p;
+}
+
+void operator delete(void* p) noexcept {
+    std::free(p);
+}
+
+void operator delete(void* p, size_t) noexcept {
+    std::free(p);
+}
+
+const std::string DEFAULT_FONT = "textures/Roboto-Black.ttf";
+
+const int STRINGS_PER_FRAME = 10000;
+const int FRAMES = 60;
+
+// ui text of a few different lengths, longer than small string buffers
+std::vector<std::string> makeStrings() {
+    const std::vector<std::string> words = {
+	"Health", "Score:", "the", "quick", "brown", "fox", "jumps", "over",
+	"lazy", "dog", "Inventory", "0123456789", "Press [E] to interact", "~!?",
+    };
+    std::vector<std::string> strings;
+    for(int i = 0; i < STRINGS_PER_FRAME; i++) {
+	std::string s;
+	int count = 1 + i % 6;
+	for(int w = 0; w < count; w++) {
+	    if(w > 0)
+		s += ' ';
+	    s += words[(i * 7 + w * 3) % words.size()];
+	}
+	strings.push_back(s);
+    }
+    return strings;
+}
+
+int main(int argc, char** argv) {
+    std::string path = argc > 1 ? argv[1] : DEFAULT_FONT;
+
+    TextureCache cache;
+    InternalTexLoader texLoader(Resource::Pool(0), RenderConfig(), &cache);
+    InternalFontLoader fontLoader(Resource::Pool(0), &texLoader);
+    Resource::Font font;
+    try {
+	font = fontLoader.load(path);
+    } catch(std::exception &e) {
+	std::cout << "failed to load " << path << " - " << e.what() << "\n";
+	return 1;
+    }
+    fontLoader.loadGPU();
+
+    std::vector<std::string> strings = makeStrings();
+    std::vector<Resource::QuadDraw> draws;
+    double layoutMs = 0;
+    double lengthMs = 0;
+    uint64_t quads = 0;
+    uint64_t frameAllocations = 0;
+    float totalLength = 0;
+    // the first frame grows the quad buffer, so isn't counted
+    for(int frame = -1; frame < FRAMES; frame++) {
+	uint64_t allocationsBefore = allocations;
+	auto start = std::chrono::high_resolution_clock::now();
+	for(int i = 0; i < STRINGS_PER_FRAME; i++) {
+	    draws.clear();
+	    fontLoader.DrawString(font, strings[i], glm::vec2(10, 20 * (i % 50)),
+				  0.2f, 1.0f, glm::vec4(1), 0.0f, &draws);
+	    if(frame >= 0)
+		quads += draws.size();
+	}
+	auto laidOut = std::chrono::high_resolution_clock::now();
+	for(int i = 0; i < STRINGS_PER_FRAME; i++)
+	    totalLength += fontLoader.length(font, strings[i], 0.2f);
+	auto measured = std::chrono::high_resolution_clock::now();
+	if(frame < 0)
+	    continue;
+	frameAllocations += allocations - allocationsBefore;
+	layoutMs += std::chrono::duration<double, std::milli>(laidOut - start).count();
+	lengthMs += std::chrono::duration<double, std::milli>(measured - laidOut).count();
+    }
+
+    std::cout << std::fixed << std::setprecision(3);
+    std::cout << path << " - strings per frame: " << STRINGS_PER_FRAME
+	      << " - frames: " << FRAMES << "\n";
+    std::cout << "  quads per frame:       " << quads / FRAMES << "\n";
+    std::cout << "  DrawString ms:         " << layoutMs / FRAMES << "\n";
+    std::cout << "  length ms:             " << lengthMs / FRAMES << "\n";
+    std::cout << "  allocations per frame: " << frameAllocations / FRAMES << "\n";
+    // so the lengths aren't optimised away
+    if(totalLength < 0)
+	std::cout << totalLength << "\n";
+}
@@ -0,0 +1,132 @@
+#include <render-internal/resource-loaders/texture_cache.h>
+#include <render-internal/resource-loaders/compressed_texture.h>
+#include <render-internal/resource-loaders/mipmaps.h>
+#include <iostream>
+#include <iomanip>
+#include <string>
+#include <vector>
+#include <algorithm>
+
+// A tool for baking textures into block compressed KTX2 files
+// (see RenderConfig::use_compressed_textures)
+// Runs on the cpu only, so doesn't need a window or gpu.
+//
+// Saves each texture next to the original as <texture>.ktx2 with its mip chain
+// (made the same way as RenderConfig::mip_mapping does),
+// and reports the size it would take in gpu memory as RGBA8 and compressed.
+//
+// usage: texture_compressor [-f bc1|bc3|bc4|bc5] [--srgb] [texture files...]
+// without -f, opaque textures use BC1 and ones with transparency use BC3.
+// with no files, compresses the textures in resources/textures
+
+const std::vector<std::string> DEFAULT_TEXTURES = {
+    "textures/error.png",
+    "textures/Cube.png",
+    "textures/Cylinder.png",
+    "textures/cone.png",
+    "textures/icosphere.png",
+    "textures/sphere.png",
+};
+
+bool hasTransparency(const unsigned char* rgba, size_t pixels) {
+    for(size_t i = 0; i < pixels; i++)
+	if(rgba[i * 4 + 3] < 255)
+	    return true;
+    return false;
+}
+
+std::string formatName(TextureFormat format) {
+    switch(format) {
+    case TextureFormat::BC1: return "BC1";
+    case TextureFormat::BC3: return "BC3";
+    case TextureFormat::BC4: return "BC4";
+    case TextureFormat::BC5: return "BC5";
+    case TextureFormat::BC7: return "BC7";
+    default: return "RGBA8";
+    }
+}
+
+int main(int argc, char** argv) {
+    bool chooseFormat = true;
+    TextureFormat format = TextureFormat::BC1;
+    bool srgb = false;
+    std::vector<std::string> textures;
+    for(int i = 1; i < argc; i++) {
+	std::string arg = argv[i];
+	if(arg == "--srgb") {
+	    srgb = true;
+	} else if(arg == "-f" && i + 1 < argc) {
+	    std::string f = argv[++i];
+	    chooseFormat = false;
+	    if(f == "bc1") format = TextureFormat::BC1;
+	    else if(f == "bc3") format = TextureFormat::BC3;
+	    else if(f == "bc4") format = TextureFormat::BC4;
+	    else if(f == "bc5") format = TextureFormat::BC5;
+	    else {
+		std::cout << "unsupported format: " << f << "\n";
+		return 1;
+	    }
+	} else {
+	    textures.push_back(arg);
+	}
+    }
+    if(textures.size() == 0)
+	textures = DEFAULT_TEXTURES;
+
+    TextureCache cache;
+    size_t totalRaw = 0, totalCompressed = 0;
+    std::cout << std::fixed << std::setprecision(2);
+    for(auto &path: textures) {
+	TextureCache::Entry* entry;
+	unsigned char* rgba;
+	try {
+	    entry = cache.acquire(path, 4);
+	    if(entry->format != TextureFormat::RGBA8) {
+		std::cout << path << " - already compressed\n";
+		cache.release(entry);
+		continue;
+	    }
+	    rgba = cache.decode(entry);
+	} catch(std::exception &e) {
+	    std::cout << "failed to load " << path << " - " << e.what() << "\n";
+	    continue;
+	}
+	int w = entry->width, h = entry->height;
+	TextureFormat texFormat = format;
+	if(chooseFormat)
+	    texFormat = hasTransparency(rgba, (size_t)w * h) ?
+		TextureFormat::BC3 : TextureFormat::BC1;
+	std::vector<size_t> levelSizes = mipgen::levelSizes(w, h);
+	std::vector<unsigned char> generated = mipgen::generate(rgba, w, h, srgb);
+	std::vector<std::vector<unsigned char>> mips(levelSizes.size());
+	std::vector<const unsigned char*> mipData(mips.size());
+	std::vector<size_t> mipSizes(mips.size());
+	const unsigned char* level = rgba;
+	size_t rawSize = 0, compressedSize = 0;
+	for(size_t i = 0; i < mips.size(); i++) {
+	    int mipW = std::max(w >> i, 1), mipH = std::max(h >> i, 1);
+	    rawSize += levelSizes[i];
+	    mips[i] = compressedtex::encode(texFormat, level, mipW, mipH);
+	    mipData[i] = mips[i].data();
+	    mipSizes[i] = mips[i].size();
+	    compressedSize += mips[i].size();
+	    level = i == 0 ? generated.data() : level + levelSizes[i];
+	}
+	cache.release(entry);
+	std::string out = compressedtex::compressedPath(path);
+	if(!compressedtex::writeKtx2(out, texFormat, srgb, w, h, mipData, mipSizes)) {
+	    std::cout << "failed to write " << out << "\n";
+	    continue;
+	}
+	totalRaw += rawSize;
+	totalCompressed += compressedSize;
+	std::cout << out << " - " << w << "x" << h << " " << formatName(texFormat)
+		  << " - mips: " << mips.size()
+		  << " - RGBA8: " << rawSize / 1024.0 << "KB"
+		  << " - compressed: " << compressedSize / 1024.0 << "KB\n";
+    }
+    if(totalCompressed > 0)
+	std::cout << "total - RGBA8: " << totalRaw / 1024.0 << "KB"
+		  << " - compressed: " << totalCompressed / 1024.0 << "KB"
+		  << " - " << (float)totalRaw / totalCompressed << "x smaller\n";
+}
@@ -0,0 +1,136 @@
+#ifndef GRAPHICS_WORLD_STREAMER_H
+#define GRAPHICS_WORLD_STREAMER_H
+
+#include <graphics/render.h>
+#include <glm/glm.hpp>
+#include <functional>
+#include <future>
+#include <string>
+#include <vector>
+
+/// A part of the world with its own resource pool, see WorldStreamer
+struct StreamRegion {
+    /// bounds of the region, in world space
+    glm::vec3 min;
+    glm::vec3 max;
+    /// asset packs made by the asset_packer tool, loaded with ResourcePool::loadPack
+    std::vector<std::string> packs;
+    /// files loaded with the pool's loaders, models are loaded with vertex::v3D
+    std::vector<std::string> textures;
+    std::vector<std::string> models;
+    std::vector<std::string> fonts;
+    /// Optional, called after the files are staged to stage anything else into the pool.
+    /// Runs on the streaming thread, so shouldn't touch the renderer.
+    std::function<void(ResourcePool*)> stage;
+};
+
+/// something that could have caused a frame to take longer than it should
+struct StreamHitch {
+    enum class Type {
+	/// a render call the streamer made took longer than the hitch threshold
+	stall,
+	/// the camera was in the region before it was ready
+	late,
+    };
+    Type type;
+    size_t region;
+    /// how long the call took, 0 for late regions
+    float ms;
+};
+
+struct StreamConfig {
+    /// regions closer than this to the camera are loaded, nearest first
+    float loadDistance = 100.0f;
+    /// bytes of gpu memory the regions' pools can use between them.
+    /// regions that aren't wanted are evicted, least recently wanted first, to stay under it.
+    /// 0 for no limit.
+    uint64_t memoryBudget = 0;
+    /// render calls taking longer than this are reported as hitches
+    float hitchThresholdMs = 2.0f;
+};
+
+/// Streams the pools of regions in and out around the camera, so worlds
+/// can be bigger than the gpu memory without any loading screens.
+/// Files are staged and decoded on a background thread, and the pools are copied
+/// to the gpu with LoadResourcesToGPUAsync, so the render thread doesn't decode
+/// anything or wait for the copies. It still creates the gpu buffers and records the copies.
+/// Only one region is staged at a time. Its pool is marked with ResourcePool::setStaging
+/// while it is, and the renderer can still create and destroy other pools.
+///
+/// The size of a region isn't known until it has been loaded once,
+/// so the budget can be overshot by the first load of a region, until
+/// other regions are evicted to make up for it.
+class WorldStreamer {
+public:
+    WorldStreamer(Render* render, StreamConfig config);
+    /// waits for any staging to finish, then destroys the regions' pools
+    ~WorldStreamer();
+    WorldStreamer(const WorldStreamer&) = delete;
+    WorldStreamer& operator=(const WorldStreamer&) = delete;
+
+    /// returns the index of the region
+    size_t addRegion(StreamRegion region);
+
+    /// Call once a frame on the render thread, before drawing.
+    /// Starts and finishes loads and evicts regions based on the camera position.
+    void update(glm::vec3 cameraPos);
+
+    /// the region's resources can be drawn
+    bool ready(size_t region);
+    /// Resources of a ready region by the path they were loaded from,
+    /// null if the region isn't ready. Resources the stage function loaded aren't in here.
+    const Resource::PackedResources* resources(size_t region);
+    /// the pool of a region, null unless it is uploading or ready
+    ResourcePool* pool(size_t region);
+
+    /// gpu memory of the ready and uploading regions,
+    /// uploading ones are counted by their size last time they were loaded.
+    uint64_t memoryUsed();
+    /// the hitches since the last call
+    std::vector<StreamHitch> takeHitches();
+
+private:
+    enum class RegionState {
+	unloaded,
+	staging,
+	uploading,
+	ready,
+    };
+    struct Region {
+	StreamRegion desc;
+	RegionState state = RegionState::unloaded;
+	ResourcePool* pool = nullptr;
+	Resource::LoadTicket ticket;
+	Resource::PackedResources resources;
+	/// gpu memory the region used last time it was loaded, 0 if it never was
+	uint64_t memory = 0;
+	/// the update it was last wanted in
+	uint64_t lastWanted = 0;
+	/// the camera is in it, so it has already been reported if late
+	bool cameraInside = false;
+	/// staging threw, so it isn't tried again
+	bool failed = false;
+    };
+
+    void startStaging(size_t region);
+    void finishStaging();
+    void evict(size_t region);
+    /// evict regions that aren't wanted until size more bytes fits in the budget.
+    /// returns false if it can't.
+    bool makeSpace(uint64_t size);
+    /// call a render function, reporting it if it takes too long
+    void timed(size_t region, std::function<void()> call);
+
+    Render* render;
+    StreamConfig config;
+    std::vector<Region> regions;
+    uint64_t updateCount = 0;
+    /// the region being staged on the streaming thread, if staging is valid.
+    /// staged resources are returned rather than written to the region,
+    /// as adding regions can move them.
+    size_t stagingRegion;
+    std::future<Resource::PackedResources> staging;
+    std::vector<StreamHitch> hitches;
+};
+
+#endif /* GRAPHICS_WORLD_STREAMER_H */
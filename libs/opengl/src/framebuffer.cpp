@@ -35,6 +35,8 @@ GlFramebuffer::GlFramebuffer(GLsizei width, GLsizei height, int samples,
 
     this->attachments = new InternalAttachment[attachments.size()];
     this->attachmentCount = attachments.size();
+    // drivers usually pad RGB to 4 bytes, and depth stencil is 4 bytes
+    this->memSize = (size_t)width * height * samples * 4 * attachments.size();
     std::vector<GLenum> drawBuffers;
 
     for(unsigned int i = 0; i < attachments.size(); i++)
@@ -3,6 +3,7 @@
 
 #include <glad/glad.h>
 #include <vector>
+#include <cstddef>
 
 struct InternalAttachment;
 
@@ -33,10 +34,13 @@ class GlFramebuffer {
     ~GlFramebuffer();
     GLuint id();
     GLuint textureId(unsigned int attachmentIndex);
+    /// rough bytes of the attachments, taking every pixel as 4 bytes per sample
+    size_t memorySize() { return memSize; }
  private:
     GLuint framebuffer;
     InternalAttachment* attachments;
     int attachmentCount;
+    size_t memSize;
 };
 
 
@@ -44,4 +44,57 @@ void createShaderStorageBuffer(GLuint* glBuffer, size_t bufferSize, void* pBuffe
       glBindTexture(texType, 0);
       return texture;
   }
+
+  GLuint genMipmappedTexture(GLuint format, bool compressed, GLsizei width, GLsizei height,
+			     unsigned char* data, const size_t* mipSizes, size_t mipCount,
+			     size_t firstMip, int filtering, int addressingMode) {
+      GLuint texture;
+      glGenTextures(1, &texture);
+      glBindTexture(GL_TEXTURE_2D, texture);
+      // only the levels from the base level up have to exist for the texture to be complete
+      for(size_t i = 0; i < mipCount; i++) {
+	  if(i >= firstMip) {
+	      if(compressed)
+		  glCompressedTexImage2D(GL_TEXTURE_2D, (GLint)i, format, width, height, 0,
+					 (GLsizei)mipSizes[i], data);
+	      else
+		  glTexImage2D(GL_TEXTURE_2D, (GLint)i, format, width, height, 0,
+			       format, GL_UNSIGNED_BYTE, data);
+	      data += mipSizes[i];
+	  }
+	  if(width > 1) width /= 2;
+	  if(height > 1) height /= 2;
+      }
+      glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_BASE_LEVEL, (GLint)firstMip);
+      glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAX_LEVEL, (GLint)mipCount - 1);
+
+      glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, addressingMode);
+      glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, addressingMode);
+
+      // linear between mips, like the vulkan sampler
+      int minFilter = filtering;
+      if(mipCount > 1)
+	  minFilter = filtering == GL_NEAREST ? GL_NEAREST_MIPMAP_LINEAR : GL_LINEAR_MIPMAP_LINEAR;
+      glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, minFilter);
+      glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, filtering);
+
+      glBindTexture(GL_TEXTURE_2D, 0);
+      return texture;
+  }
+
+  void addTextureMip(GLuint texture, GLuint format, bool compressed,
+		     GLsizei width, GLsizei height, GLint level,
+		     const unsigned char* data, size_t size) {
+      width = width >> level > 0 ? width >> level : 1;
+      height = height >> level > 0 ? height >> level : 1;
+      glBindTexture(GL_TEXTURE_2D, texture);
+      if(compressed)
+	  glCompressedTexImage2D(GL_TEXTURE_2D, level, format, width, height, 0,
+				 (GLsizei)size, data);
+      else
+	  glTexImage2D(GL_TEXTURE_2D, level, format, width, height, 0,
+		       format, GL_UNSIGNED_BYTE, data);
+      glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_BASE_LEVEL, level);
+      glBindTexture(GL_TEXTURE_2D, 0);
+  }
 }
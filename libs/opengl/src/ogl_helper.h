@@ -15,6 +15,19 @@ namespace ogl_helper {
     /// samples = 1 means no multisamping
     GLuint genTexture(GLuint format, GLsizei width, GLsizei height, unsigned char* data,
 		      bool mipmapping, int filtering, int adressingMode, unsigned int samples);
+
+    /// data holds the levels from firstMip to mipCount one after the other, from largest
+    /// to smallest, with mipSizes bytes each. format is a compressed internal format if compressed.
+    /// Levels before firstMip are left out, for streaming in later with addTextureMip.
+    GLuint genMipmappedTexture(GLuint format, bool compressed, GLsizei width, GLsizei height,
+			       unsigned char* data, const size_t* mipSizes, size_t mipCount,
+			       size_t firstMip, int filtering, int adressingMode);
+
+    /// Upload a level of a texture from genMipmappedTexture and start sampling from it,
+    /// width and height are the size of the texture, not of the level.
+    void addTextureMip(GLuint texture, GLuint format, bool compressed,
+		       GLsizei width, GLsizei height, GLint level,
+		       const unsigned char* data, size_t size);
     
 }
 
@@ -11,6 +11,7 @@
 #include "shader.h"
 #include "resources/resource_pool.h"
 #include "spirv_shaders.h"
+#include <render-internal/file_watcher.h>
 
 namespace glenv {
 
@@ -31,6 +32,10 @@ namespace glenv {
       glEnable(GL_BLEND);
       glBlendFunc(GL_SRC_ALPHA, GL_ONE_MINUS_SRC_ALPHA);
       glEnable(GL_CULL_FACE);
+      if(renderConf.meshlet_culling)
+	  meshletCuller = new meshopt::MeshletCuller(true);
+      if(renderConf.hot_reload)
+	  fileWatcher = new FileWatcher();
 
       view2D = glm::mat4(1.0f);
       createShaders();
@@ -55,6 +60,10 @@ namespace glenv {
       delete flatShader;
       delete finalShader;
       delete pools;
+      if(meshletCuller != nullptr)
+	  delete meshletCuller;
+      if(fileWatcher != nullptr)
+	  delete fileWatcher;
   }
 
   void RenderGl::createShaders() {
@@ -124,6 +133,10 @@ namespace glenv {
       
       if(offscreenFramebuffer != nullptr)
 	  delete offscreenFramebuffer;
+      offscreenFramebuffer = nullptr;
+      if(offscreenBlitFramebuffer != nullptr)
+	  delete offscreenBlitFramebuffer;
+      offscreenBlitFramebuffer = nullptr;
 
       std::vector<GlFramebuffer::Attachment> attachments;
       if(useFinalFramebuffer || msaaSamples > 1) {
@@ -182,6 +195,72 @@ namespace glenv {
   void RenderGl::LoadResourcesToGPU(Resource::Pool pool) {
       _throwIfPoolInvaid(pool);
       pools->get(pool)->loadGpu();
+      watchPoolFiles(pool);
+  }
+
+  void RenderGl::AppendResourcesToGPU(Resource::Pool pool) {
+      _throwIfPoolInvaid(pool);
+      pools->get(pool)->appendGpu();
+      watchPoolFiles(pool);
+  }
+
+  void RenderGl::ReloadTexture(Resource::Texture texture) {
+      _throwIfPoolInvaid(texture.pool);
+      pools->get(texture.pool)->texLoader->reload(texture);
+  }
+
+  void RenderGl::ReloadModel(Resource::Model model) {
+      _throwIfPoolInvaid(model.pool);
+      pools->get(model.pool)->modelLoader->reload(model);
+  }
+
+  MemoryUsage RenderGl::GetMemoryUsage() {
+      MemoryUsage usage;
+      for(int i = 0; i < pools->PoolCount(); i++)
+	  if(pools->get(i) != nullptr && !pools->get(i)->isStaging())
+	      usage.pools.push_back({ pools->get(i)->id(), pools->get(i)->memoryUsage() });
+      usage.shaderBuffers = sizeof(perInstance3DModel) + sizeof(perInstance3DNormal)
+	  + sizeof(perInstance2DModel) + sizeof(perInstance2DTexOffset);
+      if(offscreenFramebuffer != nullptr)
+	  usage.frameAttachments += offscreenFramebuffer->memorySize();
+      if(offscreenBlitFramebuffer != nullptr)
+	  usage.frameAttachments += offscreenBlitFramebuffer->memorySize();
+      return usage;
+  }
+
+  void RenderGl::watchPoolFiles(Resource::Pool pool) {
+      if(fileWatcher == nullptr)
+	  return;
+      for(auto &path: pools->get(pool)->texLoader->getLoadedPaths())
+	  fileWatcher->watch(path);
+      for(auto &path: pools->get(pool)->modelLoader->getLoadedPaths())
+	  fileWatcher->watch(path);
+  }
+
+  // a file that can't be read, ie it is still being written,
+  // is tried again the next time it changes
+  void RenderGl::hotReload() {
+      if(fileWatcher == nullptr)
+	  return;
+      for(auto &path: fileWatcher->changed())
+	  for(int i = 0; i < pools->PoolCount(); i++) {
+	      GLResourcePool* pool = pools->get(i);
+	      if(pool == nullptr)
+		  continue;
+	      try {
+		  for(auto &texture: pool->texLoader->getTexturesFrom(path))
+		      ReloadTexture(texture);
+		  for(auto &model: pool->modelLoader->getModelsFrom(path))
+		      ReloadModel(model);
+	      } catch(std::exception &e) {
+		  LOG_ERROR("Failed to reload - path: " << path << " - " << e.what());
+	      }
+	  }
+  }
+
+  Resource::LoadTicket RenderGl::LoadResourcesToGPUAsync(Resource::Pool pool) {
+      LoadResourcesToGPU(pool);
+      return Resource::LoadTicket(pool, 0);
   }
 
   RenderGl::Draw2D::Draw2D(Resource::Texture tex, glm::mat4 model, glm::vec4 colour, glm::vec4 texOffset) {
@@ -268,6 +347,8 @@ namespace glenv {
   }
 
   void RenderGl::EndDraw(std::atomic<bool>& submit) {
+      streamTextures();
+      hotReload();
       glm::vec2 mainResolution = offscreenSize();
       
       glBindFramebuffer(GL_FRAMEBUFFER, useFinalFramebuffer || msaaSamples > 1 ?
@@ -304,8 +385,10 @@ namespace glenv {
 	  }
 	  switch(currentMode) {
 	  case DrawMode::d2D:
+	      // textures in the same atlas page share a batch
 	      if((drawCount > 0 &&
-		 (currentTexture != drawCalls[i].d2D.tex ||
+		 (currentTexture.pool != drawCalls[i].d2D.tex.pool ||
+		  currentTexture.ID != drawCalls[i].d2D.tex.ID ||
 		  currentColour != drawCalls[i].d2D.colour)) ||
 		  drawCount == Resource::MAX_2D_BATCH) {
 		  draw2DBatch(drawCount, currentTexture, currentColour);
@@ -324,14 +407,13 @@ namespace glenv {
 		  drawCount = 0;
 	      }
 	      currentModel = drawCalls[i].d3D.model;
-	      perInstance3DModel[drawCount] = drawCalls[i].d3D.modelMatrix;
-	      perInstance3DNormal[drawCount] = drawCalls[i].d3D.normalMatrix;
+	      batch3DCalls[drawCount] = i;
 	      drawCount++;
 	      break;
 
 	  case DrawMode::d3DAnim:
 	      currentModel = drawCalls[i].d3DAnim.model;
-	      draw3DAnim(currentModel);
+	      draw3DAnim(currentModel, drawCalls[i].d3DAnim.lod);
 	      drawCount = 0;
 	      break;
 	  }
@@ -377,6 +459,13 @@ namespace glenv {
       submit = true;
   }
 
+  void RenderGl::streamTextures() {
+      size_t budget = renderConf.texture_stream_budget;
+      for(int i = 0; i < pools->PoolCount(); i++)
+	  if(pools->get(i) != nullptr)
+	      pools->get(i)->texLoader->streamMips(&budget);
+  }
+
   void RenderGl::draw2DBatch(int drawCount, Resource::Texture texture, glm::vec4 currentColour) {
       if(!_poolInUse(texture.pool)) {
 	  LOG_ERROR("Tried Drawing with pool that is not in use");
@@ -396,11 +485,29 @@ namespace glenv {
 	  LOG_ERROR("Tried Drawing with pool that is not in use");
 	  return;
       }
-      ogl_helper::shaderStorageBufferData(model3DSSBO, sizeAndPtr(perInstance3DModel), 2);
-      ogl_helper::shaderStorageBufferData(normal3DSSBO, sizeAndPtr(perInstance3DNormal), 3);
-      pools->get(model.pool.ID)->modelLoader->DrawModelInstanced(
-	      model, drawCount,
-	      shader3D->Location("spriteColour"), shader3D->Location("enableTex"));
+      // one instanced draw per level of detail, there is no base instance
+      // so the instances of each lod are uploaded seperately.
+      int drawn = 0;
+      for(unsigned int lod = 0; lod < MAX_MODEL_LODS && drawn < drawCount; lod++) {
+	  int lodCount = 0;
+	  for(int i = 0; i < drawCount; i++) {
+	      Draw3D &draw = drawCalls[batch3DCalls[i]].d3D;
+	      if(draw.lod != lod)
+		  continue;
+	      perInstance3DModel[lodCount] = draw.modelMatrix;
+	      perInstance3DNormal[lodCount] = draw.normalMatrix;
+	      lodCount++;
+	  }
+	  if(lodCount == 0)
+	      continue;
+	  ogl_helper::shaderStorageBufferData(model3DSSBO, sizeAndPtr(perInstance3DModel), 2);
+	  ogl_helper::shaderStorageBufferData(normal3DSSBO, sizeAndPtr(perInstance3DNormal), 3);
+	  pools->get(model.pool.ID)->modelLoader->DrawModelInstanced(
+		  model, lodCount,
+		  shader3D->Location("spriteColour"), shader3D->Location("enableTex"), lod,
+		  meshletCuller, perInstance3DModel);
+	  drawn += lodCount;
+      }
   }
 
   bool RenderGl::_validPool(Resource::Pool pool) {
@@ -422,20 +529,28 @@ namespace glenv {
 				   "with a pool that does not exist");
   }
 
-  void RenderGl::draw3DAnim(Resource::Model model) {
+  void RenderGl::draw3DAnim(Resource::Model model, unsigned int lod) {
       if(!_poolInUse(model.pool)) {
 	  LOG_ERROR("tried to draw string with pool that is not currently in use!");
 	  return;
       }
       pools->get(model.pool)->modelLoader->DrawModel(
-	      model, shader3DAnim->Location("spriteColour"), shader3DAnim->Location("enableTex"));
+	      model, shader3DAnim->Location("spriteColour"), shader3DAnim->Location("enableTex"),
+	      lod);
+  }
+
+  unsigned int RenderGl::modelLod(Resource::Model model, glm::mat4 modelMatrix) {
+      if(!pools->ValidPool(model.pool))
+	  return 0;
+      return pools->get(model.pool)->modelLoader->getLod(model, view3D * modelMatrix, proj3D);
   }
 
   void RenderGl::DrawModel(Resource::Model model, glm::mat4 modelMatrix, glm::mat4 normalMat) {
       if(currentDraw < MAX_DRAWS) {
 	  currentDrawMode = DrawMode::d3D;
 	  drawCalls[currentDraw].mode = DrawMode::d3D;
-	  drawCalls[currentDraw++].d3D = Draw3D(model, modelMatrix, normalMat);
+	  drawCalls[currentDraw].d3D = Draw3D(model, modelMatrix, normalMat);
+	  drawCalls[currentDraw++].d3D.lod = modelLod(model, modelMatrix);
       }
   }   
 
@@ -446,6 +561,7 @@ namespace glenv {
 	  currentDrawMode = DrawMode::d3DAnim;
 	  drawCalls[currentDraw].mode = DrawMode::d3DAnim;
 	  drawCalls[currentDraw].d3DAnim = DrawAnim3D(model, modelMatrix, normalMatrix);
+	  drawCalls[currentDraw].d3DAnim.lod = modelLod(model, modelMatrix);
 	  std::vector<glm::mat4>* bones = animation->getCurrentBones();
 	  for(int i = 0; i < Resource::MAX_BONES && i < bones->size(); i++)
 	      drawCalls[currentDraw].d3DAnim.bones[i] = bones->at(i);
@@ -458,25 +574,29 @@ namespace glenv {
       if(currentDraw < MAX_DRAWS) {
 	  currentDrawMode = DrawMode::d3D;
 	  drawCalls[currentDraw].mode = DrawMode::d2D;
-	  drawCalls[currentDraw++].d2D = Draw2D(texture, modelMatrix, colour, texOffset);
+	  drawCalls[currentDraw++].d2D = Draw2D(texture, modelMatrix, colour,
+						texture.atlasTexOffset(texOffset));
       }
   }
 
-  void RenderGl::DrawString(Resource::Font font, std::string text, glm::vec2 position,
+  void RenderGl::DrawString(Resource::Font font, const std::string &text, glm::vec2 position,
 			    float size, float depth, glm::vec4 colour, float rotate) {
       if(!_poolInUse(font.pool)) {
 	  LOG_ERROR("tried to draw string with pool that is not currently in use!");
 	  return;
       }
-      auto draws = pools->get(font.pool)->fontLoader->DrawString(
-	      font, text, position, size, depth, colour, rotate);
-      for(const auto &draw: draws) 
+      stringDraws.clear();
+      pools->get(font.pool)->fontLoader->DrawString(
+	      font, text, position, size, depth, colour, rotate, &stringDraws);
+      for(const auto &draw: stringDraws) 
 	  DrawQuad(draw.tex, draw.model, draw.colour, draw.texOffset);
   }
 
   void RenderGl::set3DViewMat(glm::mat4 view, glm::vec4 camPos) {
       view3D = view;
       lighting.camPos = camPos;
+      if(meshletCuller != nullptr)
+	  meshletCuller->setCamera(view3D, proj3D);
   }
 
   void RenderGl::set2DViewMat(glm::mat4 view) {
@@ -485,6 +605,8 @@ namespace glenv {
 
   void RenderGl::set3DProjMat(glm::mat4 proj) {
       proj3D = proj;
+      if(meshletCuller != nullptr)
+	  meshletCuller->setCamera(view3D, proj3D);
   }
 
   void RenderGl::set2DProjMat(glm::mat4 proj) {
@@ -8,14 +8,17 @@
 
 #include <string>
 #include <atomic>
+#include <vector>
 
 #include <graphics/render.h>
 #include <graphics/shader_structs.h>
+#include <render-internal/resource-loaders/meshlets.h>
 
 #include "framebuffer.h"
 
 class GLVertexData;
 class GLPoolManager;
+class FileWatcher;
 
 namespace glenv {
   class GLShader;
@@ -38,16 +41,25 @@ namespace glenv {
       ResourcePool* pool(Resource::Pool pool) override;
       
       void LoadResourcesToGPU(Resource::Pool pool) override;
+      // uploads in OGL are finished when they return, so this is the same as above
+      Resource::LoadTicket LoadResourcesToGPUAsync(Resource::Pool pool) override;
+      bool LoadFinished(Resource::LoadTicket ticket) override { return true; }
+      void AppendResourcesToGPU(Resource::Pool pool) override;
+      void ReloadTexture(Resource::Texture texture) override;
+      void ReloadModel(Resource::Model model) override;
       // does nothing in OGL version
       void UseLoadedResources() override {}
 
+      // OGL doesn't expose the gpu's memory heaps, so heaps is left empty
+      MemoryUsage GetMemoryUsage() override;
+
       void DrawModel(Resource::Model model, glm::mat4 modelMatrix, glm::mat4 normalMat) override;
       void DrawAnimModel(Resource::Model model, glm::mat4 modelMatrix,
 			 glm::mat4 normalMatrix,
 			 Resource::ModelAnimation *animation) override;
       void DrawQuad(Resource::Texture texture, glm::mat4 modelMatrix,
 		    glm::vec4 colour, glm::vec4 texOffset) override;
-      void DrawString(Resource::Font font, std::string text, glm::vec2 position,
+      void DrawString(Resource::Font font, const std::string &text, glm::vec2 position,
 		      float size, float depth, glm::vec4 colour, float rotate) override;
       void EndDraw(std::atomic<bool> &submit) override;
 
@@ -66,7 +78,11 @@ namespace glenv {
       void draw2DBatch(int drawCount, Resource::Texture texture,
 		       glm::vec4 currentColour);
       void draw3DBatch(int drawCount, Resource::Model model);
-      void draw3DAnim(Resource::Model model);
+      void draw3DAnim(Resource::Model model, unsigned int lod);
+      void streamTextures();
+      void watchPoolFiles(Resource::Pool pool);
+      void hotReload();
+      unsigned int modelLod(Resource::Model model, glm::mat4 modelMatrix);
       void setVPshader(GLShader *shader);
       void setLightingShader(GLShader *shader);
 
@@ -122,6 +138,7 @@ namespace glenv {
 	  Resource::Model model;
 	  glm::mat4 modelMatrix;
 	  glm::mat4 normalMatrix;
+	  unsigned int lod = 0;
       };
       struct DrawAnim3D {
 	  DrawAnim3D() {}
@@ -129,6 +146,7 @@ namespace glenv {
 	  Resource::Model model;
 	  glm::mat4 modelMatrix;
 	  glm::mat4 normalMatrix;
+	  unsigned int lod = 0;
 	  glm::mat4 bones[Resource::MAX_BONES];
       };
 
@@ -148,10 +166,17 @@ namespace glenv {
       GLuint model2DSSBO;
       GLuint texOffset2DSSBO;
 
+      // indices into drawCalls of the current 3D batch
+      unsigned int batch3DCalls[Resource::MAX_3D_BATCH];
       glm::mat4 perInstance3DModel[Resource::MAX_3D_BATCH];
       glm::mat4 perInstance3DNormal[Resource::MAX_3D_BATCH];
       GLuint model3DSSBO;
       GLuint normal3DSSBO;
+      meshopt::MeshletCuller* meshletCuller = nullptr;
+      // null unless hot_reload is set
+      FileWatcher* fileWatcher = nullptr;
+      // reused by DrawString, so drawing text doesn't allocate
+      std::vector<Resource::QuadDraw> stringDraws;
   };
 
 } // namespace glenv
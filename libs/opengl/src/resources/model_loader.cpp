@@ -2,6 +2,8 @@
 
 #include "vertex_data.h"
 #include <graphics/logger.h>
+#define GLFW_INCLUDE_NONE
+#include <GLFW/glfw3.h>
 
 struct GPUMeshGL : public GPUMesh {
     GPUMeshGL(){}
@@ -9,21 +11,26 @@ struct GPUMeshGL : public GPUMesh {
     
     GLVertexData *vertexData;
     void draw(Resource::Model model, int instanceCount, BasePoolManager *pools,
-	      int colLoc, int enableTexLoc);
+	      int colLoc, int enableTexLoc, unsigned int lod,
+	      meshopt::MeshletCuller* culler, const glm::mat4* modelMatrices);
 };
 
 struct GPUModelGL : public GPUModel {
     std::vector<GPUMeshGL> meshes;    
     GPUModelGL(ModelData *data);  
+    /// meshes' vertices are in vertexBuffer at their offset from vertexBase
+    GPUModelGL(ModelData *data, GLuint vertexBuffer, const char* vertexBase);
     ~GPUModelGL();
     void draw(Resource::Model model, int instanceCount, BasePoolManager *pools, int colLoc,
-	      int enableTexLoc);
+	      int enableTexLoc, unsigned int lod,
+	      meshopt::MeshletCuller* culler, const glm::mat4* modelMatrices);
 };
 
-ModelLoaderGL::ModelLoaderGL(Resource::Pool pool, BasePoolManager *pools)
-    : InternalModelLoader(pool, pools) {}
+ModelLoaderGL::ModelLoaderGL(Resource::Pool pool, BasePoolManager *pools, RenderConfig conf)
+    : InternalModelLoader(pool, pools, conf) {}
 
 ModelLoaderGL::~ModelLoaderGL() {
+    clearStaged();
     clearGPU();
 }
 
@@ -31,59 +38,189 @@ void ModelLoaderGL::clearGPU() {
     for (GPUModelGL *model : models)
 	delete model;
     models.clear();
+    loadedSources.clear();
+    glDeleteBuffers((GLsizei)loadedVertexBuffers.size(), loadedVertexBuffers.data());
+    loadedVertexBuffers.clear();
+}
+
+void* ModelLoaderGL::allocateVertexData(size_t size) {
+    // the world streamer etc stage pools on threads without the context
+    if(size == 0 || glfwGetCurrentContext() == nullptr)
+	return InternalModelLoader::allocateVertexData(size);
+    VertexBuffer vb;
+    vb.size = size;
+    vb.used = false;
+    vb.mapped = true;
+    glGenBuffers(1, &vb.buffer);
+    glBindBuffer(GL_ARRAY_BUFFER, vb.buffer);
+    glBufferData(GL_ARRAY_BUFFER, size, nullptr, GL_STATIC_DRAW);
+    vb.data = (char*)glMapBufferRange(GL_ARRAY_BUFFER, 0, size,
+				      GL_MAP_WRITE_BIT | GL_MAP_INVALIDATE_BUFFER_BIT);
+    glBindBuffer(GL_ARRAY_BUFFER, 0);
+    if(vb.data == nullptr) {
+	LOG_ERROR("Failed to map vertex buffer, using cpu memory - size: " << size);
+	glDeleteBuffers(1, &vb.buffer);
+	return InternalModelLoader::allocateVertexData(size);
+    }
+    vertexBuffers.push_back(vb);
+    return vb.data;
+}
+
+void ModelLoaderGL::unmapVertexBuffers() {
+    for(auto &vb: vertexBuffers) {
+	if(!vb.mapped)
+	    continue;
+	glBindBuffer(GL_ARRAY_BUFFER, vb.buffer);
+	if(glUnmapBuffer(GL_ARRAY_BUFFER) == GL_FALSE)
+	    LOG_ERROR("Vertex buffer contents were lost while it was mapped");
+	vb.mapped = false;
+    }
+    glBindBuffer(GL_ARRAY_BUFFER, 0);
+}
+
+void ModelLoaderGL::freeVertexData() {
+    InternalModelLoader::freeVertexData();
+    unmapVertexBuffers();
+    for(auto &vb: vertexBuffers) {
+	if(vb.used)
+	    loadedVertexBuffers.push_back(vb.buffer);
+	else
+	    glDeleteBuffers(1, &vb.buffer);
+    }
+    vertexBuffers.clear();
+}
+
+GPUModelGL* ModelLoaderGL::createModel(ModelData* data) {
+    const char* vertices = data->meshes.empty() ? nullptr :
+	(const char*)data->meshes[0]->vertices;
+    // the vertices of a model are converted into one allocation
+    for(auto &vb: vertexBuffers) {
+	const char* base = vb.data;
+	if(vertices < base || vertices >= base + vb.size)
+	    continue;
+	vb.used = true;
+	return new GPUModelGL(data, vb.buffer, base);
+    }
+    return new GPUModelGL(data);
 }
 
 void ModelLoaderGL::loadGPU() {
     clearGPU();
-    loadQuad();
-    models.resize(staged.size());
-    for(int i = 0; i < staged.size(); i++)
-	models[i] = new GPUModelGL(staged[i]);
+    appendGPU();
+}
+
+void ModelLoaderGL::appendGPU() {
+    size_t first = models.size();
+    startGpuLoad(first);
+    unmapVertexBuffers();
+    models.resize(first + staged.size());
+    // size if every mesh used 32 bit indices, for the memory report
+    size_t fullIndexDataSize = 0;
+    size_t indexDataSize = 0;
+    for(int i = 0; i < staged.size(); i++) {
+	GPUModelGL* model = createModel(staged[i]);
+	models[first + i] = model;
+	for(int j = 0; j < staged[i]->meshes.size(); j++) {
+	    fullIndexDataSize += sizeof(uint32_t) * staged[i]->meshes[j]->indices.size();
+	    indexDataSize += model->meshes[j].vertexData->IndexDataSize();
+	}
+    }
+    LOG("Model index memory - pool: " << pool.ID <<
+	" - all 32 bit: " << fullIndexDataSize <<
+	" - used: " << indexDataSize <<
+	" - saved: " << fullIndexDataSize - indexDataSize);
     clearStaged();
 }
 
+// each mesh has its own gl buffers, so the reloaded model gets new ones.
+// the gl driver keeps the old ones alive for any draws still using them.
+void ModelLoaderGL::reload(Resource::Model model) {
+    size_t index = gpuIndex(model);
+    if(index >= models.size() || !beginReload(model)) {
+	LOG_ERROR("model loader - reload: model wasn't loaded from a file in this pool. id: "
+		  << model.ID);
+	return;
+    }
+    GPUModelGL* reloaded;
+    try {
+	unmapVertexBuffers();
+	reloaded = createModel(staged[0]);
+    } catch(std::exception &e) {
+	endReload();
+	throw;
+    }
+    endReload();
+    for(size_t i = 0; i < reloaded->meshes.size() && i < models[index]->meshes.size(); i++)
+	reloaded->meshes[i].texture = models[index]->meshes[i].texture;
+    delete models[index];
+    models[index] = reloaded;
+}
+
   void ModelLoaderGL::DrawQuad(int count) {
-      models[quad.ID]->meshes[0].vertexData->DrawInstanced(GL_TRIANGLES, count);
+      models[gpuIndex(quad)]->meshes[0].vertexData->DrawInstanced(GL_TRIANGLES, count);
   }
 
-void ModelLoaderGL::DrawModel(Resource::Model model, uint32_t spriteColourShaderLoc, uint32_t enableTexShaderLoc) {
-    draw(model, 1, spriteColourShaderLoc, enableTexShaderLoc);
+void ModelLoaderGL::DrawModel(Resource::Model model, uint32_t spriteColourShaderLoc, uint32_t enableTexShaderLoc,
+			      unsigned int lod) {
+    draw(model, 1, spriteColourShaderLoc, enableTexShaderLoc, lod, nullptr, nullptr);
   }
 
 void ModelLoaderGL::DrawModelInstanced(Resource::Model model,
 				       int count, uint32_t spriteColourShaderLoc,
-				       uint32_t enableTexShaderLoc) {
-    draw(model, count, spriteColourShaderLoc, enableTexShaderLoc);
+				       uint32_t enableTexShaderLoc, unsigned int lod,
+				       meshopt::MeshletCuller* culler,
+				       const glm::mat4* modelMatrices) {
+    draw(model, count, spriteColourShaderLoc, enableTexShaderLoc, lod, culler, modelMatrices);
 }
 
 void ModelLoaderGL::draw(Resource::Model model, int count,
-                         uint32_t colLoc, uint32_t enableTexLoc) {
-    if(model.ID >= models.size()) {
+                         uint32_t colLoc, uint32_t enableTexLoc, unsigned int lod,
+			 meshopt::MeshletCuller* culler, const glm::mat4* modelMatrices) {
+    size_t index = gpuIndex(model);
+    if(index >= models.size()) {
 	LOG_ERROR("in draw with out of range model. id: "
                   << model.ID << " -  model count: " << models.size());
 	return;
     }
-    models[model.ID]->draw(model, count, pools, colLoc, enableTexLoc);
+    models[index]->draw(model, count, pools, colLoc, enableTexLoc, lod,
+			   culler, modelMatrices);
 
 }
 
 Resource::ModelAnimation ModelLoaderGL::getAnimation(Resource::Model model,
                                                      std::string animation) {
-    if(model.ID >= models.size()) {
+    size_t index = gpuIndex(model);
+    if(index >= models.size()) {
 	LOG_ERROR("in getAnimation with out of range model. id: "
                   << model.ID << " -  model count: " << models.size());
 	return Resource::ModelAnimation();
     }
-    return models[model.ID]->getAnimation(animation);
+    return models[index]->getAnimation(animation);
 }
 
 Resource::ModelAnimation ModelLoaderGL::getAnimation(Resource::Model model, int index) {
-    if(model.ID >= models.size()) {
+    size_t modelIndex = gpuIndex(model);
+    if(modelIndex >= models.size()) {
 	LOG_ERROR("in getAnimation with out of range model. id: "
                   << model.ID << " -  model count: " << models.size());
 	return Resource::ModelAnimation();
     }
-    return models[model.ID]->getAnimation(index);
+    return models[modelIndex]->getAnimation(index);
+}
+
+unsigned int ModelLoaderGL::getLod(Resource::Model model, glm::mat4 modelView, glm::mat4 proj) {
+    size_t index = gpuIndex(model);
+    if(index >= models.size())
+	return 0;
+    return models[index]->selectLod(modelView, proj, lodScreenSize);
+}
+
+size_t ModelLoaderGL::gpuMemory() {
+    size_t size = 0;
+    for(GPUModelGL* model: models)
+	for(auto &mesh: model->meshes)
+	    size += mesh.vertexData->VertexDataSize() + mesh.vertexData->IndexDataSize();
+    return size;
 }
 
 
@@ -101,22 +238,39 @@ GPUModelGL::GPUModelGL(ModelData *data) : GPUModel(data) {
     }
 }
 
+GPUModelGL::GPUModelGL(ModelData *data, GLuint vertexBuffer,
+		       const char* vertexBase) : GPUModel(data) {
+    meshes.resize(data->meshes.size());
+    for (int i = 0; i < meshes.size(); i++) {
+	meshes[i] = GPUMeshGL(data->meshes[i]);
+	meshes[i].vertexData = new GLVertexData(
+		data->format,
+		vertexBuffer,
+		(const char*)data->meshes[i]->vertices - vertexBase,
+		data->meshes[i]->vertexCount,
+		data->meshes[i]->indices);
+    }
+}
+
 GPUModelGL::~GPUModelGL() {
     for (auto &mesh : meshes)
 	delete mesh.vertexData;
 }
 
 void GPUModelGL::draw(Resource::Model model, int instanceCount, BasePoolManager *pools,
-		      int colLoc, int enableTexLoc) {
+		      int colLoc, int enableTexLoc, unsigned int lod,
+		      meshopt::MeshletCuller* culler, const glm::mat4* modelMatrices) {
     for (auto& mesh: meshes)
-	mesh.draw(model, instanceCount, pools, colLoc, enableTexLoc);
+	mesh.draw(model, instanceCount, pools, colLoc, enableTexLoc, lod,
+		  culler, modelMatrices);
 }
 
 
 ///  ---  Mesh  ---
 
 void GPUMeshGL::draw(Resource::Model model, int instanceCount, BasePoolManager *pools,
-		  int colLoc, int enableTexLoc) {
+		     int colLoc, int enableTexLoc, unsigned int lod,
+		     meshopt::MeshletCuller* culler, const glm::mat4* modelMatrices) {
     glActiveTexture(GL_TEXTURE0);
     int texID = modelGetTexID(model, texture, pools);
     if(texID != -1) {		
@@ -129,8 +283,18 @@ void GPUMeshGL::draw(Resource::Model model, int instanceCount, BasePoolManager *
 		 model.colour.a == 0.0f ? &diffuseColour[0] :
 		 &model.colour[0]);
     
+    // meshes can have fewer lods than the model
+    IndexRange range = lods[lod < lods.size() ? lod : lods.size() - 1];
+    if(culler != nullptr && lod == 0 && !meshlets.empty()) {
+	// there is no base instance, so draw the meshlets any instance could see
+	culler->cull(meshlets, modelMatrices, sizeof(glm::mat4), instanceCount, true);
+	for(auto &visible: culler->ranges(0))
+	    vertexData->DrawInstanced(GL_TRIANGLES, instanceCount,
+				      range.offset + visible.first, visible.second);
+	return;
+    }
     if(instanceCount > 1)
-	vertexData->DrawInstanced(GL_TRIANGLES, instanceCount);
+	vertexData->DrawInstanced(GL_TRIANGLES, instanceCount, range.offset, range.count);
     else if(instanceCount == 1)
-	vertexData->Draw(GL_TRIANGLES);
+	vertexData->Draw(GL_TRIANGLES, range.offset, range.count);
 }
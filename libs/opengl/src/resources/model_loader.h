@@ -1,6 +1,7 @@
 #ifndef GL_MODEL_RENDER_H
 #define GL_MODEL_RENDER_H
 
+#include <glad/glad.h>
 #include <render-internal/resource-loaders/texture_loader.h>
 #include <render-internal/resource-loaders/model_loader.h>
 
@@ -8,25 +9,62 @@ struct GPUModelGL;
 
 class ModelLoaderGL : public InternalModelLoader {
 public:
-    ModelLoaderGL(Resource::Pool pool, BasePoolManager *pools);
+    ModelLoaderGL(Resource::Pool pool, BasePoolManager *pools, RenderConfig conf);
     ~ModelLoaderGL() override;
     void loadGPU() override;
+    void appendGPU() override;
     void clearGPU() override;
+    /// Load the file of a model again, keeping its handle and its meshes' textures.
+    void reload(Resource::Model model);
     void DrawQuad(int count);
     void DrawModel(Resource::Model model,
 		   uint32_t spriteColourShaderLoc,
-		   uint32_t enableTexShaderLoc);
+		   uint32_t enableTexShaderLoc,
+		   unsigned int lod = 0);
+    /// if culler is not null, meshes with meshlets only draw the meshlets
+    /// that any of the instances in modelMatrices could see.
     void DrawModelInstanced(Resource::Model model, int count,
 			    uint32_t spriteColourShaderLoc,
-			    uint32_t enableTexShaderLoc);
+			    uint32_t enableTexShaderLoc,
+			    unsigned int lod = 0,
+			    meshopt::MeshletCuller* culler = nullptr,
+			    const glm::mat4* modelMatrices = nullptr);
     Resource::ModelAnimation getAnimation(Resource::Model model, std::string animation) override;
     Resource::ModelAnimation getAnimation(Resource::Model model, int index) override;
+    unsigned int getLod(Resource::Model model, glm::mat4 modelView, glm::mat4 proj);
+    /// bytes of the vertex and index buffers
+    size_t gpuMemory();
+
+protected:
+
+    /// if the thread has the gl context, vertices are converted straight into
+    /// a mapped gl buffer, otherwise into malloced memory that gets copied.
+    void* allocateVertexData(size_t size) override;
+    void freeVertexData() override;
 
 private:
-    
+
+    struct VertexBuffer {
+	GLuint buffer;
+	/// where it was mapped, the staged meshes' vertices point into this
+	char* data;
+	size_t size;
+	bool mapped;
+	/// a loaded model's meshes use it
+	bool used;
+    };
+    /// buffers of the staged vertices
+    std::vector<VertexBuffer> vertexBuffers;
+    /// buffers the loaded models' vertices are in
+    std::vector<GLuint> loadedVertexBuffers;
+    /// call before using the staged vertex buffers
+    void unmapVertexBuffers();
+    GPUModelGL* createModel(ModelData* data);
+
     std::vector<GPUModelGL*> models;
     void draw(Resource::Model model, int count,
-	      uint32_t colLoc, uint32_t enableTexLoc);
+	      uint32_t colLoc, uint32_t enableTexLoc, unsigned int lod,
+	      meshopt::MeshletCuller* culler, const glm::mat4* modelMatrices);
 };
 
 #endif
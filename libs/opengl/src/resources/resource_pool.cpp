@@ -1,11 +1,12 @@
 #include "resource_pool.h"
 
+#include <render-internal/resource-loaders/asset_pack.h>
 #include <graphics/logger.h>
 
 GLResourcePool::GLResourcePool(Resource::Pool pool, RenderConfig config, BasePoolManager* pools) {
     this->pool = pool;
-    texLoader = new TextureLoaderGL(pool, config);
-    modelLoader = new ModelLoaderGL(pool, pools);
+    texLoader = new TextureLoaderGL(pool, config, &pools->texCache);
+    modelLoader = new ModelLoaderGL(pool, pools, config);
     fontLoader = new InternalFontLoader(pool, texLoader);
 }
 
@@ -24,6 +25,13 @@ void GLResourcePool::loadGpu() {
     usingGPUResources = true;
 }
 
+void GLResourcePool::appendGpu() {
+    texLoader->appendGPU();
+    fontLoader->appendGPU();
+    modelLoader->appendGPU();
+    usingGPUResources = true;
+}
+
 void GLResourcePool::unloadStaged() {
     texLoader->clearStaged();
     fontLoader->clearStaged();
@@ -36,3 +44,19 @@ void GLResourcePool::unloadGPU() {
     modelLoader->clearGPU();
     usingGPUResources = false;
 }
+
+Resource::PackedResources GLResourcePool::loadPack(std::string path) {
+    return assetpack::load(path, texLoader, modelLoader, fontLoader);
+}
+
+void GLResourcePool::decodeStaged() {
+    texLoader->decodeStaged();
+}
+
+Resource::PoolMemory GLResourcePool::memoryUsage() {
+    Resource::PoolMemory memory;
+    memory.staged = texLoader->stagedMemory() + modelLoader->stagedMemory();
+    memory.textures = texLoader->gpuMemory();
+    memory.models = modelLoader->gpuMemory();
+    return memory;
+}
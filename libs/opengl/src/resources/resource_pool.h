@@ -13,12 +13,17 @@ public:
     virtual ~GLResourcePool();
 
     void loadGpu();
+    /// load the staged resources, keeping the ones already loaded
+    void appendGpu();
     void unloadStaged();
     void unloadGPU();
 
     ModelLoader* model() override { return modelLoader; }
     TextureLoader* tex() override { return texLoader; }
     FontLoader* font()   override { return fontLoader; }
+    Resource::PackedResources loadPack(std::string path) override;
+    void decodeStaged() override;
+    Resource::PoolMemory memoryUsage() override;
 
     TextureLoaderGL* texLoader;
     InternalFontLoader* fontLoader;
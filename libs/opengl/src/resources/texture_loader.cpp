@@ -2,9 +2,33 @@
 
 #include <graphics/logger.h>
 #include "../ogl_helper.h"
+#include <render-internal/worker_pool.h>
 
-TextureLoaderGL::TextureLoaderGL(Resource::Pool pool, RenderConfig conf)
-    : InternalTexLoader(pool, conf) {}
+// s3tc formats are an extension, so aren't in the core profile glad header
+#ifndef GL_COMPRESSED_RGBA_S3TC_DXT1_EXT
+#define GL_COMPRESSED_RGBA_S3TC_DXT1_EXT 0x83F1
+#define GL_COMPRESSED_RGBA_S3TC_DXT5_EXT 0x83F3
+#endif
+
+GLuint compressedFormat(TextureFormat format) {
+    switch(format) {
+    case TextureFormat::BC1:
+	return GL_COMPRESSED_RGBA_S3TC_DXT1_EXT;
+    case TextureFormat::BC3:
+	return GL_COMPRESSED_RGBA_S3TC_DXT5_EXT;
+    case TextureFormat::BC4:
+	return GL_COMPRESSED_RED_RGTC1;
+    case TextureFormat::BC5:
+	return GL_COMPRESSED_RG_RGTC2;
+    case TextureFormat::BC7:
+	return GL_COMPRESSED_RGBA_BPTC_UNORM;
+    default:
+	throw std::runtime_error("Texture format is not block compressed");
+    }
+}
+
+TextureLoaderGL::TextureLoaderGL(Resource::Pool pool, RenderConfig conf, TextureCache* cache)
+    : InternalTexLoader(pool, conf, cache) {}
 
 TextureLoaderGL::~TextureLoaderGL() {
     clearGPU();
@@ -13,44 +37,208 @@ TextureLoaderGL::~TextureLoaderGL() {
 void TextureLoaderGL::loadGPU() {
     if(staged.size() <= 0)
 	return;
-    InternalTexLoader::loadGPU();
     clearGPU();
-    inGpu.resize(staged.size());
+    InternalTexLoader::loadGPU();
+    uploadStaged();
+}
+
+void TextureLoaderGL::appendGPU() {
+    if(staged.size() <= 0)
+	return;
+    InternalTexLoader::appendGPU();
+    uploadStaged();
+}
+
+void TextureLoaderGL::uploadStaged() {
+    size_t first = inGpu.size();
+    inGpu.resize(first + staged.size());
+    gpuEntries.resize(first + staged.size());
+    gpuSizes.resize(first + staged.size());
+    // gl textures can be used by any pool, so reuse ones other pools loaded
+    std::vector<int> toDecode;
     for(int i = 0; i < staged.size(); i++) {
-	GLuint format = GL_RGBA;
-	switch(staged[i]->nrChannels) {
-	case 1:
-	    format = GL_RED;
-	    break;
-	case 2:
-	    format = GL_RG;
-	    break;
-	case 3:
-	    format = GL_RGB;
-	    break;
-	case 4:
-	    format = GL_RGBA;
-	    break;
-	default:
-	    throw std::runtime_error("Unsupported no. of channels");
-	}  
-	inGpu[i] = ogl_helper::genTexture(format,
-					  staged[i]->width,
-					  staged[i]->height,
-					  staged[i]->data,
-					  mipmapping,
-					  filterNearest ? GL_NEAREST : GL_LINEAR,
-					  GL_REPEAT, 1);
+	TextureCache::Entry* entry = staged[i]->cacheEntry;
+	gpuEntries[first + i] = entry;
+	gpuSizes[first + i] = gpuSize(staged[i]);
+	inGpu[first + i] = 0;
+	if(entry != nullptr && cache->acquireGpu(entry))
+	    inGpu[first + i] = entry->gpuTexture;
+	else
+	    toDecode.push_back(i);
     }
+    // decode and make mips across the worker threads,
+    // streaming textures only get the levels they start with
+    std::vector<std::vector<unsigned char>> pixels(toDecode.size());
+    std::vector<unsigned int> firstMips(toDecode.size());
+    std::vector<std::shared_ptr<MipSource>> sources(toDecode.size());
+    WorkerPool::get()->run(toDecode.size(), [&](size_t i) {
+	StagedTex* tex = staged[toDecode[i]];
+	firstMips[i] = mipmapping ? firstResidentMip(tex) : 0;
+	pixels[i].resize(residentSize(tex, firstMips[i]));
+	sources[i] = stageTexture(tex, pixels[i].data(), firstMips[i]);
+    });
+    for(int i = 0; i < toDecode.size(); i++)
+	uploadTexture(staged[toDecode[i]], pixels[i], first + toDecode[i],
+		      firstMips[i], sources[i]);
     clearStaged();
 }
 
+void TextureLoaderGL::uploadTexture(StagedTex* tex, std::vector<unsigned char> &pixels,
+				    size_t index, unsigned int firstMip,
+				    std::shared_ptr<MipSource> source) {
+    bool compressed = tex->format != TextureFormat::RGBA8;
+    if(!compressed && tex->nrChannels != 4)
+	throw std::runtime_error("Unsupported no. of channels");
+    GLuint format = compressed ? compressedFormat(tex->format) : GL_RGBA;
+    size_t mipCount = mipmapping ? tex->mipSizes.size() : 1;
+    GLuint id = ogl_helper::genMipmappedTexture(
+	    format,
+	    compressed,
+	    tex->width,
+	    tex->height,
+	    pixels.data(),
+	    tex->mipSizes.data(),
+	    mipCount,
+	    firstMip,
+	    filterNearest ? GL_NEAREST : GL_LINEAR,
+	    GL_REPEAT);
+    inGpu[index] = id;
+    if(tex->cacheEntry != nullptr)
+	cache->setGpu(tex->cacheEntry, id);
+    if(firstMip > 0) {
+	source->request(firstMip - 1);
+	streaming.push_back({ index, format, compressed,
+			      tex->width, tex->height, source,
+			      tex->mipSizes, firstMip });
+    }
+}
+
+// gl textures are shared with other pools through the cache and the old one may be a
+// different size, so a reloaded texture always gets a new one.
+// the gl driver keeps the old one alive for any draws still using it.
+void TextureLoaderGL::reload(Resource::Texture tex) {
+    size_t index = gpuIndex(tex);
+    if(tex.pool != this->pool || index >= inGpu.size()) {
+	LOG_ERROR("tex loader - reload: texture isn't loaded in this pool. id: " << tex.ID);
+	return;
+    }
+    StagedTex* staged = stageReload(tex);
+    if(staged == nullptr) {
+	LOG_ERROR("tex loader - reload: texture wasn't loaded from a file. id: " << tex.ID);
+	return;
+    }
+    try {
+	// another pool may have reloaded the same file already
+	if(staged->cacheEntry != nullptr && cache->acquireGpu(staged->cacheEntry)) {
+	    releaseTexture(index);
+	    inGpu[index] = staged->cacheEntry->gpuTexture;
+	} else {
+	    std::vector<unsigned char> pixels(staged->filesize);
+	    stageTexture(staged, pixels.data());
+	    releaseTexture(index);
+	    uploadTexture(staged, pixels, index, 0, nullptr);
+	}
+	gpuEntries[index] = staged->cacheEntry;
+	gpuSizes[index] = gpuSize(staged);
+    } catch(std::exception &e) {
+	staged->deleteData();
+	delete staged;
+	throw;
+    }
+    staged->deleteData();
+    delete staged;
+}
+
+size_t TextureLoaderGL::gpuSize(StagedTex* tex) {
+    // only the first level is uploaded without mip mapping
+    return mipmapping ? (size_t)tex->filesize : tex->mipSizes[0];
+}
+
+size_t TextureLoaderGL::gpuMemory() {
+    size_t size = 0;
+    for(size_t texSize: gpuSizes)
+	size += texSize;
+    return size;
+}
+
+void TextureLoaderGL::releaseTexture(size_t index) {
+    if(gpuEntries[index] == nullptr || cache->releaseGpu(gpuEntries[index])) {
+	glDeleteTextures(1, &inGpu[index]);
+    } else {
+	// other pools still use it, so it can't be left without its bigger mips
+	try {
+	    for(auto &tex: streaming)
+		while(tex.index == index && tex.residentMip > 0)
+		    uploadNextMip(tex);
+	} catch(std::exception &e) {
+	    LOG_ERROR("Failed to read mip level of shared texture, "
+		      "it stays at a lower resolution - " << e.what());
+	}
+    }
+    for(size_t i = 0; i < streaming.size();) {
+	if(streaming[i].index == index)
+	    streaming.erase(streaming.begin() + i);
+	else
+	    i++;
+    }
+}
+
 void TextureLoaderGL::clearGPU() {
     if (inGpu.size() <= 0)
 	return;
     InternalTexLoader::clearGPU();
-    glDeleteTextures(inGpu.size(), inGpu.data());
-    inGpu.clear(); 
+    for(size_t i = 0; i < inGpu.size(); i++)
+	releaseTexture(i);
+    inGpu.clear();
+    gpuEntries.clear();
+    gpuSizes.clear();
+    streaming.clear();
+}
+
+void TextureLoaderGL::streamMips(size_t* budget) {
+    // the smallest missing level of any texture goes first,
+    // so every texture sharpens a bit each frame.
+    // levels still being read are skipped until they're ready.
+    while(*budget > 0 && streaming.size() > 0) {
+	int next = -1;
+	for(size_t i = 0; i < streaming.size();) {
+	    StreamingTex &tex = streaming[i];
+	    if(next >= 0 && tex.mipSizes[tex.residentMip - 1] >=
+	       streaming[next].mipSizes[streaming[next].residentMip - 1]) {
+		i++;
+		continue;
+	    }
+	    try {
+		if(tex.source->get(tex.residentMip - 1) != nullptr)
+		    next = (int)i;
+		i++;
+	    } catch(std::exception &e) {
+		LOG_ERROR("Failed to read mip level of streaming texture, "
+			  "it stays at a lower resolution - " << e.what());
+		streaming.erase(streaming.begin() + i);
+	    }
+	}
+	if(next < 0)
+	    return;
+	uploadNextMip(streaming[next]);
+	size_t size = streaming[next].mipSizes[streaming[next].residentMip];
+	*budget -= size < *budget ? size : *budget;
+	if(streaming[next].residentMip == 0)
+	    streaming.erase(streaming.begin() + next);
+    }
+}
+
+void TextureLoaderGL::uploadNextMip(StreamingTex &tex) {
+    unsigned int mip = tex.residentMip - 1;
+    // streamMips only picks levels that were read, so this only blocks in releaseTexture
+    const unsigned char* pixels = tex.source->wait(mip);
+    ogl_helper::addTextureMip(inGpu[tex.index], tex.format, tex.compressed,
+			      tex.width, tex.height, (GLint)mip,
+			      pixels, tex.mipSizes[mip]);
+    tex.source->release(mip);
+    tex.residentMip = mip;
+    if(mip > 0)
+	tex.source->request(mip - 1);
 }
   
 unsigned int TextureLoaderGL::getViewIndex(Resource::Texture tex) {
@@ -60,11 +248,12 @@ unsigned int TextureLoaderGL::getViewIndex(Resource::Texture tex) {
     }
     if(tex.ID == Resource::NULL_ID)
 	return tex.ID;
-    if (tex.ID >= inGpu.size()) {
+    size_t index = gpuIndex(tex);
+    if (index >= inGpu.size()) {
 	LOG_ERROR("in pool: " << tex.pool.ID <<
 		  " texture ID out of range: " << tex.ID
 		  << " max: " << inGpu.size());
 	return 0;
     }
-    return inGpu[tex.ID];
+    return inGpu[index];
 }
@@ -6,13 +6,51 @@
   
 class TextureLoaderGL : public InternalTexLoader {
 public:
-    TextureLoaderGL(Resource::Pool pool, RenderConfig conf);
+    TextureLoaderGL(Resource::Pool pool, RenderConfig conf, TextureCache* cache);
     ~TextureLoaderGL() override;
     unsigned int getViewIndex(Resource::Texture tex) override;
     void loadGPU() override;
+    void appendGPU() override;
     void clearGPU() override;
+
+    /// Upload the next mip levels of streaming textures, taking the bytes uploaded from budget.
+    void streamMips(size_t* budget);
+
+    /// Load the file of a texture again, it gets a new gl texture.
+    void reload(Resource::Texture tex);
+
+    /// bytes of the gl textures, ones shared with other pools are counted in each of them
+    size_t gpuMemory();
 private:
+    struct StreamingTex {
+	/// index into inGpu
+	size_t index;
+	GLuint format;
+	bool compressed;
+	int width, height;
+	/// where the levels before residentMip are read from
+	std::shared_ptr<MipSource> source;
+	std::vector<size_t> mipSizes;
+	unsigned int residentMip;
+    };
+    void uploadNextMip(StreamingTex &tex);
+    /// make gl textures for the staged textures after the ones in inGpu
+    void uploadStaged();
+    /// make the gl texture at index in inGpu from a staged texture's pixels,
+    /// which start at firstMip. The levels before it are streamed from source.
+    void uploadTexture(StagedTex* tex, std::vector<unsigned char> &pixels, size_t index,
+		       unsigned int firstMip, std::shared_ptr<MipSource> source);
+    /// drop this pool's reference to the gl texture at index, deleting it if it was the last
+    void releaseTexture(size_t index);
+    /// bytes the gl texture of a staged texture takes up
+    size_t gpuSize(StagedTex* tex);
+
     std::vector<GLuint> inGpu;
+    /// cache entry of each texture in inGpu, as textures are shared with other pools
+    std::vector<TextureCache::Entry*> gpuEntries;
+    /// gpuSize of each texture in inGpu
+    std::vector<size_t> gpuSizes;
+    std::vector<StreamingTex> streaming;
 };    
 
 #endif
@@ -1,34 +1,64 @@
 #include "vertex_data.h"
+#include <render-internal/resource-loaders/model_loader.h>
 #include <stdexcept>
+#include <stdint.h>
 
 void GLVertexData::initBuffers(void* vertexData,
 			       uint32_t vertexCount,
 			       uint32_t vertexSize,
 			       std::vector<unsigned int> &indices) {
     this->size = (GLuint)indices.size();
+    this->vertexDataSize = (size_t)vertexCount * vertexSize;
     glGenVertexArrays(1, &VAO);
-    glGenBuffers(1, &VBO);
+    if(ownsVertexBuffer)
+	glGenBuffers(1, &VBO);
     glGenBuffers(1, &EBO);
 
     glBindVertexArray(VAO);
 
     glBindBuffer(GL_ARRAY_BUFFER, VBO);
-    glBufferData(GL_ARRAY_BUFFER, vertexCount * vertexSize, vertexData, GL_STATIC_DRAW);
+    if(ownsVertexBuffer)
+	glBufferData(GL_ARRAY_BUFFER, vertexCount * vertexSize, vertexData, GL_STATIC_DRAW);
 
     glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, EBO);
-    glBufferData(GL_ELEMENT_ARRAY_BUFFER,
-		 indices.size() * sizeof(GLuint), indices.data(), GL_STATIC_DRAW);
+    if(vertexCount <= MAX_SHORT_INDEX_VERTICES) {
+	indexType = GL_UNSIGNED_SHORT;
+	indexSize = sizeof(GLushort);
+	std::vector<GLushort> shortIndices(indices.begin(), indices.end());
+	glBufferData(GL_ELEMENT_ARRAY_BUFFER,
+		     shortIndices.size() * sizeof(GLushort), shortIndices.data(), GL_STATIC_DRAW);
+    } else {
+	indexType = GL_UNSIGNED_INT;
+	indexSize = sizeof(GLuint);
+	glBufferData(GL_ELEMENT_ARRAY_BUFFER,
+		     indices.size() * sizeof(GLuint), indices.data(), GL_STATIC_DRAW);
+    }
 }
 
 GLVertexData::GLVertexData(PipelineInput format,
 			   void* vertexData,
 			   uint32_t vertexCount,
 			   std::vector<unsigned int> &indices) {
+    initBuffers(vertexData, vertexCount, format.size, indices);
+    setAttributes(format, 0);
+}
+
+GLVertexData::GLVertexData(PipelineInput format,
+			   GLuint vertexBuffer,
+			   size_t vertexOffset,
+			   uint32_t vertexCount,
+			   std::vector<unsigned int> &indices) {
+    VBO = vertexBuffer;
+    ownsVertexBuffer = false;
+    initBuffers(nullptr, vertexCount, format.size, indices);
+    setAttributes(format, vertexOffset);
+}
+
+void GLVertexData::setAttributes(PipelineInput format, size_t vertexOffset) {
     size_t size = format.size;
-    initBuffers(vertexData, vertexCount, size, indices);
     for(int i = 0; i < format.entries.size(); i++) {
 	glEnableVertexAttribArray(i);
-	size_t offset = format.entries[i].offset;
+	size_t offset = vertexOffset + format.entries[i].offset;
 	
 	switch(format.entries[i].input_type) {
 	case PipelineInput::type::vec2:
@@ -43,6 +73,27 @@ GLVertexData::GLVertexData(PipelineInput format,
 	case PipelineInput::type::ivec4:
 	    glVertexAttribIPointer(i, 4, GL_INT, size, (void*)offset);
 	    break;
+	case PipelineInput::type::half2:
+	    glVertexAttribPointer(i, 2, GL_HALF_FLOAT, GL_FALSE, size, (void*)offset);
+	    break;
+	case PipelineInput::type::half4:
+	    glVertexAttribPointer(i, 4, GL_HALF_FLOAT, GL_FALSE, size, (void*)offset);
+	    break;
+	case PipelineInput::type::snorm8x4:
+	    glVertexAttribPointer(i, 4, GL_BYTE, GL_TRUE, size, (void*)offset);
+	    break;
+	case PipelineInput::type::snorm16x4:
+	    glVertexAttribPointer(i, 4, GL_SHORT, GL_TRUE, size, (void*)offset);
+	    break;
+	case PipelineInput::type::unorm8x4:
+	    glVertexAttribPointer(i, 4, GL_UNSIGNED_BYTE, GL_TRUE, size, (void*)offset);
+	    break;
+	case PipelineInput::type::unorm16x2:
+	    glVertexAttribPointer(i, 2, GL_UNSIGNED_SHORT, GL_TRUE, size, (void*)offset);
+	    break;
+	case PipelineInput::type::uint8x4:
+	    glVertexAttribIPointer(i, 4, GL_UNSIGNED_BYTE, size, (void*)offset);
+	    break;
 	default:
 	    throw std::runtime_error(
 		    "GL Vertex Data: Unrecognised pipeline input entry type!");
@@ -51,24 +102,38 @@ GLVertexData::GLVertexData(PipelineInput format,
 }
 
 GLVertexData::~GLVertexData() {
-    glDeleteBuffers(1, &VBO);
+    if(ownsVertexBuffer)
+	glDeleteBuffers(1, &VBO);
     glDeleteBuffers(1, &EBO);
     glDeleteVertexArrays(1, &VAO);
 }
 
 void GLVertexData::Draw(unsigned int mode) {
     glBindVertexArray(VAO);
-    glDrawElements(mode, size, GL_UNSIGNED_INT, 0);
+    glDrawElements(mode, size, indexType, 0);
 }
 
 void GLVertexData::DrawInstanced(unsigned int mode, int count) {
     glBindVertexArray(VAO);
-    glDrawElementsInstanced(mode, size, GL_UNSIGNED_INT, 0, count);
+    glDrawElementsInstanced(mode, size, indexType, 0, count);
 }
 
 void GLVertexData::Draw(unsigned int mode, unsigned int verticies) {
     if (verticies > size)
 	verticies = size;
     glBindVertexArray(VAO);
-    glDrawElements(mode, verticies, GL_UNSIGNED_INT, 0);
+    glDrawElements(mode, verticies, indexType, 0);
+}
+
+void GLVertexData::Draw(unsigned int mode, unsigned int indexOffset, unsigned int indexCount) {
+    glBindVertexArray(VAO);
+    glDrawElements(mode, indexCount, indexType,
+		   (void*)(uintptr_t)(indexOffset * indexSize));
+}
+
+void GLVertexData::DrawInstanced(unsigned int mode, int count,
+				 unsigned int indexOffset, unsigned int indexCount) {
+    glBindVertexArray(VAO);
+    glDrawElementsInstanced(mode, indexCount, indexType,
+			    (void*)(uintptr_t)(indexOffset * indexSize), count);
 }
@@ -10,26 +10,47 @@ class GLVertexData
 {
 public:
     GLVertexData() {}
+    /// uses 16 bit indices if vertexCount is small enough.
     GLVertexData(PipelineInput format,
 		 void* vertexData,
 		 uint32_t vertexCount,
 		 std::vector<unsigned int> &indices);
+    /// the vertices are already in vertexBuffer, starting vertexOffset bytes in.
+    /// the buffer isn't deleted with this.
+    GLVertexData(PipelineInput format,
+		 GLuint vertexBuffer,
+		 size_t vertexOffset,
+		 uint32_t vertexCount,
+		 std::vector<unsigned int> &indices);
     ~GLVertexData();
     
     void Draw(unsigned int mode);
     void DrawInstanced(unsigned int mode, int count);
     void Draw(unsigned int mode, unsigned int verticies);
+    /// size of the index buffer in bytes
+    size_t IndexDataSize() { return size * indexSize; }
+    /// size of the vertex buffer in bytes
+    size_t VertexDataSize() { return vertexDataSize; }
+    /// draw part of the index buffer, indexOffset and indexCount are in indices.
+    void Draw(unsigned int mode, unsigned int indexOffset, unsigned int indexCount);
+    void DrawInstanced(unsigned int mode, int count,
+		       unsigned int indexOffset, unsigned int indexCount);
 
 private:
     void initBuffers(void* vertexData,
 		     uint32_t vertexCount,
 		     uint32_t vertexSize,
 		     std::vector<unsigned int> &indices);
+    void setAttributes(PipelineInput format, size_t vertexOffset);
     
     GLuint VAO;
     GLuint VBO;
     GLuint EBO;
     GLuint size;
+    GLenum indexType;
+    GLuint indexSize;
+    size_t vertexDataSize;
+    bool ownsVertexBuffer = true;
 };
 
 
@@ -3,6 +3,7 @@
 
 #include "resource_loaders/vertex_type.h"
 #include <glm/glm.hpp>
+#include <stdint.h>
 
 namespace vertex {
 
@@ -25,6 +26,22 @@ namespace vertex {
 	    glm::ivec4 BoneIDs;
 	    glm::vec4  Weights;
 	};
+
+	/// normal is snorm8x4 (w unused), and the tex coords are half floats,
+	/// so tiled tex coords outside of 0 to 1 still work.
+	struct CompactVertex3D {
+	    glm::vec3 Position;
+	    uint32_t Normal;
+	    uint32_t TexCoord;
+	};
+
+	struct CompactVertexAnim3D {
+	    glm::vec3 Position;
+	    uint32_t Normal;
+	    uint32_t TexCoord;
+	    uint8_t BoneIDs[4];
+	    uint8_t Weights[4];
+	};
     }
 
     
@@ -34,6 +51,15 @@ namespace vertex {
 
     extern ModelVertexType<data::VertexAnim3D> Anim3D;
 
+    /// Reads the same as v3D in a shader (vec3, vec3, vec2),
+    /// but 20 bytes per vertex instead of 32.
+    /// Draw with a pipeline made using Compact3D's input.
+    extern ModelVertexType<data::CompactVertex3D> Compact3D;
+
+    /// Like Anim3D, but 28 bytes per vertex instead of 64.
+    /// The bone ids are uint8x4, so the shader must read them as a uvec4.
+    extern ModelVertexType<data::CompactVertexAnim3D> CompactAnim3D;
+
 }
 
 #endif /* RENDER_API_DEFAULT_VERTEX_TYPES_H */
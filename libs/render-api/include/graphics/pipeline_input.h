@@ -6,11 +6,20 @@
 /// Represents vertex input to a pipeline for a custom vertex type.
 /// Constructed by ModelType
 struct PipelineInput {
+    /// The shader sees the normalised and half types as floats (ie vec2/vec4),
+    /// uint8x4 must be read as a uvec4.
     enum class type {
 	vec2,
 	vec3,
 	vec4,
 	ivec4,
+	half2,     // 2 x 16 bit float
+	half4,     // 4 x 16 bit float
+	snorm8x4,  // 4 x 8 bit int, mapped to -1 to 1
+	snorm16x4, // 4 x 16 bit int, mapped to -1 to 1
+	unorm8x4,  // 4 x 8 bit uint, mapped to 0 to 1
+	unorm16x2, // 2 x 16 bit uint, mapped to 0 to 1
+	uint8x4,   // 4 x 8 bit uint
     };
     struct Entry {
 	type input_type;
@@ -7,6 +7,34 @@
 #include "render_config.h"
 #include "shader_structs.h"
 #include "resource_pool.h"
+#include <vector>
+
+/// bytes held by the renderer, see Render::GetMemoryUsage
+struct MemoryUsage {
+    struct PoolUsage {
+	Resource::Pool pool;
+	Resource::PoolMemory memory;
+    };
+    /// every created resource pool
+    std::vector<PoolUsage> pools;
+    /// gpu memory of the buffers used by the shaders (uniforms, per frame data, etc)
+    uint64_t shaderBuffers = 0;
+    /// gpu memory of the offscreen targets that frames are drawn to
+    uint64_t frameAttachments = 0;
+    /// host visible memory used to copy resources to the gpu
+    uint64_t staging = 0;
+
+    struct Heap {
+	bool deviceLocal;
+	uint64_t size;
+	/// how much the driver thinks the program can use, and is using, of the heap.
+	/// zero if the driver doesn't report them (ie no VK_EXT_memory_budget)
+	uint64_t budget = 0;
+	uint64_t usage = 0;
+    };
+    /// the gpu's memory heaps, empty if the graphics api doesn't expose them
+    std::vector<Heap> heaps;
+};
 
 class Render {
  public:
@@ -24,7 +52,8 @@ class Render {
     /// Create a new pool to load resource into.
     /// Pool will be in use by default.
     virtual ResourcePool* CreateResourcePool() = 0;
-    /// also frees any resources held by the pool
+    /// also frees any resources held by the pool, once the frames
+    /// in flight that may be drawing with them are done
     virtual void DestroyResourcePool(Resource::Pool pool) = 0;
     /// enable or disable using this resource pool's GPU loaded resources
     /// on by default
@@ -48,10 +77,44 @@ class Render {
     void LoadResourcesToGPU(ResourcePool* pool) {
 	return LoadResourcesToGPU(pool->id());
     }
+    /// Load the resources staged in the pool since it was last loaded, keeping
+    /// the ones it already has on the GPU, and their IDs, as they are.
+    /// Can be used on a pool that is in use, the new resources can be drawn from the next frame.
+    /// A pool that isn't in use still needs UseLoadedResources to be called.
+    virtual void AppendResourcesToGPU(Resource::Pool pool) = 0;
+    void AppendResourcesToGPU(ResourcePool* pool) {
+	return AppendResourcesToGPU(pool->id());
+    }
+    /// Like LoadResourcesToGPU, but returns without waiting for the uploads.
+    /// Staged files are still decoded (and their mips made) on the calling thread,
+    /// unless the pool's decodeStaged was called, only the copies to the gpu aren't waited for.
+    /// The pool's resources are used from the first frame after they are on the gpu,
+    /// until then draws using them are skipped.
+    /// Pools that are in use are loaded the blocking way.
+    virtual Resource::LoadTicket LoadResourcesToGPUAsync(Resource::Pool pool) = 0;
+    Resource::LoadTicket LoadResourcesToGPUAsync(ResourcePool* pool) {
+	return LoadResourcesToGPUAsync(pool->id());
+    }
+    /// true once the pool of an async load is being used by the renderer
+    virtual bool LoadFinished(Resource::LoadTicket ticket) = 0;
+    /// Load the file of a texture or model on the GPU again, the handle stays the same.
+    /// Only works for ones loaded from a file, atlas sprites and fonts can't be reloaded.
+    /// Models keep the textures their meshes had.
+    /// Throws if the file can't be read. With hot_reload set in the RenderConfig
+    /// this is done for you when a loaded file changes.
+    virtual void ReloadTexture(Resource::Texture texture) = 0;
+    virtual void ReloadModel(Resource::Model model) = 0;
     /// update render to reflect newly loaded resources
     /// destroyed pools or set resourcePoolInUse changes
     virtual void UseLoadedResources() = 0;
 
+    /// --- Memory ---
+
+    /// bytes held by each pool and by the renderer, for fitting into
+    /// a memory budget or finding pools that leak when recreated.
+    /// Pools marked with ResourcePool::setStaging are left out.
+    virtual MemoryUsage GetMemoryUsage() = 0;
+
 
     /// --- Resource Drawing ---
     
@@ -83,9 +146,9 @@ class Render {
 	DrawQuad(texture, modelMatrix, glm::vec4(1));
     }
 
-    virtual void DrawString(Resource::Font font, std::string text, glm::vec2 position,
+    virtual void DrawString(Resource::Font font, const std::string &text, glm::vec2 position,
 			    float size, float depth, glm::vec4 colour, float rotate) = 0;
-    void DrawString(Resource::Font font, std::string text, glm::vec2 position,
+    void DrawString(Resource::Font font, const std::string &text, glm::vec2 position,
 		    float size, float depth, glm::vec4 colour) {
 	DrawString(font, text, position, size, depth, colour, 0.0f);
     }
@@ -21,8 +21,42 @@ struct RenderConfig {
     //Texture Loading Settings
     bool srgb = false;
     bool mip_mapping = false;
+    // save the mip chains made for textures next to them,
+    // later loads read those instead of decoding the texture and making the mips again.
+    bool cache_mip_maps = false;
     // for a pixelated look (ie no smoothing of pixels)
     bool texture_filter_nearest = false;
+    // load the block compressed .ktx2 made by the texture compressor tool
+    // in place of a texture, if there is one newer than it.
+    bool use_compressed_textures = false;
+    // with mip mapping, a pool can be used once the small mips of its textures are loaded,
+    // the bigger ones are uploaded over the next frames. Textures are blurry until then.
+    bool stream_textures = false;
+    // bytes of mip levels uploaded each frame when streaming textures,
+    // at least one level is uploaded each frame even if it is bigger.
+    unsigned int texture_stream_budget = 4 * 1024 * 1024;
+
+    //Model Loading Settings
+    // save models loaded from files in a binary format next to the original,
+    // later loads read that instead of importing the file again.
+    bool cook_models = false;
+    // reorder mesh triangles and vertices for better gpu vertex cache use
+    // and less overdraw, makes loading a bit slower.
+    bool optimise_meshes = false;
+    // generate lower detail versions of meshes when they are loaded,
+    // DrawModel then picks one for each instance from how big it is on screen.
+    bool generate_lods = false;
+    // fraction of the full screen height the diameter of a model's bounding sphere
+    // has to cover for it to be drawn at full detail,
+    // each lower level of detail is used below half the size of the last one.
+    float lod_screen_size = 0.25f;
+    // split big static meshes into meshlets when loaded, and skip drawing
+    // the meshlets that are off screen or facing away each frame.
+    bool meshlet_culling = false;
+
+    // watch the files textures and models were loaded from, and reload
+    // them when they change. Only on linux, elsewhere it does nothing.
+    bool hot_reload = false;
 
     // vulkan only
     bool manuallyChoseGpu = false;
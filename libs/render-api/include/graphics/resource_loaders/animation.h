@@ -17,6 +17,8 @@ namespace Resource {
       /// get list of transforms for the all of the bones at the current point of the animation.
       std::vector<glm::mat4>* getCurrentBones() { return &bones; }
       std::string getName() { return animation.name; }
+      /// the keyframes this was made from, ie to save the animation
+      const ModelInfo::Animation& getAnimationInfo() { return animation; }
   private:
       void processNode(const ModelInfo::AnimNodes &animNode, glm::mat4 parentMat, bool animated);
       glm::mat4 boneTransform (const ModelInfo::AnimNodes &animNode);
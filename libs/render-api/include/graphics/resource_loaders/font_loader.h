@@ -7,7 +7,7 @@
 class FontLoader {
  public:
     virtual Resource::Font load(std::string file) = 0;
-    virtual float length(Resource::Font font, std::string text, float size) = 0;
+    virtual float length(Resource::Font font, const std::string &text, float size) = 0;
 };
 
 #endif
@@ -12,6 +12,9 @@
 #include <string>
 
 namespace ModelInfo {
+  /// The most bones that can influence one vertex
+  const unsigned int MAX_BONE_INFLUENCES = 4;
+  
   /// A point on the model.
   /// --------------
   /// If the model does not have certain properties,
@@ -25,8 +28,41 @@ namespace ModelInfo {
       glm::vec2 TexCoord = glm::vec2(0);
       glm::vec4 Colour = glm::vec4(0);
       
-      std::vector<unsigned int> BoneIDs;
-      std::vector<float> BoneWeights;  
+      /// The strongest bones influencing this vertex, ordered by weight.
+      /// Only the first BoneCount entries are used.
+      unsigned int BoneIDs[MAX_BONE_INFLUENCES] = { 0 };
+      float BoneWeights[MAX_BONE_INFLUENCES] = { 0 };
+      unsigned int BoneCount = 0;
+
+      /// Keeps the bone if it is one of the strongest MAX_BONE_INFLUENCES seen so far.
+      void addBoneInfluence(unsigned int boneID, float weight) {
+	  unsigned int i = BoneCount;
+	  if(BoneCount < MAX_BONE_INFLUENCES)
+	      BoneCount++;
+	  else if(weight <= BoneWeights[MAX_BONE_INFLUENCES - 1])
+	      return;
+	  else
+	      i = MAX_BONE_INFLUENCES - 1;
+	  // shift weaker influences down to keep the order
+	  for(; i > 0 && BoneWeights[i - 1] < weight; i--) {
+	      BoneIDs[i] = BoneIDs[i - 1];
+	      BoneWeights[i] = BoneWeights[i - 1];
+	  }
+	  BoneIDs[i] = boneID;
+	  BoneWeights[i] = weight;
+      }
+
+      /// Scale the used weights so they sum to one,
+      /// needed after weaker influences were dropped.
+      void normaliseBoneWeights() {
+	  float total = 0;
+	  for(unsigned int i = 0; i < BoneCount; i++)
+	      total += BoneWeights[i];
+	  if(total <= 0)
+	      return;
+	  for(unsigned int i = 0; i < BoneCount; i++)
+	      BoneWeights[i] /= total;
+      }
   };
 
   /// A collection of verticies with indicies, color and a bind transform.
@@ -35,6 +71,11 @@ namespace ModelInfo {
       /// indicies index into the vertex array, to build triangles, which allows for vertex reuse
       /// when mutliple triangles share a vertex.
       std::vector<unsigned int> indices;
+      /// Lower detail versions of the mesh, each is a list of indices into the same verticies.
+      /// Ordered from most to least detailed, not including the full detail indices above.
+      /// Filled in by the model loader if RenderConfig::generate_lods is set
+      /// and this is empty, so you can also supply your own.
+      std::vector<std::vector<unsigned int>> lodIndices;
       /// Diffuse textures change the look of the model.
       std::vector<std::string> diffuseTextures;
       /// The diffuse color gives the overall color of the model,
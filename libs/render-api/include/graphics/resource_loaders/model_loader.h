@@ -6,6 +6,8 @@
 #include "vertex_type.h"
 #include "../default_vertex_types.h"
 
+#include <algorithm>
+
 
 class ModelLoader {
     
@@ -40,7 +42,9 @@ class ModelLoader {
 			 std::string       textureFolder,
 			 std::vector<Resource::ModelAnimation>* pAnimations) {
 	ModelInfo::Model model = loadModelData(path);
-	return load(modeltype, model, textureFolder, pAnimations);
+	Resource::Model loaded = load(modeltype, model, textureFolder, pAnimations);
+	loadedFromFile(loaded, path, reloadWith(modeltype));
+	return loaded;
     }
     
     template <typename T_Vert>
@@ -67,10 +71,34 @@ class ModelLoader {
 	return load(vertex::v3D, path);
     }
     
+    /// ----- Load many models from files -----
+
+    /// Imports the files and converts their vertices across worker threads.
+    /// The returned models are in the same order as paths.
+    /// Note: the vertexLoader of your vertex type will be called from several threads at once.
+    template <typename T_Vert>
+    std::vector<Resource::Model> loadBatch(std::vector<std::string> paths,
+					   ModelVertexType<T_Vert>  modelType,
+					   std::string              textureFolder);
+
+    template <typename T_Vert>
+    std::vector<Resource::Model> loadBatch(std::vector<std::string> paths,
+					   ModelVertexType<T_Vert>  modelType) {
+	return loadBatch(paths, modelType, DEFAULT_TEXTURE_PATH);
+    }
+
+    std::vector<Resource::Model> loadBatch(std::vector<std::string> paths) {
+	return loadBatch(paths, vertex::v3D);
+    }
+    
     /// Load Model from file into a ModelInfo::Model variable.
     /// Can then be inspected and modified before being loaded to GPU
     virtual ModelInfo::Model loadModelData(std::string path) = 0;
 
+    /// Load many files at once, each on a worker thread.
+    /// Returned in the same order as paths.
+    virtual std::vector<ModelInfo::Model> loadModelDataBatch(std::vector<std::string> paths) = 0;
+
     
     /// ----- Animation Info -----
     
@@ -86,6 +114,32 @@ protected:
 				     std::vector<void*> &meshVertData,
 				     std::string textureFolder,
 				     std::vector<Resource::ModelAnimation> *pAnimations) = 0;
+
+    /// called on the model data before the vertices are converted,
+    /// lets the loader optimise meshes etc.
+    virtual void prepareModelData(ModelInfo::Model &model) = 0;
+
+    /// memory the vertices of a load are converted into, sized for all of its meshes at once.
+    /// owned by the loader, so it can be staging memory that gets copied straight to the gpu.
+    virtual void* allocateVertexData(size_t size) = 0;
+
+    /// calls job for every index in [0, count), possibly from many threads at once.
+    /// returns once every call has finished.
+    virtual void parallelFor(size_t count, std::function<void(size_t)> job) = 0;
+
+    /// called after a model is staged from a file, with a function that stages
+    /// model data the same way again, so the loader can reload the model later.
+    virtual void loadedFromFile(Resource::Model model, std::string path,
+				std::function<void(ModelInfo::Model&)> stage) {}
+
+private:
+    template <typename T_Vert>
+    std::function<void(ModelInfo::Model&)> reloadWith(ModelVertexType<T_Vert> modelType) {
+	// textures stay as they were, so no folder is needed
+	return [this, modelType](ModelInfo::Model &model) {
+	    load(modelType, model, "", nullptr);
+	};
+    }
 };
 
 
@@ -96,21 +150,76 @@ Resource::Model ModelLoader::load(ModelVertexType<T_Vert> modelType,
 				  std::string textureFolder,
 				  std::vector<Resource::ModelAnimation>* pAnimations) {
 
+    prepareModelData(model);
+
+    size_t vertexCount = 0;
+    for(auto &mesh: model.meshes)
+	vertexCount += mesh.verticies.size();
+    T_Vert* vertices = (T_Vert*)allocateVertexData(modelType.input.size * vertexCount);
+    
     std::vector<void*> meshVertData(model.meshes.size());
     
     for(int i = 0; i < model.meshes.size(); i++) {
 
 	ModelInfo::Mesh* m = &model.meshes[i];
-	T_Vert* vertices = (T_Vert*)
-	    std::malloc(modelType.input.size * m->verticies.size());
 	
 	for(int j = 0; j < m->verticies.size(); j++)
 	    vertices[j] = modelType.vertexLoader(m->verticies[j], m->bindTransform);
 
 	meshVertData[i] = vertices;
+	vertices += m->verticies.size();
     }
     
     return loadData(modelType.input, model, meshVertData, textureFolder, pAnimations);
 }
 
+template <typename T_Vert>
+std::vector<Resource::Model> ModelLoader::loadBatch(std::vector<std::string> paths,
+						    ModelVertexType<T_Vert> modelType,
+						    std::string textureFolder) {
+    std::vector<ModelInfo::Model> models = loadModelDataBatch(paths);
+    for(auto &model: models)
+	prepareModelData(model);
+
+    // split the vertices into chunks so big meshes get spread over threads too
+    const size_t CHUNK_SIZE = 4096;
+    struct Chunk {
+	ModelInfo::Mesh* mesh;
+	T_Vert* vertices;
+	size_t start, end;
+    };
+    std::vector<Chunk> chunks;
+    size_t vertexCount = 0;
+    for(auto &model: models)
+	for(auto &mesh: model.meshes)
+	    vertexCount += mesh.verticies.size();
+    T_Vert* vertices = (T_Vert*)allocateVertexData(modelType.input.size * vertexCount);
+    std::vector<std::vector<void*>> meshVertData(models.size());
+    for(int i = 0; i < models.size(); i++) {
+	meshVertData[i].resize(models[i].meshes.size());
+	for(int j = 0; j < models[i].meshes.size(); j++) {
+	    ModelInfo::Mesh* m = &models[i].meshes[j];
+	    meshVertData[i][j] = vertices;
+	    for(size_t start = 0; start < m->verticies.size(); start += CHUNK_SIZE)
+		chunks.push_back({m, vertices, start,
+				  std::min(start + CHUNK_SIZE, m->verticies.size())});
+	    vertices += m->verticies.size();
+	}
+    }
+
+    parallelFor(chunks.size(), [&chunks, &modelType](size_t i) {
+	Chunk &c = chunks[i];
+	for(size_t j = c.start; j < c.end; j++)
+	    c.vertices[j] = modelType.vertexLoader(c.mesh->verticies[j], c.mesh->bindTransform);
+    });
+
+    // staging isn't thread safe, and this keeps the model ids in path order
+    std::vector<Resource::Model> loaded(models.size());
+    for(int i = 0; i < models.size(); i++)
+	loaded[i] = loadData(modelType.input, models[i], meshVertData[i], textureFolder, nullptr);
+    for(int i = 0; i < models.size(); i++)
+	loadedFromFile(loaded[i], paths[i], reloadWith(modelType));
+    return loaded;
+}
+
 #endif /* RENDER_API_MODEL_LOADER_H */
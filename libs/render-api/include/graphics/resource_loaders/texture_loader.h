@@ -8,6 +8,11 @@
 class TextureLoader {
  public:
     virtual Resource::Texture load(std::string path) = 0;
+    /// Small textures are packed into shared atlas pages when the pool is loaded,
+    /// so quads drawn with them can share a batch. Bigger ones are loaded like load(path).
+    /// The returned texture knows its part of the page, which DrawQuad uses.
+    /// Only for quads, as models and repeating texOffsets would sample the whole page.
+    virtual Resource::Texture loadToAtlas(std::string path) = 0;
     /// takes ownership of data
     virtual Resource::Texture load(unsigned char* data,
 					  int width,
@@ -5,14 +5,54 @@
 #include "resource_loaders/texture_loader.h"
 #include "resource_loaders/font_loader.h"
 
+#include <map>
+#include <string>
+#include <cstdint>
+
+namespace Resource {
+  /// what an asset pack staged, by the path each resource was loaded from
+  /// when the pack was made. models that weren't loaded from a file are staged, but not named.
+  struct PackedResources {
+      std::map<std::string, Texture> textures;
+      std::map<std::string, Model> models;
+      std::map<std::string, Font> fonts;
+  };
+
+  /// bytes a pool is holding
+  struct PoolMemory {
+      /// ram used by resources waiting to be loaded to the gpu
+      uint64_t staged = 0;
+      /// gpu memory of the loaded textures
+      uint64_t textures = 0;
+      /// gpu memory of the loaded vertex and index buffers
+      uint64_t models = 0;
+  };
+}
+
 class ResourcePool {
  public:
     virtual ModelLoader* model() = 0;
     virtual TextureLoader* tex() = 0;
     virtual FontLoader* font() = 0;
+    /// Stage everything in an asset pack made by the asset_packer tool.
+    /// Nothing needs decoding or converting, so this is much faster than loading the files.
+    /// Throws if the pack can't be read.
+    virtual Resource::PackedResources loadPack(std::string path) = 0;
+    /// Decode the staged textures and make their mips now, rather than when the pool
+    /// is loaded to the gpu, so loading only copies them. Models are converted when staged.
+    /// Can be called from another thread, like staging, while nothing else uses the pool.
+    virtual void decodeStaged() = 0;
+    /// What the pool currently has staged and loaded.
+    virtual Resource::PoolMemory memoryUsage() = 0;
     Resource::Pool id() { return pool; }
+    /// Mark the pool as being staged on another thread, so the renderer
+    /// leaves it out of Render::GetMemoryUsage until it is unmarked.
+    /// Call from the render thread.
+    void setStaging(bool staging) { this->staging = staging; }
+    bool isStaging() { return staging; }
 protected:
     Resource::Pool pool;
+    bool staging = false;
 };
 
 
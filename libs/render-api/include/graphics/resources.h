@@ -36,6 +36,19 @@ namespace Resource {
       size_t ID = NULL_POOL_ID;
   };
 
+  /// returned by an async pool load, to check when it is finished
+  struct LoadTicket {
+      LoadTicket() {}
+      LoadTicket(Pool pool, uint64_t ID) {
+	  this->pool = pool;
+	  this->ID = ID;
+      }
+      
+      Pool pool;
+      /// zero if the load was already finished when it returned
+      uint64_t ID = 0;
+  };
+
   static size_t NULL_ID = SIZE_MAX;
   
   struct Texture {
@@ -57,16 +70,28 @@ namespace Resource {
 	  return
 	      pool == other.pool &&
 	      ID == other.ID &&
-	      dim == other.dim;
+	      dim == other.dim &&
+	      atlasRect == other.atlasRect;
       }
       
       bool operator!=(Texture other) {
 	  return !(*this == other);
       }
+
+      /// the texOffset to draw a quad with, so it only samples this texture's part of its atlas
+      glm::vec4 atlasTexOffset(glm::vec4 texOffset) {
+	  return glm::vec4(atlasRect.x + texOffset.x * atlasRect.z,
+			   atlasRect.y + texOffset.y * atlasRect.w,
+			   texOffset.z * atlasRect.z,
+			   texOffset.w * atlasRect.w);
+      }
       
       Pool pool;
       size_t ID = NULL_ID;
       glm::vec2 dim = glm::vec2(0, 0);
+      /// offset and size of the texture in its image, in texture coords.
+      /// only textures packed into an atlas don't use the whole image.
+      glm::vec4 atlasRect = glm::vec4(0, 0, 1, 1);
   };
 
   static size_t NULL_MODEL_ID = SIZE_MAX;
@@ -2,6 +2,7 @@
 
 #include <glm/gtc/matrix_inverse.hpp>
 #include <graphics/logger.h>
+#include <algorithm>
 
 namespace vertex {
 
@@ -52,7 +53,7 @@ namespace vertex {
 	  v.Normal = vert.Normal;
 	  v.TexCoord = vert.TexCoord;
 	  for(int vecElem = 0; vecElem < 4; vecElem++) {
-	      if(vert.BoneIDs.size() <= vecElem) {
+	      if(vert.BoneCount <= vecElem) {
 		  v.BoneIDs[vecElem] = -1;
 		  v.Weights[vecElem] = 0;
 	      } else {
@@ -60,10 +61,60 @@ namespace vertex {
 		  v.Weights[vecElem] = vert.BoneWeights[vecElem];
 	      }
 	  }
-	  if(vert.BoneIDs.size() > 4)
-	      LOG_CERR("vertex influenced by more than 4 bones, but only 4 bones will be used!\n",
-		       "Warning");
 	  return v;
       });
-  
+
+  uint32_t packNormal(glm::vec3 normal) {
+      float len = glm::length(normal);
+      if(len > 0)
+	  normal /= len;
+      return glm::packSnorm4x8(glm::vec4(normal, 0.0f));
+  }
+
+  ModelVertexType<data::CompactVertex3D> Compact3D( {
+	  PipelineInput::Entry(
+		  PipelineInput::type::vec3, offsetof(data::CompactVertex3D, Position)),
+	  PipelineInput::Entry(
+		  PipelineInput::type::snorm8x4, offsetof(data::CompactVertex3D, Normal)),
+	  PipelineInput::Entry(
+		  PipelineInput::type::half2, offsetof(data::CompactVertex3D, TexCoord))},
+      [](ModelInfo::Vertex vert, glm::mat4 transform) {
+	  data::CompactVertex3D v;
+	  v.Position = transform * glm::vec4(vert.Position, 1.0f);
+	  v.Normal = packNormal(glm::mat3(glm::inverseTranspose(transform)) * vert.Normal);
+	  v.TexCoord = glm::packHalf2x16(vert.TexCoord);
+	  return v;
+      });
+
+  ModelVertexType<data::CompactVertexAnim3D> CompactAnim3D( {
+	  PipelineInput::Entry(
+		  PipelineInput::type::vec3, offsetof(data::CompactVertexAnim3D, Position)),
+	  PipelineInput::Entry(
+		  PipelineInput::type::snorm8x4, offsetof(data::CompactVertexAnim3D, Normal)),
+	  PipelineInput::Entry(
+		  PipelineInput::type::half2, offsetof(data::CompactVertexAnim3D, TexCoord)),
+	  PipelineInput::Entry(
+		  PipelineInput::type::uint8x4, offsetof(data::CompactVertexAnim3D, BoneIDs)),
+	  PipelineInput::Entry(
+		  PipelineInput::type::unorm8x4, offsetof(data::CompactVertexAnim3D, Weights)),},
+      [](ModelInfo::Vertex vert, glm::mat4 transform) {
+	  data::CompactVertexAnim3D v;
+	  v.Position = vert.Position;
+	  v.Normal = packNormal(vert.Normal);
+	  v.TexCoord = glm::packHalf2x16(vert.TexCoord);
+	  // round the weights to 8 bits, then give the rounding error
+	  // to the strongest bone so they still add up to one
+	  int total = 0;
+	  for(int i = 0; i < 4; i++) {
+	      bool used = i < vert.BoneCount;
+	      v.BoneIDs[i] = used ? (uint8_t)vert.BoneIDs[i] : 0;
+	      v.Weights[i] = used ?
+		  (uint8_t)std::min(std::max(vert.BoneWeights[i], 0.0f) * 255.0f + 0.5f, 255.0f) : 0;
+	      total += v.Weights[i];
+	  }
+	  if(vert.BoneCount > 0)
+	      v.Weights[0] = (uint8_t)std::min(std::max(v.Weights[0] + 255 - total, 0), 255);
+	  return v;
+      });
+
 }
@@ -0,0 +1,37 @@
+/// Tells which files have been written to, for reloading resources while the program runs.
+/// Uses inotify on linux, on other platforms no changes are ever reported.
+
+#ifndef RENDER_INTERNAL_FILE_WATCHER_H
+#define RENDER_INTERNAL_FILE_WATCHER_H
+
+#include <string>
+#include <vector>
+#include <map>
+#include <set>
+
+class FileWatcher {
+public:
+    FileWatcher();
+    ~FileWatcher();
+    FileWatcher(const FileWatcher&) = delete;
+    FileWatcher& operator=(const FileWatcher&) = delete;
+
+    /// Start watching the file at path, does nothing if it is empty or already watched.
+    /// The file's folder is what gets watched, so files replaced by
+    /// editors that save to a new file and rename it are still seen.
+    void watch(std::string path);
+
+    /// The watched paths written to since the last call, as they were passed to watch.
+    /// Doesn't block.
+    std::vector<std::string> changed();
+
+private:
+    int fd = -1;
+    /// inotify watch of each folder
+    std::map<std::string, int> folders;
+    /// folder watch and file name -> the path given to watch
+    std::map<std::pair<int, std::string>, std::string> files;
+    std::set<std::string> watched;
+};
+
+#endif /* RENDER_INTERNAL_FILE_WATCHER_H */
@@ -0,0 +1,134 @@
+/// A binary format holding everything a resource pool staged, already in the form
+/// it gets copied to the gpu in. Textures have their mips, models have their converted
+/// vertices, levels of detail and meshlets, and fonts have their rendered atlas.
+/// Packs are made by the asset_packer tool, and are memory mapped when loaded,
+/// so loading a pool from one is a read of the file and copies into staging memory.
+
+#ifndef RENDER_INTERNAL_ASSET_PACK_H
+#define RENDER_INTERNAL_ASSET_PACK_H
+
+#include <graphics/resource_pool.h>
+#include "texture_loader.h"
+#include "model_loader.h"
+#include "font_loader.h"
+#include <string>
+#include <vector>
+
+class MappedFile;
+
+namespace assetpack {
+
+  /// bumped whenever the layout of the pack changes, packs made
+  /// with a different version fail to load and need to be packed again.
+  const unsigned int FORMAT_VERSION = 2;
+
+  struct Texture {
+      int width, height, nrChannels;
+      TextureFormat format;
+      /// the colours are in srgb, from the file or the packer's config,
+      /// and the mips were averaged for it
+      bool srgb = false;
+      /// bytes of each mip level, from largest to smallest
+      std::vector<size_t> mipSizes;
+      /// every mip level, one after the other. pixels is what gets written,
+      /// when the pack is read data points to them in the mapped file instead.
+      std::vector<unsigned char> pixels;
+      const unsigned char* data = nullptr;
+  };
+
+  /// a file loaded as a texture, and what it gave back
+  struct TextureName {
+      std::string path;
+      /// index into the pack's textures
+      uint32_t texture;
+      glm::vec2 dim;
+      glm::vec4 atlasRect;
+  };
+
+  struct Mesh {
+      /// vertexCount vertices of the model's format, written from vertexData
+      /// and read back as a pointer into the mapped file, like Texture's pixels.
+      std::vector<char> vertexData;
+      const char* vertices = nullptr;
+      uint64_t vertexCount;
+      std::vector<uint32_t> indices;
+      std::vector<IndexRange> lods;
+      std::vector<meshopt::Meshlet> meshlets;
+      glm::vec4 diffuseColour;
+      /// index into the pack's textures, -1 if it has none
+      int32_t texture;
+  };
+
+  struct Animation {
+      /// bones in the bind pose the animation starts from
+      std::vector<glm::mat4> bones;
+      ModelInfo::Animation animation;
+  };
+
+  struct Model {
+      /// the file it was loaded from, empty if it wasn't
+      std::string path;
+      PipelineInput format;
+      std::vector<Mesh> meshes;
+      std::vector<Animation> animations;
+      glm::vec3 boundsCentre;
+      float boundsRadius;
+      uint32_t lodCount;
+  };
+
+  struct Glyph {
+      char c;
+      bool blank;
+      glm::vec4 texOffset;
+      glm::vec2 size;
+      glm::vec2 bearing;
+      float advance;
+  };
+
+  struct Font {
+      std::string path;
+      /// index into the pack's textures of the font's atlas
+      uint32_t texture;
+      std::vector<Glyph> glyphs;
+  };
+
+  /// in the order they were staged in
+  struct Contents {
+      std::vector<Texture> textures;
+      std::vector<TextureName> textureNames;
+      std::vector<Model> models;
+      std::vector<Font> fonts;
+  };
+
+  /// Everything the loaders have staged. The textures are decoded and their mips
+  /// are made, so this can take a while. fontLoader can be null.
+  Contents pack(InternalTexLoader* texLoader, InternalModelLoader* modelLoader,
+		InternalFontLoader* fontLoader);
+
+  /// returns false if the file could not be written.
+  bool write(const Contents &contents, std::string path);
+
+  /// A mapped pack file, the texture and vertex data in contents point into it.
+  class Pack {
+  public:
+      /// Throws if the file is missing, truncated or was packed with a different format version.
+      Pack(std::string path);
+      ~Pack();
+      Pack(const Pack&) = delete;
+      Pack& operator=(const Pack&) = delete;
+
+      std::string path;
+      Contents contents;
+  private:
+      MappedFile* file;
+  };
+
+  /// Stage everything in the pack at path, after what the loaders already have staged.
+  /// The pack stays mapped until texLoader's staged textures are cleared.
+  /// fontLoader can be null if the pack has no fonts. Throws if the pack can't be read.
+  Resource::PackedResources load(std::string path, InternalTexLoader* texLoader,
+				 InternalModelLoader* modelLoader,
+				 InternalFontLoader* fontLoader);
+}
+
+#endif /* RENDER_INTERNAL_ASSET_PACK_H */
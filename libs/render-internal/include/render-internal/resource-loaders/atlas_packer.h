@@ -0,0 +1,33 @@
+/// Packs rectangles into a fixed size page, for putting many small textures in one image.
+
+#ifndef RENDER_INTERNAL_ATLAS_PACKER_H
+#define RENDER_INTERNAL_ATLAS_PACKER_H
+
+#include <vector>
+#include <cstddef>
+
+/// Places each rectangle as low as it will fit on the skyline of the ones placed so far,
+/// which packs well when rects are added in any order.
+class AtlasPacker {
+public:
+    AtlasPacker(int width, int height);
+
+    /// returns false if there is no room left for the rect
+    bool add(int width, int height, int* x, int* y);
+
+    int width() { return pageWidth; }
+    int height() { return pageHeight; }
+
+private:
+    /// a run of the top edge of the placed rects
+    struct Segment {
+	int x, y, width;
+    };
+    /// the lowest y a rect starting at segment i would sit at, or -1 if it doesn't fit
+    int fitAt(size_t i, int width, int height);
+
+    int pageWidth, pageHeight;
+    std::vector<Segment> skyline;
+};
+
+#endif /* RENDER_INTERNAL_ATLAS_PACKER_H */
@@ -0,0 +1,68 @@
+/// Textures compressed ahead of time into block compressed (BCn) formats,
+/// stored in KTX2 or DDS files with their mip chains.
+/// These are uploaded as they are, using a quarter to an eighth of the
+/// memory of an RGBA8 texture.
+
+#ifndef RENDER_INTERNAL_COMPRESSED_TEXTURE_H
+#define RENDER_INTERNAL_COMPRESSED_TEXTURE_H
+
+#include <string>
+#include <vector>
+#include <ostream>
+#include <cstddef>
+
+/// how a texture's pixels are stored on the gpu
+enum class TextureFormat {
+    RGBA8,
+    BC1, // rgb + 1 bit alpha, 8 bytes per 4x4 block
+    BC3, // rgba, 16 bytes per block
+    BC4, // one channel, 8 bytes per block
+    BC5, // two channels, 16 bytes per block
+    BC7, // rgba, 16 bytes per block, can be loaded but not encoded
+};
+
+namespace compressedtex {
+
+  struct Info {
+      TextureFormat format;
+      /// if the file says the colours are in srgb
+      bool srgb;
+      /// false if the file doesn't say what colour space it is in,
+      /// ie dds files without a dx10 header
+      bool hasColourSpace;
+      int width, height;
+      /// where each mip level is in the file, from largest to smallest
+      std::vector<size_t> mipOffsets;
+      std::vector<size_t> mipSizes;
+  };
+
+  /// the path the compressed version of a texture is saved to, ie tex.png -> tex.png.ktx2
+  std::string compressedPath(std::string texturePath);
+
+  /// true if the data starts with a KTX2 or DDS identifier
+  bool isCompressedFile(const char* data, size_t size);
+
+  /// returns false if the header is truncated, the mips go past the end of the file
+  /// or the file uses something not supported (ie cubemaps, arrays or other formats).
+  bool readHeader(const char* data, size_t size, Info* info);
+
+  /// bytes of a mip level with the given size
+  size_t mipSize(TextureFormat format, int width, int height);
+
+  /// Encode an RGBA8 image into a BC1, BC3, BC4 or BC5 format.
+  /// BC4 uses the red channel, BC5 the red and green channels.
+  std::vector<unsigned char> encode(TextureFormat format,
+				    const unsigned char* rgba, int width, int height);
+
+  /// mips from largest to smallest, returns false if the file could not be written
+  bool writeKtx2(std::string path, TextureFormat format, bool srgb, int width, int height,
+		 const std::vector<const unsigned char*> &mips,
+		 const std::vector<size_t> &mipSizes);
+  /// write the KTX2 file to out instead, returns false if out failed
+  bool writeKtx2(std::ostream &out, TextureFormat format, bool srgb, int width, int height,
+		 const std::vector<const unsigned char*> &mips,
+		 const std::vector<size_t> &mipSizes);
+
+}
+
+#endif /* RENDER_INTERNAL_COMPRESSED_TEXTURE_H */
@@ -0,0 +1,36 @@
+/// A binary format for ModelInfo::Models, so model files only need to go
+/// through assimp once. Cooked files are stored next to the model they
+/// were made from, and are memory mapped when read back.
+
+#ifndef RENDER_INTERNAL_COOKED_MODEL_H
+#define RENDER_INTERNAL_COOKED_MODEL_H
+
+#include <graphics/resource_loaders/model_info.h>
+#include <string>
+
+namespace cookedmodel {
+
+  /// bumped whenever the layout of the cooked file changes,
+  /// older cooked files are then ignored and recooked.
+  const unsigned int FORMAT_VERSION = 3;
+
+  /// the path the cooked version of a model file is saved to.
+  std::string cookedPath(std::string modelPath);
+
+  /// true if the cooked file exists and is newer than the model file.
+  /// Times are compared to the nanosecond where the filesystem has them,
+  /// so a model saved again in the same second gets recooked.
+  /// Also true if only the cooked file exists, so cooked models can be shipped
+  /// without the original files.
+  bool upToDate(std::string modelPath, std::string cookedPath);
+
+  /// returns false if the file could not be written.
+  bool write(const ModelInfo::Model &model, std::string cookedPath);
+
+  /// returns false if the file is missing, truncated
+  /// or was cooked with a different format version.
+  bool read(std::string cookedPath, ModelInfo::Model *model);
+
+}
+
+#endif /* RENDER_INTERNAL_COOKED_MODEL_H */
@@ -8,21 +8,34 @@
 #include <string>
 
 struct FontData;
+class InternalTexLoader;
+namespace assetpack {
+  struct Contents;
+}
 
 class InternalFontLoader : public FontLoader {
 public:
     InternalFontLoader(Resource::Pool pool, TextureLoader *texLoader);
     virtual ~InternalFontLoader();
     Resource::Font load(std::string file) override;
-    float length(Resource::Font font, std::string text, float size) override;
+    float length(Resource::Font font, const std::string &text, float size) override;
 
-    std::vector<Resource::QuadDraw> DrawString(Resource::Font font,
-					       std::string text, glm::vec2 pos,
-					       float size, float depth,
-					       glm::vec4 colour, float rotate);
+    /// Add the quads of the text's characters to draws. Doesn't allocate
+    /// if draws already has the capacity, so renderers can reuse one each frame.
+    void DrawString(Resource::Font font, const std::string &text, glm::vec2 pos,
+		    float size, float depth, glm::vec4 colour, float rotate,
+		    std::vector<Resource::QuadDraw> *draws);
     void clearStaged();
     void loadGPU();
+    /// keeps the fonts already loaded, see InternalTexLoader::appendGPU
+    void appendGPU();
     void clearGPU();
+
+    /// Add the staged fonts to pack, their atlases are found in texLoader's staged textures.
+    void writePack(assetpack::Contents* pack, InternalTexLoader* texLoader);
+    /// Stage the fonts of a pack, see InternalModelLoader::loadPack
+    std::vector<Resource::Font> loadPack(const assetpack::Contents &pack,
+					 const std::vector<Resource::Texture> &textures);
     
 private:
     void clearFonts(std::vector<FontData*> &fonts);
@@ -31,6 +44,9 @@ private:
     TextureLoader *texLoader;
     std::vector<FontData*> staged;
     std::vector<FontData*> fonts;
+    /// ID of fonts[0] and of staged[0]
+    size_t gpuBaseID = 0;
+    size_t stagedBaseID = 0;
 };
 
 #endif
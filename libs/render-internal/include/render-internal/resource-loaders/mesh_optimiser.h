@@ -0,0 +1,45 @@
+/// Reorders mesh indices and vertices so the GPU does less work drawing them.
+/// Only the order of triangles and vertices is changed, the mesh looks the same.
+
+#ifndef RENDER_INTERNAL_MESH_OPTIMISER_H
+#define RENDER_INTERNAL_MESH_OPTIMISER_H
+
+#include <graphics/resource_loaders/model_info.h>
+#include <vector>
+
+namespace meshopt {
+
+  /// Results of running a mesh's indices through a simulated FIFO post-transform cache.
+  struct CacheStats {
+      /// average cache miss ratio, vertex shader runs per triangle.
+      /// 0.5 is the best case for a big grid, 3 is the worst.
+      float acmr = 0;
+      /// average transform to vertex ratio, vertex shader runs per vertex.
+      /// 1 is the best case.
+      float atvr = 0;
+      size_t transforms = 0;
+  };
+
+  CacheStats analyseVertexCache(const std::vector<unsigned int> &indices,
+				size_t vertexCount, unsigned int cacheSize);
+
+  /// Reorder triangles so recently used vertices get reused while still in the cache.
+  /// (Tom Forsyth's linear-speed vertex cache optimisation)
+  void optimiseVertexCache(std::vector<unsigned int> &indices, size_t vertexCount);
+
+  /// Reorder clusters of cache optimised triangles so triangles facing outwards
+  /// get drawn first, which helps early depth testing reject hidden pixels.
+  /// threshold is how much worse than the cache optimised ACMR the result can be.
+  void optimiseOverdraw(ModelInfo::Mesh &mesh, float threshold);
+
+  /// Reorder vertices to the order the indices first use them, so vertex fetches
+  /// read memory in order. Vertices that no triangle uses are removed.
+  /// The mesh's lod indices are remapped too, and the vertices they use are kept.
+  void optimiseVertexFetch(ModelInfo::Mesh &mesh);
+
+  /// Runs all of the above on the mesh.
+  void optimiseMesh(ModelInfo::Mesh &mesh);
+
+}
+
+#endif /* RENDER_INTERNAL_MESH_OPTIMISER_H */
@@ -0,0 +1,22 @@
+/// Makes lower detail versions of meshes by collapsing edges.
+/// The simplified meshes use the same vertices as the original,
+/// only the indices change, so all levels of detail can share one vertex buffer.
+
+#ifndef RENDER_INTERNAL_MESH_SIMPLIFIER_H
+#define RENDER_INTERNAL_MESH_SIMPLIFIER_H
+
+#include <graphics/resource_loaders/model_info.h>
+#include <vector>
+
+namespace meshopt {
+
+  /// Repeatedly halves the triangle count of the mesh using quadric error edge collapse
+  /// (Garland and Heckbert), returning up to lodCount index lists from most to least detailed.
+  /// Stops early if the mesh can't be simplified much further,
+  /// ie open borders and uv seams are kept in place, so some meshes won't shrink.
+  std::vector<std::vector<unsigned int>> generateLods(const ModelInfo::Mesh &mesh,
+						      unsigned int lodCount);
+
+}
+
+#endif /* RENDER_INTERNAL_MESH_SIMPLIFIER_H */
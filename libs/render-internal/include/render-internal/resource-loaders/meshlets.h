@@ -0,0 +1,79 @@
+/// Splits meshes into small clusters of triangles (meshlets) with bounds,
+/// so parts of a big mesh that are off screen or facing away can be skipped.
+
+#ifndef RENDER_INTERNAL_MESHLETS_H
+#define RENDER_INTERNAL_MESHLETS_H
+
+#include <graphics/resource_loaders/model_info.h>
+#include <vector>
+#include <stdint.h>
+
+namespace meshopt {
+
+  const unsigned int MESHLET_MAX_VERTICES = 64;
+  const unsigned int MESHLET_MAX_TRIANGLES = 124;
+  /// meshes with fewer meshlets than this aren't worth culling
+  const size_t MIN_MESHLETS = 8;
+
+  /// A run of triangles in the mesh's index data.
+  struct Meshlet {
+      uint32_t indexOffset;
+      uint32_t indexCount;
+      glm::vec3 centre;
+      float radius;
+      /// every triangle's normal is within the cone around axis,
+      /// cutoff is the sine of the cone's angle, or 1 if the cone is too wide to cull with.
+      glm::vec3 coneAxis;
+      float coneCutoff;
+  };
+
+  /// Cuts the triangles into meshlets in the order the indices already have,
+  /// so run the vertex cache optimiser first to get tight clusters.
+  /// Positions are put through the mesh's bind transform like vertex::v3D does.
+  /// Returns no meshlets if there would be fewer than MIN_MESHLETS.
+  std::vector<Meshlet> buildMeshlets(const ModelInfo::Mesh &mesh);
+
+  /// Tests meshlets against the camera for each instance of a mesh.
+  class MeshletCuller {
+  public:
+      /// Cone culling assumes back faces are culled and counter clockwise triangles face forwards,
+      /// turn it off if back faces are drawn.
+      MeshletCuller(bool coneCulling);
+
+      void setCamera(glm::mat4 view, glm::mat4 proj);
+
+      /// Culls every instance's meshlets, spread over worker threads.
+      /// modelMatrices points to the first instance's matrix, each instance's
+      /// matrix is stride bytes after the last.
+      /// If mergeInstances, a meshlet is kept if any instance could see it and
+      /// there is one set of ranges, otherwise there is a set for each instance.
+      void cull(const std::vector<Meshlet> &meshlets,
+		const void* modelMatrices, size_t stride, size_t instanceCount,
+		bool mergeInstances);
+
+      /// Visible index ranges of an instance from the last cull,
+      /// neighbouring meshlets are merged into one range.
+      /// offset and count pairs, relative to the start of the mesh's indices.
+      const std::vector<std::pair<uint32_t, uint32_t>> &ranges(size_t instance) {
+	  return visible[instance];
+      }
+
+      /// triangle counts since the last resetStats
+      uint64_t trianglesDrawn = 0;
+      uint64_t trianglesCulled = 0;
+      void resetStats() {
+	  trianglesDrawn = 0;
+	  trianglesCulled = 0;
+      }
+
+  private:
+      bool coneCulling;
+      glm::vec4 frustum[6];
+      glm::vec3 cameraPos;
+      std::vector<uint8_t> flags;
+      std::vector<std::vector<std::pair<uint32_t, uint32_t>>> visible;
+  };
+
+}
+
+#endif /* RENDER_INTERNAL_MESHLETS_H */
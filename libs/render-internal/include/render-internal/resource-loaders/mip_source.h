@@ -0,0 +1,43 @@
+/// Where the mip levels of a streaming texture that weren't loaded with its pool come from.
+/// Each level is only read when it is asked for, on its own thread,
+/// so streaming doesn't keep every level in memory or read files on the render thread.
+
+#ifndef RENDER_INTERNAL_MIP_SOURCE_H
+#define RENDER_INTERNAL_MIP_SOURCE_H
+
+#include <vector>
+#include <functional>
+#include <future>
+#include <stdint.h>
+
+class MipSource {
+public:
+    /// read writes level mip (mipSizes[mip] bytes) to dst, it is called
+    /// from other threads and can throw if the level can't be read.
+    MipSource(std::vector<size_t> mipSizes,
+	      std::function<void(uint32_t mip, unsigned char* dst)> read);
+    /// waits for any reads that haven't finished
+    ~MipSource();
+    MipSource(const MipSource&) = delete;
+    MipSource& operator=(const MipSource&) = delete;
+
+    /// start reading mip if it isn't already read or being read
+    void request(uint32_t mip);
+    /// The pixels of mip, or null if they are still being read.
+    /// Requests the level if it wasn't already. Rethrows if the read failed.
+    const unsigned char* get(uint32_t mip);
+    /// like get, but waits for the read to finish
+    const unsigned char* wait(uint32_t mip);
+    /// free the pixels of mip once they are uploaded
+    void release(uint32_t mip);
+
+private:
+    std::vector<size_t> mipSizes;
+    std::function<void(uint32_t, unsigned char*)> read;
+    std::vector<std::vector<unsigned char>> levels;
+    std::vector<bool> ready;
+    // after the levels, so reads in flight are waited for before their levels are freed
+    std::vector<std::future<void>> reads;
+};
+
+#endif /* RENDER_INTERNAL_MIP_SOURCE_H */
@@ -0,0 +1,34 @@
+/// Mip chains for RGBA8 textures, made on the cpu so every backend
+/// gets the same levels and can upload them all at once.
+
+#ifndef RENDER_INTERNAL_MIPMAPS_H
+#define RENDER_INTERNAL_MIPMAPS_H
+
+#include <string>
+#include <vector>
+#include <cstddef>
+
+namespace mipgen {
+
+  /// bytes of each level of an RGBA8 texture, from full size down to 1x1
+  std::vector<size_t> levelSizes(int width, int height);
+
+  /// Returns every level after the first, one after the other.
+  /// Each level is a 2x2 box filter of the last, with the colour averaged
+  /// in linear space if gammaCorrect (alpha is always averaged as it is).
+  /// Rows are split across the worker pool.
+  std::vector<unsigned char> generate(const unsigned char* rgba, int width, int height,
+				      bool gammaCorrect);
+
+  /// the path the mip chain of a texture is saved to, ie tex.png -> tex.png.mips.ktx2
+  std::string cachePath(std::string texturePath);
+
+  /// Save the full chain as an RGBA8 KTX2 file, so it can be loaded like any other texture.
+  /// It is written to a temporary file then renamed, so other threads or programs
+  /// never read half of one. returns false if the file could not be written.
+  bool writeCache(std::string path, int width, int height, bool srgb,
+		  const unsigned char* firstLevel, const unsigned char* otherLevels);
+
+}
+
+#endif /* RENDER_INTERNAL_MIPMAPS_H */
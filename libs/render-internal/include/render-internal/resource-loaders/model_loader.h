@@ -2,12 +2,23 @@
 #define GL_MODEL_LOADER_H
 
 #include <graphics/resource_loaders/model_loader.h>
+#include <graphics/render_config.h>
+#include "meshlets.h"
 #include <map>
 #include "pool_manager.h"
 
 class AssimpLoader;
 struct ModelData;
 struct MeshData;
+namespace assetpack {
+  struct Contents;
+}
+
+/// full detail mesh plus the generated lower detail versions.
+const unsigned int MAX_MODEL_LODS = 4;
+
+/// meshes with at most this many vertices can use 16 bit indices
+const size_t MAX_SHORT_INDEX_VERTICES = 65536;
 
 int modelGetTexID(Resource::Model model,
 		  Resource::Texture texture,
@@ -16,17 +27,37 @@ int modelGetTexID(Resource::Model model,
 class InternalModelLoader : public ModelLoader {
 public:
 
-    InternalModelLoader(Resource::Pool pool, BasePoolManager* pools);
+    InternalModelLoader(Resource::Pool pool, BasePoolManager* pools, RenderConfig conf);
     
     virtual ~InternalModelLoader();
     
     ModelInfo::Model loadModelData(std::string path) override;
 
+    std::vector<ModelInfo::Model> loadModelDataBatch(std::vector<std::string> paths) override;
+
     virtual void loadGPU() = 0;
 
+    /// load the staged models after the ones already on the gpu
+    virtual void appendGPU() = 0;
+
     virtual void clearGPU() = 0;
 
     void clearStaged();
+
+    /// the files the models on the gpu were loaded from, empty for ones that weren't
+    std::vector<std::string> getLoadedPaths();
+    /// models on the gpu that were loaded from the file at path
+    std::vector<Resource::Model> getModelsFrom(std::string path);
+
+    /// bytes of vertices, indices and meshlets the staged models hold
+    uint64_t stagedMemory();
+
+    /// Add the staged models to pack, their meshes' textures are found in texLoader's staged textures.
+    void writePack(assetpack::Contents* pack, InternalTexLoader* texLoader);
+    /// Stage the models of a pack, textures are the pack's textures as texLoader staged them.
+    /// The vertices of every model are copied into one allocation. Returned in the pack's order.
+    std::vector<Resource::Model> loadPack(const assetpack::Contents &pack,
+					  const std::vector<Resource::Texture> &textures);
     
 protected:    
     Resource::Model loadData(PipelineInput format,
@@ -34,36 +65,115 @@ protected:
 			     std::vector<void*> &meshVertData,
 			     std::string textureFolder,
 			     std::vector<Resource::ModelAnimation> *pAnimations) override;
+
+    void prepareModelData(ModelInfo::Model &model) override;
+
+    void parallelFor(size_t count, std::function<void(size_t)> job) override;
+
+    void loadedFromFile(Resource::Model model, std::string path,
+			std::function<void(ModelInfo::Model&)> stage) override;
+
+    /// by default the vertices are converted into malloced memory,
+    /// freed along with the staged models.
+    void* allocateVertexData(size_t size) override;
+    virtual void freeVertexData();
     
     void loadQuad();
 
+    /// Backends call this before loading the staged models after the gpuModelCount
+    /// they already have, adds the quad if there are none.
+    void startGpuLoad(size_t gpuModelCount);
+    /// index of model in the backend's gpu models, out of range if it was unloaded
+    size_t gpuIndex(Resource::Model model) { return model.ID - gpuBaseID; }
+
+    /// Stage the file of a model on the gpu again, on its own, for the backend to
+    /// load in place of the old one. Anything already staged is set aside until endReload.
+    /// The meshes have no textures, the backend keeps the old model's.
+    /// Returns false if the model wasn't loaded from a file. Throws if the file can't be read.
+    bool beginReload(Resource::Model model);
+    /// free the reloaded model's staging data and put back what was set aside
+    void endReload();
+
     Resource::Pool pool;    
     BasePoolManager *pools;
     Resource::Model quad;
     std::vector<ModelData*> staged;
+    float lodScreenSize;
+    /// IDs keep counting up across loads, so appending leaves the loaded ones valid.
+    /// ID of the first model on the gpu, and of staged[0].
+    size_t gpuBaseID = 0;
+    size_t stagedBaseID = 0;
+
+    /// where each model on the gpu came from, indexed like the backend's models.
+    /// the path is empty if it wasn't loaded from a file.
+    struct ModelSource {
+	std::string path;
+	PipelineInput format;
+	std::function<void(ModelInfo::Model&)> stage;
+    };
+    std::vector<ModelSource> loadedSources;
+
+    /// the loaded models from before startGpuLoad, so a backend can put them back
+    struct GpuLoadState {
+	std::vector<ModelSource> loadedSources;
+	size_t gpuBaseID;
+	Resource::Model quad;
+    };
+    GpuLoadState gpuLoadState();
+    /// For a backend whose load failed. The loaded models go back to state and the
+    /// staged ones, along with any quad startGpuLoad added, are cleared.
+    /// IDs aren't reused, so the failed models' handles stay out of range.
+    void failedGpuLoad(const GpuLoadState &state);
 
 private:
+
+    ModelInfo::Model loadModelFile(AssimpLoader* loader, std::string path);
+
+    /// generates lods for the meshes that don't have any yet
+    void addLods(ModelInfo::Model &model);
     
     AssimpLoader* loader;
+    bool cookModels;
+    bool optimiseMeshes;
+    bool generateLods;
+    bool meshletCulling;
+    std::vector<void*> vertexAllocations;
+    std::vector<ModelData*> setAside;
 };
 
 
 /// ------- Model and Mesh Staging Data -------
 
+/// part of a mesh's index data
+struct IndexRange {
+    uint32_t offset = 0;
+    uint32_t count = 0;
+};
+
 struct MeshData {
+    /// left for the caller to fill in, ie from an asset pack
+    MeshData() {}
     MeshData(ModelInfo::Mesh &mesh, void* vertexData,
 	     std::string texturePath,
 	     TextureLoader* tex);
-    ~MeshData();
+    /// write the indices to dst as indexSize (2 or 4) byte integers
+    void copyIndices(void* dst, uint32_t indexSize);
+    /// owned by the model loader, see allocateVertexData
     void* vertices;
     size_t vertexCount;
+    /// all levels of detail, one after the other
     std::vector<uint32_t> indices;
+    /// where each level of detail is in indices, lods[0] is the full detail mesh
+    std::vector<IndexRange> lods;
+    /// clusters of the full detail indices, empty if not culling this mesh
+    std::vector<meshopt::Meshlet> meshlets;
     //temp until pipeline changes
     Resource::Texture texture;
     glm::vec4 diffuseColour;
 };
 
 struct ModelData {
+    ModelData() {}
     ModelData(ModelInfo::Model &model, PipelineInput format,
 	      std::vector<void*> meshVertData,
 	      //temp
@@ -73,6 +183,15 @@ struct ModelData {
     PipelineInput format;
     std::vector<MeshData*> meshes;
     std::vector<Resource::ModelAnimation> animations;
+    /// 2 if every mesh is small enough for 16 bit indices, otherwise 4
+    uint32_t indexSize;
+    // bounding sphere of the bind pose, in model space
+    glm::vec3 boundsCentre;
+    float boundsRadius;
+    unsigned int lodCount;
+    /// the file it was loaded from, and how to stage it again. empty if not from a file.
+    std::string path;
+    std::function<void(ModelInfo::Model&)> stage;
 };
 
 
@@ -84,6 +203,8 @@ struct GPUMesh {
 
     Resource::Texture texture;
     glm::vec4 diffuseColour;
+    std::vector<IndexRange> lods;
+    std::vector<meshopt::Meshlet> meshlets;
 };
 
 struct GPUModel {
@@ -93,10 +214,16 @@ struct GPUModel {
     
     Resource::ModelAnimation getAnimation(std::string animation);
 
+    /// Picks the level of detail to draw at from the fraction of the full
+    /// screen height the diameter of the model's bounding sphere covers.
+    unsigned int selectLod(glm::mat4 modelView, glm::mat4 proj, float lodScreenSize);
 
     std::vector<Resource::ModelAnimation> animations;
     std::map<std::string, int> animationMap;
     PipelineInput vertType;
+    glm::vec3 boundsCentre;
+    float boundsRadius;
+    unsigned int lodCount;
 };
 
 #endif
@@ -4,6 +4,7 @@
 #include <vector>
 #include <graphics/resources.h>
 #include <stdexcept>
+#include <mutex>
 
 #include "texture_loader.h"
 
@@ -18,6 +19,14 @@ public:
     }
     
     virtual InternalTexLoader* tex(int id) = 0;
+
+    /// shared by the texture loaders of every pool
+    TextureCache texCache;
+
+ protected:
+    /// pools can be staged on other threads, which look up their texture loader
+    /// with tex, so adding and removing pools can't move the list under them.
+    std::mutex poolsMutex;
 };
 
 template<class Pool>
@@ -44,6 +53,7 @@ class InternalPoolManager : public BasePoolManager {
 #define MAKE_POOL_MANAGER(name, resource_pool_type) \
     class name : public InternalPoolManager<resource_pool_type> {	\
 	InternalTexLoader* tex(int id) override {			\
+	    std::lock_guard<std::mutex> lock(poolsMutex);		\
 	    if(!ValidPool(id)) {					\
 		LOG_ERROR("PoolManager: tex given invalid pool id: "	\
 			  << id);					\
@@ -97,6 +107,7 @@ int InternalPoolManager<Pool>::PoolCount() {
 
 template <class Pool>
 int InternalPoolManager<Pool>::NextPoolIndex() {
+    std::lock_guard<std::mutex> lock(this->poolsMutex);
     int index = pools.size();
     if(freePools.empty())
 	pools.push_back(nullptr);
@@ -110,6 +121,7 @@ int InternalPoolManager<Pool>::NextPoolIndex() {
 
 template <class Pool>
 Pool* InternalPoolManager<Pool>::AddPool(Pool* pool, int index) {
+    std::lock_guard<std::mutex> lock(this->poolsMutex);
     if(ValidPool(index)) {
 	throw std::runtime_error("PoolManager: Tried to add pool to index "
 				 "that already contains a valid pool!");
@@ -124,6 +136,7 @@ void InternalPoolManager<Pool>::DeletePool(Resource::Pool pool) {
     if(!ValidPool(pool))
 	return;
     delete pools[pool.ID];
+    std::lock_guard<std::mutex> lock(this->poolsMutex);
     if(pools.size() == pool.ID + 1) {
 	pools.pop_back();
 	while(pools.size() > 0 && pools[pools.size() -1] == nullptr) {
@@ -0,0 +1,101 @@
+/// Texture files shared by the texture loaders of every resource pool,
+/// so a file used by many pools is only decoded (and, if the backend can, uploaded) once.
+
+#ifndef RENDER_INTERNAL_TEXTURE_CACHE_H
+#define RENDER_INTERNAL_TEXTURE_CACHE_H
+
+#include "compressed_texture.h"
+
+#include <string>
+#include <vector>
+#include <unordered_map>
+#include <memory>
+#include <mutex>
+#include <stdint.h>
+
+class MappedFile;
+
+class TextureCache {
+public:
+    struct Entry {
+	int width = 0, height = 0, nrChannels = 0;
+	TextureFormat format = TextureFormat::RGBA8;
+	/// bytes of each mip level in the decoded data, from largest to smallest.
+	/// only compressed files come with more than one.
+	std::vector<size_t> mipSizes;
+	/// the colour space a compressed file says it is in, if hasColourSpace
+	bool srgb = false;
+	bool hasColourSpace = false;
+	/// a KTX2 or DDS file, rather than an image decoded by stb
+	bool compressedFile = false;
+	/// a texture made by the backend that pools can share, eg an opengl texture name.
+	/// zero if there isn't one.
+	unsigned int gpuTexture = 0;
+    private:
+	friend class TextureCache;
+	std::string path;
+	std::string key;
+	unsigned char* data = nullptr;
+	/// mapped to read the header, kept for decoding until the pixels are kept
+	/// or the entry is released, so the file is only opened once
+	std::shared_ptr<MappedFile> file;
+	int refs = 0;
+	int gpuRefs = 0;
+    };
+
+    ~TextureCache();
+
+    /// Returns the entry with the same path, file size and modified time, or makes one.
+    /// The time is to the nanosecond where the filesystem has it, so a file written
+    /// again in the same second gets a new entry.
+    /// Only a new entry's file is opened, to read its header, the pixels are decoded later.
+    /// KTX2 and DDS files are kept in their compressed format.
+    /// Throws if the file can't be read or isn't an image.
+    /// The entry stays valid until the caller calls release.
+    Entry* acquire(std::string path, int desiredChannels);
+
+    void release(Entry* entry);
+
+    /// Decodes the pixels once and keeps them for everyone holding the entry.
+    /// Can be called from many threads at once.
+    unsigned char* decode(Entry* entry);
+
+    /// Writes the pixels of the mip levels from firstMip on to dst without keeping them,
+    /// so there is no lasting second copy when dst is staging memory.
+    /// Levels of compressed files are read straight from the file, so the ones
+    /// before firstMip aren't read at all. Can be called from many threads at once.
+    void decodeTo(Entry* entry, void* dst, size_t firstMip = 0);
+
+    /// Like decodeTo, but only the one level
+    void readLevel(Entry* entry, size_t mip, void* dst);
+
+    /// take another reference to an entry the caller holds, release it as well
+    Entry* share(Entry* entry);
+
+    /// Take a reference to the entry's gpu texture, returns false if it doesn't have one yet.
+    bool acquireGpu(Entry* entry);
+
+    /// Give the entry a gpu texture for other pools to share, the caller holds a reference to it.
+    void setGpu(Entry* entry, unsigned int gpuTexture);
+
+    /// Returns true if that was the last reference, so the caller should destroy the texture.
+    bool releaseGpu(Entry* entry);
+
+private:
+    unsigned char* decodeFile(Entry* entry);
+
+    /// write levels [first, last) of the entry to dst
+    void copyLevels(Entry* entry, size_t first, size_t last, unsigned char* dst);
+
+    /// the entry's mapping if it still has it, throws if the header changed
+    std::shared_ptr<MappedFile> mapCompressed(Entry* entry, compressedtex::Info* info);
+
+    void freeData(Entry* entry, unsigned char* data);
+
+    void freeIfUnused(Entry* entry);
+
+    std::unordered_map<std::string, Entry*> entries;
+    std::mutex mut;
+};
+
+#endif /* RENDER_INTERNAL_TEXTURE_CACHE_H */
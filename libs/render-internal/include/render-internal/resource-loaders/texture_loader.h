@@ -3,15 +3,41 @@
 
 #include <graphics/resource_loaders/texture_loader.h>
 #include <graphics/render_config.h>
+#include "texture_cache.h"
+#include "mip_source.h"
+#include "atlas_packer.h"
 #include <vector>
+#include <unordered_map>
+#include <memory>
 
 #include <graphics/logger.h>
 
+namespace assetpack {
+  struct Contents;
+  class Pack;
+}
+
 struct StagedTex {
-    unsigned char* data;
+    /// null for pathed textures until they are decoded, in loadGPU or by decodeStaged
+    unsigned char* data = nullptr;
+    /// data belongs to something else (ie a mapped asset pack), so isn't deleted with the texture
+    bool borrowedData = false;
+    /// the pack data points into, if it came from one
+    std::shared_ptr<assetpack::Pack> pack;
     int width, height, nrChannels, filesize;
+    TextureFormat format = TextureFormat::RGBA8;
+    /// the colours are in srgb, from the file if it says, otherwise from the render config
+    bool srgb = false;
+    /// bytes of each mip level in data, from largest to smallest.
+    /// one level unless mip mapping or the file came with its mips.
+    std::vector<size_t> mipSizes;
+    /// the file only has the first level, the rest are made in stageTexture
+    bool generateMips = false;
     std::string path;
     bool pathedTex;
+    /// pathed textures get their size and pixels from the texture cache
+    TextureCache::Entry* cacheEntry = nullptr;
+    TextureCache* cache = nullptr;
     // for renderers to subclass their own staged texture
     // to know if this is of internal type or not
     bool internalTex = false;
@@ -20,38 +46,134 @@ struct StagedTex {
 
 class InternalTexLoader : public TextureLoader {
 public:
-    InternalTexLoader(Resource::Pool pool, RenderConfig conf);
+    InternalTexLoader(Resource::Pool pool, RenderConfig conf, TextureCache* cache);
     virtual ~InternalTexLoader();
     Resource::Texture load(std::string path) override;
     Resource::Texture load(unsigned char* data,
 				  int width,
 				  int height,
 				  int nrChannels) override;
+    Resource::Texture loadToAtlas(std::string path) override;
 
     Resource::Texture addStagedTexture(StagedTex* tex);
 
-    virtual void loadGPU() {
-	loadedTextures = stagedTextures;
-	stagedTextures.clear();
-    }
+    /// Write the pixels of the mip levels of tex from firstMip on to dst,
+    /// making the levels the file didn't have. Can be called from many threads at once.
+    /// If firstMip isn't 0, returns where to read the levels before it from when they're streamed.
+    /// Files with every level are only read from firstMip, the rest are read later.
+    /// Images that need their mips made are decoded in full, the bigger levels are then
+    /// read back from the mip cache if it is on, otherwise they are kept in memory.
+    std::shared_ptr<MipSource> stageTexture(StagedTex* tex, unsigned char* dst,
+					    unsigned int firstMip = 0);
+
+    /// The first mip level of tex to load with the pool, 0 unless streaming textures.
+    /// The bigger levels before it are uploaded over the next frames.
+    unsigned int firstResidentMip(StagedTex* tex);
+
+    /// bytes of the levels of tex from firstMip on
+    size_t residentSize(StagedTex* tex, unsigned int firstMip);
+
+    /// Decode the staged images and make their mips now, across the worker threads,
+    /// so loading them to the gpu only copies them. Compressed files are left to be
+    /// read when loading, as they are already what the gpu takes.
+    /// Can be called off the render thread while nothing else uses the loader.
+    void decodeStaged();
+
+    /// backends call this before staging, it draws the atlas pages
+    virtual void loadGPU();
+    /// Like loadGPU, but the staged textures are added after the ones already loaded.
+    virtual void appendGPU();
     void clearStaged();
+
+    /// the loaded textures from before loadGPU or appendGPU, so a backend can put them back
+    struct GpuLoadState {
+	std::vector<Resource::Texture> loadedTextures;
+	std::vector<std::string> loadedPaths;
+	size_t gpuBaseID;
+    };
+    GpuLoadState gpuLoadState();
+    /// For a backend whose load failed. The loaded textures go back to state and the
+    /// staged ones are cleared, as their pixels may have been freed while uploading.
+    /// IDs aren't reused, so the failed textures' handles stay out of range.
+    void failedGpuLoad(const GpuLoadState &state);
+
     virtual void clearGPU() {
 	loadedTextures.clear();
+	loadedPaths.clear();
     }
 
     virtual unsigned int getViewIndex(Resource::Texture tex) { return tex.ID; }
 
     std::vector<Resource::Texture> getTextures() override { return loadedTextures; }
 
+    /// the files the loaded textures came from, empty for ones that weren't from a file
+    std::vector<std::string> getLoadedPaths() { return loadedPaths; }
+    /// loaded textures that came from the file at path
+    std::vector<Resource::Texture> getTexturesFrom(std::string path);
+
+    /// bytes of pixels the staged textures own. pathed textures are only counted
+    /// once decoded, and pixels mapped from an asset pack aren't counted.
+    uint64_t stagedMemory();
+
+    /// --- asset packs, see asset_pack.h ---
+
+    /// Add the staged textures to pack with every mip level, along with the paths
+    /// they were loaded from. Draws the atlas pages, so clear the staged textures
+    /// after rather than loading them.
+    void writePack(assetpack::Contents* pack);
+    /// position of a staged texture in the staged textures, -1 if it isn't staged by this loader
+    int stagedIndex(Resource::Texture tex);
+    /// Stage the textures of a pack, returned in the pack's order.
+    /// Their pixels are copied from the mapped pack, which is kept until the staged textures are cleared.
+    std::vector<Resource::Texture> loadPack(std::shared_ptr<assetpack::Pack> pack);
+
  protected:
-    bool srgb, mipmapping, filterNearest;
+    bool srgb, mipmapping, filterNearest, useCompressed, cacheMips, streamTextures;
     Resource::Pool pool;
     int desiredChannels = 4;
+    TextureCache* cache;
 
     std::vector<StagedTex*> staged;
+    /// index into staged of each pathed texture
+    std::unordered_map<std::string, unsigned int> stagedPaths;
+
+    struct AtlasPage {
+	unsigned int id;
+	AtlasPacker packer;
+    };
+    struct AtlasSprite {
+	StagedTex* tex;
+	unsigned int page;
+	int x, y;
+    };
+    std::vector<AtlasPage> atlasPages;
+    std::vector<AtlasSprite> atlasSprites;
+    std::unordered_map<std::string, Resource::Texture> atlasPaths;
     
     std::vector<Resource::Texture> stagedTextures;
+    /// packs that staged textures point into
+    std::vector<std::shared_ptr<assetpack::Pack>> stagedPacks;
     std::vector<Resource::Texture> loadedTextures;
+    /// file of each loaded texture, empty if it wasn't from one (ie atlas pages)
+    std::vector<std::string> loadedPaths;
+
+    /// Read the header of a texture file, the pixels are decoded by stageTexture.
+    /// Throws if the file can't be read. Delete with deleteData, then delete.
+    StagedTex* stageFile(std::string path);
+    /// Stage the file of a loaded texture again, for a backend to reload it with.
+    /// Returns null if it wasn't loaded from a file.
+    StagedTex* stageReload(Resource::Texture tex);
+
+    /// IDs keep counting up across loads, so appending leaves the loaded ones valid.
+    /// ID of the first texture on the gpu, and of staged[0].
+    size_t gpuBaseID = 0;
+    size_t stagedBaseID = 0;
+    /// index of tex in the backend's gpu textures, out of range if it was unloaded
+    size_t gpuIndex(Resource::Texture tex) { return tex.ID - gpuBaseID; }
+
+private:
+    void drawAtlasPages();
+    void addLoadedPaths();
 };
 
 
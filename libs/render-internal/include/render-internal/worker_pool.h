@@ -0,0 +1,53 @@
+/// A set of persistent threads for splitting resource loading work across cores.
+
+#ifndef RENDER_INTERNAL_WORKER_POOL_H
+#define RENDER_INTERNAL_WORKER_POOL_H
+
+#include <functional>
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+#include <vector>
+#include <deque>
+#include <cstdint>
+
+class WorkerPool {
+public:
+    /// threadCount does not include the calling thread, which also does work in run().
+    WorkerPool(unsigned int threadCount);
+    ~WorkerPool();
+
+    /// The pool shared by the loaders, made on first use
+    /// with one thread per core (minus the calling thread).
+    static WorkerPool* get();
+
+    /// calls job(i) for every i in [0, count) across the worker threads,
+    /// and returns once all of the calls have finished.
+    /// If any job throws, the first exception is rethrown here.
+    /// Calling run from inside a job runs the jobs on that thread.
+    /// Threads can call run at the same time, the workers take jobs from the
+    /// oldest batch first, but callers also work through their own batch,
+    /// so a short batch isn't stuck waiting behind a long one from another thread.
+    void run(size_t count, std::function<void(size_t)> job);
+
+    /// number of threads that do work in run(), including the caller
+    unsigned int threadCount() { return (unsigned int)threads.size() + 1; }
+
+private:
+    struct Batch;
+
+    void work();
+
+    void process(Batch* batch);
+
+    std::vector<std::thread> threads;
+
+    std::mutex mut;
+    std::condition_variable wake;
+    std::condition_variable finished;
+    // batches with jobs that haven't been taken yet, oldest first
+    std::deque<Batch*> batches;
+    bool quit = false;
+};
+
+#endif /* RENDER_INTERNAL_WORKER_POOL_H */
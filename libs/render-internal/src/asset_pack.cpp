@@ -0,0 +1,327 @@
+#include <render-internal/resource-loaders/asset_pack.h>
+
+#include "mapped_file.h"
+#include "binary_file.h"
+#include <graphics/logger.h>
+#include <fstream>
+#include <stdexcept>
+#include <cstring>
+#include <cstdint>
+#include <climits>
+
+namespace assetpack {
+
+  const char MAGIC[8] = { 'G', 'E', 'P', 'A', 'C', 'K', '\0', '\0' };
+  // see cooked_model.cpp
+  const uint32_t BYTE_ORDER_MARK = 0x01020304;
+  // texture and vertex data start on a multiple of this, so it can be
+  // copied from the mapped file as fast as from a normal allocation
+  const size_t DATA_ALIGNMENT = 16;
+
+  struct Header {
+      char magic[8];
+      uint32_t version;
+      uint32_t byteOrder;
+      // total size of the file, catches packs cut short while being written
+      uint64_t size;
+  };
+
+  using binfile::Writer;
+  using binfile::Reader;
+
+  /// --- Packing ---
+
+  Contents pack(InternalTexLoader* texLoader, InternalModelLoader* modelLoader,
+		InternalFontLoader* fontLoader) {
+      Contents contents;
+      texLoader->writePack(&contents);
+      modelLoader->writePack(&contents, texLoader);
+      if(fontLoader != nullptr)
+	  fontLoader->writePack(&contents, texLoader);
+      return contents;
+  }
+
+  /// --- Writing ---
+
+  void writeTexture(Writer &w, const Texture &tex) {
+      w.put<int32_t>(tex.width);
+      w.put<int32_t>(tex.height);
+      w.put<int32_t>(tex.nrChannels);
+      w.put<uint32_t>((uint32_t)tex.format);
+      w.put<uint8_t>(tex.srgb);
+      w.put<uint64_t>(tex.mipSizes.size());
+      for(size_t size: tex.mipSizes)
+	  w.put<uint64_t>(size);
+      w.align(DATA_ALIGNMENT);
+      w.bytes(tex.pixels.data(), tex.pixels.size());
+  }
+
+  void writeFormat(Writer &w, const PipelineInput &format) {
+      w.put(format.size);
+      w.put<uint64_t>(format.entries.size());
+      for(const PipelineInput::Entry &entry: format.entries) {
+	  w.put<uint32_t>((uint32_t)entry.input_type);
+	  w.put(entry.offset);
+      }
+  }
+
+  void writeMesh(Writer &w, const Mesh &mesh) {
+      w.put<uint64_t>(mesh.vertexCount);
+      w.align(DATA_ALIGNMENT);
+      w.bytes(mesh.vertexData.data(), mesh.vertexData.size());
+      w.array(mesh.indices);
+      w.array(mesh.lods);
+      w.array(mesh.meshlets);
+      w.put(mesh.diffuseColour);
+      w.put<int32_t>(mesh.texture);
+  }
+
+  void writeModel(Writer &w, const Model &model) {
+      w.string(model.path);
+      writeFormat(w, model.format);
+      w.put(model.boundsCentre);
+      w.put(model.boundsRadius);
+      w.put<uint32_t>(model.lodCount);
+      w.put<uint64_t>(model.meshes.size());
+      for(const Mesh &mesh: model.meshes)
+	  writeMesh(w, mesh);
+      w.put<uint64_t>(model.animations.size());
+      for(const Animation &anim: model.animations) {
+	  w.array(anim.bones);
+	  binfile::writeAnimation(w, anim.animation);
+      }
+  }
+
+  void writeFont(Writer &w, const Font &font) {
+      w.string(font.path);
+      w.put<uint32_t>(font.texture);
+      w.put<uint64_t>(font.glyphs.size());
+      for(const Glyph &glyph: font.glyphs) {
+	  w.put(glyph.c);
+	  w.put<uint8_t>(glyph.blank);
+	  w.put(glyph.texOffset);
+	  w.put(glyph.size);
+	  w.put(glyph.bearing);
+	  w.put(glyph.advance);
+      }
+  }
+
+  bool write(const Contents &contents, std::string path) {
+      Writer w(sizeof(Header));
+      w.put<uint64_t>(contents.textures.size());
+      for(const Texture &tex: contents.textures)
+	  writeTexture(w, tex);
+      w.put<uint64_t>(contents.textureNames.size());
+      for(const TextureName &name: contents.textureNames) {
+	  w.string(name.path);
+	  w.put<uint32_t>(name.texture);
+	  w.put(name.dim);
+	  w.put(name.atlasRect);
+      }
+      w.put<uint64_t>(contents.models.size());
+      for(const Model &model: contents.models)
+	  writeModel(w, model);
+      w.put<uint64_t>(contents.fonts.size());
+      for(const Font &font: contents.fonts)
+	  writeFont(w, font);
+
+      Header header;
+      std::memcpy(header.magic, MAGIC, sizeof(MAGIC));
+      header.version = FORMAT_VERSION;
+      header.byteOrder = BYTE_ORDER_MARK;
+      header.size = w.data.size();
+      std::memcpy(w.data.data(), &header, sizeof(Header));
+
+      std::ofstream out(path, std::ios::binary | std::ios::trunc);
+      if(!out.is_open())
+	  return false;
+      out.write(w.data.data(), w.data.size());
+      return out.good();
+  }
+
+  /// --- Reading ---
+
+  void readTexture(Reader &r, Texture *tex) {
+      tex->width = r.get<int32_t>();
+      tex->height = r.get<int32_t>();
+      tex->nrChannels = r.get<int32_t>();
+      uint32_t format = r.get<uint32_t>();
+      if(format > (uint32_t)TextureFormat::BC7)
+	  throw std::runtime_error("texture had an unknown format");
+      tex->format = (TextureFormat)format;
+      tex->srgb = r.get<uint8_t>() != 0;
+      tex->mipSizes.resize(r.count(sizeof(uint64_t)));
+      size_t total = 0;
+      for(size_t &size: tex->mipSizes) {
+	  size = (size_t)r.get<uint64_t>();
+	  // staged textures hold their size as an int
+	  if(size > (size_t)INT_MAX - total)
+	      throw std::runtime_error("texture was too big");
+	  total += size;
+      }
+      r.align(DATA_ALIGNMENT);
+      tex->data = (const unsigned char*)r.skip(total);
+  }
+
+  PipelineInput readFormat(Reader &r) {
+      PipelineInput format;
+      format.size = r.get<float>();
+      size_t count = r.count(sizeof(uint32_t) + sizeof(float));
+      for(size_t i = 0; i < count; i++) {
+	  uint32_t type = r.get<uint32_t>();
+	  if(type > (uint32_t)PipelineInput::type::uint8x4)
+	      throw std::runtime_error("vertex format had an unknown type");
+	  format.entries.push_back(PipelineInput::Entry((PipelineInput::type)type,
+							r.get<float>()));
+      }
+      return format;
+  }
+
+  void readMesh(Reader &r, const PipelineInput &format, size_t textureCount, Mesh *mesh) {
+      size_t vertexSize = (size_t)format.size;
+      mesh->vertexCount = r.count(vertexSize);
+      r.align(DATA_ALIGNMENT);
+      mesh->vertices = r.skip(vertexSize * mesh->vertexCount);
+      r.array(&mesh->indices);
+      r.array(&mesh->lods);
+      for(IndexRange &lod: mesh->lods)
+	  if(lod.offset > mesh->indices.size() ||
+	     lod.count > mesh->indices.size() - lod.offset)
+	      throw std::runtime_error("mesh lod was outside of its indices");
+      r.array(&mesh->meshlets);
+      mesh->diffuseColour = r.get<glm::vec4>();
+      mesh->texture = r.get<int32_t>();
+      if(mesh->texture < -1 || mesh->texture >= (int64_t)textureCount)
+	  throw std::runtime_error("mesh texture was not in the pack");
+  }
+
+  void readModel(Reader &r, size_t textureCount, Model *model) {
+      model->path = r.string();
+      model->format = readFormat(r);
+      model->boundsCentre = r.get<glm::vec3>();
+      model->boundsRadius = r.get<float>();
+      model->lodCount = r.get<uint32_t>();
+      model->meshes.resize(r.count(sizeof(uint64_t)));
+      for(Mesh &mesh: model->meshes)
+	  readMesh(r, model->format, textureCount, &mesh);
+      model->animations.resize(r.count(sizeof(uint64_t)));
+      for(Animation &anim: model->animations) {
+	  r.array(&anim.bones);
+	  binfile::readAnimation(r, &anim.animation);
+	  // the bind pose starts from the first node
+	  if(anim.animation.nodes.empty())
+	      throw std::runtime_error("animation had no nodes");
+	  for(ModelInfo::AnimNodes &node: anim.animation.nodes) {
+	      if(node.modelNode.boneID >= (int64_t)anim.bones.size())
+		  throw std::runtime_error("animation node had a bone that wasn't in the pack");
+	      for(int child: node.modelNode.children)
+		  if(child < 0 || child >= (int64_t)anim.animation.nodes.size())
+		      throw std::runtime_error("animation node had a child that wasn't in the pack");
+	  }
+      }
+  }
+
+  void readFont(Reader &r, size_t textureCount, Font *font) {
+      font->path = r.string();
+      font->texture = r.get<uint32_t>();
+      if(font->texture >= textureCount)
+	  throw std::runtime_error("font texture was not in the pack");
+      font->glyphs.resize(r.count(sizeof(char) + sizeof(uint8_t)));
+      for(Glyph &glyph: font->glyphs) {
+	  glyph.c = r.get<char>();
+	  glyph.blank = r.get<uint8_t>() != 0;
+	  glyph.texOffset = r.get<glm::vec4>();
+	  glyph.size = r.get<glm::vec2>();
+	  glyph.bearing = r.get<glm::vec2>();
+	  glyph.advance = r.get<float>();
+      }
+  }
+
+  void readContents(Reader &r, Contents *contents) {
+      contents->textures.resize(r.count(sizeof(uint64_t)));
+      for(Texture &tex: contents->textures)
+	  readTexture(r, &tex);
+      size_t textureCount = contents->textures.size();
+      contents->textureNames.resize(r.count(sizeof(uint64_t)));
+      for(TextureName &name: contents->textureNames) {
+	  name.path = r.string();
+	  name.texture = r.get<uint32_t>();
+	  if(name.texture >= textureCount)
+	      throw std::runtime_error("named texture was not in the pack");
+	  name.dim = r.get<glm::vec2>();
+	  name.atlasRect = r.get<glm::vec4>();
+      }
+      contents->models.resize(r.count(sizeof(uint64_t)));
+      for(Model &model: contents->models)
+	  readModel(r, textureCount, &model);
+      contents->fonts.resize(r.count(sizeof(uint64_t)));
+      for(Font &font: contents->fonts)
+	  readFont(r, textureCount, &font);
+  }
+
+  Pack::Pack(std::string path) {
+      this->path = path;
+      file = new MappedFile(path);
+      try {
+	  if(!file->valid())
+	      throw std::runtime_error("could not be opened");
+	  Header header;
+	  if(file->size() < sizeof(Header))
+	      throw std::runtime_error("file was truncated");
+	  std::memcpy(&header, file->data(), sizeof(Header));
+	  if(std::memcmp(header.magic, MAGIC, sizeof(MAGIC)) != 0 ||
+	     header.byteOrder != BYTE_ORDER_MARK)
+	      throw std::runtime_error("not an asset pack made on this platform");
+	  if(header.version != FORMAT_VERSION)
+	      throw std::runtime_error("made with a different format version, pack it again");
+	  if(header.size != file->size())
+	      throw std::runtime_error("file was truncated");
+	  // offsets are aligned from the start of the file, so read it all with one reader
+	  Reader r(file->data(), file->size());
+	  r.skip(sizeof(Header));
+	  readContents(r, &contents);
+      } catch(std::runtime_error &e) {
+	  delete file;
+	  throw std::runtime_error("failed to read asset pack at " + path + " - " + e.what());
+      }
+  }
+
+  Pack::~Pack() {
+      delete file;
+  }
+
+  /// --- Loading ---
+
+  Resource::PackedResources load(std::string path, InternalTexLoader* texLoader,
+				 InternalModelLoader* modelLoader,
+				 InternalFontLoader* fontLoader) {
+      std::shared_ptr<Pack> pack = std::make_shared<Pack>(path);
+      const Contents &contents = pack->contents;
+      if(fontLoader == nullptr && contents.fonts.size() > 0)
+	  throw std::runtime_error("asset pack at " + path + " has fonts, but no font loader to load them");
+      Resource::PackedResources loaded;
+      std::vector<Resource::Texture> textures = texLoader->loadPack(pack);
+      for(const TextureName &name: contents.textureNames) {
+	  Resource::Texture tex = textures[name.texture];
+	  tex.dim = name.dim;
+	  tex.atlasRect = name.atlasRect;
+	  loaded.textures[name.path] = tex;
+      }
+      std::vector<Resource::Model> models = modelLoader->loadPack(contents, textures);
+      for(size_t i = 0; i < models.size(); i++)
+	  if(!contents.models[i].path.empty())
+	      loaded.models[contents.models[i].path] = models[i];
+      if(fontLoader != nullptr) {
+	  std::vector<Resource::Font> fonts = fontLoader->loadPack(contents, textures);
+	  for(size_t i = 0; i < fonts.size(); i++)
+	      loaded.fonts[contents.fonts[i].path] = fonts[i];
+      }
+      LOG("Asset Pack Loaded"
+	  " - textures: " << textures.size() <<
+	  " - models: "   << models.size() <<
+	  " - fonts: "    << contents.fonts.size() <<
+	  " - path: "     << path);
+      return loaded;
+  }
+
+}
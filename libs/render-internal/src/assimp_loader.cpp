@@ -89,6 +89,7 @@ void AssimpLoader::processMesh(ModelInfo::Model* model, aiMesh* aimesh,
     mesh->diffuseTextures = getTextures(material, aiTextureType_DIFFUSE);
     
     //vertcies
+    mesh->verticies.reserve(aimesh->mNumVertices);
     for(unsigned int i = 0; i < aimesh->mNumVertices;i++) {
 	ModelInfo::Vertex vertex;
 	vertex.Position = toGlm(aimesh->mVertices[i]);       
@@ -119,11 +120,15 @@ void AssimpLoader::processMesh(ModelInfo::Model* model, aiMesh* aimesh,
 	
 	for(unsigned int weightI = 0; weightI < aibone->mNumWeights; weightI++) {
 	    auto vertexWeight = aibone->mWeights[weightI];
-	    mesh->verticies[vertexWeight.mVertexId].BoneIDs.push_back(boneID == -1 ? 0 : boneID);
-	    mesh->verticies[vertexWeight.mVertexId].BoneWeights.push_back(vertexWeight.mWeight);
+	    mesh->verticies[vertexWeight.mVertexId].addBoneInfluence(
+		    boneID == -1 ? 0 : boneID, vertexWeight.mWeight);
 	}
     }
+    if(aimesh->mNumBones > 0)
+	for(auto &v: mesh->verticies)
+	    v.normaliseBoneWeights();
     //indicies
+    mesh->indices.reserve(aimesh->mNumFaces * 3);
     for(unsigned int i = 0; i < aimesh->mNumFaces; i++) {
 	aiFace face = aimesh->mFaces[i];
 	for(unsigned int j = 0; j < face.mNumIndices; j++)
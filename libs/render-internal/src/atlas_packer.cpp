@@ -0,0 +1,72 @@
+#include <render-internal/resource-loaders/atlas_packer.h>
+
+#include <algorithm>
+
+AtlasPacker::AtlasPacker(int width, int height) {
+    pageWidth = width;
+    pageHeight = height;
+    skyline.push_back({0, 0, width});
+}
+
+int AtlasPacker::fitAt(size_t i, int width, int height) {
+    if(skyline[i].x + width > pageWidth)
+	return -1;
+    int y = 0;
+    int remaining = width;
+    for(; i < skyline.size() && remaining > 0; i++) {
+	y = std::max(y, skyline[i].y);
+	if(y + height > pageHeight)
+	    return -1;
+	remaining -= skyline[i].width;
+    }
+    return y;
+}
+
+bool AtlasPacker::add(int width, int height, int* x, int* y) {
+    int bestY = -1, bestWidth = 0;
+    size_t best = 0;
+    for(size_t i = 0; i < skyline.size(); i++) {
+	int fitY = fitAt(i, width, height);
+	if(fitY < 0)
+	    continue;
+	// lowest first, then the narrowest spot to waste less space
+	if(bestY < 0 || fitY < bestY ||
+	   (fitY == bestY && skyline[i].width < bestWidth)) {
+	    bestY = fitY;
+	    bestWidth = skyline[i].width;
+	    best = i;
+	}
+    }
+    if(bestY < 0)
+	return false;
+    *x = skyline[best].x;
+    *y = bestY;
+
+    // raise the skyline under the new rect
+    Segment placed = { *x, bestY + height, width };
+    skyline.insert(skyline.begin() + best, placed);
+    size_t i = best + 1;
+    while(i < skyline.size()) {
+	Segment &s = skyline[i];
+	int placedEnd = placed.x + placed.width;
+	if(s.x >= placedEnd)
+	    break;
+	int shrink = placedEnd - s.x;
+	if(shrink < s.width) {
+	    s.x += shrink;
+	    s.width -= shrink;
+	    break;
+	}
+	skyline.erase(skyline.begin() + i);
+    }
+    // join neighbours at the same height
+    for(size_t j = 0; j + 1 < skyline.size();) {
+	if(skyline[j].y == skyline[j + 1].y) {
+	    skyline[j].width += skyline[j + 1].width;
+	    skyline.erase(skyline.begin() + j + 1);
+	} else {
+	    j++;
+	}
+    }
+    return true;
+}
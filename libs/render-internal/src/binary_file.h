@@ -0,0 +1,198 @@
+/// Writing and reading the binary formats render-internal saves (ie cooked models, asset packs).
+/// Values are stored as they are in memory, so files are only valid
+/// on machines with the same byte order, which the formats check in their headers.
+
+#ifndef RENDER_INTERNAL_BINARY_FILE_H
+#define RENDER_INTERNAL_BINARY_FILE_H
+
+#include <graphics/resource_loaders/model_info.h>
+#include <vector>
+#include <string>
+#include <fstream>
+#include <functional>
+#include <thread>
+#include <stdexcept>
+#include <cstdio>
+#include <cstring>
+#include <cstdint>
+
+namespace binfile {
+
+  class Writer {
+  public:
+      /// the first headerSize bytes are left for the format's header
+      Writer(size_t headerSize) { data.resize(headerSize); }
+
+      void bytes(const void* src, size_t size) {
+	  size_t start = data.size();
+	  data.resize(start + size);
+	  if(size > 0)
+	      std::memcpy(data.data() + start, src, size);
+      }
+
+      template <typename T>
+      void put(const T &value) { bytes(&value, sizeof(T)); }
+
+      template <typename T>
+      void array(const std::vector<T> &values) {
+	  put<uint64_t>(values.size());
+	  bytes(values.data(), sizeof(T) * values.size());
+      }
+
+      void string(const std::string &str) {
+	  put<uint64_t>(str.size());
+	  bytes(str.data(), str.size());
+      }
+
+      /// pad with zeros to a multiple of alignment from the start of the file
+      void align(size_t alignment) {
+	  data.resize((data.size() + alignment - 1) / alignment * alignment, 0);
+      }
+
+      std::vector<char> data;
+  };
+
+  /// throws a runtime_error if it would read past the end
+  class Reader {
+  public:
+      Reader(const char* data, size_t size) {
+	  this->start = data;
+	  this->pos = data;
+	  this->end = data + size;
+      }
+
+      void bytes(void* dst, size_t size) {
+	  const char* src = skip(size);
+	  if(size > 0)
+	      std::memcpy(dst, src, size);
+      }
+
+      /// move past size bytes without copying them, returns where they start
+      const char* skip(size_t size) {
+	  if(size > (size_t)(end - pos))
+	      throw std::runtime_error("file was truncated");
+	  const char* src = pos;
+	  pos += size;
+	  return src;
+      }
+
+      template <typename T>
+      T get() {
+	  T value;
+	  bytes(&value, sizeof(T));
+	  return value;
+      }
+
+      // checks a count read from the file could fit in the remaining bytes,
+      // so a corrupt file can't make us allocate huge arrays.
+      size_t count(size_t elementSize) {
+	  uint64_t n = get<uint64_t>();
+	  if(elementSize > 0 && n > (uint64_t)(end - pos) / elementSize)
+	      throw std::runtime_error("file had an invalid array size");
+	  return (size_t)n;
+      }
+
+      template <typename T>
+      void array(std::vector<T> *values) {
+	  values->resize(count(sizeof(T)));
+	  bytes(values->data(), sizeof(T) * values->size());
+      }
+
+      std::string string() {
+	  std::string str(count(1), '\0');
+	  bytes(&str[0], str.size());
+	  return str;
+      }
+
+      /// skip the padding the Writer added with align
+      void align(size_t alignment) {
+	  size_t offset = pos - start;
+	  skip((offset + alignment - 1) / alignment * alignment - offset);
+      }
+
+  private:
+      const char* start;
+      const char* pos;
+      const char* end;
+  };
+
+  /// --- Model Info ---
+
+  inline void writeNode(Writer &w, const ModelInfo::Node &node) {
+      w.put(node.transform);
+      w.put<int32_t>(node.parentNode);
+      w.array(node.children);
+      w.put<int32_t>(node.boneID);
+      w.put(node.boneOffset);
+  }
+
+  inline void readNode(Reader &r, ModelInfo::Node *node) {
+      node->transform = r.get<glm::mat4>();
+      node->parentNode = r.get<int32_t>();
+      r.array(&node->children);
+      node->boneID = r.get<int32_t>();
+      node->boneOffset = r.get<glm::mat4>();
+  }
+
+  inline void writeAnimation(Writer &w, const ModelInfo::Animation &anim) {
+      w.string(anim.name);
+      w.put(anim.duration);
+      w.put(anim.ticks);
+      w.put<uint64_t>(anim.nodes.size());
+      for(const ModelInfo::AnimNodes &node: anim.nodes) {
+	  writeNode(w, node.modelNode);
+	  w.array(node.positions);
+	  w.array(node.rotationsQ);
+	  w.array(node.scalings);
+      }
+  }
+
+  inline void readAnimation(Reader &r, ModelInfo::Animation *anim) {
+      anim->name = r.string();
+      anim->duration = r.get<double>();
+      anim->ticks = r.get<double>();
+      anim->nodes.resize(r.count(sizeof(glm::mat4)));
+      for(ModelInfo::AnimNodes &node: anim->nodes) {
+	  readNode(r, &node.modelNode);
+	  r.array(&node.positions);
+	  r.array(&node.rotationsQ);
+	  r.array(&node.scalings);
+      }
+  }
+
+  /// write fills a temp file next to path, which is then renamed over path,
+  /// so other threads writing the same file, or with the old one mapped, never see it half written.
+  /// write returns false if it failed. Returns false if the file could not be written.
+  inline bool writeFileAtomically(std::string path, std::function<bool(std::ostream&)> write) {
+      std::string temp = path + ".tmp" +
+	  std::to_string(std::hash<std::thread::id>()(std::this_thread::get_id()));
+      std::ofstream out(temp, std::ios::binary | std::ios::trunc);
+      if(!out.is_open())
+	  return false;
+      bool written = write(out);
+      out.close();
+      if(!written || out.fail()) {
+	  std::remove(temp.c_str());
+	  return false;
+      }
+      if(std::rename(temp.c_str(), path.c_str()) != 0) {
+	  // windows won't rename over an existing file
+	  std::remove(path.c_str());
+	  if(std::rename(temp.c_str(), path.c_str()) != 0) {
+	      std::remove(temp.c_str());
+	      return false;
+	  }
+      }
+      return true;
+  }
+
+  inline bool writeFileAtomically(std::string path, const char* data, size_t size) {
+      return writeFileAtomically(path, [data, size](std::ostream &out) {
+	  out.write(data, size);
+	  return true;
+      });
+  }
+
+}
+
+#endif /* RENDER_INTERNAL_BINARY_FILE_H */
@@ -0,0 +1,393 @@
+#include <render-internal/resource-loaders/compressed_texture.h>
+
+#include <fstream>
+#include <cstring>
+#include <cstdint>
+
+namespace compressedtex {
+
+  const unsigned char KTX2_IDENTIFIER[12] = {
+      0xAB, 'K', 'T', 'X', ' ', '2', '0', 0xBB, '\r', '\n', 0x1A, '\n' };
+  const char DDS_MAGIC[4] = { 'D', 'D', 'S', ' ' };
+
+  // ktx2 uses vulkan's format enum
+  const uint32_t VK_R8G8B8A8_UNORM = 37;
+  const uint32_t VK_R8G8B8A8_SRGB = 43;
+  const uint32_t VK_BC1_RGB_UNORM = 131;
+  const uint32_t VK_BC1_RGB_SRGB = 132;
+  const uint32_t VK_BC1_RGBA_UNORM = 133;
+  const uint32_t VK_BC1_RGBA_SRGB = 134;
+  const uint32_t VK_BC3_UNORM = 137;
+  const uint32_t VK_BC3_SRGB = 138;
+  const uint32_t VK_BC4_UNORM = 139;
+  const uint32_t VK_BC5_UNORM = 141;
+  const uint32_t VK_BC7_UNORM = 145;
+  const uint32_t VK_BC7_SRGB = 146;
+
+  // dds files from older tools use a four character code instead of a dxgi format
+  const uint32_t DXGI_BC1_UNORM = 71;
+  const uint32_t DXGI_BC1_SRGB = 72;
+  const uint32_t DXGI_BC3_UNORM = 77;
+  const uint32_t DXGI_BC3_SRGB = 78;
+  const uint32_t DXGI_BC4_UNORM = 80;
+  const uint32_t DXGI_BC5_UNORM = 83;
+  const uint32_t DXGI_BC7_UNORM = 98;
+  const uint32_t DXGI_BC7_SRGB = 99;
+  const uint32_t DXGI_R8G8B8A8_UNORM = 28;
+  const uint32_t DXGI_R8G8B8A8_SRGB = 29;
+
+  const size_t DDS_HEADER_SIZE = 128;
+  const size_t DDS_DX10_HEADER_SIZE = 20;
+  const uint32_t DDSD_MIPMAPCOUNT = 0x20000;
+  const uint32_t DDPF_FOURCC = 0x4;
+
+  uint32_t fourCC(const char* code) {
+      return (uint32_t)(unsigned char)code[0] |
+	  ((uint32_t)(unsigned char)code[1] << 8) |
+	  ((uint32_t)(unsigned char)code[2] << 16) |
+	  ((uint32_t)(unsigned char)code[3] << 24);
+  }
+
+  template <typename T>
+  T get(const char* data, size_t offset) {
+      T v;
+      std::memcpy(&v, data + offset, sizeof(T));
+      return v;
+  }
+
+  std::string compressedPath(std::string texturePath) {
+      return texturePath + ".ktx2";
+  }
+
+  bool isCompressedFile(const char* data, size_t size) {
+      return (size >= sizeof(KTX2_IDENTIFIER) &&
+	      std::memcmp(data, KTX2_IDENTIFIER, sizeof(KTX2_IDENTIFIER)) == 0) ||
+	  (size >= sizeof(DDS_MAGIC) && std::memcmp(data, DDS_MAGIC, sizeof(DDS_MAGIC)) == 0);
+  }
+
+  size_t mipSize(TextureFormat format, int width, int height) {
+      if(format == TextureFormat::RGBA8)
+	  return (size_t)width * height * 4;
+      size_t blocks = (size_t)((width + 3) / 4) * ((height + 3) / 4);
+      switch(format) {
+      case TextureFormat::BC1:
+      case TextureFormat::BC4:
+	  return blocks * 8;
+      default:
+	  return blocks * 16;
+      }
+  }
+
+  // fills in the sizes each mip should be, then checks the file has them
+  bool checkMips(Info* info, size_t fileSize) {
+      int w = info->width, h = info->height;
+      for(size_t i = 0; i < info->mipOffsets.size(); i++) {
+	  size_t expected = mipSize(info->format, w, h);
+	  if(info->mipSizes[i] < expected ||
+	     info->mipOffsets[i] > fileSize ||
+	     expected > fileSize - info->mipOffsets[i])
+	      return false;
+	  info->mipSizes[i] = expected;
+	  w = w > 1 ? w / 2 : 1;
+	  h = h > 1 ? h / 2 : 1;
+      }
+      return true;
+  }
+
+  bool vkFormatToTexture(uint32_t vkFormat, Info* info) {
+      info->srgb = false;
+      info->hasColourSpace = true;
+      switch(vkFormat) {
+      case VK_R8G8B8A8_SRGB:
+	  info->srgb = true;
+      case VK_R8G8B8A8_UNORM:
+	  info->format = TextureFormat::RGBA8;
+	  return true;
+      case VK_BC1_RGB_SRGB:
+      case VK_BC1_RGBA_SRGB:
+	  info->srgb = true;
+      case VK_BC1_RGB_UNORM:
+      case VK_BC1_RGBA_UNORM:
+	  info->format = TextureFormat::BC1;
+	  return true;
+      case VK_BC3_SRGB:
+	  info->srgb = true;
+      case VK_BC3_UNORM:
+	  info->format = TextureFormat::BC3;
+	  return true;
+      case VK_BC4_UNORM:
+	  info->format = TextureFormat::BC4;
+	  return true;
+      case VK_BC5_UNORM:
+	  info->format = TextureFormat::BC5;
+	  return true;
+      case VK_BC7_SRGB:
+	  info->srgb = true;
+      case VK_BC7_UNORM:
+	  info->format = TextureFormat::BC7;
+	  return true;
+      default:
+	  return false;
+      }
+  }
+
+  bool readKtx2Header(const char* data, size_t size, Info* info) {
+      const size_t LEVEL_INDEX = 80;
+      if(size < LEVEL_INDEX)
+	  return false;
+      if(!vkFormatToTexture(get<uint32_t>(data, 12), info))
+	  return false;
+      info->width = (int)get<uint32_t>(data, 20);
+      info->height = (int)get<uint32_t>(data, 24);
+      uint32_t depth = get<uint32_t>(data, 28);
+      uint32_t layers = get<uint32_t>(data, 32);
+      uint32_t faces = get<uint32_t>(data, 36);
+      uint32_t levels = get<uint32_t>(data, 40);
+      uint32_t supercompression = get<uint32_t>(data, 44);
+      if(info->width == 0 || info->height == 0 || depth > 1 || layers > 1 ||
+	 faces != 1 || supercompression != 0)
+	  return false;
+      if(levels == 0)
+	  levels = 1;
+      if(size < LEVEL_INDEX + levels * 24)
+	  return false;
+      info->mipOffsets.resize(levels);
+      info->mipSizes.resize(levels);
+      for(uint32_t i = 0; i < levels; i++) {
+	  info->mipOffsets[i] = (size_t)get<uint64_t>(data, LEVEL_INDEX + i * 24);
+	  info->mipSizes[i] = (size_t)get<uint64_t>(data, LEVEL_INDEX + i * 24 + 8);
+      }
+      return checkMips(info, size);
+  }
+
+  bool readDdsHeader(const char* data, size_t size, Info* info) {
+      if(size < DDS_HEADER_SIZE)
+	  return false;
+      uint32_t flags = get<uint32_t>(data, 8);
+      info->height = (int)get<uint32_t>(data, 12);
+      info->width = (int)get<uint32_t>(data, 16);
+      uint32_t levels = (flags & DDSD_MIPMAPCOUNT) ? get<uint32_t>(data, 28) : 1;
+      if(levels == 0)
+	  levels = 1;
+      uint32_t pixelFlags = get<uint32_t>(data, 80);
+      uint32_t code = get<uint32_t>(data, 84);
+      size_t offset = DDS_HEADER_SIZE;
+      info->srgb = false;
+      info->hasColourSpace = false;
+      if(!(pixelFlags & DDPF_FOURCC))
+	  return false;
+      if(code == fourCC("DXT1"))
+	  info->format = TextureFormat::BC1;
+      else if(code == fourCC("DXT5"))
+	  info->format = TextureFormat::BC3;
+      else if(code == fourCC("ATI1") || code == fourCC("BC4U"))
+	  info->format = TextureFormat::BC4;
+      else if(code == fourCC("ATI2") || code == fourCC("BC5U"))
+	  info->format = TextureFormat::BC5;
+      else if(code == fourCC("DX10")) {
+	  if(size < DDS_HEADER_SIZE + DDS_DX10_HEADER_SIZE)
+	      return false;
+	  offset += DDS_DX10_HEADER_SIZE;
+	  info->hasColourSpace = true;
+	  // only plain 2D textures
+	  if(get<uint32_t>(data, DDS_HEADER_SIZE + 4) != 3 ||
+	     get<uint32_t>(data, DDS_HEADER_SIZE + 12) > 1)
+	      return false;
+	  switch(get<uint32_t>(data, DDS_HEADER_SIZE)) {
+	  case DXGI_R8G8B8A8_SRGB:
+	      info->srgb = true;
+	  case DXGI_R8G8B8A8_UNORM:
+	      info->format = TextureFormat::RGBA8;
+	      break;
+	  case DXGI_BC1_SRGB:
+	      info->srgb = true;
+	  case DXGI_BC1_UNORM:
+	      info->format = TextureFormat::BC1;
+	      break;
+	  case DXGI_BC3_SRGB:
+	      info->srgb = true;
+	  case DXGI_BC3_UNORM:
+	      info->format = TextureFormat::BC3;
+	      break;
+	  case DXGI_BC4_UNORM:
+	      info->format = TextureFormat::BC4;
+	      break;
+	  case DXGI_BC5_UNORM:
+	      info->format = TextureFormat::BC5;
+	      break;
+	  case DXGI_BC7_SRGB:
+	      info->srgb = true;
+	  case DXGI_BC7_UNORM:
+	      info->format = TextureFormat::BC7;
+	      break;
+	  default:
+	      return false;
+	  }
+      } else {
+	  return false;
+      }
+      if(info->width == 0 || info->height == 0)
+	  return false;
+      // dds mips are one after the other from largest to smallest
+      info->mipOffsets.resize(levels);
+      info->mipSizes.resize(levels);
+      int w = info->width, h = info->height;
+      for(uint32_t i = 0; i < levels; i++) {
+	  info->mipOffsets[i] = offset;
+	  info->mipSizes[i] = mipSize(info->format, w, h);
+	  offset += info->mipSizes[i];
+	  w = w > 1 ? w / 2 : 1;
+	  h = h > 1 ? h / 2 : 1;
+      }
+      return checkMips(info, size);
+  }
+
+  bool readHeader(const char* data, size_t size, Info* info) {
+      if(size >= sizeof(KTX2_IDENTIFIER) &&
+	 std::memcmp(data, KTX2_IDENTIFIER, sizeof(KTX2_IDENTIFIER)) == 0)
+	  return readKtx2Header(data, size, info);
+      if(size >= sizeof(DDS_MAGIC) && std::memcmp(data, DDS_MAGIC, sizeof(DDS_MAGIC)) == 0)
+	  return readDdsHeader(data, size, info);
+      return false;
+  }
+
+  // --- Writing ---
+
+  void put32(std::vector<char> &out, uint32_t v) {
+      out.insert(out.end(), (char*)&v, (char*)&v + sizeof(v));
+  }
+
+  void put64(std::vector<char> &out, uint64_t v) {
+      out.insert(out.end(), (char*)&v, (char*)&v + sizeof(v));
+  }
+
+  // the data format descriptor ktx2 requires, describing the texel block layout
+  std::vector<char> basicDfd(TextureFormat format, bool srgb) {
+      struct Sample {
+	  uint32_t bitOffset, bitLength, channel, upper;
+      };
+      std::vector<Sample> samples;
+      uint32_t model = 0, blockDim = 3, bytes = 16;
+      switch(format) {
+      case TextureFormat::RGBA8:
+	  model = 1; blockDim = 0; bytes = 4;
+	  samples = { {0, 8, 0, 255}, {8, 8, 1, 255}, {16, 8, 2, 255}, {24, 8, 15, 255} };
+	  break;
+      case TextureFormat::BC1:
+	  model = 128; bytes = 8;
+	  samples = { {0, 64, 0, UINT32_MAX} };
+	  break;
+      case TextureFormat::BC3:
+	  model = 130;
+	  samples = { {0, 64, 15, UINT32_MAX}, {64, 64, 0, UINT32_MAX} };
+	  break;
+      case TextureFormat::BC4:
+	  model = 131; bytes = 8;
+	  samples = { {0, 64, 0, UINT32_MAX} };
+	  break;
+      case TextureFormat::BC5:
+	  model = 132;
+	  samples = { {0, 64, 0, UINT32_MAX}, {64, 64, 1, UINT32_MAX} };
+	  break;
+      case TextureFormat::BC7:
+	  model = 134;
+	  samples = { {0, 128, 0, UINT32_MAX} };
+	  break;
+      }
+      uint32_t blockSize = 24 + 16 * (uint32_t)samples.size();
+      std::vector<char> dfd;
+      put32(dfd, 4 + blockSize);
+      put32(dfd, 0); // khronos vendor, basic descriptor type
+      put32(dfd, 2 | (blockSize << 16)); // version 2
+      // colour model, bt709 primaries, transfer function, flags
+      put32(dfd, model | (1 << 8) | ((srgb ? 2 : 1) << 16));
+      put32(dfd, blockDim | (blockDim << 8));
+      put32(dfd, bytes);
+      put32(dfd, 0);
+      for(Sample &s: samples) {
+	  put32(dfd, s.bitOffset | ((s.bitLength - 1) << 16) | (s.channel << 24));
+	  put32(dfd, 0);
+	  put32(dfd, 0);
+	  put32(dfd, s.upper);
+      }
+      return dfd;
+  }
+
+  uint32_t textureToVkFormat(TextureFormat format, bool srgb) {
+      switch(format) {
+      case TextureFormat::RGBA8:
+	  return srgb ? VK_R8G8B8A8_SRGB : VK_R8G8B8A8_UNORM;
+      case TextureFormat::BC1:
+	  return srgb ? VK_BC1_RGBA_SRGB : VK_BC1_RGBA_UNORM;
+      case TextureFormat::BC3:
+	  return srgb ? VK_BC3_SRGB : VK_BC3_UNORM;
+      case TextureFormat::BC4:
+	  return VK_BC4_UNORM;
+      case TextureFormat::BC5:
+	  return VK_BC5_UNORM;
+      case TextureFormat::BC7:
+	  return srgb ? VK_BC7_SRGB : VK_BC7_UNORM;
+      }
+      return 0;
+  }
+
+  bool writeKtx2(std::string path, TextureFormat format, bool srgb, int width, int height,
+		 const std::vector<const unsigned char*> &mips,
+		 const std::vector<size_t> &mipSizes) {
+      std::ofstream file(path, std::ios::binary | std::ios::trunc);
+      if(!file.is_open())
+	  return false;
+      return writeKtx2(file, format, srgb, width, height, mips, mipSizes);
+  }
+
+  bool writeKtx2(std::ostream &file, TextureFormat format, bool srgb, int width, int height,
+		 const std::vector<const unsigned char*> &mips,
+		 const std::vector<size_t> &mipSizes) {
+      size_t levels = mips.size();
+      std::vector<char> dfd = basicDfd(format, srgb);
+      std::vector<char> out(KTX2_IDENTIFIER, KTX2_IDENTIFIER + sizeof(KTX2_IDENTIFIER));
+      put32(out, textureToVkFormat(format, srgb));
+      put32(out, 1); // type size
+      put32(out, width);
+      put32(out, height);
+      put32(out, 0); // depth
+      put32(out, 0); // layers
+      put32(out, 1); // faces
+      put32(out, (uint32_t)levels);
+      put32(out, 0); // no supercompression
+      size_t dfdOffset = out.size() + 24 + levels * 24;
+      put32(out, (uint32_t)dfdOffset);
+      put32(out, (uint32_t)dfd.size());
+      put32(out, 0); // no key/value data
+      put32(out, 0);
+      put64(out, 0); // no supercompression data
+      put64(out, 0);
+      size_t levelIndex = out.size();
+      out.resize(out.size() + levels * 24, 0);
+      out.insert(out.end(), dfd.begin(), dfd.end());
+      // levels are stored smallest first, each aligned to the texel block size
+      size_t alignment = format == TextureFormat::RGBA8 ? 4 :
+	  mipSize(format, 1, 1);
+      std::vector<uint64_t> offsets(levels);
+      uint64_t end = out.size();
+      for(size_t i = levels; i-- > 0;) {
+	  end = (end + alignment - 1) / alignment * alignment;
+	  offsets[i] = end;
+	  uint64_t length = mipSizes[i];
+	  std::memcpy(&out[levelIndex + i * 24], &offsets[i], 8);
+	  std::memcpy(&out[levelIndex + i * 24 + 8], &length, 8);
+	  std::memcpy(&out[levelIndex + i * 24 + 16], &length, 8);
+	  end += length;
+      }
+      file.write(out.data(), out.size());
+      const char padding[16] = {};
+      uint64_t written = out.size();
+      for(size_t i = levels; i-- > 0;) {
+	  file.write(padding, offsets[i] - written);
+	  file.write((const char*)mips[i], mipSizes[i]);
+	  written = offsets[i] + mipSizes[i];
+      }
+      return file.good();
+  }
+
+}
@@ -0,0 +1,159 @@
+#include <render-internal/resource-loaders/cooked_model.h>
+
+#include "mapped_file.h"
+#include "binary_file.h"
+#include "file_time.h"
+#include <graphics/logger.h>
+#include <sys/stat.h>
+#include <stdexcept>
+#include <cstring>
+#include <cstdint>
+
+namespace cookedmodel {
+
+  const char MAGIC[8] = { 'G', 'E', 'M', 'O', 'D', 'E', 'L', '\0' };
+  // written as a number, so a file cooked on a machine
+  // with a different byte order gets rejected
+  const uint32_t BYTE_ORDER_MARK = 0x01020304;
+
+  struct Header {
+      char magic[8];
+      uint32_t version;
+      uint32_t byteOrder;
+      // total size of the file, catches files cut short by a crash while cooking
+      uint64_t size;
+  };
+
+  using binfile::Writer;
+  using binfile::Reader;
+  using binfile::writeNode;
+  using binfile::readNode;
+  using binfile::writeAnimation;
+  using binfile::readAnimation;
+
+  /// --- Writing ---
+
+  void writeMesh(Writer &w, const ModelInfo::Mesh &mesh) {
+      w.array(mesh.verticies);
+      w.array(mesh.indices);
+      w.put<uint64_t>(mesh.lodIndices.size());
+      for(const std::vector<unsigned int> &lod: mesh.lodIndices)
+	  w.array(lod);
+      w.put<uint64_t>(mesh.diffuseTextures.size());
+      for(const std::string &tex: mesh.diffuseTextures)
+	  w.string(tex);
+      w.put(mesh.diffuseColour);
+      w.put(mesh.bindTransform);
+  }
+
+  bool write(const ModelInfo::Model &model, std::string cookedPath) {
+      Writer w(sizeof(Header));
+      w.put<uint64_t>(model.meshes.size());
+      for(const ModelInfo::Mesh &mesh: model.meshes)
+	  writeMesh(w, mesh);
+      w.put<uint64_t>(model.nodes.size());
+      for(const ModelInfo::Node &node: model.nodes)
+	  writeNode(w, node);
+      w.put<uint64_t>(model.nodeMap.size());
+      for(auto &e: model.nodeMap) {
+	  w.string(e.first);
+	  w.put<int32_t>(e.second);
+      }
+      w.array(model.bones);
+      w.put<uint64_t>(model.boneMap.size());
+      for(auto &e: model.boneMap) {
+	  w.string(e.first);
+	  w.put<uint32_t>(e.second);
+      }
+      w.put<uint64_t>(model.animations.size());
+      for(const ModelInfo::Animation &anim: model.animations)
+	  writeAnimation(w, anim);
+
+      Header header;
+      std::memcpy(header.magic, MAGIC, sizeof(MAGIC));
+      header.version = FORMAT_VERSION;
+      header.byteOrder = BYTE_ORDER_MARK;
+      header.size = w.data.size();
+      std::memcpy(w.data.data(), &header, sizeof(Header));
+
+      // other threads may be cooking the same model, or have the old file mapped
+      return binfile::writeFileAtomically(cookedPath, w.data.data(), w.data.size());
+  }
+
+  /// --- Reading ---
+
+  void readMesh(Reader &r, ModelInfo::Mesh *mesh) {
+      r.array(&mesh->verticies);
+      r.array(&mesh->indices);
+      mesh->lodIndices.resize(r.count(sizeof(uint64_t)));
+      for(std::vector<unsigned int> &lod: mesh->lodIndices)
+	  r.array(&lod);
+      mesh->diffuseTextures.resize(r.count(sizeof(uint64_t)));
+      for(std::string &tex: mesh->diffuseTextures)
+	  tex = r.string();
+      mesh->diffuseColour = r.get<glm::vec4>();
+      mesh->bindTransform = r.get<glm::mat4>();
+  }
+
+  bool read(std::string cookedPath, ModelInfo::Model *model) {
+      MappedFile file(cookedPath);
+      if(!file.valid() || file.size() < sizeof(Header))
+	  return false;
+      Header header;
+      std::memcpy(&header, file.data(), sizeof(Header));
+      if(std::memcmp(header.magic, MAGIC, sizeof(MAGIC)) != 0 ||
+	 header.version != FORMAT_VERSION ||
+	 header.byteOrder != BYTE_ORDER_MARK ||
+	 header.size != file.size()) {
+	  LOG("cooked model at " << cookedPath << " is out of date or invalid");
+	  return false;
+      }
+
+      ModelInfo::Model m;
+      try {
+	  Reader r(file.data() + sizeof(Header), file.size() - sizeof(Header));
+	  m.meshes.resize(r.count(sizeof(glm::mat4)));
+	  for(ModelInfo::Mesh &mesh: m.meshes)
+	      readMesh(r, &mesh);
+	  m.nodes.resize(r.count(sizeof(glm::mat4)));
+	  for(ModelInfo::Node &node: m.nodes)
+	      readNode(r, &node);
+	  size_t nodeCount = r.count(sizeof(uint64_t));
+	  for(size_t i = 0; i < nodeCount; i++) {
+	      std::string name = r.string();
+	      m.nodeMap[name] = r.get<int32_t>();
+	  }
+	  r.array(&m.bones);
+	  size_t boneCount = r.count(sizeof(uint64_t));
+	  for(size_t i = 0; i < boneCount; i++) {
+	      std::string name = r.string();
+	      m.boneMap[name] = r.get<uint32_t>();
+	  }
+	  m.animations.resize(r.count(sizeof(uint64_t)));
+	  for(ModelInfo::Animation &anim: m.animations)
+	      readAnimation(r, &anim);
+      } catch(std::runtime_error &e) {
+	  LOG_ERROR("failed to read cooked model at " << cookedPath << " - " << e.what());
+	  return false;
+      }
+      *model = std::move(m);
+      return true;
+  }
+
+  /// --- Paths ---
+
+  std::string cookedPath(std::string modelPath) {
+      return modelPath + ".cooked";
+  }
+
+  bool upToDate(std::string modelPath, std::string cookedPath) {
+      struct stat cooked;
+      if(stat(cookedPath.c_str(), &cooked) != 0)
+	  return false;
+      struct stat source;
+      if(stat(modelPath.c_str(), &source) != 0)
+	  return true;
+      return fileModifiedTime(cookedPath, cooked) >= fileModifiedTime(modelPath, source);
+  }
+
+}
@@ -0,0 +1,22 @@
+#include "file_time.h"
+
+#ifdef _WIN32
+#define WIN32_LEAN_AND_MEAN
+#define NOMINMAX
+#include <windows.h>
+#endif
+
+int64_t fileModifiedTime(const std::string &path, const struct stat &st) {
+#if defined(_WIN32)
+    WIN32_FILE_ATTRIBUTE_DATA attribs;
+    if(!GetFileAttributesExA(path.c_str(), GetFileExInfoStandard, &attribs))
+	return (int64_t)st.st_mtime * 1000000000;
+    // in 100ns ticks
+    return ((int64_t)attribs.ftLastWriteTime.dwHighDateTime << 32
+	    | attribs.ftLastWriteTime.dwLowDateTime) * 100;
+#elif defined(__APPLE__)
+    return (int64_t)st.st_mtimespec.tv_sec * 1000000000 + st.st_mtimespec.tv_nsec;
+#else
+    return (int64_t)st.st_mtim.tv_sec * 1000000000 + st.st_mtim.tv_nsec;
+#endif
+}
@@ -0,0 +1,14 @@
+/// Modified times of files to the nanosecond, where the filesystem has them.
+/// st_mtime is only in seconds, so a file written again in the same second would look unchanged.
+
+#ifndef RENDER_INTERNAL_FILE_TIME_H
+#define RENDER_INTERNAL_FILE_TIME_H
+
+#include <sys/stat.h>
+#include <string>
+#include <stdint.h>
+
+/// st is the result of stat on path.
+int64_t fileModifiedTime(const std::string &path, const struct stat &st);
+
+#endif /* RENDER_INTERNAL_FILE_TIME_H */
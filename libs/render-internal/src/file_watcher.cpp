@@ -0,0 +1,84 @@
+#include <render-internal/file_watcher.h>
+
+#include <graphics/logger.h>
+#include <algorithm>
+
+#ifdef __linux__
+#include <sys/inotify.h>
+#include <unistd.h>
+#include <fcntl.h>
+#include <cerrno>
+
+FileWatcher::FileWatcher() {
+    fd = inotify_init1(IN_NONBLOCK | IN_CLOEXEC);
+    if(fd < 0)
+	LOG_ERROR("File Watcher: failed to start inotify, files won't be reloaded");
+}
+
+FileWatcher::~FileWatcher() {
+    if(fd >= 0)
+	close(fd);
+}
+
+void FileWatcher::watch(std::string path) {
+    if(fd < 0 || path.empty() || watched.find(path) != watched.end())
+	return;
+    size_t slash = path.find_last_of('/');
+    std::string folder = slash == std::string::npos ? "." : path.substr(0, slash);
+    std::string name = slash == std::string::npos ? path : path.substr(slash + 1);
+    if(folder.empty())
+	folder = "/";
+    auto found = folders.find(folder);
+    int wd;
+    if(found != folders.end()) {
+	wd = found->second;
+    } else {
+	// written in place, or saved elsewhere and moved over the old file
+	wd = inotify_add_watch(fd, folder.c_str(), IN_CLOSE_WRITE | IN_MOVED_TO);
+	if(wd < 0) {
+	    LOG_ERROR("File Watcher: failed to watch folder - path: " << folder);
+	    return;
+	}
+	folders[folder] = wd;
+    }
+    files[{wd, name}] = path;
+    watched.insert(path);
+}
+
+std::vector<std::string> FileWatcher::changed() {
+    std::vector<std::string> paths;
+    if(fd < 0)
+	return paths;
+    alignas(inotify_event) char buffer[4096];
+    for(;;) {
+	ssize_t length = read(fd, buffer, sizeof(buffer));
+	if(length <= 0)
+	    break;
+	for(char* p = buffer; p < buffer + length;) {
+	    inotify_event* event = (inotify_event*)p;
+	    p += sizeof(inotify_event) + event->len;
+	    if(event->len == 0)
+		continue;
+	    auto found = files.find({event->wd, std::string(event->name)});
+	    // an editor may write the file more than once when saving
+	    if(found != files.end() &&
+	       std::find(paths.begin(), paths.end(), found->second) == paths.end())
+		paths.push_back(found->second);
+	}
+    }
+    return paths;
+}
+
+#else
+
+FileWatcher::FileWatcher() {
+    LOG("File Watcher: not supported on this platform, files won't be reloaded");
+}
+
+FileWatcher::~FileWatcher() {}
+
+void FileWatcher::watch(std::string path) {}
+
+std::vector<std::string> FileWatcher::changed() { return {}; }
+
+#endif
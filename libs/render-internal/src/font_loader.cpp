@@ -1,4 +1,5 @@
 #include <render-internal/resource-loaders/font_loader.h>
+#include <render-internal/resource-loaders/asset_pack.h>
 
 #include <graphics/glm_helper.h>
 #include <graphics/logger.h>
@@ -6,22 +7,33 @@
 #include <map>
 
 const int FONT_LOAD_SIZE = 100;
+// glyphs are indexed by their char, so text doesn't have to search for them
+const size_t GLYPH_TABLE_SIZE = 256;
 
 struct Character {
-    Resource::Texture tex;
+    bool loaded = false;
     bool blank = false;
     glm::vec4 texOffset;
     glm::vec2 size;
     glm::vec2 bearing;
-    float advance;
+    float advance = 0.0f;
 };
 
 struct FontData {
+    std::string path;
+    /// the atlas every character is drawn from
+    Resource::Texture texture;
     unsigned char* textureData;
     unsigned int width;
     unsigned int height;
     unsigned int nrChannels;
-    std::map<char, Character> chars;
+    Character chars[GLYPH_TABLE_SIZE];
+
+    /// null if the font doesn't have the char
+    const Character* glyph(char c) const {
+	const Character* chr = &chars[(unsigned char)c];
+	return chr->loaded ? chr : nullptr;
+    }
 };
 
 InternalFontLoader::InternalFontLoader(Resource::Pool pool, TextureLoader * texLoader) {
@@ -43,10 +55,10 @@ Resource::Font InternalFontLoader::load(std::string file) {
 					  d->height,
 					  d->nrChannels);
     d->textureData = nullptr; // ownership taken by texloader
-    for(auto& c: d->chars)
-	c.second.tex = t;
+    d->path = file;
+    d->texture = t;
     staged.push_back(d);
-    Resource::Font f(staged.size() - 1, pool);
+    Resource::Font f(stagedBaseID + staged.size() - 1, pool);
     LOG("Font Loaded - pool: " << pool.ID <<
 	" - id: " << f.ID <<
 	" - path: " << file);
@@ -55,10 +67,20 @@ Resource::Font InternalFontLoader::load(std::string file) {
 
 void InternalFontLoader::loadGPU() {
     clearGPU();
+    gpuBaseID = stagedBaseID;
+    stagedBaseID += staged.size();
     fonts = staged;
     staged.clear();
 }
 
+void InternalFontLoader::appendGPU() {
+    if(fonts.empty())
+	gpuBaseID = stagedBaseID;
+    stagedBaseID += staged.size();
+    fonts.insert(fonts.end(), staged.begin(), staged.end());
+    staged.clear();
+}
+
 void InternalFontLoader::clearFonts(std::vector<FontData *> &fonts) {
     for(int i = 0; i < fonts.size(); i++)
 	delete fonts[i];
@@ -69,51 +91,101 @@ void InternalFontLoader::clearGPU() { clearFonts(fonts); }
 
 void InternalFontLoader::clearStaged() { clearFonts(staged); }
 
-float InternalFontLoader::length(Resource::Font font, std::string text, float size) {
-    if(font.ID >= fonts.size()) {
+void InternalFontLoader::writePack(assetpack::Contents* pack, InternalTexLoader* texLoader) {
+    for(FontData* data: staged) {
+	int texture = texLoader->stagedIndex(data->texture);
+	if(texture < 0) {
+	    LOG_ERROR("Font atlas wasn't staged in the same pool, it won't be packed"
+		      " - path: " << data->path);
+	    continue;
+	}
+	assetpack::Font font;
+	font.path = data->path;
+	font.texture = (uint32_t)texture;
+	for(size_t i = 0; i < GLYPH_TABLE_SIZE; i++) {
+	    Character &c = data->chars[i];
+	    if(c.loaded)
+		font.glyphs.push_back({ (char)i, c.blank, c.texOffset,
+					c.size, c.bearing, c.advance });
+	}
+	pack->fonts.push_back(font);
+    }
+}
+
+std::vector<Resource::Font> InternalFontLoader::loadPack(
+	const assetpack::Contents &pack, const std::vector<Resource::Texture> &textures) {
+    std::vector<Resource::Font> loaded;
+    for(auto &font: pack.fonts) {
+	FontData* d = new FontData();
+	d->path = font.path;
+	d->texture = textures[font.texture];
+	d->textureData = nullptr;
+	d->width = (unsigned int)d->texture.dim.x;
+	d->height = (unsigned int)d->texture.dim.y;
+	d->nrChannels = 4;
+	for(auto &glyph: font.glyphs) {
+	    Character &c = d->chars[(unsigned char)glyph.c];
+	    c.loaded = true;
+	    c.blank = glyph.blank;
+	    c.texOffset = glyph.texOffset;
+	    c.size = glyph.size;
+	    c.bearing = glyph.bearing;
+	    c.advance = glyph.advance;
+	}
+	staged.push_back(d);
+	loaded.push_back(Resource::Font(stagedBaseID + staged.size() - 1, pool));
+    }
+    return loaded;
+}
+
+float InternalFontLoader::length(Resource::Font font, const std::string &text, float size) {
+    size_t index = font.ID - gpuBaseID;
+    if(index >= fonts.size()) {
 	LOG_ERROR("font ID: " << font.ID << " was out of range: " << fonts.size());
 	return 0.0f;
     }
+    const FontData* data = fonts[index];
     float sz = 0;
-    for(std::string::const_iterator c = text.begin(); c != text.end(); c++) {
-	if(fonts[font.ID]->chars.count(*c) == 0)
-	    continue;
-	sz += fonts[font.ID]->chars.at(*c).advance * size;
+    for(char c: text) {
+	const Character* chr = data->glyph(c);
+	if(chr != nullptr)
+	    sz += chr->advance;
     }
-    return sz;
+    return sz * size;
 }
 
-std::vector<Resource::QuadDraw> InternalFontLoader::DrawString(Resource::Font font,
-							       std::string text,
-							       glm::vec2 pos,
-							       float size,
-							       float depth,
-							       glm::vec4 colour,
-							       float rotate) {
-    if(font.ID >= fonts.size()) {
+void InternalFontLoader::DrawString(Resource::Font font,
+				    const std::string &text,
+				    glm::vec2 pos,
+				    float size,
+				    float depth,
+				    glm::vec4 colour,
+				    float rotate,
+				    std::vector<Resource::QuadDraw> *draws) {
+    size_t index = font.ID - gpuBaseID;
+    if(index >= fonts.size()) {
 	LOG_ERROR("font ID: " << font.ID << " was out of range: " << fonts.size());
-	return {};
+	return;
     }
-    std::vector<Resource::QuadDraw> draws;
-    for(std::string::const_iterator c = text.begin(); c != text.end(); c++) {
-	if(fonts[font.ID]->chars.count(*c) == 0)
+    const FontData* data = fonts[index];
+    for(char c: text) {
+	const Character* chr = data->glyph(c);
+	if(chr == nullptr)
 	    continue;
-	Character chr = fonts[font.ID]->chars.at(*c);
-	if(!chr.blank) {
+	if(!chr->blank) {
 	    glm::vec4 p = glm::vec4(pos.x, pos.y, 0, 0);
-	    p.x += chr.bearing.x * size;
-	    p.y += (chr.size.y - chr.bearing.y) * size;
-	    p.y -= chr.size.y * size;
-	    p.z = chr.size.x  * size;
-	    p.w = chr.size.y * size;
+	    p.x += chr->bearing.x * size;
+	    p.y += (chr->size.y - chr->bearing.y) * size;
+	    p.y -= chr->size.y * size;
+	    p.z = chr->size.x  * size;
+	    p.w = chr->size.y * size;
 	    glm::mat4 model = glmhelper::calcMatFromRect(p, rotate, depth);
-	    draws.push_back(
+	    draws->push_back(
 		    Resource::QuadDraw(
-			    chr.tex, model, colour, chr.texOffset));
+			    data->texture, model, colour, chr->texOffset));
 	}
-	pos.x += chr.advance * size;
+	pos.x += chr->advance * size;
     }
-    return draws;
 }
 
 
@@ -209,7 +281,8 @@ FontData* loadFont(std::string path, int fontSize) {
 		glm::vec2(totalWidth, largestHeight),
 		glm::vec4(widthOffset, 0, charMap[c].width, charMap[c].height));
 
-	fontD->chars[c] = charMap[c].c;							     
+	fontD->chars[c] = charMap[c].c;
+	fontD->chars[c].loaded = true;
 	widthOffset += charMap[c].width + spacing;
     }
 
@@ -0,0 +1,62 @@
+#include "mapped_file.h"
+
+#ifdef _WIN32
+#define WIN32_LEAN_AND_MEAN
+#define NOMINMAX
+#include <windows.h>
+
+MappedFile::MappedFile(std::string path) {
+    HANDLE f = CreateFileA(path.c_str(), GENERIC_READ, FILE_SHARE_READ, NULL,
+			   OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL, NULL);
+    if(f == INVALID_HANDLE_VALUE)
+	return;
+    file = f;
+    LARGE_INTEGER fileSize;
+    if(!GetFileSizeEx(f, &fileSize) || fileSize.QuadPart == 0)
+	return;
+    HANDLE m = CreateFileMappingA(f, NULL, PAGE_READONLY, 0, 0, NULL);
+    if(m == NULL)
+	return;
+    mapping = m;
+    bytes = (const char*)MapViewOfFile(m, FILE_MAP_READ, 0, 0, 0);
+    if(bytes != nullptr)
+	length = (size_t)fileSize.QuadPart;
+}
+
+MappedFile::~MappedFile() {
+    if(bytes != nullptr)
+	UnmapViewOfFile(bytes);
+    if(mapping != nullptr)
+	CloseHandle((HANDLE)mapping);
+    if(file != nullptr)
+	CloseHandle((HANDLE)file);
+}
+
+#else
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <fcntl.h>
+#include <unistd.h>
+
+MappedFile::MappedFile(std::string path) {
+    int fd = open(path.c_str(), O_RDONLY);
+    if(fd < 0)
+	return;
+    struct stat st;
+    if(fstat(fd, &st) == 0 && st.st_size > 0) {
+	void* m = mmap(nullptr, (size_t)st.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+	if(m != MAP_FAILED) {
+	    bytes = (const char*)m;
+	    length = (size_t)st.st_size;
+	}
+    }
+    // the mapping stays valid after the descriptor is closed
+    close(fd);
+}
+
+MappedFile::~MappedFile() {
+    if(bytes != nullptr)
+	munmap((void*)bytes, length);
+}
+
+#endif
@@ -0,0 +1,31 @@
+/// A read only view of a file's bytes.
+/// The file is memory mapped, so only the pages that are touched get read from disk.
+
+#ifndef RENDER_INTERNAL_MAPPED_FILE_H
+#define RENDER_INTERNAL_MAPPED_FILE_H
+
+#include <string>
+#include <cstddef>
+
+class MappedFile {
+public:
+    MappedFile(std::string path);
+    ~MappedFile();
+    MappedFile(const MappedFile&) = delete;
+    MappedFile& operator=(const MappedFile&) = delete;
+
+    /// false if the file could not be opened or mapped
+    bool valid() { return bytes != nullptr; }
+    const char* data() { return bytes; }
+    size_t size() { return length; }
+
+private:
+    const char* bytes = nullptr;
+    size_t length = 0;
+#ifdef _WIN32
+    void* file = nullptr;
+    void* mapping = nullptr;
+#endif
+};
+
+#endif /* RENDER_INTERNAL_MAPPED_FILE_H */
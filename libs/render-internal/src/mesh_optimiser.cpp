@@ -0,0 +1,290 @@
+#include <render-internal/resource-loaders/mesh_optimiser.h>
+
+#include <algorithm>
+#include <cmath>
+
+namespace meshopt {
+
+  bool validIndices(const std::vector<unsigned int> &indices, size_t vertexCount) {
+      if(indices.size() % 3 != 0)
+	  return false;
+      for(unsigned int i: indices)
+	  if(i >= vertexCount)
+	      return false;
+      return true;
+  }
+
+  /// --- Cache Analysis ---
+
+  CacheStats analyseVertexCache(const std::vector<unsigned int> &indices,
+				size_t vertexCount, unsigned int cacheSize) {
+      CacheStats stats;
+      if(indices.size() < 3)
+	  return stats;
+      // a vertex is in the cache if it was one of the last cacheSize vertices added
+      std::vector<size_t> added(vertexCount, 0);
+      size_t clock = cacheSize + 1;
+      std::vector<bool> used(vertexCount, false);
+      size_t usedCount = 0;
+      for(unsigned int i: indices) {
+	  if(i >= vertexCount)
+	      continue;
+	  if(!used[i]) {
+	      used[i] = true;
+	      usedCount++;
+	  }
+	  if(clock - added[i] > cacheSize) {
+	      added[i] = clock++;
+	      stats.transforms++;
+	  }
+      }
+      stats.acmr = (float)stats.transforms / (indices.size() / 3);
+      stats.atvr = usedCount == 0 ? 0 : (float)stats.transforms / usedCount;
+      return stats;
+  }
+
+  /// --- Vertex Cache Optimisation ---
+
+  const int MAX_CACHE = 32;
+  const float CACHE_DECAY_POWER = 1.5f;
+  const float LAST_TRI_SCORE = 0.75f;
+  const float VALENCE_BOOST_SCALE = 2.0f;
+  const float VALENCE_BOOST_POWER = 0.5f;
+
+  float vertexScore(int cachePos, unsigned int remainingTris) {
+      if(remainingTris == 0)
+	  return -1.0f;
+      float score = 0.0f;
+      if(cachePos >= 0) {
+	  // the last triangle's vertices get a fixed score,
+	  // so we don't just reuse the same edge again
+	  if(cachePos < 3)
+	      score = LAST_TRI_SCORE;
+	  else
+	      score = std::pow(1.0f - (float)(cachePos - 3) / (MAX_CACHE - 3),
+			       CACHE_DECAY_POWER);
+      }
+      // favour vertices with few triangles left, so they get finished off
+      return score + VALENCE_BOOST_SCALE *
+	  std::pow((float)remainingTris, -VALENCE_BOOST_POWER);
+  }
+
+  void optimiseVertexCache(std::vector<unsigned int> &indices, size_t vertexCount) {
+      size_t triCount = indices.size() / 3;
+      if(triCount < 2 || !validIndices(indices, vertexCount))
+	  return;
+
+      // triangles that use each vertex
+      std::vector<unsigned int> remaining(vertexCount, 0);
+      for(unsigned int i: indices)
+	  remaining[i]++;
+      std::vector<unsigned int> triOffset(vertexCount, 0);
+      for(size_t v = 1; v < vertexCount; v++)
+	  triOffset[v] = triOffset[v - 1] + remaining[v - 1];
+      std::vector<unsigned int> vertTris(indices.size());
+      std::vector<unsigned int> filled(vertexCount, 0);
+      for(size_t t = 0; t < triCount; t++)
+	  for(int k = 0; k < 3; k++) {
+	      unsigned int v = indices[t * 3 + k];
+	      vertTris[triOffset[v] + filled[v]++] = (unsigned int)t;
+	  }
+
+      std::vector<int> cachePos(vertexCount, -1);
+      std::vector<float> vScore(vertexCount);
+      for(size_t v = 0; v < vertexCount; v++)
+	  vScore[v] = vertexScore(-1, remaining[v]);
+      std::vector<float> tScore(triCount);
+      std::vector<bool> emitted(triCount, false);
+      int best = 0;
+      for(size_t t = 0; t < triCount; t++) {
+	  tScore[t] = vScore[indices[t*3]] + vScore[indices[t*3 + 1]] + vScore[indices[t*3 + 2]];
+	  if(tScore[t] > tScore[best])
+	      best = (int)t;
+      }
+
+      std::vector<unsigned int> out;
+      out.reserve(indices.size());
+      std::vector<unsigned int> cache, nextCache;
+      cache.reserve(MAX_CACHE + 3);
+      nextCache.reserve(MAX_CACHE + 3);
+      size_t cursor = 0;
+      while(best >= 0) {
+	  emitted[best] = true;
+	  nextCache.clear();
+	  for(int k = 0; k < 3; k++) {
+	      unsigned int v = indices[best * 3 + k];
+	      out.push_back(v);
+	      if(std::find(nextCache.begin(), nextCache.end(), v) == nextCache.end())
+		  nextCache.push_back(v);
+	      // remove this triangle from the vertex's remaining triangles
+	      unsigned int* tris = &vertTris[triOffset[v]];
+	      for(unsigned int j = 0; j < remaining[v]; j++)
+		  if(tris[j] == (unsigned int)best) {
+		      tris[j] = tris[remaining[v] - 1];
+		      remaining[v]--;
+		      break;
+		  }
+	  }
+	  auto triEnd = nextCache.begin() + nextCache.size();
+	  for(unsigned int v: cache)
+	      if(std::find(nextCache.begin(), triEnd, v) == triEnd)
+		  nextCache.push_back(v);
+	  for(size_t i = MAX_CACHE; i < nextCache.size(); i++) {
+	      cachePos[nextCache[i]] = -1;
+	      vScore[nextCache[i]] = vertexScore(-1, remaining[nextCache[i]]);
+	  }
+	  if(nextCache.size() > MAX_CACHE)
+	      nextCache.resize(MAX_CACHE);
+	  std::swap(cache, nextCache);
+	  for(size_t i = 0; i < cache.size(); i++) {
+	      cachePos[cache[i]] = (int)i;
+	      vScore[cache[i]] = vertexScore((int)i, remaining[cache[i]]);
+	  }
+
+	  // next triangle is the best scoring one that uses a cached vertex
+	  best = -1;
+	  float bestScore = -1.0f;
+	  for(unsigned int v: cache) {
+	      unsigned int* tris = &vertTris[triOffset[v]];
+	      for(unsigned int j = 0; j < remaining[v]; j++) {
+		  unsigned int t = tris[j];
+		  tScore[t] = vScore[indices[t*3]] + vScore[indices[t*3 + 1]]
+		      + vScore[indices[t*3 + 2]];
+		  if(tScore[t] > bestScore) {
+		      bestScore = tScore[t];
+		      best = (int)t;
+		  }
+	      }
+	  }
+	  if(best < 0) {
+	      while(cursor < triCount && emitted[cursor])
+		  cursor++;
+	      best = cursor < triCount ? (int)cursor : -1;
+	  }
+      }
+      indices.swap(out);
+  }
+
+  /// --- Overdraw Optimisation ---
+
+  const unsigned int OVERDRAW_CACHE_SIZE = 16;
+  const size_t MIN_CLUSTER_TRIS = 16;
+
+  struct Cluster {
+      size_t start, end;
+      float sortKey;
+  };
+
+  void optimiseOverdraw(ModelInfo::Mesh &mesh, float threshold) {
+      std::vector<unsigned int> &indices = mesh.indices;
+      size_t vertexCount = mesh.verticies.size();
+      size_t triCount = indices.size() / 3;
+      if(triCount < MIN_CLUSTER_TRIS * 2 || !validIndices(indices, vertexCount))
+	  return;
+      float targetAcmr = analyseVertexCache(
+	      indices, vertexCount, OVERDRAW_CACHE_SIZE).acmr * threshold;
+
+      // split into clusters where doing so barely hurts the cache,
+      // ie the cluster started with a cold cache is still close to the whole mesh's acmr.
+      std::vector<Cluster> clusters;
+      std::vector<size_t> added(vertexCount, 0);
+      size_t clock = OVERDRAW_CACHE_SIZE + 1;
+      size_t start = 0, misses = 0;
+      for(size_t t = 0; t < triCount; t++) {
+	  for(int k = 0; k < 3; k++) {
+	      unsigned int v = indices[t*3 + k];
+	      if(clock - added[v] > OVERDRAW_CACHE_SIZE) {
+		  added[v] = clock++;
+		  misses++;
+	      }
+	  }
+	  size_t tris = t - start + 1;
+	  if(t + 1 == triCount ||
+	     (tris >= MIN_CLUSTER_TRIS && (float)misses / tris <= targetAcmr)) {
+	      clusters.push_back({start, t + 1, 0.0f});
+	      start = t + 1;
+	      misses = 0;
+	      // empty the simulated cache for the next cluster
+	      clock += OVERDRAW_CACHE_SIZE + 1;
+	  }
+      }
+      if(clusters.size() < 2)
+	  return;
+
+      glm::vec3 meshCentre(0);
+      float meshArea = 0;
+      std::vector<glm::vec3> centres(clusters.size()), normals(clusters.size());
+      for(size_t c = 0; c < clusters.size(); c++) {
+	  glm::vec3 centre(0), normal(0);
+	  float area = 0;
+	  for(size_t t = clusters[c].start; t < clusters[c].end; t++) {
+	      glm::vec3 p0 = mesh.verticies[indices[t*3]].Position;
+	      glm::vec3 p1 = mesh.verticies[indices[t*3 + 1]].Position;
+	      glm::vec3 p2 = mesh.verticies[indices[t*3 + 2]].Position;
+	      glm::vec3 n = glm::cross(p1 - p0, p2 - p0);
+	      float a = glm::length(n);
+	      centre += (p0 + p1 + p2) * (a / 3.0f);
+	      normal += n;
+	      area += a;
+	  }
+	  meshCentre += centre;
+	  meshArea += area;
+	  centres[c] = area > 0 ? centre / area : centre;
+	  normals[c] = normal;
+      }
+      if(meshArea > 0)
+	  meshCentre /= meshArea;
+      // clusters further out along their own normal are more likely
+      // to be in front of the rest of the mesh
+      for(size_t c = 0; c < clusters.size(); c++) {
+	  float len = glm::length(normals[c]);
+	  clusters[c].sortKey = len > 0 ?
+	      glm::dot(centres[c] - meshCentre, normals[c] / len) : 0.0f;
+      }
+      std::stable_sort(clusters.begin(), clusters.end(),
+		       [](const Cluster &a, const Cluster &b) {
+			   return a.sortKey > b.sortKey;
+		       });
+
+      std::vector<unsigned int> out;
+      out.reserve(indices.size());
+      for(Cluster &c: clusters)
+	  out.insert(out.end(), indices.begin() + c.start * 3, indices.begin() + c.end * 3);
+      indices.swap(out);
+  }
+
+  /// --- Vertex Fetch Optimisation ---
+
+  void optimiseVertexFetch(ModelInfo::Mesh &mesh) {
+      if(!validIndices(mesh.indices, mesh.verticies.size()))
+	  return;
+      for(auto &lod: mesh.lodIndices)
+	  if(!validIndices(lod, mesh.verticies.size()))
+	      return;
+      const unsigned int UNUSED = ~0u;
+      std::vector<unsigned int> remap(mesh.verticies.size(), UNUSED);
+      std::vector<ModelInfo::Vertex> verticies;
+      verticies.reserve(mesh.verticies.size());
+      auto remapIndices = [&](std::vector<unsigned int> &indices) {
+	  for(unsigned int &i: indices) {
+	      if(remap[i] == UNUSED) {
+		  remap[i] = (unsigned int)verticies.size();
+		  verticies.push_back(mesh.verticies[i]);
+	      }
+	      i = remap[i];
+	  }
+      };
+      // lods index the same verticies, so keep the ones only they use
+      remapIndices(mesh.indices);
+      for(auto &lod: mesh.lodIndices)
+	  remapIndices(lod);
+      mesh.verticies.swap(verticies);
+  }
+
+  void optimiseMesh(ModelInfo::Mesh &mesh) {
+      optimiseVertexCache(mesh.indices, mesh.verticies.size());
+      optimiseOverdraw(mesh, 1.05f);
+      optimiseVertexFetch(mesh);
+  }
+
+}
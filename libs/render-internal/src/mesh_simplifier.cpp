@@ -0,0 +1,337 @@
+#include <render-internal/resource-loaders/mesh_simplifier.h>
+
+#include <algorithm>
+#include <cstring>
+#include <queue>
+#include <unordered_map>
+
+namespace meshopt {
+
+  /// error of a point from a set of planes, stored as the symmetric 4x4 matrix of
+  /// the summed plane equations.
+  struct Quadric {
+      double a2 = 0, ab = 0, ac = 0, ad = 0;
+      double b2 = 0, bc = 0, bd = 0;
+      double c2 = 0, cd = 0;
+      double d2 = 0;
+
+      void addPlane(glm::vec3 n, float d, float weight) {
+	  a2 += weight * n.x * n.x; ab += weight * n.x * n.y;
+	  ac += weight * n.x * n.z; ad += weight * n.x * d;
+	  b2 += weight * n.y * n.y; bc += weight * n.y * n.z;
+	  bd += weight * n.y * d;
+	  c2 += weight * n.z * n.z; cd += weight * n.z * d;
+	  d2 += weight * d * d;
+      }
+
+      void add(const Quadric &q) {
+	  a2 += q.a2; ab += q.ab; ac += q.ac; ad += q.ad;
+	  b2 += q.b2; bc += q.bc; bd += q.bd;
+	  c2 += q.c2; cd += q.cd;
+	  d2 += q.d2;
+      }
+
+      double error(glm::vec3 p) const {
+	  double x = p.x, y = p.y, z = p.z;
+	  return x*x*a2 + y*y*b2 + z*z*c2
+	      + 2*(x*y*ab + x*z*ac + y*z*bc)
+	      + 2*(x*ad + y*bd + z*cd)
+	      + d2;
+      }
+  };
+
+  // open borders are much more noticable when they move
+  const float BORDER_WEIGHT = 10.0f;
+  // reject collapses that turn a triangle more than this (cos of the angle)
+  const float MAX_FLIP = 0.2f;
+  // don't bother making lods for tiny meshes
+  const size_t MIN_LOD_TRIS = 64;
+  // stop the chain when a level wasn't at least this much smaller than the last one
+  const float MIN_LOD_REDUCTION = 0.8f;
+
+  struct Collapse {
+      float cost;
+      unsigned int from, to;
+      unsigned int fromVersion, toVersion;
+      bool operator<(const Collapse &other) const {
+	  // priority queue puts the largest first, we want the cheapest
+	  return cost > other.cost;
+      }
+  };
+
+  struct PositionHash {
+      size_t operator()(const glm::vec3 &p) const {
+	  // adding zero makes -0 the same as 0
+	  float f[3] = { p.x + 0.0f, p.y + 0.0f, p.z + 0.0f };
+	  unsigned int h[3];
+	  std::memcpy(h, f, sizeof(h));
+	  return (h[0] * 73856093u) ^ (h[1] * 19349663u) ^ (h[2] * 83492791u);
+      }
+  };
+
+  class Simplifier {
+  public:
+      Simplifier(const ModelInfo::Mesh &mesh);
+
+      /// collapse edges until there are at most targetTris triangles left,
+      /// or no more edges can be collapsed.
+      void simplify(size_t targetTris);
+
+      size_t triangleCount() { return aliveTris; }
+
+      std::vector<unsigned int> indices();
+
+  private:
+      void pushCollapses(unsigned int p);
+      float collapseCost(unsigned int from, unsigned int to);
+      bool mapVertices(unsigned int from, unsigned int to);
+      bool flips(unsigned int from, unsigned int to);
+      void collapse(unsigned int from, unsigned int to);
+
+      // vertices with the same position are welded together,
+      // so edges are collapsed across uv and normal seams
+      std::vector<glm::vec3> positions;
+      std::vector<unsigned int> vertexPosition;
+      std::vector<std::vector<unsigned int>> positionVertices;
+      std::vector<std::vector<unsigned int>> positionTris;
+      std::vector<Quadric> quadrics;
+      std::vector<unsigned int> version;
+      std::vector<bool> removed;
+
+      std::vector<unsigned int> tris;
+      std::vector<bool> triAlive;
+      size_t aliveTris = 0;
+
+      std::priority_queue<Collapse> queue;
+      // vertex remap found by mapVertices, for the collapse being tested
+      std::vector<std::pair<unsigned int, unsigned int>> vertexMap;
+  };
+
+  Simplifier::Simplifier(const ModelInfo::Mesh &mesh) {
+      std::unordered_map<glm::vec3, unsigned int, PositionHash> weld;
+      vertexPosition.resize(mesh.verticies.size());
+      for(size_t v = 0; v < mesh.verticies.size(); v++) {
+	  glm::vec3 p = mesh.verticies[v].Position;
+	  auto it = weld.find(p);
+	  if(it == weld.end()) {
+	      it = weld.insert({p, (unsigned int)positions.size()}).first;
+	      positions.push_back(p);
+	      positionVertices.push_back({});
+	  }
+	  vertexPosition[v] = it->second;
+	  positionVertices[it->second].push_back((unsigned int)v);
+      }
+      positionTris.resize(positions.size());
+      quadrics.resize(positions.size());
+      version.resize(positions.size(), 0);
+      removed.resize(positions.size(), false);
+
+      tris = mesh.indices;
+      triAlive.resize(tris.size() / 3, true);
+      aliveTris = tris.size() / 3;
+      std::unordered_map<unsigned long long, unsigned int> edgeUses;
+      for(size_t t = 0; t < triAlive.size(); t++) {
+	  unsigned int p[3];
+	  for(int k = 0; k < 3; k++) {
+	      p[k] = vertexPosition[tris[t*3 + k]];
+	      positionTris[p[k]].push_back((unsigned int)t);
+	  }
+	  glm::vec3 n = glm::cross(positions[p[1]] - positions[p[0]],
+				   positions[p[2]] - positions[p[0]]);
+	  float area = glm::length(n);
+	  if(area > 0) {
+	      n /= area;
+	      for(int k = 0; k < 3; k++)
+		  quadrics[p[k]].addPlane(n, -glm::dot(n, positions[p[0]]), area);
+	  }
+	  for(int k = 0; k < 3; k++) {
+	      unsigned int a = std::min(p[k], p[(k+1)%3]), b = std::max(p[k], p[(k+1)%3]);
+	      edgeUses[((unsigned long long)a << 32) | b]++;
+	  }
+      }
+
+      // planes perpendicular to border edges keep open borders where they are
+      for(size_t t = 0; t < triAlive.size(); t++) {
+	  unsigned int p[3];
+	  for(int k = 0; k < 3; k++)
+	      p[k] = vertexPosition[tris[t*3 + k]];
+	  glm::vec3 n = glm::cross(positions[p[1]] - positions[p[0]],
+				   positions[p[2]] - positions[p[0]]);
+	  for(int k = 0; k < 3; k++) {
+	      unsigned int a = p[k], b = p[(k+1)%3];
+	      if(edgeUses[((unsigned long long)std::min(a, b) << 32) | std::max(a, b)] != 1)
+		  continue;
+	      glm::vec3 edge = positions[b] - positions[a];
+	      glm::vec3 border = glm::cross(edge, n);
+	      float len = glm::length(border);
+	      if(len == 0)
+		  continue;
+	      border /= len;
+	      float weight = BORDER_WEIGHT * glm::dot(edge, edge);
+	      quadrics[a].addPlane(border, -glm::dot(border, positions[a]), weight);
+	      quadrics[b].addPlane(border, -glm::dot(border, positions[a]), weight);
+	  }
+      }
+
+      for(unsigned int p = 0; p < positions.size(); p++)
+	  pushCollapses(p);
+  }
+
+  void Simplifier::pushCollapses(unsigned int p) {
+      for(unsigned int t: positionTris[p]) {
+	  if(!triAlive[t])
+	      continue;
+	  for(int k = 0; k < 3; k++) {
+	      unsigned int q = vertexPosition[tris[t*3 + k]];
+	      if(q == p)
+		  continue;
+	      queue.push({collapseCost(p, q), p, q, version[p], version[q]});
+	      queue.push({collapseCost(q, p), q, p, version[q], version[p]});
+	  }
+      }
+  }
+
+  float Simplifier::collapseCost(unsigned int from, unsigned int to) {
+      Quadric q = quadrics[from];
+      q.add(quadrics[to]);
+      return (float)q.error(positions[to]);
+  }
+
+  /// Each vertex at from must share a triangle with exactly one vertex at to,
+  /// and no two vertices may map to the same one.
+  /// Otherwise the collapse would drag a uv or normal seam across the surface.
+  bool Simplifier::mapVertices(unsigned int from, unsigned int to) {
+      vertexMap.clear();
+      for(unsigned int v: positionVertices[from]) {
+	  unsigned int match = ~0u;
+	  bool used = false;
+	  for(unsigned int t: positionTris[from]) {
+	      if(!triAlive[t])
+		  continue;
+	      unsigned int* tri = &tris[t*3];
+	      if(tri[0] != v && tri[1] != v && tri[2] != v)
+		  continue;
+	      used = true;
+	      for(int k = 0; k < 3; k++) {
+		  if(vertexPosition[tri[k]] != to)
+		      continue;
+		  if(match != ~0u && match != tri[k])
+		      return false;
+		  match = tri[k];
+	      }
+	  }
+	  if(!used)
+	      continue;
+	  if(match == ~0u)
+	      return false;
+	  for(auto &m: vertexMap)
+	      if(m.second == match)
+		  return false;
+	  vertexMap.push_back({v, match});
+      }
+      return true;
+  }
+
+  bool Simplifier::flips(unsigned int from, unsigned int to) {
+      for(unsigned int t: positionTris[from]) {
+	  if(!triAlive[t])
+	      continue;
+	  glm::vec3 p[3], moved[3];
+	  bool hasTo = false;
+	  for(int k = 0; k < 3; k++) {
+	      unsigned int pos = vertexPosition[tris[t*3 + k]];
+	      hasTo |= pos == to;
+	      p[k] = positions[pos];
+	      moved[k] = pos == from ? positions[to] : p[k];
+	  }
+	  // this triangle gets removed by the collapse
+	  if(hasTo)
+	      continue;
+	  glm::vec3 before = glm::cross(p[1] - p[0], p[2] - p[0]);
+	  glm::vec3 after = glm::cross(moved[1] - moved[0], moved[2] - moved[0]);
+	  float lengths = glm::length(before) * glm::length(after);
+	  if(lengths == 0 || glm::dot(before, after) < MAX_FLIP * lengths)
+	      return true;
+      }
+      return false;
+  }
+
+  void Simplifier::collapse(unsigned int from, unsigned int to) {
+      for(unsigned int t: positionTris[from]) {
+	  if(!triAlive[t])
+	      continue;
+	  unsigned int* tri = &tris[t*3];
+	  bool hasTo = false;
+	  for(int k = 0; k < 3; k++)
+	      hasTo |= vertexPosition[tri[k]] == to;
+	  if(hasTo) {
+	      triAlive[t] = false;
+	      aliveTris--;
+	      continue;
+	  }
+	  for(int k = 0; k < 3; k++)
+	      for(auto &m: vertexMap)
+		  if(tri[k] == m.first)
+		      tri[k] = m.second;
+	  positionTris[to].push_back(t);
+      }
+      positionTris[from].clear();
+      quadrics[to].add(quadrics[from]);
+      removed[from] = true;
+      version[to]++;
+      // drop dead triangles so the list doesn't keep growing
+      auto &toTris = positionTris[to];
+      toTris.erase(std::remove_if(toTris.begin(), toTris.end(),
+				  [this](unsigned int t) { return !triAlive[t]; }),
+		   toTris.end());
+      pushCollapses(to);
+  }
+
+  void Simplifier::simplify(size_t targetTris) {
+      while(aliveTris > targetTris && !queue.empty()) {
+	  Collapse c = queue.top();
+	  queue.pop();
+	  if(removed[c.from] || removed[c.to] ||
+	     version[c.from] != c.fromVersion || version[c.to] != c.toVersion)
+	      continue;
+	  if(!mapVertices(c.from, c.to) || flips(c.from, c.to))
+	      continue;
+	  collapse(c.from, c.to);
+      }
+  }
+
+  std::vector<unsigned int> Simplifier::indices() {
+      std::vector<unsigned int> out;
+      out.reserve(aliveTris * 3);
+      for(size_t t = 0; t < triAlive.size(); t++)
+	  if(triAlive[t])
+	      out.insert(out.end(), tris.begin() + t*3, tris.begin() + t*3 + 3);
+      return out;
+  }
+
+  std::vector<std::vector<unsigned int>> generateLods(const ModelInfo::Mesh &mesh,
+						      unsigned int lodCount) {
+      std::vector<std::vector<unsigned int>> lods;
+      size_t triCount = mesh.indices.size() / 3;
+      if(triCount < MIN_LOD_TRIS || mesh.indices.size() % 3 != 0)
+	  return lods;
+      for(unsigned int i: mesh.indices)
+	  if(i >= mesh.verticies.size())
+	      return lods;
+
+      // one simplifier for the whole chain, so each level carries on
+      // from the collapses of the last one.
+      Simplifier simplifier(mesh);
+      size_t lastTris = triCount;
+      for(unsigned int lod = 0; lod < lodCount; lod++) {
+	  simplifier.simplify(lastTris / 2);
+	  size_t tris = simplifier.triangleCount();
+	  if(tris == 0 || tris > lastTris * MIN_LOD_REDUCTION)
+	      break;
+	  lods.push_back(simplifier.indices());
+	  lastTris = tris;
+      }
+      return lods;
+  }
+
+}
@@ -0,0 +1,213 @@
+#include <render-internal/resource-loaders/meshlets.h>
+
+#include <render-internal/worker_pool.h>
+#include <algorithm>
+#include <cmath>
+#include <cstring>
+
+namespace meshopt {
+
+  // cones where a normal is nearly perpendicular to the axis rarely cull anything
+  const float MIN_CONE_DOT = 0.1f;
+  const size_t INSTANCES_PER_JOB = 16;
+  // fewer meshlet tests than this are quicker to do on the calling thread
+  // than to hand to the worker pool
+  const size_t MIN_PARALLEL_TESTS = 4096;
+
+  void setBounds(Meshlet *meshlet,
+		 const std::vector<glm::vec3> &positions,
+		 const std::vector<unsigned int> &indices) {
+      size_t start = meshlet->indexOffset, end = start + meshlet->indexCount;
+      glm::vec3 minPos = positions[indices[start]], maxPos = minPos;
+      for(size_t i = start; i < end; i++) {
+	  minPos = glm::min(minPos, positions[indices[i]]);
+	  maxPos = glm::max(maxPos, positions[indices[i]]);
+      }
+      meshlet->centre = (minPos + maxPos) * 0.5f;
+      meshlet->radius = 0;
+      for(size_t i = start; i < end; i++)
+	  meshlet->radius = std::max(meshlet->radius,
+				     glm::length(positions[indices[i]] - meshlet->centre));
+
+      std::vector<glm::vec3> normals;
+      normals.reserve(meshlet->indexCount / 3);
+      glm::vec3 axis(0);
+      for(size_t i = start; i < end; i += 3) {
+	  glm::vec3 p0 = positions[indices[i]];
+	  glm::vec3 n = glm::cross(positions[indices[i + 1]] - p0,
+				   positions[indices[i + 2]] - p0);
+	  float len = glm::length(n);
+	  if(len == 0)
+	      continue;
+	  normals.push_back(n / len);
+	  axis += normals.back();
+      }
+      meshlet->coneAxis = glm::vec3(0);
+      meshlet->coneCutoff = 1.0f;
+      float len = glm::length(axis);
+      if(len == 0)
+	  return;
+      axis /= len;
+      float minDot = 1.0f;
+      for(glm::vec3 &n: normals)
+	  minDot = std::min(minDot, glm::dot(n, axis));
+      meshlet->coneAxis = axis;
+      if(minDot > MIN_CONE_DOT)
+	  meshlet->coneCutoff = std::sqrt(1.0f - minDot * minDot);
+  }
+
+  std::vector<Meshlet> buildMeshlets(const ModelInfo::Mesh &mesh) {
+      std::vector<Meshlet> meshlets;
+      const std::vector<unsigned int> &indices = mesh.indices;
+      size_t triCount = indices.size() / 3;
+      if(triCount < MIN_MESHLETS * MESHLET_MAX_TRIANGLES / 2)
+	  return meshlets;
+      std::vector<glm::vec3> positions(mesh.verticies.size());
+      for(size_t i = 0; i < positions.size(); i++)
+	  positions[i] = mesh.bindTransform * glm::vec4(mesh.verticies[i].Position, 1.0f);
+      for(unsigned int i: indices)
+	  if(i >= positions.size())
+	      return meshlets;
+
+      // which meshlet last used each vertex, plus one
+      std::vector<uint32_t> usedBy(positions.size(), 0);
+      Meshlet current = {};
+      unsigned int vertexCount = 0;
+      for(size_t t = 0; t < triCount; t++) {
+	  unsigned int newVertices = 0;
+	  for(int k = 0; k < 3; k++)
+	      if(usedBy[indices[t*3 + k]] != meshlets.size() + 1)
+		  newVertices++;
+	  if(vertexCount + newVertices > MESHLET_MAX_VERTICES ||
+	     current.indexCount / 3 + 1 > MESHLET_MAX_TRIANGLES) {
+	      setBounds(&current, positions, indices);
+	      meshlets.push_back(current);
+	      current = {};
+	      current.indexOffset = (uint32_t)(t * 3);
+	      vertexCount = 0;
+	  }
+	  for(int k = 0; k < 3; k++) {
+	      unsigned int v = indices[t*3 + k];
+	      if(usedBy[v] != meshlets.size() + 1) {
+		  usedBy[v] = (uint32_t)meshlets.size() + 1;
+		  vertexCount++;
+	      }
+	  }
+	  current.indexCount += 3;
+      }
+      setBounds(&current, positions, indices);
+      meshlets.push_back(current);
+
+      if(meshlets.size() < MIN_MESHLETS)
+	  meshlets.clear();
+      return meshlets;
+  }
+
+  /// --- Culling ---
+
+  MeshletCuller::MeshletCuller(bool coneCulling) {
+      this->coneCulling = coneCulling;
+      setCamera(glm::mat4(1.0f), glm::mat4(1.0f));
+  }
+
+  void MeshletCuller::setCamera(glm::mat4 view, glm::mat4 proj) {
+      glm::mat4 vp = proj * view;
+      glm::vec4 row[4];
+      for(int i = 0; i < 4; i++)
+	  row[i] = glm::vec4(vp[0][i], vp[1][i], vp[2][i], vp[3][i]);
+      // the near plane is from -w to w, which also covers 0 to w projections
+      frustum[0] = row[3] + row[0];
+      frustum[1] = row[3] - row[0];
+      frustum[2] = row[3] + row[1];
+      frustum[3] = row[3] - row[1];
+      frustum[4] = row[3] + row[2];
+      frustum[5] = row[3] - row[2];
+      for(int i = 0; i < 6; i++) {
+	  float len = glm::length(glm::vec3(frustum[i]));
+	  if(len > 0)
+	      frustum[i] /= len;
+      }
+      cameraPos = glm::vec3(glm::inverse(view)[3]);
+  }
+
+  void MeshletCuller::cull(const std::vector<Meshlet> &meshlets,
+			   const void* modelMatrices, size_t stride, size_t instanceCount,
+			   bool mergeInstances) {
+      size_t meshletCount = meshlets.size();
+      flags.resize(meshletCount * instanceCount);
+      visible.resize(mergeInstances ? 1 : instanceCount);
+
+      auto buildRanges = [&meshlets](const uint8_t* meshletVisible,
+				     std::vector<std::pair<uint32_t, uint32_t>> &out) {
+	  out.clear();
+	  for(size_t m = 0; m < meshlets.size(); m++) {
+	      if(!meshletVisible[m])
+		  continue;
+	      const Meshlet &meshlet = meshlets[m];
+	      if(!out.empty() && out.back().first + out.back().second == meshlet.indexOffset)
+		  out.back().second += meshlet.indexCount;
+	      else
+		  out.push_back({meshlet.indexOffset, meshlet.indexCount});
+	  }
+      };
+
+      size_t jobs = (instanceCount + INSTANCES_PER_JOB - 1) / INSTANCES_PER_JOB;
+      auto cullJob = [&](size_t job) {
+	  size_t end = std::min(instanceCount, (job + 1) * INSTANCES_PER_JOB);
+	  for(size_t i = job * INSTANCES_PER_JOB; i < end; i++) {
+	      glm::mat4 model;
+	      std::memcpy(&model, (const char*)modelMatrices + i * stride, sizeof(glm::mat4));
+	      float scale = std::max(glm::length(glm::vec3(model[0])),
+				     std::max(glm::length(glm::vec3(model[1])),
+					      glm::length(glm::vec3(model[2]))));
+	      // facing doesn't change with the model transform,
+	      // so the cone test can be done in model space
+	      glm::vec3 modelCamera = glm::vec3(glm::inverse(model) * glm::vec4(cameraPos, 1.0f));
+	      uint8_t* instanceFlags = &flags[i * meshletCount];
+	      for(size_t m = 0; m < meshletCount; m++) {
+		  const Meshlet &meshlet = meshlets[m];
+		  bool inside = true;
+		  glm::vec3 centre = glm::vec3(model * glm::vec4(meshlet.centre, 1.0f));
+		  float radius = meshlet.radius * scale;
+		  for(int p = 0; p < 6 && inside; p++)
+		      inside = glm::dot(glm::vec3(frustum[p]), centre) + frustum[p].w > -radius;
+		  if(inside && coneCulling && meshlet.coneCutoff < 1.0f) {
+		      glm::vec3 toMeshlet = meshlet.centre - modelCamera;
+		      inside = glm::dot(toMeshlet, meshlet.coneAxis) <
+			  meshlet.coneCutoff * glm::length(toMeshlet) + meshlet.radius;
+		  }
+		  instanceFlags[m] = inside;
+	      }
+	      if(!mergeInstances)
+		  buildRanges(instanceFlags, visible[i]);
+	  }
+      };
+      if(meshletCount * instanceCount < MIN_PARALLEL_TESTS) {
+	  for(size_t job = 0; job < jobs; job++)
+	      cullJob(job);
+      } else {
+	  WorkerPool::get()->run(jobs, cullJob);
+      }
+
+      if(mergeInstances) {
+	  for(size_t i = 1; i < instanceCount; i++)
+	      for(size_t m = 0; m < meshletCount; m++)
+		  flags[m] |= flags[i * meshletCount + m];
+	  buildRanges(flags.data(), visible[0]);
+      }
+
+      uint64_t total = 0;
+      for(const Meshlet &meshlet: meshlets)
+	  total += meshlet.indexCount / 3;
+      total *= instanceCount;
+      uint64_t drawn = 0;
+      for(auto &instance: visible)
+	  for(auto &range: instance)
+	      drawn += range.second / 3;
+      if(mergeInstances)
+	  drawn *= instanceCount;
+      trianglesDrawn += drawn;
+      trianglesCulled += total - drawn;
+  }
+
+}
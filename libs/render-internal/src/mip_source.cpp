@@ -0,0 +1,63 @@
+#include <render-internal/resource-loaders/mip_source.h>
+
+#include <chrono>
+
+MipSource::MipSource(std::vector<size_t> mipSizes,
+		     std::function<void(uint32_t mip, unsigned char* dst)> read) {
+    this->mipSizes = mipSizes;
+    this->read = read;
+    levels.resize(mipSizes.size());
+    ready.resize(mipSizes.size(), false);
+    reads.resize(mipSizes.size());
+}
+
+MipSource::~MipSource() {
+    for(auto &r: reads)
+	if(r.valid())
+	    r.wait();
+}
+
+void MipSource::request(uint32_t mip) {
+    if(mip >= mipSizes.size() || ready[mip] || reads[mip].valid())
+	return;
+    levels[mip].resize(mipSizes[mip]);
+    unsigned char* dst = levels[mip].data();
+    reads[mip] = std::async(std::launch::async, [this, mip, dst] {
+	read(mip, dst);
+    });
+}
+
+const unsigned char* MipSource::get(uint32_t mip) {
+    if(mip >= mipSizes.size())
+	return nullptr;
+    if(!ready[mip]) {
+	request(mip);
+	if(reads[mip].wait_for(std::chrono::seconds(0)) != std::future_status::ready)
+	    return nullptr;
+	ready[mip] = true;
+	try {
+	    reads[mip].get();
+	} catch(...) {
+	    ready[mip] = false;
+	    std::vector<unsigned char>().swap(levels[mip]);
+	    throw;
+	}
+    }
+    return levels[mip].data();
+}
+
+const unsigned char* MipSource::wait(uint32_t mip) {
+    if(mip >= mipSizes.size())
+	return nullptr;
+    request(mip);
+    if(!ready[mip])
+	reads[mip].wait();
+    return get(mip);
+}
+
+void MipSource::release(uint32_t mip) {
+    if(mip >= mipSizes.size() || reads[mip].valid())
+	return;
+    ready[mip] = false;
+    std::vector<unsigned char>().swap(levels[mip]);
+}
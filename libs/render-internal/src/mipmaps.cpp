@@ -0,0 +1,124 @@
+#include <render-internal/resource-loaders/mipmaps.h>
+#include <render-internal/resource-loaders/compressed_texture.h>
+#include <render-internal/worker_pool.h>
+#include "binary_file.h"
+
+#include <cmath>
+#include <algorithm>
+
+namespace mipgen {
+
+  // rows of each level done by one job
+  const int ROWS_PER_JOB = 16;
+  const int LINEAR_TO_SRGB_STEPS = 4096;
+
+  struct GammaTables {
+      float toLinear[256];
+      unsigned char toSrgb[LINEAR_TO_SRGB_STEPS + 1];
+
+      GammaTables() {
+	  for(int i = 0; i < 256; i++) {
+	      float c = i / 255.0f;
+	      toLinear[i] = c <= 0.04045f ? c / 12.92f : std::pow((c + 0.055f) / 1.055f, 2.4f);
+	  }
+	  for(int i = 0; i <= LINEAR_TO_SRGB_STEPS; i++) {
+	      float c = (float)i / LINEAR_TO_SRGB_STEPS;
+	      c = c <= 0.0031308f ? c * 12.92f : 1.055f * std::pow(c, 1.0f / 2.4f) - 0.055f;
+	      toSrgb[i] = (unsigned char)std::min(255.0f, c * 255.0f + 0.5f);
+	  }
+      }
+  };
+
+  const GammaTables& gammaTables() {
+      static GammaTables tables;
+      return tables;
+  }
+
+  std::vector<size_t> levelSizes(int width, int height) {
+      std::vector<size_t> sizes;
+      while(true) {
+	  sizes.push_back((size_t)width * height * 4);
+	  if(width == 1 && height == 1)
+	      break;
+	  width = width > 1 ? width / 2 : 1;
+	  height = height > 1 ? height / 2 : 1;
+      }
+      return sizes;
+  }
+
+  // the four source texels of each destination texel, clamped at the edge for odd sizes
+  void downsampleRow(const unsigned char* src, int srcW, int srcH,
+		     unsigned char* dst, int dstW, int y,
+		     const GammaTables* gamma) {
+      const unsigned char* row0 = src + (size_t)std::min(y * 2, srcH - 1) * srcW * 4;
+      const unsigned char* row1 = src + (size_t)std::min(y * 2 + 1, srcH - 1) * srcW * 4;
+      unsigned char* out = dst + (size_t)y * dstW * 4;
+      for(int x = 0; x < dstW; x++) {
+	  size_t x0 = (size_t)std::min(x * 2, srcW - 1) * 4;
+	  size_t x1 = (size_t)std::min(x * 2 + 1, srcW - 1) * 4;
+	  if(gamma != nullptr) {
+	      for(int c = 0; c < 3; c++) {
+		  float sum = gamma->toLinear[row0[x0 + c]] + gamma->toLinear[row0[x1 + c]] +
+		      gamma->toLinear[row1[x0 + c]] + gamma->toLinear[row1[x1 + c]];
+		  out[x * 4 + c] = gamma->toSrgb[(int)(sum * (LINEAR_TO_SRGB_STEPS / 4.0f) + 0.5f)];
+	      }
+	  } else {
+	      for(int c = 0; c < 3; c++)
+		  out[x * 4 + c] = (unsigned char)(
+			  (row0[x0 + c] + row0[x1 + c] + row1[x0 + c] + row1[x1 + c] + 2) / 4);
+	  }
+	  out[x * 4 + 3] = (unsigned char)(
+		  (row0[x0 + 3] + row0[x1 + 3] + row1[x0 + 3] + row1[x1 + 3] + 2) / 4);
+      }
+  }
+
+  std::vector<unsigned char> generate(const unsigned char* rgba, int width, int height,
+				      bool gammaCorrect) {
+      std::vector<size_t> sizes = levelSizes(width, height);
+      size_t total = 0;
+      for(size_t i = 1; i < sizes.size(); i++)
+	  total += sizes[i];
+      std::vector<unsigned char> mips(total);
+      const GammaTables* gamma = gammaCorrect ? &gammaTables() : nullptr;
+      const unsigned char* src = rgba;
+      unsigned char* dst = mips.data();
+      // each level needs the last one finished, so only the rows of a level are split up
+      for(size_t level = 1; level < sizes.size(); level++) {
+	  int dstW = width > 1 ? width / 2 : 1;
+	  int dstH = height > 1 ? height / 2 : 1;
+	  size_t jobs = (dstH + ROWS_PER_JOB - 1) / ROWS_PER_JOB;
+	  WorkerPool::get()->run(jobs, [=](size_t job) {
+	      int end = std::min((int)(job + 1) * ROWS_PER_JOB, dstH);
+	      for(int y = (int)job * ROWS_PER_JOB; y < end; y++)
+		  downsampleRow(src, width, height, dst, dstW, y, gamma);
+	  });
+	  src = dst;
+	  dst += sizes[level];
+	  width = dstW;
+	  height = dstH;
+      }
+      return mips;
+  }
+
+  std::string cachePath(std::string texturePath) {
+      return texturePath + ".mips.ktx2";
+  }
+
+  bool writeCache(std::string path, int width, int height, bool srgb,
+		  const unsigned char* firstLevel, const unsigned char* otherLevels) {
+      std::vector<size_t> sizes = levelSizes(width, height);
+      std::vector<const unsigned char*> mips(sizes.size());
+      mips[0] = firstLevel;
+      const unsigned char* level = otherLevels;
+      for(size_t i = 1; i < sizes.size(); i++) {
+	  mips[i] = level;
+	  level += sizes[i];
+      }
+      // pools on other threads may be writing or reading the same cache
+      return binfile::writeFileAtomically(path, [&](std::ostream &out) {
+	  return compressedtex::writeKtx2(out, TextureFormat::RGBA8, srgb, width, height,
+					  mips, sizes);
+      });
+  }
+
+}
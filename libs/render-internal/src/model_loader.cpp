@@ -1,8 +1,16 @@
 #include <render-internal/resource-loaders/model_loader.h>
 
 #include <graphics/logger.h>
+#include <render-internal/resource-loaders/cooked_model.h>
+#include <render-internal/resource-loaders/asset_pack.h>
+#include <render-internal/resource-loaders/mesh_optimiser.h>
+#include <render-internal/resource-loaders/mesh_simplifier.h>
+#include <render-internal/worker_pool.h>
 #include "assimp_loader.h"
 #include <cstdlib>
+#include <cstring>
+#include <cmath>
+#include <algorithm>
 
 int modelGetTexID(Resource::Model model, Resource::Texture texture, BasePoolManager* pools) {
     Resource::Texture meshTex = model.overrideTexture.ID == Resource::NULL_ID ?
@@ -13,9 +21,15 @@ int modelGetTexID(Resource::Model model, Resource::Texture texture, BasePoolMana
 
 /// ------- Internal Model Loader --------
 
-InternalModelLoader::InternalModelLoader(Resource::Pool pool, BasePoolManager* pools) {
+InternalModelLoader::InternalModelLoader(Resource::Pool pool, BasePoolManager* pools,
+					 RenderConfig conf) {
     this->pool = pool;
     this->pools = pools;
+    this->cookModels = conf.cook_models;
+    this->optimiseMeshes = conf.optimise_meshes;
+    this->generateLods = conf.generate_lods;
+    this->lodScreenSize = conf.lod_screen_size;
+    this->meshletCulling = conf.meshlet_culling;
     loader = new AssimpLoader();
 }
 
@@ -28,10 +42,96 @@ void InternalModelLoader::clearStaged() {
     for(auto &s: staged)
 	delete s;
     staged.clear();
+    freeVertexData();
+}
+
+void* InternalModelLoader::allocateVertexData(size_t size) {
+    void* data = std::malloc(size);
+    vertexAllocations.push_back(data);
+    return data;
+}
+
+void InternalModelLoader::freeVertexData() {
+    for(void* data: vertexAllocations)
+	std::free(data);
+    vertexAllocations.clear();
 }
 
 ModelInfo::Model InternalModelLoader::loadModelData(std::string path) {
-    return loader->LoadModel(path);
+    return loadModelFile(loader, path);
+}
+
+std::vector<ModelInfo::Model> InternalModelLoader::loadModelDataBatch(
+	std::vector<std::string> paths) {
+    // only import each file once, this also stops two threads
+    // writing the same cooked file.
+    std::vector<std::string> unique;
+    std::map<std::string, size_t> uniqueIndex;
+    for(auto &path: paths)
+	if(uniqueIndex.find(path) == uniqueIndex.end()) {
+	    uniqueIndex[path] = unique.size();
+	    unique.push_back(path);
+	}
+
+    std::vector<ModelInfo::Model> models(unique.size());
+    WorkerPool::get()->run(unique.size(), [&](size_t i) {
+	// assimp importers can't be shared between threads
+	static thread_local AssimpLoader threadLoader;
+	models[i] = loadModelFile(&threadLoader, unique[i]);
+    });
+
+    if(unique.size() == paths.size())
+	return models;
+    std::vector<ModelInfo::Model> ordered(paths.size());
+    for(int i = 0; i < paths.size(); i++)
+	ordered[i] = models[uniqueIndex[paths[i]]];
+    return ordered;
+}
+
+void InternalModelLoader::prepareModelData(ModelInfo::Model &model) {
+    if(!optimiseMeshes && !generateLods)
+	return;
+    parallelFor(model.meshes.size(), [&model, this](size_t i) {
+	ModelInfo::Mesh &mesh = model.meshes[i];
+	if(optimiseMeshes)
+	    meshopt::optimiseMesh(mesh);
+	// cooked models and models from a tool can come with their lods
+	if(generateLods && mesh.lodIndices.empty())
+	    mesh.lodIndices = meshopt::generateLods(mesh, MAX_MODEL_LODS - 1);
+	if(optimiseMeshes)
+	    for(auto &lod: mesh.lodIndices)
+		meshopt::optimiseVertexCache(lod, mesh.verticies.size());
+    });
+}
+
+void InternalModelLoader::addLods(ModelInfo::Model &model) {
+    parallelFor(model.meshes.size(), [&model](size_t i) {
+	ModelInfo::Mesh &mesh = model.meshes[i];
+	if(mesh.lodIndices.empty())
+	    mesh.lodIndices = meshopt::generateLods(mesh, MAX_MODEL_LODS - 1);
+    });
+}
+
+void InternalModelLoader::parallelFor(size_t count, std::function<void(size_t)> job) {
+    WorkerPool::get()->run(count, job);
+}
+
+ModelInfo::Model InternalModelLoader::loadModelFile(AssimpLoader* loader, std::string path) {
+    if(!cookModels)
+	return loader->LoadModel(path);
+    std::string cooked = cookedmodel::cookedPath(path);
+    ModelInfo::Model model;
+    if(cookedmodel::upToDate(path, cooked) && cookedmodel::read(cooked, &model)) {
+	LOG("Model loaded from cooked file - path: " << cooked);
+	return model;
+    }
+    model = loader->LoadModel(path);
+    // simplifying is slow, so the lods are cooked with the model
+    if(generateLods)
+	addLods(model);
+    if(!cookedmodel::write(model, cooked))
+	LOG_ERROR("Failed to write cooked model - path: " << cooked);
+    return model;
 }
 
 ModelData::ModelData(ModelInfo::Model &model,
@@ -48,6 +148,31 @@ ModelData::ModelData(ModelInfo::Model &model,
     meshes.resize(model.meshes.size());
     for(int i = 0; i < model.meshes.size(); i++)
 	meshes[i] = new MeshData(model.meshes[i], meshVertData[i], texturePath, tex);
+
+    lodCount = 1;
+    indexSize = sizeof(uint16_t);
+    for(auto mesh: meshes) {
+	lodCount = std::max(lodCount, (unsigned int)mesh->lods.size());
+	if(mesh->vertexCount > MAX_SHORT_INDEX_VERTICES)
+	    indexSize = sizeof(uint32_t);
+    }
+
+    glm::vec3 minPos(0), maxPos(0);
+    bool first = true;
+    for(auto &mesh: model.meshes)
+	for(auto &v: mesh.verticies) {
+	    glm::vec3 p = mesh.bindTransform * glm::vec4(v.Position, 1.0f);
+	    minPos = first ? p : glm::min(minPos, p);
+	    maxPos = first ? p : glm::max(maxPos, p);
+	    first = false;
+	}
+    boundsCentre = (minPos + maxPos) * 0.5f;
+    boundsRadius = 0;
+    for(auto &mesh: model.meshes)
+	for(auto &v: mesh.verticies) {
+	    glm::vec3 p = mesh.bindTransform * glm::vec4(v.Position, 1.0f);
+	    boundsRadius = std::max(boundsRadius, glm::length(p - boundsCentre));
+	}
     
     for(ModelInfo::Animation &anim: model.animations) {
 	if(model.bones.size() >= Resource::MAX_BONES)
@@ -68,11 +193,18 @@ Resource::Model InternalModelLoader::loadData(
     if(textureFolder.size() > 0 && textureFolder[textureFolder.size() - 1] != '/')
 	textureFolder.push_back('/');
 	
-    Resource::Model usermodel(staged.size(), format, pool);
+    Resource::Model usermodel(stagedBaseID + staged.size(), format, pool);
     staged.push_back(new ModelData(model, format, meshVertData,
 				   //temp
 				   textureFolder,
 				   pools->tex(pool)));
+    // animated meshes move around, so the meshlet bounds would be wrong
+    if(meshletCulling && model.animations.empty()) {
+	ModelData* data = staged.back();
+	parallelFor(model.meshes.size(), [data, &model](size_t i) {
+	    data->meshes[i]->meshlets = meshopt::buildMeshlets(model.meshes[i]);
+	});
+    }
     if(pAnimations != nullptr)
 	*pAnimations = staged.back()->animations;       
     LOG("Model Loaded " <<
@@ -100,6 +232,169 @@ void InternalModelLoader::loadQuad() {
     this->quad = ModelLoader::load(vertex::v2D, quad, "", nullptr);
 }
 
+void InternalModelLoader::startGpuLoad(size_t gpuModelCount) {
+    if(gpuModelCount == 0) {
+	loadedSources.clear();
+	loadQuad();
+	gpuBaseID = stagedBaseID;
+    }
+    stagedBaseID += staged.size();
+    for(auto &model: staged)
+	loadedSources.push_back({ model->path, model->format, model->stage });
+}
+
+InternalModelLoader::GpuLoadState InternalModelLoader::gpuLoadState() {
+    return { loadedSources, gpuBaseID, quad };
+}
+
+void InternalModelLoader::failedGpuLoad(const GpuLoadState &state) {
+    loadedSources = state.loadedSources;
+    gpuBaseID = state.gpuBaseID;
+    quad = state.quad;
+    clearStaged();
+}
+
+void InternalModelLoader::loadedFromFile(Resource::Model model, std::string path,
+					 std::function<void(ModelInfo::Model&)> stage) {
+    size_t index = model.ID - stagedBaseID;
+    if(index >= staged.size())
+	return;
+    staged[index]->path = path;
+    staged[index]->stage = stage;
+}
+
+std::vector<std::string> InternalModelLoader::getLoadedPaths() {
+    std::vector<std::string> paths;
+    for(auto &source: loadedSources)
+	paths.push_back(source.path);
+    return paths;
+}
+
+std::vector<Resource::Model> InternalModelLoader::getModelsFrom(std::string path) {
+    std::vector<Resource::Model> models;
+    for(size_t i = 0; i < loadedSources.size(); i++)
+	if(loadedSources[i].path == path)
+	    models.push_back(Resource::Model(gpuBaseID + i, loadedSources[i].format, pool));
+    return models;
+}
+
+uint64_t InternalModelLoader::stagedMemory() {
+    uint64_t size = 0;
+    for(ModelData* data: staged)
+	for(MeshData* mesh: data->meshes)
+	    size += mesh->vertexCount * (uint64_t)data->format.size
+		+ mesh->indices.size() * sizeof(uint32_t)
+		+ mesh->meshlets.size() * sizeof(meshopt::Meshlet);
+    return size;
+}
+
+void InternalModelLoader::writePack(assetpack::Contents* pack, InternalTexLoader* texLoader) {
+    for(ModelData* data: staged) {
+	assetpack::Model model;
+	model.path = data->path;
+	model.format = data->format;
+	model.boundsCentre = data->boundsCentre;
+	model.boundsRadius = data->boundsRadius;
+	model.lodCount = data->lodCount;
+	for(MeshData* mesh: data->meshes) {
+	    assetpack::Mesh packed;
+	    const char* vertices = (const char*)mesh->vertices;
+	    packed.vertexData.assign(vertices, vertices + (size_t)data->format.size * mesh->vertexCount);
+	    packed.vertexCount = mesh->vertexCount;
+	    packed.indices = mesh->indices;
+	    packed.lods = mesh->lods;
+	    packed.meshlets = mesh->meshlets;
+	    packed.diffuseColour = mesh->diffuseColour;
+	    packed.texture = texLoader->stagedIndex(mesh->texture);
+	    if(packed.texture < 0 && mesh->texture.ID != Resource::NULL_ID)
+		LOG_ERROR("Mesh texture wasn't staged in the same pool, it won't be packed"
+			  " - pool: " << pool.ID);
+	    model.meshes.push_back(std::move(packed));
+	}
+	// staged animations are still in their bind pose
+	for(Resource::ModelAnimation &anim: data->animations)
+	    model.animations.push_back({ *anim.getCurrentBones(), anim.getAnimationInfo() });
+	pack->models.push_back(std::move(model));
+    }
+}
+
+std::vector<Resource::Model> InternalModelLoader::loadPack(
+	const assetpack::Contents &pack, const std::vector<Resource::Texture> &textures) {
+    std::vector<Resource::Model> models;
+    size_t vertexSize = 0;
+    for(auto &model: pack.models)
+	for(auto &mesh: model.meshes)
+	    vertexSize += (size_t)model.format.size * mesh.vertexCount;
+    if(pack.models.empty())
+	return models;
+    char* vertices = (char*)allocateVertexData(vertexSize);
+    for(auto &model: pack.models) {
+	ModelData* data = new ModelData();
+	data->format = model.format;
+	data->boundsCentre = model.boundsCentre;
+	data->boundsRadius = model.boundsRadius;
+	data->lodCount = model.lodCount;
+	data->indexSize = sizeof(uint16_t);
+	data->path = model.path;
+	for(auto &mesh: model.meshes) {
+	    MeshData* m = new MeshData();
+	    size_t size = (size_t)model.format.size * mesh.vertexCount;
+	    std::memcpy(vertices, mesh.vertices, size);
+	    m->vertices = vertices;
+	    vertices += size;
+	    m->vertexCount = mesh.vertexCount;
+	    m->indices = mesh.indices;
+	    m->lods = mesh.lods;
+	    m->meshlets = mesh.meshlets;
+	    m->diffuseColour = mesh.diffuseColour;
+	    if(mesh.texture >= 0)
+		m->texture = textures[mesh.texture];
+	    if(m->vertexCount > MAX_SHORT_INDEX_VERTICES)
+		data->indexSize = sizeof(uint32_t);
+	    data->meshes.push_back(m);
+	}
+	for(auto &anim: model.animations)
+	    data->animations.push_back(Resource::ModelAnimation(anim.bones, anim.animation));
+	models.push_back(Resource::Model(stagedBaseID + staged.size(), model.format, pool));
+	staged.push_back(data);
+	LOG("Model Loaded from pack"
+	    " - pool: " << pool.ID <<
+	    " - id: " << models.back().ID <<
+	    " - path: " << model.path);
+    }
+    return models;
+}
+
+bool InternalModelLoader::beginReload(Resource::Model model) {
+    size_t index = gpuIndex(model);
+    if(index >= loadedSources.size() || !loadedSources[index].stage)
+	return false;
+    LOG("Model Reload"
+	" - pool: " << pool.ID <<
+	" - id: " << model.ID <<
+	" - path: " << loadedSources[index].path);
+    ModelInfo::Model data = loadModelData(loadedSources[index].path);
+    // the meshes keep the textures they have, rather than staging them again
+    for(auto &mesh: data.meshes)
+	mesh.diffuseTextures.clear();
+    setAside.swap(staged);
+    try {
+	loadedSources[index].stage(data);
+    } catch(std::exception &e) {
+	endReload();
+	throw;
+    }
+    return true;
+}
+
+void InternalModelLoader::endReload() {
+    // the vertices stay allocated with the set aside models' until they are cleared
+    for(auto &s: staged)
+	delete s;
+    staged.clear();
+    staged.swap(setAside);
+}
+
 
 /// ------- Model and Mesh Staging Data -------
 
@@ -115,7 +410,16 @@ MeshData::MeshData(ModelInfo::Mesh &mesh,
 		   TextureLoader* tex) {
     this->vertices = vertexData;
     this->vertexCount = mesh.verticies.size();
-    this->indices = mesh.indices;
+    size_t lodCount = std::min(mesh.lodIndices.size() + 1, (size_t)MAX_MODEL_LODS);
+    size_t indexCount = mesh.indices.size();
+    for(size_t i = 1; i < lodCount; i++)
+	indexCount += mesh.lodIndices[i - 1].size();
+    this->indices.reserve(indexCount);
+    for(size_t i = 0; i < lodCount; i++) {
+	std::vector<unsigned int> &lod = i == 0 ? mesh.indices : mesh.lodIndices[i - 1];
+	lods.push_back({(uint32_t)indices.size(), (uint32_t)lod.size()});
+	indices.insert(indices.end(), lod.begin(), lod.end());
+    }
 
     //TODO: remove after pipeline update
     this->diffuseColour = mesh.diffuseColour;
@@ -123,8 +427,14 @@ MeshData::MeshData(ModelInfo::Mesh &mesh,
 	this->texture = tex->load(texturePath + mesh.diffuseTextures[0]);
 }
 
-MeshData::~MeshData() {
-    std::free(vertices);
+void MeshData::copyIndices(void* dst, uint32_t indexSize) {
+    if(indexSize == sizeof(uint32_t)) {
+	std::memcpy(dst, indices.data(), sizeof(uint32_t) * indices.size());
+	return;
+    }
+    uint16_t* shortIndices = (uint16_t*)dst;
+    for(size_t i = 0; i < indices.size(); i++)
+	shortIndices[i] = (uint16_t)indices[i];
 }
 
 
@@ -134,10 +444,15 @@ MeshData::~MeshData() {
 GPUMesh::GPUMesh(MeshData* mesh) {
     diffuseColour = mesh->diffuseColour;
     texture = mesh->texture;
+    lods = mesh->lods;
+    meshlets = mesh->meshlets;
 }
 
 GPUModel::GPUModel(ModelData* model) {
     vertType = model->format;
+    boundsCentre = model->boundsCentre;
+    boundsRadius = model->boundsRadius;
+    lodCount = model->lodCount;
     animations.resize(model->animations.size());
     for (int i = 0; i < model->animations.size(); i++) {
 	animations[i] = model->animations[i];
@@ -163,3 +478,31 @@ Resource::ModelAnimation GPUModel::getAnimation(std::string animation) {
     }        
     return getAnimation(animationMap[animation]);  
 }    
+
+unsigned int GPUModel::selectLod(glm::mat4 modelView, glm::mat4 proj, float lodScreenSize) {
+    if(lodCount < 2)
+	return 0;
+    glm::vec4 centre = modelView * glm::vec4(boundsCentre, 1.0f);
+    float scale = std::max(glm::length(glm::vec3(modelView[0])),
+			   std::max(glm::length(glm::vec3(modelView[1])),
+				    glm::length(glm::vec3(modelView[2]))));
+    float radius = boundsRadius * scale;
+    // height of the sphere in normalised device coords, where the screen is 2 high
+    float ndcHeight;
+    if(proj[2][3] == 0.0f) { // orthographic
+	ndcHeight = 2.0f * radius * std::abs(proj[1][1]);
+    } else {
+	// w is the distance in front of the camera
+	float w = (proj * centre).w;
+	if(w <= radius)
+	    return 0;
+	ndcHeight = 2.0f * radius * std::abs(proj[1][1]) / w;
+    }
+    float size = ndcHeight / 2.0f;
+    unsigned int lod = 0;
+    while(lod + 1 < lodCount && size < lodScreenSize) {
+	lod++;
+	lodScreenSize *= 0.5f;
+    }
+    return lod;
+}
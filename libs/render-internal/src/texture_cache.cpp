@@ -0,0 +1,253 @@
+#include <render-internal/resource-loaders/texture_cache.h>
+
+#include "mapped_file.h"
+#include "file_time.h"
+#include "stb_image.h"
+#include <graphics/logger.h>
+#include <sys/stat.h>
+#include <stdexcept>
+#include <cstring>
+#include <cstdlib>
+
+TextureCache::~TextureCache() {
+    for(auto &e: entries) {
+	if(e.second->data != nullptr)
+	    freeData(e.second, e.second->data);
+	delete e.second;
+    }
+}
+
+TextureCache::Entry* TextureCache::acquire(std::string path, int desiredChannels) {
+    struct stat st;
+    if(stat(path.c_str(), &st) != 0) {
+	LOG_ERROR("Failed to load texture - path: " << path);
+	throw std::runtime_error("texture file not found");
+    }
+    // the size and modified time are part of the key so a file changed on disk gets loaded again
+    std::string key = path + "#" + std::to_string((uint64_t)st.st_size)
+	+ "#" + std::to_string(fileModifiedTime(path, st));
+    {
+	std::lock_guard<std::mutex> lock(mut);
+	auto found = entries.find(key);
+	if(found != entries.end()) {
+	    found->second->refs++;
+	    return found->second;
+	}
+    }
+    // only new entries need the header
+    std::shared_ptr<MappedFile> file = std::make_shared<MappedFile>(path);
+    if(!file->valid()) {
+	LOG_ERROR("Failed to load texture - path: " << path);
+	throw std::runtime_error("texture file not found");
+    }
+    Entry* entry = new Entry();
+    if(compressedtex::isCompressedFile(file->data(), file->size())) {
+	compressedtex::Info info;
+	if(!compressedtex::readHeader(file->data(), file->size(), &info)) {
+	    delete entry;
+	    LOG_ERROR("Unsupported compressed texture - path: " << path);
+	    throw std::runtime_error("texture file could not be decoded");
+	}
+	entry->width = info.width;
+	entry->height = info.height;
+	entry->nrChannels = 4;
+	entry->compressedFile = true;
+	entry->format = info.format;
+	entry->mipSizes = info.mipSizes;
+	entry->srgb = info.srgb;
+	entry->hasColourSpace = info.hasColourSpace;
+    } else {
+	int width, height, nrChannels;
+	if(!stbi_info_from_memory((const stbi_uc*)file->data(), (int)file->size(),
+				  &width, &height, &nrChannels)) {
+	    delete entry;
+	    LOG_ERROR("Failed to load texture - path: " << path);
+	    throw std::runtime_error("texture file could not be decoded");
+	}
+	entry->width = width;
+	entry->height = height;
+	entry->nrChannels = desiredChannels;
+	entry->mipSizes = { (size_t)width * height * desiredChannels };
+    }
+    entry->path = path;
+    entry->key = key;
+    entry->file = file;
+    entry->refs = 1;
+    std::lock_guard<std::mutex> lock(mut);
+    auto found = entries.find(key);
+    if(found != entries.end()) {
+	// another thread made it while the header was read
+	delete entry;
+	found->second->refs++;
+	return found->second;
+    }
+    entries[key] = entry;
+    return entry;
+}
+
+void TextureCache::release(Entry* entry) {
+    std::lock_guard<std::mutex> lock(mut);
+    if(--entry->refs == 0) {
+	if(entry->data != nullptr)
+	    freeData(entry, entry->data);
+	entry->data = nullptr;
+	entry->file.reset();
+	freeIfUnused(entry);
+    }
+}
+
+unsigned char* TextureCache::decode(Entry* entry) {
+    {
+	std::lock_guard<std::mutex> lock(mut);
+	if(entry->data != nullptr)
+	    return entry->data;
+    }
+    unsigned char* data = decodeFile(entry);
+    std::lock_guard<std::mutex> lock(mut);
+    if(entry->data == nullptr)
+	entry->data = data;
+    else // decoded by another thread at the same time
+	freeData(entry, data);
+    entry->file.reset();
+    return entry->data;
+}
+
+void TextureCache::decodeTo(Entry* entry, void* dst, size_t firstMip) {
+    copyLevels(entry, firstMip, entry->mipSizes.size(), (unsigned char*)dst);
+}
+
+void TextureCache::readLevel(Entry* entry, size_t mip, void* dst) {
+    copyLevels(entry, mip, mip + 1, (unsigned char*)dst);
+}
+
+TextureCache::Entry* TextureCache::share(Entry* entry) {
+    std::lock_guard<std::mutex> lock(mut);
+    entry->refs++;
+    return entry;
+}
+
+void TextureCache::copyLevels(Entry* entry, size_t first, size_t last, unsigned char* dst) {
+    size_t offset = 0, size = 0;
+    for(size_t mip = 0; mip < last && mip < entry->mipSizes.size(); mip++) {
+	if(mip < first)
+	    offset += entry->mipSizes[mip];
+	else
+	    size += entry->mipSizes[mip];
+    }
+    {
+	std::lock_guard<std::mutex> lock(mut);
+	if(entry->data != nullptr) {
+	    std::memcpy(dst, entry->data + offset, size);
+	    return;
+	}
+    }
+    if(entry->compressedFile) {
+	// straight from the file, so only the levels asked for are read
+	compressedtex::Info info;
+	std::shared_ptr<MappedFile> file = mapCompressed(entry, &info);
+	for(size_t mip = first; mip < last && mip < info.mipSizes.size(); mip++) {
+	    std::memcpy(dst, file->data() + info.mipOffsets[mip], info.mipSizes[mip]);
+	    dst += info.mipSizes[mip];
+	}
+	return;
+    }
+    // stb allocates its own output, so this is only held for the one image
+    unsigned char* data = decodeFile(entry);
+    std::memcpy(dst, data + offset, size);
+    freeData(entry, data);
+}
+
+std::shared_ptr<MappedFile> TextureCache::mapCompressed(Entry* entry, compressedtex::Info* info) {
+    std::shared_ptr<MappedFile> file;
+    {
+	std::lock_guard<std::mutex> lock(mut);
+	file = entry->file;
+    }
+    if(file == nullptr)
+	file = std::make_shared<MappedFile>(entry->path);
+    if(!file->valid() || !compressedtex::readHeader(file->data(), file->size(), info) ||
+       info->width != entry->width || info->height != entry->height ||
+       info->format != entry->format || info->mipSizes != entry->mipSizes) {
+	LOG_ERROR("Failed to read compressed texture, "
+		  "it may have changed since it was loaded - path: " << entry->path);
+	throw std::runtime_error("texture file could not be decoded");
+    }
+    return file;
+}
+
+unsigned char* TextureCache::decodeFile(Entry* entry) {
+    if(entry->compressedFile) {
+	// compressed mips are used as they are, just gathered in order
+	size_t size = 0;
+	for(size_t mip: entry->mipSizes)
+	    size += mip;
+	unsigned char* data = (unsigned char*)std::malloc(size);
+	try {
+	    copyLevels(entry, 0, entry->mipSizes.size(), data);
+	} catch(std::exception &e) {
+	    std::free(data);
+	    throw;
+	}
+	return data;
+    }
+    std::shared_ptr<MappedFile> mapped;
+    {
+	std::lock_guard<std::mutex> lock(mut);
+	mapped = entry->file;
+    }
+    if(mapped == nullptr)
+	mapped = std::make_shared<MappedFile>(entry->path);
+    MappedFile &file = *mapped;
+    int width = 0, height = 0, nrChannels;
+    unsigned char* data = nullptr;
+    if(file.valid())
+	data = stbi_load_from_memory((const stbi_uc*)file.data(), (int)file.size(),
+				     &width, &height, &nrChannels, entry->nrChannels);
+    if(data != nullptr && (width != entry->width || height != entry->height)) {
+	stbi_image_free(data);
+	data = nullptr;
+    }
+    if(data == nullptr) {
+	LOG_ERROR("Failed to decode texture, "
+		  "it may have changed since it was loaded - path: " << entry->path);
+	throw std::runtime_error("texture file could not be decoded");
+    }
+    return data;
+}
+
+void TextureCache::freeData(Entry* entry, unsigned char* data) {
+    if(entry->compressedFile)
+	std::free(data);
+    else
+	stbi_image_free(data);
+}
+
+bool TextureCache::acquireGpu(Entry* entry) {
+    std::lock_guard<std::mutex> lock(mut);
+    if(entry->gpuRefs == 0)
+	return false;
+    entry->gpuRefs++;
+    return true;
+}
+
+void TextureCache::setGpu(Entry* entry, unsigned int gpuTexture) {
+    std::lock_guard<std::mutex> lock(mut);
+    entry->gpuTexture = gpuTexture;
+    entry->gpuRefs = 1;
+}
+
+bool TextureCache::releaseGpu(Entry* entry) {
+    std::lock_guard<std::mutex> lock(mut);
+    if(--entry->gpuRefs > 0)
+	return false;
+    entry->gpuTexture = 0;
+    freeIfUnused(entry);
+    return true;
+}
+
+void TextureCache::freeIfUnused(Entry* entry) {
+    if(entry->refs > 0 || entry->gpuRefs > 0)
+	return;
+    entries.erase(entry->key);
+    delete entry;
+}
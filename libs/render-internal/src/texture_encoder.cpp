@@ -0,0 +1,221 @@
+#include <render-internal/resource-loaders/compressed_texture.h>
+
+#include <stdexcept>
+#include <cstring>
+#include <cstdint>
+#include <cmath>
+#include <algorithm>
+
+// A simple BCn encoder for baking textures offline.
+// Picks the endpoints from the extremes of each block along its main axis,
+// which is fast and good enough for most colour and normal maps.
+
+namespace compressedtex {
+
+  struct Block {
+      unsigned char px[16][4];
+  };
+
+  // texels past the edge of the image use the nearest edge texel
+  Block readBlock(const unsigned char* rgba, int width, int height, int bx, int by) {
+      Block b;
+      for(int y = 0; y < 4; y++) {
+	  int sy = std::min(by * 4 + y, height - 1);
+	  for(int x = 0; x < 4; x++) {
+	      int sx = std::min(bx * 4 + x, width - 1);
+	      std::memcpy(b.px[y * 4 + x], rgba + ((size_t)sy * width + sx) * 4, 4);
+	  }
+      }
+      return b;
+  }
+
+  uint16_t to565(const float* c) {
+      int r = (int)std::round(std::min(std::max(c[0], 0.0f), 255.0f) * 31.0f / 255.0f);
+      int g = (int)std::round(std::min(std::max(c[1], 0.0f), 255.0f) * 63.0f / 255.0f);
+      int b = (int)std::round(std::min(std::max(c[2], 0.0f), 255.0f) * 31.0f / 255.0f);
+      return (uint16_t)((r << 11) | (g << 5) | b);
+  }
+
+  void from565(uint16_t c, int* out) {
+      int r = (c >> 11) & 31, g = (c >> 5) & 63, b = c & 31;
+      out[0] = (r << 3) | (r >> 2);
+      out[1] = (g << 2) | (g >> 4);
+      out[2] = (b << 3) | (b >> 2);
+  }
+
+  // alwaysFourColour for bc3, where the colour block can't use the 3 colour + transparent mode
+  void encodeColourBlock(const Block &b, bool alwaysFourColour, unsigned char* out) {
+      bool transparent = false;
+      float mean[3] = {0, 0, 0};
+      int opaqueCount = 0;
+      for(int i = 0; i < 16; i++) {
+	  if(!alwaysFourColour && b.px[i][3] < 128) {
+	      transparent = true;
+	      continue;
+	  }
+	  for(int c = 0; c < 3; c++)
+	      mean[c] += b.px[i][c];
+	  opaqueCount++;
+      }
+      uint16_t c0 = 0, c1 = 0;
+      if(opaqueCount > 0) {
+	  for(int c = 0; c < 3; c++)
+	      mean[c] /= opaqueCount;
+	  // main axis of the colours, from a few power iterations on the covariance
+	  float cov[6] = {0, 0, 0, 0, 0, 0};
+	  for(int i = 0; i < 16; i++) {
+	      if(!alwaysFourColour && b.px[i][3] < 128)
+		  continue;
+	      float d[3] = { b.px[i][0] - mean[0], b.px[i][1] - mean[1], b.px[i][2] - mean[2] };
+	      cov[0] += d[0] * d[0]; cov[1] += d[0] * d[1]; cov[2] += d[0] * d[2];
+	      cov[3] += d[1] * d[1]; cov[4] += d[1] * d[2]; cov[5] += d[2] * d[2];
+	  }
+	  float axis[3] = {1, 1, 1};
+	  for(int iter = 0; iter < 4; iter++) {
+	      float n[3] = {
+		  cov[0] * axis[0] + cov[1] * axis[1] + cov[2] * axis[2],
+		  cov[1] * axis[0] + cov[3] * axis[1] + cov[4] * axis[2],
+		  cov[2] * axis[0] + cov[4] * axis[1] + cov[5] * axis[2] };
+	      float len = std::max(std::max(std::abs(n[0]), std::abs(n[1])), std::abs(n[2]));
+	      if(len == 0)
+		  break;
+	      for(int c = 0; c < 3; c++)
+		  axis[c] = n[c] / len;
+	  }
+	  float minT = 0, maxT = 0;
+	  bool first = true;
+	  for(int i = 0; i < 16; i++) {
+	      if(!alwaysFourColour && b.px[i][3] < 128)
+		  continue;
+	      float t = 0;
+	      for(int c = 0; c < 3; c++)
+		  t += (b.px[i][c] - mean[c]) * axis[c];
+	      minT = first ? t : std::min(minT, t);
+	      maxT = first ? t : std::max(maxT, t);
+	      first = false;
+	  }
+	  float axisLenSq = axis[0] * axis[0] + axis[1] * axis[1] + axis[2] * axis[2];
+	  if(axisLenSq > 0) {
+	      minT /= axisLenSq;
+	      maxT /= axisLenSq;
+	  }
+	  float lo[3], hi[3];
+	  for(int c = 0; c < 3; c++) {
+	      lo[c] = mean[c] + axis[c] * minT;
+	      hi[c] = mean[c] + axis[c] * maxT;
+	  }
+	  c0 = to565(hi);
+	  c1 = to565(lo);
+      }
+      // c0 > c1 selects four colours, c0 <= c1 three colours and transparent black
+      if(transparent ? c0 > c1 : c0 < c1)
+	  std::swap(c0, c1);
+      bool fourColour = c0 > c1;
+      int palette[4][3];
+      from565(c0, palette[0]);
+      from565(c1, palette[1]);
+      for(int c = 0; c < 3; c++) {
+	  if(fourColour) {
+	      palette[2][c] = (2 * palette[0][c] + palette[1][c]) / 3;
+	      palette[3][c] = (palette[0][c] + 2 * palette[1][c]) / 3;
+	  } else {
+	      palette[2][c] = (palette[0][c] + palette[1][c]) / 2;
+	      palette[3][c] = 0;
+	  }
+      }
+      uint32_t indices = 0;
+      for(int i = 0; i < 16; i++) {
+	  int best = 0;
+	  if(transparent && b.px[i][3] < 128) {
+	      best = 3;
+	  } else {
+	      int bestDist = INT32_MAX;
+	      for(int p = 0; p < (fourColour ? 4 : 3); p++) {
+		  int dist = 0;
+		  for(int c = 0; c < 3; c++) {
+		      int d = b.px[i][c] - palette[p][c];
+		      dist += d * d;
+		  }
+		  if(dist < bestDist) {
+		      bestDist = dist;
+		      best = p;
+		  }
+	      }
+	  }
+	  indices |= (uint32_t)best << (i * 2);
+      }
+      std::memcpy(out, &c0, 2);
+      std::memcpy(out + 2, &c1, 2);
+      std::memcpy(out + 4, &indices, 4);
+  }
+
+  void encodeChannelBlock(const Block &b, int channel, unsigned char* out) {
+      int lo = 255, hi = 0;
+      for(int i = 0; i < 16; i++) {
+	  lo = std::min(lo, (int)b.px[i][channel]);
+	  hi = std::max(hi, (int)b.px[i][channel]);
+      }
+      // hi > lo gives 8 interpolated values
+      int palette[8];
+      palette[0] = hi;
+      palette[1] = lo;
+      for(int p = 1; p < 7; p++)
+	  palette[p + 1] = ((7 - p) * hi + p * lo) / 7;
+      uint64_t indices = 0;
+      for(int i = 0; i < 16; i++) {
+	  int best = 0, bestDist = 256;
+	  for(int p = 0; p < 8; p++) {
+	      int dist = std::abs(b.px[i][channel] - palette[p]);
+	      if(dist < bestDist) {
+		  bestDist = dist;
+		  best = p;
+	      }
+	  }
+	  indices |= (uint64_t)best << (i * 3);
+      }
+      out[0] = (unsigned char)hi;
+      out[1] = (unsigned char)lo;
+      for(int i = 0; i < 6; i++)
+	  out[2 + i] = (unsigned char)(indices >> (i * 8));
+  }
+
+  std::vector<unsigned char> encode(TextureFormat format,
+				    const unsigned char* rgba, int width, int height) {
+      if(format == TextureFormat::RGBA8)
+	  return std::vector<unsigned char>(rgba, rgba + (size_t)width * height * 4);
+      if(format == TextureFormat::BC7)
+	  throw std::runtime_error("BC7 textures can be loaded but not encoded");
+      std::vector<unsigned char> out(mipSize(format, width, height));
+      int blocksX = (width + 3) / 4, blocksY = (height + 3) / 4;
+      unsigned char* dst = out.data();
+      for(int by = 0; by < blocksY; by++) {
+	  for(int bx = 0; bx < blocksX; bx++) {
+	      Block b = readBlock(rgba, width, height, bx, by);
+	      switch(format) {
+	      case TextureFormat::BC1:
+		  encodeColourBlock(b, false, dst);
+		  dst += 8;
+		  break;
+	      case TextureFormat::BC3:
+		  encodeChannelBlock(b, 3, dst);
+		  encodeColourBlock(b, true, dst + 8);
+		  dst += 16;
+		  break;
+	      case TextureFormat::BC4:
+		  encodeChannelBlock(b, 0, dst);
+		  dst += 8;
+		  break;
+	      case TextureFormat::BC5:
+		  encodeChannelBlock(b, 0, dst);
+		  encodeChannelBlock(b, 1, dst + 8);
+		  dst += 16;
+		  break;
+	      default:
+		  break;
+	      }
+	  }
+      }
+      return out;
+  }
+
+}
@@ -1,14 +1,32 @@
 #include <render-internal/resource-loaders/texture_loader.h>
-#include "stb_image.h"
+#include <render-internal/resource-loaders/cooked_model.h>
+#include <render-internal/resource-loaders/asset_pack.h>
+#include <render-internal/resource-loaders/mipmaps.h>
+#include <render-internal/worker_pool.h>
 #include <graphics/logger.h>
 
 #include <stdexcept>
+#include <cstring>
+#include <algorithm>
 
-InternalTexLoader::InternalTexLoader(Resource::Pool pool, RenderConfig conf) {
+// pages are small enough that a mostly empty last one isn't a big waste
+const int ATLAS_PAGE_SIZE = 1024;
+const int ATLAS_MAX_SPRITE_SIZE = 256;
+// edge texels are repeated around each sprite so filtering doesn't bleed between them
+const int ATLAS_PADDING = 2;
+// when streaming, mips this size and smaller are loaded with the pool
+const int STREAM_RESIDENT_SIZE = 64;
+
+InternalTexLoader::InternalTexLoader(Resource::Pool pool, RenderConfig conf,
+				     TextureCache* cache) {
     this->pool = pool;
+    this->cache = cache;
     this->srgb = conf.srgb;
     this->mipmapping = conf.mip_mapping;
     this->filterNearest = conf.texture_filter_nearest;
+    this->useCompressed = conf.use_compressed_textures;
+    this->cacheMips = conf.cache_mip_maps;
+    this->streamTextures = conf.stream_textures && conf.mip_mapping;
 }
 
 InternalTexLoader::~InternalTexLoader() {
@@ -16,23 +34,63 @@ InternalTexLoader::~InternalTexLoader() {
 }
 
 Resource::Texture InternalTexLoader::load(std::string path) {
-    for(int i = 0; i < staged.size(); i++)
-	if(staged[i]->pathedTex && staged[i]->path == path) {
-	    return Resource::Texture(
-		    i, glm::vec2(staged[i]->width, staged[i]->height), pool);
-	}
+    auto found = stagedPaths.find(path);
+    if(found != stagedPaths.end()) {
+	StagedTex* tex = staged[found->second];
+	return Resource::Texture(
+		stagedBaseID + found->second, glm::vec2(tex->width, tex->height), pool);
+    }
+    StagedTex* tex = stageFile(path);
+    stagedPaths[path] = (unsigned int)staged.size();
+    return addStagedTexture(tex);
+}
+
+StagedTex* InternalTexLoader::stageFile(std::string path) {
     StagedTex* tex = new StagedTex();
     tex->path = path;
     tex->pathedTex = true;
-    tex->data = stbi_load(tex->path.c_str(), &tex->width, &tex->height,
-			 &tex->nrChannels, desiredChannels);
-    if(!tex->data) {
-	LOG_ERROR("Failed to load texture - path: " << path);
-	throw std::runtime_error("texture file not found");
+    tex->cache = cache;
+    std::string filePath = path;
+    if(useCompressed) {
+	std::string compressed = compressedtex::compressedPath(path);
+	if(cookedmodel::upToDate(path, compressed))
+	    filePath = compressed;
     }
-    tex->nrChannels = desiredChannels;
-    tex->filesize = tex->width * tex->height * tex->nrChannels;
-    return addStagedTexture(tex);
+    if(mipmapping && cacheMips && filePath == path) {
+	std::string mips = mipgen::cachePath(path);
+	if(cookedmodel::upToDate(path, mips))
+	    filePath = mips;
+    }
+    bool mipCache = filePath != path && filePath == mipgen::cachePath(path);
+    try {
+	tex->cacheEntry = cache->acquire(filePath, desiredChannels);
+	// the cached mips were averaged for the other colour space, so make them again
+	if(mipCache && tex->cacheEntry->srgb != srgb) {
+	    cache->release(tex->cacheEntry);
+	    tex->cacheEntry = nullptr;
+	    mipCache = false;
+	    tex->cacheEntry = cache->acquire(path, desiredChannels);
+	}
+    } catch(std::exception &e) {
+	delete tex;
+	throw;
+    }
+    tex->width = tex->cacheEntry->width;
+    tex->height = tex->cacheEntry->height;
+    tex->nrChannels = tex->cacheEntry->nrChannels;
+    tex->format = tex->cacheEntry->format;
+    tex->mipSizes = tex->cacheEntry->mipSizes;
+    // mip caches are made from files without a colour space, so use the config's too
+    bool fileColourSpace = tex->cacheEntry->hasColourSpace && !mipCache;
+    tex->srgb = fileColourSpace ? tex->cacheEntry->srgb : srgb;
+    if(mipmapping && tex->format == TextureFormat::RGBA8 && tex->mipSizes.size() == 1) {
+	tex->generateMips = true;
+	tex->mipSizes = mipgen::levelSizes(tex->width, tex->height);
+    }
+    tex->filesize = 0;
+    for(size_t mip: tex->mipSizes)
+	tex->filesize += (int)mip;
+    return tex;
 }
 
 Resource::Texture InternalTexLoader::load(
@@ -42,35 +100,401 @@ Resource::Texture InternalTexLoader::load(
     tex->width = width;
     tex->height = height;
     tex->pathedTex = false;
+    tex->srgb = srgb;
     if(nrChannels != desiredChannels) {
 	//TODO: CORRECT CHANNLES INSTEAD OF THROW
 	throw std::runtime_error("only four channels supported");
     }
     tex->nrChannels = desiredChannels;
     tex->filesize = tex->width * tex->height * tex->nrChannels;
+    tex->mipSizes = { (size_t)tex->filesize };
+    if(mipmapping) {
+	tex->generateMips = true;
+	tex->mipSizes = mipgen::levelSizes(tex->width, tex->height);
+	tex->filesize = 0;
+	for(size_t mip: tex->mipSizes)
+	    tex->filesize += (int)mip;
+    }
     return addStagedTexture(tex);
 }
 
+Resource::Texture InternalTexLoader::loadToAtlas(std::string path) {
+    auto found = atlasPaths.find(path);
+    if(found != atlasPaths.end())
+	return found->second;
+    TextureCache::Entry* entry = cache->acquire(path, desiredChannels);
+    if(entry->format != TextureFormat::RGBA8 ||
+       entry->width > ATLAS_MAX_SPRITE_SIZE || entry->height > ATLAS_MAX_SPRITE_SIZE) {
+	cache->release(entry);
+	Resource::Texture texture = load(path);
+	atlasPaths[path] = texture;
+	return texture;
+    }
+    AtlasSprite sprite;
+    sprite.tex = new StagedTex();
+    sprite.tex->path = path;
+    sprite.tex->pathedTex = true;
+    sprite.tex->cache = cache;
+    sprite.tex->cacheEntry = entry;
+    sprite.tex->width = entry->width;
+    sprite.tex->height = entry->height;
+    sprite.tex->nrChannels = entry->nrChannels;
+    int paddedW = entry->width + ATLAS_PADDING * 2;
+    int paddedH = entry->height + ATLAS_PADDING * 2;
+    size_t page = 0;
+    for(; page < atlasPages.size(); page++)
+	if(atlasPages[page].packer.add(paddedW, paddedH, &sprite.x, &sprite.y))
+	    break;
+    if(page == atlasPages.size()) {
+	// pixels are drawn in when the pool is loaded
+	unsigned char* data = new unsigned char[ATLAS_PAGE_SIZE * ATLAS_PAGE_SIZE * 4];
+	Resource::Texture pageTex = load(data, ATLAS_PAGE_SIZE, ATLAS_PAGE_SIZE, 4);
+	staged.back()->path = "atlas page " + std::to_string(page);
+	atlasPages.push_back({ (unsigned int)(pageTex.ID - stagedBaseID),
+			       AtlasPacker(ATLAS_PAGE_SIZE, ATLAS_PAGE_SIZE) });
+	atlasPages.back().packer.add(paddedW, paddedH, &sprite.x, &sprite.y);
+    }
+    sprite.x += ATLAS_PADDING;
+    sprite.y += ATLAS_PADDING;
+    sprite.page = atlasPages[page].id;
+    atlasSprites.push_back(sprite);
+    Resource::Texture texture(stagedBaseID + sprite.page,
+			      glm::vec2(entry->width, entry->height), pool);
+    texture.atlasRect = glm::vec4(sprite.x, sprite.y, entry->width, entry->height)
+	/ (float)ATLAS_PAGE_SIZE;
+    atlasPaths[path] = texture;
+    LOG("Texture Atlas Load"
+	" - pool: " << pool.ID <<
+	" - page: " << page <<
+	" - path: " << path);
+    return texture;
+}
+
+void InternalTexLoader::loadGPU() {
+    drawAtlasPages();
+    gpuBaseID = stagedBaseID;
+    stagedBaseID += staged.size();
+    loadedTextures = stagedTextures;
+    stagedTextures.clear();
+    loadedPaths.clear();
+    addLoadedPaths();
+}
+
+void InternalTexLoader::appendGPU() {
+    drawAtlasPages();
+    if(loadedTextures.empty())
+	gpuBaseID = stagedBaseID;
+    stagedBaseID += staged.size();
+    loadedTextures.insert(loadedTextures.end(), stagedTextures.begin(), stagedTextures.end());
+    stagedTextures.clear();
+    addLoadedPaths();
+}
+
+InternalTexLoader::GpuLoadState InternalTexLoader::gpuLoadState() {
+    return { loadedTextures, loadedPaths, gpuBaseID };
+}
+
+void InternalTexLoader::failedGpuLoad(const GpuLoadState &state) {
+    loadedTextures = state.loadedTextures;
+    loadedPaths = state.loadedPaths;
+    gpuBaseID = state.gpuBaseID;
+    clearStaged();
+}
+
+void InternalTexLoader::addLoadedPaths() {
+    for(auto &tex: staged)
+	loadedPaths.push_back(tex->pathedTex ? tex->path : "");
+}
+
+std::vector<Resource::Texture> InternalTexLoader::getTexturesFrom(std::string path) {
+    std::vector<Resource::Texture> textures;
+    for(size_t i = 0; i < loadedPaths.size() && i < loadedTextures.size(); i++)
+	if(loadedPaths[i] == path)
+	    textures.push_back(loadedTextures[i]);
+    return textures;
+}
+
+StagedTex* InternalTexLoader::stageReload(Resource::Texture tex) {
+    size_t index = gpuIndex(tex);
+    if(index >= loadedPaths.size() || loadedPaths[index].empty())
+	return nullptr;
+    LOG("Texture Reload"
+	" - pool: " << pool.ID <<
+	" - id: "   << tex.ID <<
+	" - path: " << loadedPaths[index]);
+    return stageFile(loadedPaths[index]);
+}
+
+void InternalTexLoader::writePack(assetpack::Contents* pack) {
+    drawAtlasPages();
+    size_t first = pack->textures.size();
+    pack->textures.resize(first + staged.size());
+    WorkerPool::get()->run(staged.size(), [&](size_t i) {
+	StagedTex* tex = staged[i];
+	assetpack::Texture &packed = pack->textures[first + i];
+	packed.width = tex->width;
+	packed.height = tex->height;
+	packed.nrChannels = tex->nrChannels;
+	packed.format = tex->format;
+	packed.srgb = tex->srgb;
+	packed.mipSizes = tex->mipSizes;
+	packed.pixels.resize(tex->filesize);
+	stageTexture(tex, packed.pixels.data());
+    });
+    for(auto &path: stagedPaths) {
+	StagedTex* tex = staged[path.second];
+	pack->textureNames.push_back({ path.first, (uint32_t)(first + path.second),
+				       glm::vec2(tex->width, tex->height), glm::vec4(0, 0, 1, 1) });
+    }
+    for(auto &path: atlasPaths) {
+	int index = stagedIndex(path.second);
+	// sprites too big for the atlas were loaded on their own, so are already named
+	if(index < 0 || stagedPaths.find(path.first) != stagedPaths.end())
+	    continue;
+	pack->textureNames.push_back({ path.first, (uint32_t)(first + index),
+				       path.second.dim, path.second.atlasRect });
+    }
+}
+
+uint64_t InternalTexLoader::stagedMemory() {
+    uint64_t size = 0;
+    for(StagedTex* tex: staged) {
+	if(tex->data == nullptr || tex->borrowedData)
+	    continue;
+	// the other levels are made when the texture is copied to the gpu
+	size += tex->generateMips ? tex->mipSizes[0] : (uint64_t)tex->filesize;
+    }
+    return size;
+}
+
+int InternalTexLoader::stagedIndex(Resource::Texture tex) {
+    if(tex.pool != pool || tex.ID == Resource::NULL_ID ||
+       tex.ID < stagedBaseID || tex.ID - stagedBaseID >= staged.size())
+	return -1;
+    return (int)(tex.ID - stagedBaseID);
+}
+
+std::vector<Resource::Texture> InternalTexLoader::loadPack(std::shared_ptr<assetpack::Pack> pack) {
+    std::vector<Resource::Texture> textures;
+    for(auto &packed: pack->contents.textures) {
+	StagedTex* tex = new StagedTex();
+	tex->data = (unsigned char*)packed.data;
+	tex->borrowedData = true;
+	tex->pack = pack;
+	tex->width = packed.width;
+	tex->height = packed.height;
+	tex->nrChannels = packed.nrChannels;
+	tex->format = packed.format;
+	tex->srgb = packed.srgb;
+	tex->mipSizes = packed.mipSizes;
+	tex->filesize = 0;
+	for(size_t mip: tex->mipSizes)
+	    tex->filesize += (int)mip;
+	tex->path = pack->path;
+	tex->pathedTex = false;
+	textures.push_back(addStagedTexture(tex));
+    }
+    stagedPacks.push_back(pack);
+    return textures;
+}
+
+void InternalTexLoader::drawAtlasPages() {
+    // sprites write to separate parts of their page, so can all be drawn at once
+    for(auto &page: atlasPages)
+	std::memset(staged[page.id]->data, 0, ATLAS_PAGE_SIZE * ATLAS_PAGE_SIZE * 4);
+    WorkerPool::get()->run(atlasSprites.size(), [&](size_t i) {
+	AtlasSprite &sprite = atlasSprites[i];
+	StagedTex* tex = sprite.tex;
+	const unsigned char* pixels = cache->decode(tex->cacheEntry);
+	unsigned char* page = staged[sprite.page]->data;
+	for(int y = -ATLAS_PADDING; y < tex->height + ATLAS_PADDING; y++) {
+	    int srcY = std::min(std::max(y, 0), tex->height - 1);
+	    for(int x = -ATLAS_PADDING; x < tex->width + ATLAS_PADDING; x++) {
+		int srcX = std::min(std::max(x, 0), tex->width - 1);
+		std::memcpy(page + ((size_t)(sprite.y + y) * ATLAS_PAGE_SIZE + sprite.x + x) * 4,
+			    pixels + ((size_t)srcY * tex->width + srcX) * 4, 4);
+	    }
+	}
+	tex->deleteData();
+    });
+}
+
 Resource::Texture InternalTexLoader::addStagedTexture(StagedTex *tex) {
     staged.push_back(tex);
+    Resource::Texture texture(
+	    stagedBaseID + staged.size() - 1, glm::vec2(tex->width, tex->height), pool);
     LOG("Texture Load"
 	" - pool: " << pool.ID <<
-	" - id: "   << staged.size() - 1 <<
+	" - id: "   << texture.ID <<
 	" - path: " << tex->path);
-    Resource::Texture texture(
-	    staged.size() - 1, glm::vec2(tex->width, tex->height), pool);
     stagedTextures.push_back(texture);
     return texture;
 }
 
-void StagedTex::deleteData() {
-    if(data != nullptr) {
-	if(pathedTex)
-	    stbi_image_free(data);
+// bytes before level mip
+size_t levelOffset(const std::vector<size_t> &mipSizes, uint32_t mip) {
+    size_t offset = 0;
+    for(uint32_t i = 0; i < mip && i < mipSizes.size(); i++)
+	offset += mipSizes[i];
+    return offset;
+}
+
+// reads levels from a cache entry, which is released with the source
+std::shared_ptr<MipSource> entryMipSource(TextureCache* cache, TextureCache::Entry* entry) {
+    std::shared_ptr<TextureCache::Entry> held(entry, [cache](TextureCache::Entry* e) {
+	cache->release(e);
+    });
+    return std::make_shared<MipSource>(
+	    entry->mipSizes, [cache, held](uint32_t mip, unsigned char* dst) {
+		cache->readLevel(held.get(), mip, dst);
+	    });
+}
+
+// keeps levels [0, firstMip) in memory, for when there's nowhere to read them from later
+std::shared_ptr<MipSource> keptMipSource(std::vector<size_t> mipSizes,
+					 std::vector<unsigned char> levels) {
+    auto held = std::make_shared<std::vector<unsigned char>>();
+    held->swap(levels);
+    return std::make_shared<MipSource>(
+	    mipSizes, [mipSizes, held](uint32_t mip, unsigned char* dst) {
+		std::memcpy(dst, held->data() + levelOffset(mipSizes, mip), mipSizes[mip]);
+	    });
+}
+
+std::shared_ptr<MipSource> InternalTexLoader::stageTexture(
+	StagedTex* tex, unsigned char* dst, unsigned int firstMip) {
+    if(dst == nullptr)
+	throw std::runtime_error(
+		"Texture Load to GPU: Need to stage texture but "
+		"pointer to staging memory was nullptr");
+    size_t skipped = levelOffset(tex->mipSizes, firstMip);
+    if(!tex->generateMips) {
+	if(tex->data == nullptr)
+	    cache->decodeTo(tex->cacheEntry, dst, firstMip);
 	else
+	    std::memcpy(dst, tex->data + skipped, tex->filesize - skipped);
+	if(firstMip == 0)
+	    return nullptr;
+	if(tex->data == nullptr)
+	    return entryMipSource(cache, cache->share(tex->cacheEntry));
+	if(tex->pack != nullptr) {
+	    // the pack stays mapped while the source is around
+	    std::shared_ptr<assetpack::Pack> pack = tex->pack;
+	    const unsigned char* data = tex->data;
+	    std::vector<size_t> mipSizes = tex->mipSizes;
+	    return std::make_shared<MipSource>(
+		    mipSizes, [pack, data, mipSizes](uint32_t mip, unsigned char* dst) {
+			std::memcpy(dst, data + levelOffset(mipSizes, mip), mipSizes[mip]);
+		    });
+	}
+	return keptMipSource(tex->mipSizes,
+			     std::vector<unsigned char>(tex->data, tex->data + skipped));
+    }
+    const unsigned char* pixels = tex->cacheEntry != nullptr ?
+	cache->decode(tex->cacheEntry) : tex->data;
+    // made in normal memory, as dst may be slow to read from (ie vulkan staging memory)
+    // averaging srgb colours as they are would darken the smaller levels
+    std::vector<unsigned char> mips = mipgen::generate(pixels, tex->width, tex->height,
+						       tex->srgb);
+    if(firstMip == 0) {
+	std::memcpy(dst, pixels, tex->mipSizes[0]);
+	std::memcpy(dst + tex->mipSizes[0], mips.data(), mips.size());
+    } else {
+	size_t generatedSkipped = skipped - tex->mipSizes[0];
+	std::memcpy(dst, mips.data() + generatedSkipped, mips.size() - generatedSkipped);
+    }
+    bool cached = false;
+    std::string path = mipgen::cachePath(tex->path);
+    if(cacheMips && tex->pathedTex) {
+	cached = mipgen::writeCache(path, tex->width, tex->height, tex->srgb,
+				    pixels, mips.data());
+	if(!cached)
+	    LOG_ERROR("Failed to write mip map cache - path: " << path);
+    }
+    if(firstMip == 0)
+	return nullptr;
+    if(cached) {
+	// so the bigger levels are read back from the cache instead of kept
+	try {
+	    TextureCache::Entry* entry = cache->acquire(path, desiredChannels);
+	    if(entry->mipSizes == tex->mipSizes)
+		return entryMipSource(cache, entry);
+	    cache->release(entry);
+	} catch(std::exception &e) {
+	    LOG_ERROR("Failed to reopen mip map cache - path: " << path
+		      << " - " << e.what());
+	}
+    }
+    std::vector<unsigned char> levels(skipped);
+    std::memcpy(levels.data(), pixels, tex->mipSizes[0]);
+    std::memcpy(levels.data() + tex->mipSizes[0], mips.data(), skipped - tex->mipSizes[0]);
+    return keptMipSource(tex->mipSizes, std::move(levels));
+}
+
+void InternalTexLoader::decodeStaged() {
+    // atlas pages aren't drawn until loading, as more sprites can be added,
+    // so their mips are made then
+    std::vector<bool> atlasPage(staged.size(), false);
+    for(auto &page: atlasPages)
+	atlasPage[page.id] = true;
+    std::vector<StagedTex*> toDecode;
+    for(size_t i = 0; i < staged.size(); i++) {
+	StagedTex* tex = staged[i];
+	if(atlasPage[i])
+	    continue;
+	if(tex->generateMips ||
+	   (tex->data == nullptr && tex->cacheEntry != nullptr && !tex->cacheEntry->compressedFile))
+	    toDecode.push_back(tex);
+    }
+    // atlas sprites are still drawn when loading, but from their decoded pixels
+    WorkerPool::get()->run(toDecode.size() + atlasSprites.size(), [&](size_t i) {
+	if(i >= toDecode.size()) {
+	    cache->decode(atlasSprites[i - toDecode.size()].tex->cacheEntry);
+	    return;
+	}
+	StagedTex* tex = toDecode[i];
+	unsigned char* data = new unsigned char[tex->filesize];
+	try {
+	    stageTexture(tex, data);
+	} catch(std::exception &e) {
 	    delete[] data;
-	data = nullptr;
+	    throw;
+	}
+	// the cache entry is kept, so the gpu texture can still be shared with other pools
+	if(tex->data != nullptr && !tex->borrowedData)
+	    delete[] tex->data;
+	tex->data = data;
+	tex->borrowedData = false;
+	tex->generateMips = false;
+    });
+}
+
+size_t InternalTexLoader::residentSize(StagedTex* tex, unsigned int firstMip) {
+    return tex->filesize - levelOffset(tex->mipSizes, firstMip);
+}
+
+unsigned int InternalTexLoader::firstResidentMip(StagedTex* tex) {
+    if(!streamTextures)
+	return 0;
+    unsigned int mip = 0;
+    int width = tex->width, height = tex->height;
+    while(mip + 1 < tex->mipSizes.size() && std::max(width, height) > STREAM_RESIDENT_SIZE) {
+	mip++;
+	width = std::max(width / 2, 1);
+	height = std::max(height / 2, 1);
     }
+    return mip;
+}
+
+void StagedTex::deleteData() {
+    if(cacheEntry != nullptr) {
+	cache->release(cacheEntry);
+	cacheEntry = nullptr;
+    }
+    // pathed textures own their data if decodeStaged decoded them
+    if(data != nullptr && !borrowedData)
+	delete[] data;
+    data = nullptr;
 }
 
 void InternalTexLoader::clearStaged() {
@@ -79,5 +503,14 @@ void InternalTexLoader::clearStaged() {
 	delete s;
     }
     staged.clear();
+    stagedPaths.clear();
+    for(auto &sprite: atlasSprites) {
+	sprite.tex->deleteData();
+	delete sprite.tex;
+    }
+    atlasSprites.clear();
+    atlasPages.clear();
+    atlasPaths.clear();
     stagedTextures.clear();
+    stagedPacks.clear();
 }
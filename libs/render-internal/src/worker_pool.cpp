@@ -0,0 +1,113 @@
+#include <render-internal/worker_pool.h>
+
+#include <algorithm>
+#include <atomic>
+#include <exception>
+
+struct WorkerPool::Batch {
+    std::function<void(size_t)> job;
+    size_t count;
+    std::atomic<size_t> next;
+    // threads currently processing this batch, guarded by mut
+    unsigned int active = 0;
+    std::mutex errorMut;
+    std::exception_ptr error;
+};
+
+namespace {
+  thread_local bool insideWorker = false;
+}
+
+WorkerPool::WorkerPool(unsigned int threadCount) {
+    for(unsigned int i = 0; i < threadCount; i++)
+	threads.push_back(std::thread(&WorkerPool::work, this));
+}
+
+WorkerPool::~WorkerPool() {
+    {
+	std::lock_guard<std::mutex> lock(mut);
+	quit = true;
+    }
+    wake.notify_all();
+    for(auto &t: threads)
+	t.join();
+}
+
+WorkerPool* WorkerPool::get() {
+    static WorkerPool pool(std::thread::hardware_concurrency() > 1 ?
+			   std::thread::hardware_concurrency() - 1 : 0);
+    return &pool;
+}
+
+void WorkerPool::run(size_t count, std::function<void(size_t)> job) {
+    if(count == 0)
+	return;
+    if(insideWorker || threads.size() == 0 || count == 1) {
+	for(size_t i = 0; i < count; i++)
+	    job(i);
+	return;
+    }
+    Batch b;
+    b.job = job;
+    b.count = count;
+    b.next = 0;
+    {
+	std::lock_guard<std::mutex> lock(mut);
+	b.active = 1;
+	batches.push_back(&b);
+    }
+    wake.notify_all();
+
+    insideWorker = true;
+    process(&b);
+    insideWorker = false;
+
+    {
+	std::unique_lock<std::mutex> lock(mut);
+	// every job has been taken, so no more workers can start on it
+	auto it = std::find(batches.begin(), batches.end(), &b);
+	if(it != batches.end())
+	    batches.erase(it);
+	b.active--;
+	finished.wait(lock, [&b]{ return b.active == 0; });
+    }
+    if(b.error)
+	std::rethrow_exception(b.error);
+}
+
+void WorkerPool::work() {
+    insideWorker = true;
+    std::unique_lock<std::mutex> lock(mut);
+    while(true) {
+	wake.wait(lock, [&]{ return quit || !batches.empty(); });
+	if(quit)
+	    return;
+	Batch* b = batches.front();
+	if(b->next >= b->count) {
+	    // the rest of its jobs are being done, so move on to the next batch
+	    batches.pop_front();
+	    continue;
+	}
+	b->active++;
+	lock.unlock();
+	process(b);
+	lock.lock();
+	if(--b->active == 0)
+	    finished.notify_all();
+    }
+}
+
+void WorkerPool::process(Batch* b) {
+    size_t i;
+    while((i = b->next++) < b->count) {
+	try {
+	    b->job(i);
+	} catch(...) {
+	    std::lock_guard<std::mutex> lock(b->errorMut);
+	    if(!b->error)
+		b->error = std::current_exception();
+	    // skip the remaining jobs
+	    b->next = b->count;
+	}
+    }
+}
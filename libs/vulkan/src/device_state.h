@@ -9,11 +9,20 @@ extern std::mutex graphicsPresentMutex;
 struct QueueFamilies {
     uint32_t graphicsPresentFamilyIndex;
     VkQueue graphicsPresentQueue;
+    // uploads go on a transfer only queue if the device has one,
+    // otherwise these are the same as the graphics present queue.
+    uint32_t transferFamilyIndex;
+    VkQueue transferQueue;
 };
 
 struct EnabledDeviceFeatures {
     bool samplerAnisotropy = false;
     bool sampleRateShading = false;
+    bool textureCompressionBC = false;
+    /// multiDrawIndirect and drawIndirectFirstInstance, both are needed to use either
+    bool multiDrawIndirect = false;
+    /// VK_EXT_memory_budget, heap budgets can be queried. enabled whenever it is available.
+    bool memoryBudget = false;
     bool manuallyChosePhysicalDevice = false;
 #ifndef NDEBUG
     bool debugErrorOnly = false;
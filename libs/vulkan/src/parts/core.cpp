@@ -36,6 +36,10 @@ namespace part {
     };
 
     const std::vector<const char*> REQUESTED_DEVICE_EXTENSIONS = {VK_KHR_SWAPCHAIN_EXTENSION_NAME};
+
+    // the instance has VK_KHR_get_physical_device_properties2,
+    // which VK_EXT_memory_budget needs to be queried with.
+    static bool physicalDeviceProperties2 = false;
 	
     
     VkResult Instance(VkInstance *instance) {
@@ -57,6 +61,10 @@ namespace part {
 #ifndef NDEBUG
 	extensions.push_back(VK_EXT_DEBUG_UTILS_EXTENSION_NAME);
 #endif
+	physicalDeviceProperties2 = checkInstanceExtensionSupported(
+		VK_KHR_GET_PHYSICAL_DEVICE_PROPERTIES_2_EXTENSION_NAME);
+	if(physicalDeviceProperties2)
+	    extensions.push_back(VK_KHR_GET_PHYSICAL_DEVICE_PROPERTIES_2_EXTENSION_NAME);
 	instanceCreateInfo.enabledExtensionCount = static_cast<uint32_t>(extensions.size());
 	instanceCreateInfo.ppEnabledExtensionNames = extensions.data();
 
@@ -104,23 +112,34 @@ namespace part {
 			    &deviceState->queue.graphicsPresentFamilyIndex,
 			    REQUESTED_DEVICE_EXTENSIONS,
 			    requestFeatures.manuallyChosePhysicalDevice));
+	deviceState->queue.transferFamilyIndex = chooseTransferQueueFamily(
+		deviceState->physicalDevice, deviceState->queue.graphicsPresentFamilyIndex);
 	// create logical device
 	VkDeviceCreateInfo deviceInfo{VK_STRUCTURE_TYPE_DEVICE_CREATE_INFO};
 
 	float queuePriority = 1.0f;
 	std::vector<VkDeviceQueueCreateInfo> queueInfos = fillQueueFamiliesCreateInfo(
-		{ deviceState->queue.graphicsPresentFamilyIndex }, &queuePriority);
+		{ deviceState->queue.graphicsPresentFamilyIndex,
+		  deviceState->queue.transferFamilyIndex }, &queuePriority);
 	    
 	deviceInfo.queueCreateInfoCount = (uint32_t)queueInfos.size();
 	deviceInfo.pQueueCreateInfos = queueInfos.data();
 
-	deviceInfo.enabledExtensionCount = (uint32_t)REQUESTED_DEVICE_EXTENSIONS.size();
-	deviceInfo.ppEnabledExtensionNames = REQUESTED_DEVICE_EXTENSIONS.data();
+	// optional extensions are only enabled if the device has them
+	std::vector<const char*> extensions = REQUESTED_DEVICE_EXTENSIONS;
+	bool memoryBudget = physicalDeviceProperties2 &&
+	    checkRequestedExtensionsAreSupported(
+		    deviceState->physicalDevice, { VK_EXT_MEMORY_BUDGET_EXTENSION_NAME });
+	if(memoryBudget)
+	    extensions.push_back(VK_EXT_MEMORY_BUDGET_EXTENSION_NAME);
+	deviceInfo.enabledExtensionCount = (uint32_t)extensions.size();
+	deviceInfo.ppEnabledExtensionNames = extensions.data();
 	    
 	VkPhysicalDeviceFeatures chosenDeviceFeatures = setRequestedDeviceFeatures(
 		deviceState->physicalDevice,
 		requestFeatures,
 		&deviceState->features);
+	deviceState->features.memoryBudget = memoryBudget;
 	deviceInfo.pEnabledFeatures = &chosenDeviceFeatures;
 
 	deviceInfo.enabledLayerCount = (uint32_t)OPTIONAL_LAYERS.size();
@@ -134,6 +153,9 @@ namespace part {
 	vkGetDeviceQueue(deviceState->device,
 			 deviceState->queue.graphicsPresentFamilyIndex, 0,
 			 &deviceState->queue.graphicsPresentQueue);
+	vkGetDeviceQueue(deviceState->device,
+			 deviceState->queue.transferFamilyIndex, 0,
+			 &deviceState->queue.transferQueue);
 	return result;
     }
 
@@ -152,6 +152,33 @@ bool getGraphicsPresentQueueID(VkPhysicalDevice candidateDevice,
     return false;
 }
 
+uint32_t chooseTransferQueueFamily(VkPhysicalDevice physicalDevice,
+				   uint32_t graphicsPresentQueueFamilyId) {
+    uint32_t queueFamilyCount = 0;
+    vkGetPhysicalDeviceQueueFamilyProperties(physicalDevice, &queueFamilyCount, nullptr);
+    std::unique_ptr<VkQueueFamilyProperties> queueFamilies(
+	    new VkQueueFamilyProperties[queueFamilyCount]);
+    vkGetPhysicalDeviceQueueFamilyProperties(
+	    physicalDevice, &queueFamilyCount, queueFamilies.get());
+    for(uint32_t i = 0; i < queueFamilyCount; i++) {
+	VkQueueFamilyProperties &props = queueFamilies.get()[i];
+	if(!(props.queueFlags & VK_QUEUE_TRANSFER_BIT) ||
+	   props.queueFlags & (VK_QUEUE_GRAPHICS_BIT | VK_QUEUE_COMPUTE_BIT))
+	    continue;
+	// textures are copied in rows, so the queue must allow any offset into an image
+	VkExtent3D granularity = props.minImageTransferGranularity;
+	if(granularity.width != 1 || granularity.height != 1 || granularity.depth != 1) {
+	    LOG("transfer queue family " << i << " has a coarse image transfer granularity, "
+		"not using it");
+	    continue;
+	}
+	LOG("using transfer queue family " << i << " for uploads");
+	return i;
+    }
+    LOG("no transfer only queue family, uploading on the graphics queue");
+    return graphicsPresentQueueFamilyId;
+}
+
 const size_t DEVICE_RANKING_COUNT = 6;
 const VkPhysicalDeviceType DEVICE_TYPE_RANKINGS[DEVICE_RANKING_COUNT] = {
     VK_PHYSICAL_DEVICE_TYPE_DISCRETE_GPU,
@@ -11,4 +11,8 @@ VkResult choosePhysicalDevice(VkInstance instance,
 			      const std::vector<const char*> &requestedExtensions,
 			      bool selectManually);
 
+/// a transfer only queue family for uploads, or the graphics present one if there isn't one
+uint32_t chooseTransferQueueFamily(VkPhysicalDevice physicalDevice,
+				   uint32_t graphicsPresentQueueFamilyId);
+
 #endif
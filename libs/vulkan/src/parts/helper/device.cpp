@@ -27,6 +27,18 @@ bool checkRequiredLayersSupported(std::vector<const char *> requiredLayers) {
     checkStringsAgainstList(requiredLayers, availableLayers, layerName);
 }
 
+bool checkInstanceExtensionSupported(const char* extension) {
+    uint32_t extensionCount;
+    if(vkEnumerateInstanceExtensionProperties(nullptr, &extensionCount, nullptr) != VK_SUCCESS)
+	return false;
+    std::vector<VkExtensionProperties> instanceExtensions(extensionCount);
+    if(vkEnumerateInstanceExtensionProperties(
+	       nullptr, &extensionCount, instanceExtensions.data()) != VK_SUCCESS)
+	return false;
+    std::vector<const char*> requested = { extension };
+    checkStringsAgainstList(requested, instanceExtensions, extensionName);
+}
+
 bool checkRequestedExtensionsAreSupported(
 	VkPhysicalDevice physicalDevice,
 	const std::vector<const char *> &requestedExtensions) {
@@ -81,6 +93,17 @@ VkPhysicalDeviceFeatures setRequestedDeviceFeatures(
 	chosenDeviceFeatures.sampleRateShading = VK_TRUE;
 	setFeatures->sampleRateShading = true;
     }
+    if (availableDeviceFeatures.textureCompressionBC && requestedFeatures.textureCompressionBC) {
+	chosenDeviceFeatures.textureCompressionBC = VK_TRUE;
+	setFeatures->textureCompressionBC = true;
+    }
+    if (availableDeviceFeatures.multiDrawIndirect &&
+	availableDeviceFeatures.drawIndirectFirstInstance &&
+	requestedFeatures.multiDrawIndirect) {
+	chosenDeviceFeatures.multiDrawIndirect = VK_TRUE;
+	chosenDeviceFeatures.drawIndirectFirstInstance = VK_TRUE;
+	setFeatures->multiDrawIndirect = true;
+    }
     return chosenDeviceFeatures;
 }
 
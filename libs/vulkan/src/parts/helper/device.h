@@ -9,6 +9,8 @@
 
 bool checkRequiredLayersSupported(const std::vector<const char *> requiredLayers);
 
+bool checkInstanceExtensionSupported(const char* extension);
+
 bool checkRequestedExtensionsAreSupported(
     VkPhysicalDevice physicalDevice,
     const std::vector<const char *> &requestedExtensions);
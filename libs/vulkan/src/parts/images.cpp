@@ -38,13 +38,14 @@ namespace part {
 		       VkImage image,
 		       VkFormat format,
 		       VkImageAspectFlags aspectFlags,
-		       uint32_t mipLevels) {
+		       uint32_t mipLevels,
+		       uint32_t baseMipLevel) {
 	VkResult result = VK_SUCCESS;
 	VkImageViewCreateInfo viewInfo { VK_STRUCTURE_TYPE_IMAGE_VIEW_CREATE_INFO };
 	viewInfo.image = image;
 	viewInfo.viewType = VK_IMAGE_VIEW_TYPE_2D;
 	viewInfo.format = format;
-	viewInfo.subresourceRange.baseMipLevel = 0;
+	viewInfo.subresourceRange.baseMipLevel = baseMipLevel;
 	viewInfo.subresourceRange.levelCount = mipLevels;
 	viewInfo.subresourceRange.baseArrayLayer = 0;
 	viewInfo.subresourceRange.layerCount = 1;
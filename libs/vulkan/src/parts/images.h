@@ -20,7 +20,8 @@ namespace part {
 		       VkImage image,
 		       VkFormat format,
 		       VkImageAspectFlags aspectFlags,
-		       uint32_t mipLevels);
+		       uint32_t mipLevels,
+		       uint32_t baseMipLevel = 0);
 
     VkResult TextureSampler(VkDevice device,
 			    VkPhysicalDevice physicalDevice,
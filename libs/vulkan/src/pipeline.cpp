@@ -33,6 +33,27 @@ VkVertexInputAttributeDescription getAttrib(uint32_t bindingIndex,
     case PipelineInput::type::ivec4:
 	attrib.format = VK_FORMAT_R32G32B32A32_SINT;
 	break;
+    case PipelineInput::type::half2:
+	attrib.format = VK_FORMAT_R16G16_SFLOAT;
+	break;
+    case PipelineInput::type::half4:
+	attrib.format = VK_FORMAT_R16G16B16A16_SFLOAT;
+	break;
+    case PipelineInput::type::snorm8x4:
+	attrib.format = VK_FORMAT_R8G8B8A8_SNORM;
+	break;
+    case PipelineInput::type::snorm16x4:
+	attrib.format = VK_FORMAT_R16G16B16A16_SNORM;
+	break;
+    case PipelineInput::type::unorm8x4:
+	attrib.format = VK_FORMAT_R8G8B8A8_UNORM;
+	break;
+    case PipelineInput::type::unorm16x2:
+	attrib.format = VK_FORMAT_R16G16_UNORM;
+	break;
+    case PipelineInput::type::uint8x4:
+	attrib.format = VK_FORMAT_R8G8B8A8_UINT;
+	break;
     }
     return attrib;
 }
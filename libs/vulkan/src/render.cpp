@@ -4,20 +4,28 @@
 #include "pipeline.h"
 #include "pipeline_data.h"
 #include "resources/resource_pool.h"
+#include "resources/staging_ring.h"
+#include "resources/deletion_queue.h"
 #include "vkhelper.h"
 #include "logger.h"
 
 #include <render-internal/resource-loaders/pool_manager.h>
+#include <render-internal/file_watcher.h>
 #include <graphics/glm_helper.h>
 #include <graphics/pipeline.h>
 
 #include <GLFW/glfw3.h>
+#include <cstring>
 #include <iostream>
 #include <stdexcept>
 #include <stdint.h>
 #include <string>
 #include <vector>
 
+// the staging ring grows from this if loads have to wait for space in it
+const VkDeviceSize STAGING_RING_INITIAL_SIZE = 32 * 1024 * 1024;
+// indirect draw commands for culled meshes each frame, more are drawn directly
+const uint32_t INDIRECT_DRAWS_PER_FRAME = 16384;
 
 namespace vkenv {
 
@@ -43,6 +51,9 @@ void checkVolk() {
     checkVolk();
     EnabledDeviceFeatures features;
     features.sampleRateShading = renderConf.sample_shading;
+    // compressed texture files can be loaded whatever the config says
+    features.textureCompressionBC = true;
+    features.multiDrawIndirect = renderConf.meshlet_culling;
     features.manuallyChosePhysicalDevice = renderConf.manuallyChoseGpu;
     manager = new VulkanManager(window, features);
     
@@ -50,6 +61,8 @@ void checkVolk() {
     for(int i = 0; i < MAX_CONCURRENT_FRAMES; i++)
 	frames[i] = new Frame(manager->deviceState.device,
 			      manager->deviceState.queue.graphicsPresentFamilyIndex);
+    stagingRing = new StagingRing(manager->deviceState, STAGING_RING_INITIAL_SIZE);
+    deletionQueue = new DeletionQueue(stagingRing, MAX_CONCURRENT_FRAMES);
     pools = new PoolManagerVk;
     defaultResourcePool = CreateResourcePool()->id();
     framebufferResourcePool = (ResourcePoolVk*)CreateResourcePool();
@@ -61,12 +74,44 @@ void checkVolk() {
 		VK_FORMAT_D24_UNORM_S8_UINT},
 	    VK_IMAGE_TILING_OPTIMAL,
 	    VK_FORMAT_FEATURE_DEPTH_STENCIL_ATTACHMENT_BIT);
+    // the 3D pipelines cull back faces, so meshlets facing away can be skipped too
+    if(renderConf.meshlet_culling) {
+	meshletCuller = new meshopt::MeshletCuller(true);
+	if(manager->deviceState.features.multiDrawIndirect) {
+	    VkDeviceSize size = sizeof(VkDrawIndexedIndirectCommand)
+		* INDIRECT_DRAWS_PER_FRAME * MAX_CONCURRENT_FRAMES;
+	    checkResultAndThrow(
+		    vkhelper::createBufferAndMemory(
+			    manager->deviceState, size, &_indirectBuffer, &_indirectMemory,
+			    VK_BUFFER_USAGE_INDIRECT_BUFFER_BIT,
+			    VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT
+			    | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT),
+		    "Failed to create indirect draw buffer");
+	    void* mapped;
+	    checkResultAndThrow(vkMapMemory(manager->deviceState.device, _indirectMemory,
+					    0, size, 0, &mapped),
+				"Failed to map indirect draw buffer");
+	    _indirectMapped = (VkDrawIndexedIndirectCommand*)mapped;
+	    _indirectDraws = new IndirectDraws{
+		_indirectBuffer, _indirectMapped, 0, INDIRECT_DRAWS_PER_FRAME, 0 };
+	}
+    }
+    if(renderConf.hot_reload)
+	fileWatcher = new FileWatcher();
   }
   
 RenderVk::~RenderVk() {
+    _finishAsyncLoads(true);
+    {
+	// submit any ownership acquires left for streamed mips
+	std::lock_guard<std::mutex> lock(stagingRing->mutex());
+	stagingRing->submit(true);
+    }
     vkDeviceWaitIdle(manager->deviceState.device);
     _destroyFrameResources();
     delete pools;
+    delete deletionQueue;
+    delete stagingRing;
     if(offscreenRenderPass != nullptr || finalRenderPass != nullptr) {
 	delete offscreenRenderPass;
 	if(usingFinalRenderPass)
@@ -77,6 +122,15 @@ RenderVk::~RenderVk() {
     for(int i = 0; i < MAX_CONCURRENT_FRAMES; i++)
 	delete frames[i];
     delete[] frames;
+    if(meshletCuller != nullptr)
+	delete meshletCuller;
+    if(_indirectDraws != nullptr) {
+	delete _indirectDraws;
+	vkDestroyBuffer(manager->deviceState.device, _indirectBuffer, nullptr);
+	vkFreeMemory(manager->deviceState.device, _indirectMemory, nullptr);
+    }
+    if(fileWatcher != nullptr)
+	delete fileWatcher;
     delete manager;
 }
 
@@ -89,8 +143,10 @@ bool swapchainRecreationRequired(VkResult result) {
       *getMinMipmap = 100000.0f;
       std::vector<Resource::Texture> allTextures;
       for(int i = 0; i < pools->PoolCount(); i++) {
+	  if(pools->get(i) == nullptr)
+	      continue;
 	  pools->get(i)->usingGPUResources = false;
-	  if(!pools->get(i)->UseGPUResources)
+	  if(!pools->get(i)->UseGPUResources || pools->get(i)->loading)
 	      continue;
 	  pools->get(i)->usingGPUResources = true;
 	  float n = pools->get(i)->texLoader->getMinMipmapLevel();
@@ -406,7 +462,7 @@ ResourcePool* RenderVk::CreateResourcePool() {
     int i = pools->NextPoolIndex();
     ResourcePoolVk* p = new ResourcePoolVk(
 	    i, pools,
-	    manager->deviceState, manager->generalCommandPool, manager->generalCommandBuffer,
+	    manager->deviceState, stagingRing, deletionQueue,
 	    renderConf);    
     return pools->AddPool(p, i);
 }
@@ -414,15 +470,15 @@ ResourcePool* RenderVk::CreateResourcePool() {
 void RenderVk::DestroyResourcePool(Resource::Pool pool) {
     if(!_validPool(pool))
 	return;
-    bool reloadResources = false;
-    if(pools->get(pool.ID)->usingGPUResources) {
-	reloadResources = true;
-	vkDeviceWaitIdle(manager->deviceState.device);
-	_destroyFrameResources();
-    }
+    if(pools->get(pool.ID)->loading)
+	_finishAsyncLoads(true);
+    // frames in flight may still be drawing with the pool,
+    // so its gpu resources are freed once they are done
+    pools->get(pool.ID)->unloadGPU();
+    bool inUse = pools->get(pool.ID)->usingGPUResources;
     pools->DeletePool(pool);
-    if(reloadResources)
-	_initFrameResources();
+    if(inUse)
+	_texturesChanged = true;
 }
 
   void RenderVk::setResourcePoolInUse(Resource::Pool pool, bool usePool) {
@@ -449,6 +505,12 @@ bool RenderVk::_poolInUse(Resource::Pool pool) {
     return _validPool(pool) && pools->get(pool)->usingGPUResources;
 }
 
+// draws from a pool that is loading async are skipped without an error,
+// as they are expected until the load finishes
+bool RenderVk::_poolLoading(Resource::Pool pool) {
+    return pools->ValidPool(pool) && pools->get(pool)->loading;
+}
+
 void RenderVk::_throwIfPoolInvaid(Resource::Pool pool) {
     if(!_validPool(pool))
 	throw std::runtime_error("Tried to load resource "
@@ -457,37 +519,219 @@ void RenderVk::_throwIfPoolInvaid(Resource::Pool pool) {
 
 void RenderVk::LoadResourcesToGPU(Resource::Pool pool) {
     _throwIfPoolInvaid(pool);
-    bool remakeFrameRes = false;
-    if(pools->get(pool)->usingGPUResources) {
-	LOG("Loading resources for pool that is currently in use, "
-	    "so waiting for frames to finish before staging to gpu.");
-	vkDeviceWaitIdle(manager->deviceState.device);
-	remakeFrameRes = true;
-    }
+    if(pools->get(pool)->loading)
+	_finishAsyncLoads(true);
+    // the old resources of a pool in use are freed once the frames in flight are done
+    bool inUse = pools->get(pool)->usingGPUResources;
     pools->get(pool)->loadGpu();
-    if(remakeFrameRes) //remake if pool currently in use was reloaded
+    _watchPoolFiles(pool);
+    if(inUse)
 	UseLoadedResources();
 }
 
+Resource::LoadTicket RenderVk::LoadResourcesToGPUAsync(Resource::Pool pool) {
+    _throwIfPoolInvaid(pool);
+    if(pools->get(pool)->loading)
+	_finishAsyncLoads(true);
+    // frames in flight use the pool's current resources, so can't swap them out
+    if(pools->get(pool)->usingGPUResources) {
+	LoadResourcesToGPU(pool);
+	return Resource::LoadTicket(pool, 0);
+    }
+    // the files are decoded here, only the copies to the gpu aren't waited for
+    AsyncLoad load;
+    load.pool = pool;
+    load.submitted = pools->get(pool)->loadGpuAsync();
+    {
+	std::lock_guard<std::mutex> lock(_asyncLoadMutex);
+	load.ticket = ++_loadTicketCount;
+	_asyncLoads.push_back(load);
+    }
+    _watchPoolFiles(pool);
+    return Resource::LoadTicket(pool, load.ticket);
+}
+
+bool RenderVk::LoadFinished(Resource::LoadTicket ticket) {
+    std::lock_guard<std::mutex> lock(_asyncLoadMutex);
+    for(auto &load: _asyncLoads)
+	if(load.ticket == ticket.ID)
+	    return false;
+    return true;
+}
+
+void RenderVk::AppendResourcesToGPU(Resource::Pool pool) {
+    _throwIfPoolInvaid(pool);
+    if(pools->get(pool)->loading)
+	_finishAsyncLoads(true);
+    // the resources already loaded aren't touched, so frames in flight can keep using them
+    pools->get(pool)->appendGpu();
+    _watchPoolFiles(pool);
+    if(pools->get(pool)->usingGPUResources)
+	_texturesChanged = true;
+}
+
+void RenderVk::ReloadTexture(Resource::Texture texture) {
+    _throwIfPoolInvaid(texture.pool);
+    ResourcePoolVk* pool = pools->get(texture.pool);
+    if(pool->loading)
+	_finishAsyncLoads(true);
+    // a new image's view goes in the texture's slot of each frame's descriptor set in turn
+    if(pool->texLoader->reload(texture, [this] { _waitForFrames(); }) &&
+       pool->usingGPUResources)
+	_staleTextureSlots.push_back(
+		{ pool->texLoader->getViewIndex(texture), MAX_CONCURRENT_FRAMES });
+}
+
+void RenderVk::ReloadModel(Resource::Model model) {
+    _throwIfPoolInvaid(model.pool);
+    ResourcePoolVk* pool = pools->get(model.pool);
+    if(pool->loading)
+	_finishAsyncLoads(true);
+    pool->modelLoader->reload(model, [this] { _waitForFrames(); });
+}
+
+// reloads written in place wait for the frames using the old data,
+// but only the first one since the last frame was submitted has to
+void RenderVk::_waitForFrames() {
+    if(_framesIdle)
+	return;
+    std::lock_guard<std::mutex> lock(graphicsPresentMutex);
+    vkQueueWaitIdle(manager->deviceState.queue.graphicsPresentQueue);
+    _framesIdle = true;
+}
+
+void RenderVk::_watchPoolFiles(Resource::Pool pool) {
+    if(fileWatcher == nullptr)
+	return;
+    for(auto &path: pools->get(pool)->texLoader->getLoadedPaths())
+	fileWatcher->watch(path);
+    for(auto &path: pools->get(pool)->modelLoader->getLoadedPaths())
+	fileWatcher->watch(path);
+}
+
+// a file that can't be read, ie it is still being written,
+// is tried again the next time it changes
+void RenderVk::_hotReload() {
+    if(fileWatcher == nullptr)
+	return;
+    for(auto &path: fileWatcher->changed())
+	for(int i = 0; i < pools->PoolCount(); i++) {
+	    ResourcePoolVk* pool = pools->get(i);
+	    if(pool == nullptr)
+		continue;
+	    try {
+		for(auto &texture: pool->texLoader->getTexturesFrom(path))
+		    ReloadTexture(texture);
+		for(auto &model: pool->modelLoader->getModelsFrom(path))
+		    ReloadModel(model);
+	    } catch(std::exception &e) {
+		LOG_ERROR("Failed to reload - path: " << path << " - " << e.what());
+	    }
+	}
+}
+
+// pools loaded async are freed of their staging data once the uploads are done,
+// returns true if any finished.
+bool RenderVk::_finishAsyncLoads(bool wait) {
+    {
+	std::lock_guard<std::mutex> loadsLock(_asyncLoadMutex);
+	if(_asyncLoads.empty())
+	    return false;
+    }
+    std::unique_lock<std::mutex> lock(stagingRing->mutex(), std::defer_lock);
+    if(wait)
+	lock.lock();
+    else if(!lock.try_lock())
+	return false;
+    std::lock_guard<std::mutex> loadsLock(_asyncLoadMutex);
+    bool finished = false;
+    for(size_t i = 0; i < _asyncLoads.size();) {
+	AsyncLoad &load = _asyncLoads[i];
+	if(wait)
+	    stagingRing->wait(load.submitted);
+	else if(!stagingRing->finished(load.submitted)) {
+	    i++;
+	    continue;
+	}
+	if(pools->get(load.pool) != nullptr)
+	    pools->get(load.pool)->loadFinished();
+	_asyncLoads.erase(_asyncLoads.begin() + i);
+	finished = true;
+    }
+    return finished;
+}
+
 void RenderVk::UseLoadedResources() {
-    vkDeviceWaitIdle(manager->deviceState.device);
+    _finishAsyncLoads(true);
     if(!_frameResourcesCreated) {
+	vkDeviceWaitIdle(manager->deviceState.device);
 	_initFrameResources();
 	return;
+    }
+    float minmipmap;
+    std::vector<Resource::Texture> allTextures = getActiveTextures(&minmipmap);
+    TextureSampler s = textureSet->getSampler(0);
+    if(s.maxLod == minmipmap) {
+	// frames in flight keep their descriptor sets, the rest take the textures in turn
+	((SetVk*)textureSet)->updateTexturesPerFrame(1, allTextures);
+	_staleTextureViewFrames = MAX_CONCURRENT_FRAMES;
+	return;
+    }
+    // the sampler is written to every frame's set
+    vkDeviceWaitIdle(manager->deviceState.device);
+    s.maxLod = minmipmap;
+    textureSet->updateSampler(0, s);
+    textureSet->updateTextures(1, 0, allTextures);
+}
+
+MemoryUsage RenderVk::GetMemoryUsage() {
+    MemoryUsage usage;
+    for(int i = 0; i < pools->PoolCount(); i++) {
+	ResourcePoolVk* pool = pools->get(i);
+	// staging pools are written to by another thread
+	if(pool == nullptr || pool == framebufferResourcePool || pool->isStaging())
+	    continue;
+	usage.pools.push_back({ pool->id(), pool->memoryUsage() });
+    }
+    usage.frameAttachments = framebufferResourcePool->texLoader->gpuMemory();
+    for(ShaderPoolVk* pool: shaderPools)
+	usage.shaderBuffers += pool->gpuMemory();
+    usage.staging = stagingRing->capacity();
+
+    VkPhysicalDeviceMemoryProperties memProps;
+    VkPhysicalDeviceMemoryBudgetPropertiesEXT budget{
+	VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_MEMORY_BUDGET_PROPERTIES_EXT };
+    if(manager->deviceState.features.memoryBudget) {
+	VkPhysicalDeviceMemoryProperties2KHR memProps2{
+	    VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_MEMORY_PROPERTIES_2_KHR };
+	memProps2.pNext = &budget;
+	vkGetPhysicalDeviceMemoryProperties2KHR(manager->deviceState.physicalDevice, &memProps2);
+	memProps = memProps2.memoryProperties;
     } else {
-	float minmipmap;
-	std::vector<Resource::Texture> allTextures = getActiveTextures(&minmipmap);
-	TextureSampler s = textureSet->getSampler(0);
-	s.maxLod = minmipmap;
-	textureSet->updateSampler(0, s);
-	textureSet->updateTextures(1, 0, allTextures);
+	vkGetPhysicalDeviceMemoryProperties(manager->deviceState.physicalDevice, &memProps);
     }
+    for(uint32_t i = 0; i < memProps.memoryHeapCount; i++) {
+	MemoryUsage::Heap heap;
+	heap.deviceLocal = (memProps.memoryHeaps[i].flags & VK_MEMORY_HEAP_DEVICE_LOCAL_BIT) != 0;
+	heap.size = memProps.memoryHeaps[i].size;
+	if(manager->deviceState.features.memoryBudget) {
+	    heap.budget = budget.heapBudget[i];
+	    heap.usage = budget.heapUsage[i];
+	}
+	usage.heaps.push_back(heap);
+    }
+    return usage;
 }
 
 void RenderVk::_resize() {
     LOG("resizing");
     _framebufferResized = false;
-    vkDeviceWaitIdle(manager->deviceState.device);
+    // only the frames use the swapchain and attachments,
+    // so uploads on the transfer queue can keep going
+    {
+	std::lock_guard<std::mutex> lock(graphicsPresentMutex);
+	vkQueueWaitIdle(manager->deviceState.queue.graphicsPresentQueue);
+    }
     _initFrameResources();
 }
 
@@ -502,6 +746,14 @@ void RenderVk::_startDraw() {
     frameIndex = (frameIndex + 1) % MAX_CONCURRENT_FRAMES;
     checkResultAndThrow(frames[frameIndex]->waitForPreviousFrame(),
 			"Render Error: failed to wait for previous frame fence");
+    deletionQueue->nextFrame();
+    if(_indirectDraws != nullptr) {
+	// the frame that last used this region is done
+	_indirectDraws->commands = _indirectMapped + frameIndex * INDIRECT_DRAWS_PER_FRAME;
+	_indirectDraws->offset = sizeof(VkDrawIndexedIndirectCommand)
+	    * frameIndex * INDIRECT_DRAWS_PER_FRAME;
+	_indirectDraws->used = 0;
+    }
     VkResult result = swapchain->acquireNextImage(
 	    frames[frameIndex]->swapchainImageReady, &swapchainFrameIndex);
     if(result != VK_SUCCESS && !swapchainRecreationRequired(result))
@@ -509,6 +761,10 @@ void RenderVk::_startDraw() {
     checkResultAndThrow(frames[frameIndex]->startFrame(&currentCommandBuffer),
 			"Render Error: Failed to start command buffer.");
 
+    // mips are submitted before this frame's commands, so it can sample them
+    _streamTextures();
+    _hotReload();
+
     if(usingFinalRenderPass) 
 	offscreenRenderPass->beginRenderPass(currentCommandBuffer, 0);
     else
@@ -516,12 +772,51 @@ void RenderVk::_startDraw() {
 
     for(auto pool: this->shaderPools)
 	pool->setFrameIndex(frameIndex);
+
+    // start using pools whose async loads are done, a frame's textures at a time.
+    // The sampler's max lod is left until the next UseLoadedResources,
+    // as other frames use it, views with fewer mips clamp to them anyway.
+    // Pools in use that were appended to or destroyed are updated the same way.
+    if(_finishAsyncLoads(false) || _texturesChanged) {
+	float minmipmap;
+	((SetVk*)textureSet)->updateTexturesPerFrame(1, getActiveTextures(&minmipmap));
+	_staleTextureViewFrames = MAX_CONCURRENT_FRAMES;
+	_texturesChanged = false;
+    }
+
+    // this frame's descriptor set isn't in use anymore, so can take the new views
+    if(_staleTextureViewFrames > 0) {
+	((SetVk*)textureSet)->refreshTextureViews(1);
+	_staleTextureViewFrames--;
+    }
+    for(size_t i = 0; i < _staleTextureSlots.size();) {
+	((SetVk*)textureSet)->refreshTextureView(1, _staleTextureSlots[i].slot);
+	if(--_staleTextureSlots[i].framesLeft == 0)
+	    _staleTextureSlots.erase(_staleTextureSlots.begin() + i);
+	else
+	    i++;
+    }
     
     currentBonesDynamicIndex = 0;
     currentModelPool = Resource::Pool();
     _begunDraw = true;
 }	
 
+void RenderVk::_streamTextures() {
+    VkDeviceSize budget = renderConf.texture_stream_budget;
+    bool viewsChanged = false;
+    for(int i = 0; i < pools->PoolCount(); i++) {
+	ResourcePoolVk* pool = pools->get(i);
+	if(pool == nullptr)
+	    continue;
+	if(pool->texLoader->streamMips(&budget)
+	   && pool->usingGPUResources)
+	    viewsChanged = true;
+    }
+    if(viewsChanged)
+	_staleTextureViewFrames = MAX_CONCURRENT_FRAMES;
+}
+
 void RenderVk::_store3DsetData() {
     vp3dSet->setData(0, &VP3DData);
     vp3dSet->setData(1, &timeData);
@@ -567,7 +862,8 @@ void RenderVk::_begin(RenderState state) {
 	return;
     }
     if(!_poolInUse(model.pool)) {
-	LOG_ERROR("Tried Drawing with model in pool that is not in use");
+	if(!_poolLoading(model.pool))
+	    LOG_ERROR("Tried Drawing with model in pool that is not in use");
 	return;
     }
     
@@ -580,6 +876,7 @@ void RenderVk::_begin(RenderState state) {
     _currentModel = model;
     perFrame3DData[_current3DInstanceIndex + _modelRuns].model = modelMatrix;
     perFrame3DData[_current3DInstanceIndex + _modelRuns].normalMat = normalMat;
+    _setInstanceLod(model, modelMatrix);
     _modelRuns++;
     
     if (_current3DInstanceIndex + _modelRuns == Resource::MAX_3D_BATCH)
@@ -593,7 +890,8 @@ void RenderVk::DrawAnimModel(Resource::Model model, glm::mat4 modelMatrix,
 	return;
     }
     if(!_poolInUse(model.pool)) {
-	LOG_ERROR("Tried Drawing with model in pool that is not in use");
+	if(!_poolLoading(model.pool))
+	    LOG_ERROR("Tried Drawing with model in pool that is not in use");
 	return;
     }
     _begin(RenderState::DrawAnim3D);
@@ -604,6 +902,7 @@ void RenderVk::DrawAnimModel(Resource::Model model, glm::mat4 modelMatrix,
     _currentColour = glm::vec4(0.0f);
     perFrame3DData[_current3DInstanceIndex + _modelRuns].model = modelMatrix;
     perFrame3DData[_current3DInstanceIndex + _modelRuns].normalMat = normalMat;
+    _setInstanceLod(model, modelMatrix);
     _modelRuns++;
 
     auto animBones = animation->getCurrentBones();
@@ -631,13 +930,15 @@ void RenderVk::DrawQuad(Resource::Texture texture,
       return;
   }
   if(!_poolInUse(texture.pool)) {
-      LOG_ERROR("Tried Drawing with texture in pool that is not in use");
+      if(!_poolLoading(texture.pool))
+	  LOG_ERROR("Tried Drawing with texture in pool that is not in use");
       return;
   }
   _begin(RenderState::Draw2D);
    perFrame2DVertData[_current2DInstanceIndex + _instance2Druns] = modelMatrix;
    perFrame2DFragData[_current2DInstanceIndex + _instance2Druns].colour = colour;
-   perFrame2DFragData[_current2DInstanceIndex + _instance2Druns].texOffset = texOffset;
+   perFrame2DFragData[_current2DInstanceIndex + _instance2Druns].texOffset =
+       texture.atlasTexOffset(texOffset);
    perFrame2DFragData[_current2DInstanceIndex + _instance2Druns].texID =
        pools->get(texture.pool)->texLoader->getViewIndex(texture);
    
@@ -648,15 +949,16 @@ void RenderVk::DrawQuad(Resource::Texture texture,
 }
 
 void RenderVk::DrawString(Resource::Font font,
-			  std::string text,
+			  const std::string &text,
 			  glm::vec2 position,
 			  float size,
 			  float depth,
 			  glm::vec4 colour,
 			  float rotate) {
-    auto draws = pools->get(font.pool)->fontLoader->DrawString(
-	    font, text, position, size, depth, colour, rotate);
-    for (const auto &draw : draws)
+    _stringDraws.clear();
+    pools->get(font.pool)->fontLoader->DrawString(
+	    font, text, position, size, depth, colour, rotate, &_stringDraws);
+    for (const auto &draw : _stringDraws)
 	DrawQuad(draw.tex, draw.model, draw.colour, draw.texOffset);
 }
 
@@ -685,14 +987,27 @@ void RenderVk::_drawBatch() {
 	}
 	if(_modelRuns == 0)
 	    return;
-	pools->get(currentModelPool)->modelLoader->drawModel(
-		currentCommandBuffer,
-		_pipeline3D.getLayout(),
-		_currentModel,
-		_modelRuns,
-		_current3DInstanceIndex);
+	{
+	    uint32_t lodCounts[MAX_MODEL_LODS];
+	    if(_batchHasLods)
+		_sortBatchByLod(lodCounts);
+	    MeshletCullInfo cull {
+		meshletCuller,
+		&perFrame3DData[_current3DInstanceIndex].model,
+		sizeof(shaderStructs::PerFrame3D),
+		_indirectDraws };
+	    pools->get(currentModelPool)->modelLoader->drawModel(
+		    currentCommandBuffer,
+		    _pipeline3D.getLayout(),
+		    _currentModel,
+		    _modelRuns,
+		    _current3DInstanceIndex,
+		    _batchHasLods ? lodCounts : nullptr,
+		    meshletCuller != nullptr ? &cull : nullptr);
+	}
 	_current3DInstanceIndex += _modelRuns;
 	_modelRuns = 0;
+	_batchHasLods = false;
 	break;
     case RenderState::Draw2D:
 	if(_current2DInstanceIndex + _instance2Druns > Resource::MAX_2D_BATCH) {
@@ -719,6 +1034,34 @@ void RenderVk::_drawBatch() {
     }
 }
 
+void RenderVk::_setInstanceLod(Resource::Model model, glm::mat4 modelMatrix) {
+    unsigned int lod = pools->get(model.pool)->modelLoader->getLod(
+	    model, VP3DData.view * modelMatrix, VP3DData.proj);
+    _instanceLods[_current3DInstanceIndex + _modelRuns] = lod;
+    if(lod != 0)
+	_batchHasLods = true;
+}
+
+/// counting sort of the current batch's instance data by lod
+void RenderVk::_sortBatchByLod(uint32_t *lodCounts) {
+    uint32_t lodOffsets[MAX_MODEL_LODS];
+    for(uint32_t lod = 0; lod < MAX_MODEL_LODS; lod++)
+	lodCounts[lod] = 0;
+    for(unsigned int i = 0; i < _modelRuns; i++)
+	lodCounts[_instanceLods[_current3DInstanceIndex + i]]++;
+    uint32_t offset = 0;
+    for(uint32_t lod = 0; lod < MAX_MODEL_LODS; lod++) {
+	lodOffsets[lod] = offset;
+	offset += lodCounts[lod];
+    }
+    for(unsigned int i = 0; i < _modelRuns; i++) {
+	unsigned int index = _current3DInstanceIndex + i;
+	_lodSortData[lodOffsets[_instanceLods[index]]++] = perFrame3DData[index];
+    }
+    std::memcpy(&perFrame3DData[_current3DInstanceIndex], _lodSortData,
+		sizeof(shaderStructs::PerFrame3D) * _modelRuns);
+}
+
 
   VkSubmitInfo submitDrawInfo(Frame *frame, VkPipelineStageFlags *stageFlags) {
       VkSubmitInfo submitInfo{VK_STRUCTURE_TYPE_SUBMIT_INFO};
@@ -780,6 +1123,7 @@ void RenderVk::EndDraw(std::atomic<bool> &submit) {
   if(result == VK_SUCCESS) {
       VkPipelineStageFlags stageFlags = VK_PIPELINE_STAGE_COLOR_ATTACHMENT_OUTPUT_BIT;
       auto info = submitDrawInfo(frames[frameIndex], &stageFlags);
+      _framesIdle = false;
       VkResult result = vkhelper::submitQueue(
 	      manager->deviceState.queue.graphicsPresentQueue,
 	      &info, &graphicsPresentMutex, frames[frameIndex]->frameFinished);
@@ -842,6 +1186,8 @@ void RenderVk::DestroyShaderPool(ShaderPool* pool) {
 void RenderVk::set3DViewMat(glm::mat4 view, glm::vec4 camPos) {
     VP3DData.view = view;
     lightingData.camPos = camPos;
+    if(meshletCuller != nullptr)
+	meshletCuller->setCamera(VP3DData.view, VP3DData.proj);
 }
 
 void RenderVk::set2DViewMat(glm::mat4 view) {
@@ -851,6 +1197,8 @@ void RenderVk::set2DViewMat(glm::mat4 view) {
 void RenderVk::set3DProjMat(glm::mat4 proj) {
     VP3DData.proj = proj;
     VP3DData.proj[1][1] *= -1; // glm has inverted y axis    
+    if(meshletCuller != nullptr)
+	meshletCuller->setCamera(VP3DData.view, VP3DData.proj);
 }
 
 void RenderVk::set2DProjMat(glm::mat4 proj) {
@@ -11,6 +11,7 @@
 
 #include <graphics/render.h>
 #include <graphics/shader_structs.h>
+#include <render-internal/resource-loaders/meshlets.h>
 
 #include "vulkan_manager.h"
 #include "swapchain.h"
@@ -19,9 +20,14 @@
 #include "pipeline.h"
 #include "shader_structs.h"
 #include <atomic>
+#include <mutex>
 #include <vector>
 
 class PoolManagerVk;
+class StagingRing;
+class DeletionQueue;
+class FileWatcher;
+struct IndirectDraws;
 class ShaderPoolVk;
 class ShaderSet;
 
@@ -46,6 +52,11 @@ const size_t MAX_ANIMATIONS_PER_FRAME = 10;
       void setResourcePoolInUse(Resource::Pool pool, bool usePool) override;
       ResourcePool* pool(Resource::Pool pool) override;
       void LoadResourcesToGPU(Resource::Pool pool) override;
+      Resource::LoadTicket LoadResourcesToGPUAsync(Resource::Pool pool) override;
+      bool LoadFinished(Resource::LoadTicket ticket) override;
+      void AppendResourcesToGPU(Resource::Pool pool) override;
+      void ReloadTexture(Resource::Texture texture) override;
+      void ReloadModel(Resource::Model model) override;
 
       // Shader Pools
       ShaderPool* CreateShaderPool();
@@ -59,13 +70,15 @@ const size_t MAX_ANIMATIONS_PER_FRAME = 10;
       
       void UseLoadedResources() override;
 
+      MemoryUsage GetMemoryUsage() override;
+
       // warning: switching between models that are in different pools often is slow
       void DrawModel(Resource::Model model, glm::mat4 modelMatrix, glm::mat4 normalMatrix) override;
       void DrawAnimModel(Resource::Model model, glm::mat4 modelMatrix, glm::mat4 normalMatrix,
 			 Resource::ModelAnimation *animation) override;
       void DrawQuad(Resource::Texture texture, glm::mat4 modelMatrix, glm::vec4 colour,
 		    glm::vec4 texOffset) override;
-      void DrawString(Resource::Font font, std::string text, glm::vec2 position, float size,
+      void DrawString(Resource::Font font, const std::string &text, glm::vec2 position, float size,
 		      float depth, glm::vec4 colour, float rotate) override;
       void EndDraw(std::atomic<bool> &submit) override;
 
@@ -91,14 +104,22 @@ const size_t MAX_ANIMATIONS_PER_FRAME = 10;
       void _initFrameResources();
       void _destroyFrameResources();
       void _startDraw();
+      void _streamTextures();
+      bool _finishAsyncLoads(bool wait);
+      void _waitForFrames();
+      void _watchPoolFiles(Resource::Pool pool);
+      void _hotReload();
       void _begin(RenderState state);
       void _store3DsetData();
       void _store2DsetData();
       void _resize();
       void _drawBatch();
+      void _setInstanceLod(Resource::Model model, glm::mat4 modelMatrix);
+      void _sortBatchByLod(uint32_t *lodCounts);
       void _bindModelPool(Resource::Model model);
       bool _validPool(Resource::Pool pool);
       bool _poolInUse(Resource::Pool pool);
+      bool _poolLoading(Resource::Pool pool);
       void _throwIfPoolInvaid(Resource::Pool pool);
       std::vector<Resource::Texture> getActiveTextures(float* getMinMipmap);
             
@@ -155,12 +176,56 @@ const size_t MAX_ANIMATIONS_PER_FRAME = 10;
       Resource::Pool defaultResourcePool;
       ResourcePoolVk* framebufferResourcePool;
       PoolManagerVk* pools;
+      // every pool copies its data to the gpu through this
+      StagingRing* stagingRing;
+      // resources frames in flight may be using are freed through this
+      DeletionQueue* deletionQueue;
 
       bool _begunDraw = false;
+      // frames left whose texture descriptors need the views of newly streamed mips
+      uint32_t _staleTextureViewFrames = 0;
+      // pools loaded async whose uploads may not be finished
+      struct AsyncLoad {
+	  Resource::Pool pool;
+	  uint64_t submitted;
+	  uint64_t ticket;
+      };
+      std::vector<AsyncLoad> _asyncLoads;
+      uint64_t _loadTicketCount = 0;
+      // LoadFinished can be checked from other threads than the one loading
+      std::mutex _asyncLoadMutex;
+      // the graphics queue was waited on since the last frame was submitted,
+      // so in-place reloads don't need to wait for it again
+      bool _framesIdle = false;
+      // the textures of the pools in use changed, so the descriptors need them
+      bool _texturesChanged = false;
+      // slots in the texture descriptors given a new view by a reload,
+      // and how many frames' sets still have the old one
+      struct StaleTextureSlot {
+	  uint32_t slot;
+	  uint32_t framesLeft;
+      };
+      std::vector<StaleTextureSlot> _staleTextureSlots;
+      // null unless hot_reload is set
+      FileWatcher* fileWatcher = nullptr;
       RenderState _renderState;
+      // reused by DrawString, so drawing text doesn't allocate
+      std::vector<Resource::QuadDraw> _stringDraws;
 
       unsigned int _modelRuns = 0;
       unsigned int _current3DInstanceIndex = 0;
+      // level of detail of each 3D instance, instances in a batch
+      // get sorted by lod before drawing so each lod is one draw
+      unsigned int _instanceLods[Resource::MAX_3D_BATCH];
+      shaderStructs::PerFrame3D _lodSortData[Resource::MAX_3D_BATCH];
+      bool _batchHasLods = false;
+      meshopt::MeshletCuller* meshletCuller = nullptr;
+      // culled meshes are drawn through this if the device has multi draw indirect.
+      // it has a region of commands for each frame in flight.
+      IndirectDraws* _indirectDraws = nullptr;
+      VkBuffer _indirectBuffer = VK_NULL_HANDLE;
+      VkDeviceMemory _indirectMemory = VK_NULL_HANDLE;
+      VkDrawIndexedIndirectCommand* _indirectMapped = nullptr;
       Resource::Model _currentModel;
       Resource::Texture _currentTexture;
       glm::vec4 _currentTexOffset = glm::vec4(0, 0, 1, 1);
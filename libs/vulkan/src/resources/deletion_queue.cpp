@@ -0,0 +1,57 @@
+#include "deletion_queue.h"
+
+DeletionQueue::DeletionQueue(StagingRing* stagingRing, uint32_t framesInFlight) {
+    this->stagingRing = stagingRing;
+    this->framesInFlight = framesInFlight;
+}
+
+DeletionQueue::~DeletionQueue() {
+    flush();
+}
+
+void DeletionQueue::push(std::function<void()> destroy, uint64_t transferSubmit) {
+    std::lock_guard<std::mutex> lock(queueMutex);
+    entries.push_back({ destroy, framesInFlight, transferSubmit });
+}
+
+void DeletionQueue::nextFrame() {
+    std::vector<std::function<void()>> ready;
+    {
+	std::lock_guard<std::mutex> lock(queueMutex);
+	std::unique_lock<std::mutex> ringLock(stagingRing->mutex(), std::defer_lock);
+	bool ringBusy = false;
+	for(size_t i = 0; i < entries.size();) {
+	    Entry &entry = entries[i];
+	    if(entry.transferSubmit != 0) {
+		// another thread is loading through the ring, so check again next frame
+		if(!ringBusy && !ringLock.owns_lock())
+		    ringBusy = !ringLock.try_lock();
+		if(!ringBusy && stagingRing->finished(entry.transferSubmit)) {
+		    // the acquires may have only just been submitted to the graphics queue,
+		    // so count from the frame being started
+		    entry.transferSubmit = 0;
+		    entry.framesLeft = framesInFlight;
+		}
+		i++;
+	    } else if(--entry.framesLeft == 0) {
+		ready.push_back(entry.destroy);
+		entries.erase(entries.begin() + i);
+	    } else {
+		i++;
+	    }
+	}
+    }
+    // freed in the order they were pushed, ie images before their memory
+    for(auto &destroy: ready)
+	destroy();
+}
+
+void DeletionQueue::flush() {
+    std::vector<Entry> left;
+    {
+	std::lock_guard<std::mutex> lock(queueMutex);
+	left.swap(entries);
+    }
+    for(auto &entry: left)
+	entry.destroy();
+}
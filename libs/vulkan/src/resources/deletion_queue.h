@@ -0,0 +1,43 @@
+#ifndef VK_ENV_DELETION_QUEUE_H
+#define VK_ENV_DELETION_QUEUE_H
+
+#include "staging_ring.h"
+#include <functional>
+#include <vector>
+#include <mutex>
+
+/// Gpu resources that frames in flight may still be using are freed through this,
+/// so the device doesn't have to be idle to get rid of them.
+/// Each is freed once the frames that were in flight when it was pushed are done.
+class DeletionQueue {
+public:
+    DeletionQueue(StagingRing* stagingRing, uint32_t framesInFlight);
+    /// frees everything left, the device must be idle
+    ~DeletionQueue();
+
+    /// Free with destroy once the frames in flight are done.
+    /// If transferSubmit isn't 0, the resource was written through the staging ring,
+    /// so it also waits for that submit, and for the frames after its ownership acquires.
+    void push(std::function<void()> destroy, uint64_t transferSubmit = 0);
+
+    /// Call once a frame, after waiting for the fence of the frame being started.
+    /// Resources waiting on the staging ring are skipped if another thread is using it.
+    void nextFrame();
+
+    /// free everything now, the device must be idle
+    void flush();
+
+private:
+    struct Entry {
+	std::function<void()> destroy;
+	uint32_t framesLeft;
+	uint64_t transferSubmit;
+    };
+
+    StagingRing* stagingRing;
+    uint32_t framesInFlight;
+    std::mutex queueMutex;
+    std::vector<Entry> entries;
+};
+
+#endif
@@ -1,12 +1,18 @@
 #include "model_loader.h"
 
 #include <stdexcept>
-#include <cstring>
+#include <algorithm>
 
 #include "../vkhelper.h"
 #include "../logger.h"
 #include "../pipeline_data.h"
-#include "../parts/threading.h"
+
+// vertex staging memory is handed out from blocks of at least this size
+const size_t VERTEX_STAGING_BLOCK_SIZE = 16 * 1024 * 1024;
+// enough for any vertex type's alignment
+const size_t VERTEX_DATA_ALIGNMENT = 16;
+// appended models get a buffer at least this big, so the next appends can use the rest
+const VkDeviceSize MODEL_BUFFER_CHUNK_SIZE = 16 * 1024 * 1024;
 
 struct GPUMeshVk : public GPUMesh {
     GPUMeshVk() {}
@@ -35,13 +41,20 @@ struct GPUModelVk : public GPUModel {
     // or checking if only one type of vertex is used by all models
     // then using only a single vertex buffer binding
     uint32_t vertexOffset = 0;
+    // in indices, from the start of the 16 or 32 bit index region
     uint32_t indexOffset = 0;
-    uint32_t vertexDataOffset = 0;
+    // the buffer chunk the model was loaded into
+    VkBuffer buffer;
+    VkDeviceSize vertexDataOffset = 0;
+    // start of the index region of the model's load in buffer
+    VkDeviceSize indexDataOffset = 0;
+    VkIndexType indexType;
 
     GPUModelVk(ModelData *model) : GPUModel(model) {}
     
     void draw(VkCommandBuffer cmdBuff,
 	      uint32_t meshIndex,
+	      uint32_t lod,
 	      uint32_t instanceCount,
 	      uint32_t instanceOffset) {
 	if(meshIndex >= meshes.size()) {
@@ -50,63 +63,144 @@ struct GPUModelVk : public GPUModel {
 		      " - mesh count: " << meshes.size());
 	    return;
 	}
+	if(instanceCount == 0)
+	    return;
+	// meshes can have fewer lods than the model
+	std::vector<IndexRange> &lods = meshes[meshIndex].lods;
+	IndexRange range = lods[lod < lods.size() ? lod : lods.size() - 1];
 	vkCmdDrawIndexed(
 		cmdBuff,
-		meshes[meshIndex].indexCount,
+		range.count,
 		instanceCount,
 		meshes[meshIndex].indexOffset
+		+ range.offset
 		+ indexOffset,
 		meshes[meshIndex].vertexOffset
 		+ vertexOffset,
 		instanceOffset);
     }
+
+    /// draw each instance with only the meshlets it could see
+    void drawCulled(VkCommandBuffer cmdBuff,
+		    uint32_t meshIndex,
+		    uint32_t instanceCount,
+		    uint32_t instanceOffset,
+		    MeshletCullInfo *cull) {
+	GPUMeshVk &mesh = meshes[meshIndex];
+	cull->culler->cull(mesh.meshlets, cull->modelMatrices, cull->stride,
+			   instanceCount, false);
+	IndirectDraws* indirect = cull->indirect;
+	if(indirect != nullptr) {
+	    uint32_t rangeCount = 0;
+	    for(uint32_t i = 0; i < instanceCount; i++)
+		rangeCount += (uint32_t)cull->culler->ranges(i).size();
+	    if(rangeCount == 0)
+		return;
+	    if(indirect->used + rangeCount <= indirect->capacity) {
+		VkDrawIndexedIndirectCommand* cmd = indirect->commands + indirect->used;
+		for(uint32_t i = 0; i < instanceCount; i++)
+		    for(auto &range: cull->culler->ranges(i)) {
+			cmd->indexCount = range.second;
+			cmd->instanceCount = 1;
+			cmd->firstIndex = mesh.indexOffset + range.first + indexOffset;
+			cmd->vertexOffset = (int32_t)(mesh.vertexOffset + vertexOffset);
+			cmd->firstInstance = instanceOffset + i;
+			cmd++;
+		    }
+		vkCmdDrawIndexedIndirect(
+			cmdBuff, indirect->buffer,
+			indirect->offset + indirect->used * sizeof(VkDrawIndexedIndirectCommand),
+			rangeCount, sizeof(VkDrawIndexedIndirectCommand));
+		indirect->used += rangeCount;
+		return;
+	    }
+	}
+	for(uint32_t i = 0; i < instanceCount; i++)
+	    for(auto &range: cull->culler->ranges(i))
+		vkCmdDrawIndexed(
+			cmdBuff,
+			range.second,
+			1,
+			mesh.indexOffset + range.first + indexOffset,
+			mesh.vertexOffset + vertexOffset,
+			instanceOffset + i);
+    }
 };
 	
-ModelLoaderVk::ModelLoaderVk(DeviceState base, VkCommandPool cmdpool,
-			     VkCommandBuffer generalCmdBuff,
-			     Resource::Pool pool, BasePoolManager* pools)
-    : InternalModelLoader(pool, pools) {
+ModelLoaderVk::ModelLoaderVk(DeviceState base, StagingRing* stagingRing, DeletionQueue* deletionQueue,
+			     Resource::Pool pool, BasePoolManager* pools, RenderConfig conf)
+    : InternalModelLoader(pool, pools, conf) {
       this->base = base;
-      this->cmdpool = cmdpool;
-      this->cmdbuff = generalCmdBuff;
-      checkResultAndThrow(part::create::Fence(base.device, &loadedFence, false),
-			  "failed to create finish load semaphore in model loader");
+      this->stagingRing = stagingRing;
+      this->deletionQueue = deletionQueue;
 }
 
 ModelLoaderVk::~ModelLoaderVk() {
-    vkDestroyFence(base.device, loadedFence, nullptr);
+    clearStaged();
+    loadFinished();
     clearGPU();
 }
 
 void ModelLoaderVk::clearGPU() {
-    vertexDataSize = 0;
-    indexDataSize = 0;
     if(models.empty())
 	return;
     for(GPUModelVk* model: models)
 	delete model;
     models.clear();      
-      
-    vkDestroyBuffer(base.device, buffer, nullptr);
-    vkFreeMemory(base.device, memory, nullptr);
+    loadedSources.clear();
+
+    // the buffers may still have ownership acquires to come from their copies
+    uint64_t submitted;
+    {
+	std::lock_guard<std::mutex> lock(stagingRing->mutex());
+	submitted = stagingRing->submit(false);
+    }
+    VkDevice device = base.device;
+    for(auto &chunk: bufferChunks) {
+	BufferChunk c = chunk;
+	deletionQueue->push([device, c] {
+	    vkDestroyBuffer(device, c.buffer, nullptr);
+	    vkFreeMemory(device, c.memory, nullptr);
+	}, submitted);
+    }
+    bufferChunks.clear();
+}
+
+VkDeviceSize ModelLoaderVk::gpuMemory() {
+    VkDeviceSize size = 0;
+    for(auto &chunk: bufferChunks)
+	size += chunk.size;
+    return size;
 }
 
+// the index buffer depends on where the model drawn was loaded,
+// so is bound by the first one drawn
 void ModelLoaderVk::bindBuffers(VkCommandBuffer cmdBuff) {
-    vkCmdBindIndexBuffer(cmdBuff, buffer, vertexDataSize, VK_INDEX_TYPE_UINT32);
+    boundIndexBuffer = VK_NULL_HANDLE;
 }
 
 GPUModelVk* ModelLoaderVk::getModel(VkCommandBuffer cmdBuff, Resource::Model model) {
-    if(model.ID >= models.size()) {
+    size_t index = gpuIndex(model);
+    if(index >= models.size()) {
 	LOG_ERROR("in draw with out of range model. id: "
                   << model.ID << " -  model count: " << models.size());
 	return nullptr;
     }
 
-    GPUModelVk *modelInfo = models[model.ID];
+    GPUModelVk *modelInfo = models[index];
 
-    VkBuffer vertexBuffers[] = { buffer };
+    VkBuffer vertexBuffers[] = { modelInfo->buffer };
     VkDeviceSize offsets[] = { modelInfo->vertexDataOffset };
     vkCmdBindVertexBuffers(cmdBuff, 0, 1, vertexBuffers, offsets);
+    if(modelInfo->buffer != boundIndexBuffer ||
+       modelInfo->indexDataOffset != boundIndexOffset ||
+       modelInfo->indexType != boundIndexType) {
+	vkCmdBindIndexBuffer(cmdBuff, modelInfo->buffer, modelInfo->indexDataOffset,
+			     modelInfo->indexType);
+	boundIndexBuffer = modelInfo->buffer;
+	boundIndexOffset = modelInfo->indexDataOffset;
+	boundIndexType = modelInfo->indexType;
+    }
     return modelInfo;
 }
 
@@ -114,7 +208,9 @@ void ModelLoaderVk::drawModel(VkCommandBuffer cmdBuff,
 			      VkPipelineLayout layout,
 			      Resource::Model model,
 			      uint32_t count,
-			      uint32_t instanceOffset) {
+			      uint32_t instanceOffset,
+			      const uint32_t *lodCounts,
+			      MeshletCullInfo *cull) {
     if(count == 0)
 	return;
 
@@ -129,7 +225,18 @@ void ModelLoaderVk::drawModel(VkCommandBuffer cmdBuff,
 	};
 	vkCmdPushConstants(cmdBuff, layout, VK_SHADER_STAGE_FRAGMENT_BIT,
 			   0, sizeof(fragPushConstants), &fps);
-	modelInfo->draw(cmdBuff, (uint32_t)i, count, instanceOffset);
+	uint32_t fullDetailCount = lodCounts == nullptr ? count : lodCounts[0];
+	if(cull != nullptr && !modelInfo->meshes[i].meshlets.empty())
+	    modelInfo->drawCulled(cmdBuff, (uint32_t)i, fullDetailCount, instanceOffset, cull);
+	else
+	    modelInfo->draw(cmdBuff, (uint32_t)i, 0, fullDetailCount, instanceOffset);
+	if(lodCounts == nullptr)
+	    continue;
+	uint32_t offset = instanceOffset + lodCounts[0];
+	for(uint32_t lod = 1; lod < MAX_MODEL_LODS; lod++) {
+	    modelInfo->draw(cmdBuff, (uint32_t)i, lod, lodCounts[lod], offset);
+	    offset += lodCounts[lod];
+	}
     }
 }
 
@@ -141,52 +248,166 @@ void ModelLoaderVk::drawQuad(VkCommandBuffer cmdBuff,
 	return;
     GPUModelVk* modelInfo = getModel(cmdBuff, quad);
     if(modelInfo == nullptr) return;
-    modelInfo->draw(cmdBuff, 0, count, instanceOffset);    
+    modelInfo->draw(cmdBuff, 0, 0, count, instanceOffset);    
 }
 
 void ModelLoaderVk::loadGPU() {
-    clearGPU();
-    loadQuad();
-
-    processModelData();
-
-    VkBuffer stagingBuffer;
-    VkDeviceMemory stagingMemory;
+    loadGPU(true, false);
+}
 
-    if(vkhelper::createBufferAndMemory(
-	       base, vertexDataSize + indexDataSize,
-	       &stagingBuffer, &stagingMemory,
-	       VK_BUFFER_USAGE_TRANSFER_SRC_BIT,
-	       VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT |
-	       VK_MEMORY_PROPERTY_HOST_COHERENT_BIT) != VK_SUCCESS)
-	throw std::runtime_error("Failed to create staging buffer for model data");
+uint64_t ModelLoaderVk::loadGPUAsync() {
+    return loadGPU(false, false);
+}
 
-    vkBindBufferMemory(base.device, stagingBuffer, stagingMemory, 0);
-    void* pMem;
-    vkMapMemory(base.device, stagingMemory, 0, vertexDataSize + indexDataSize, 0, &pMem);
+void ModelLoaderVk::appendGPU() {
+    loadGPU(true, true);
+}
 
-    stageModelData(pMem);
+uint64_t ModelLoaderVk::loadGPU(bool wait, bool append) {
+    if(!append)
+	clearGPU();
+    else if(staged.empty())
+	return 0;
+    // only the staged models are copied, the rest are left where they are
+    size_t first = models.size();
+    GpuLoadState before = gpuLoadState();
+    size_t chunkCount = bufferChunks.size();
+    VkDeviceSize chunkUsed = chunkCount > 0 ? bufferChunks.back().used : 0;
+    uint64_t submitted;
+    try {
+	startGpuLoad(first);
+
+	processModelData(first);
+	placeModelData(first, append);
+
+	std::lock_guard<std::mutex> lock(stagingRing->mutex());
+	try {
+	    copyModelDataToGPU();
+	} catch(std::exception &e) {
+	    // the recorded copies read the vertex staging blocks, so finish them before they are freed
+	    stagingRing->submit(true);
+	    throw;
+	}
+	submitted = stagingRing->submit(wait);
+    } catch(std::exception &e) {
+	// the failed load's models were never drawn with
+	for(size_t i = first; i < models.size(); i++)
+	    delete models[i];
+	models.resize(first);
+	// nothing is copying to the placed space any more, so the next load can have it
+	if(bufferChunks.size() > chunkCount)
+	    bufferChunks.back().used = 0;
+	else if(chunkCount > 0)
+	    bufferChunks.back().used = chunkUsed;
+	failedGpuLoad(before);
+	throw;
+    }
 
+    // the copies may still be reading the vertex staging blocks
+    if(!wait) {
+	inFlightVertexStaging.insert(inFlightVertexStaging.end(),
+				     vertexStaging.begin(), vertexStaging.end());
+	vertexStaging.clear();
+    }
     clearStaged();
 
-    copyModelDataToGPU(stagingBuffer);
-
-    //free staging buffer
-    vkDestroyBuffer(base.device, stagingBuffer, nullptr);
-    vkFreeMemory(base.device, stagingMemory, nullptr);
-
     LOG("finished loading Model Data to gpu");
+    return submitted;
 }
 
-void ModelLoaderVk::processModelData() {
+void ModelLoaderVk::reload(Resource::Model model, std::function<void()> waitForFrames) {
+    size_t index = gpuIndex(model);
+    // the reload gets its own staging blocks, so they are freed once it is copied
+    std::vector<VertexStaging> setAsideStaging;
+    setAsideStaging.swap(vertexStaging);
+    auto endStaging = [&]() {
+	freeVertexData();
+	vertexStaging.swap(setAsideStaging);
+    };
+    bool begun;
+    try {
+	begun = index < models.size() && beginReload(model);
+    } catch(std::exception &e) {
+	endStaging();
+	throw;
+    }
+    if(!begun) {
+	endStaging();
+	LOG_ERROR("model loader - reload: model wasn't loaded from a file in this pool. id: "
+		  << model.ID);
+	return;
+    }
+    GPUModelVk* old = models[index];
+    size_t first = models.size();
+    processModelData(first);
+    GPUModelVk* reloaded = models[first];
+    models.pop_back();
+    for(size_t i = 0; i < reloaded->meshes.size() && i < old->meshes.size(); i++)
+	reloaded->meshes[i].texture = old->meshes[i].texture;
+    if(reloaded->indexType == old->indexType &&
+       reloaded->vertexCount <= old->vertexCount &&
+       reloaded->indexCount <= old->indexCount) {
+	// frames in flight may still be drawing the old data
+	waitForFrames();
+	reloaded->buffer = old->buffer;
+	reloaded->vertexDataOffset = old->vertexDataOffset;
+	reloaded->indexDataOffset = old->indexDataOffset;
+	reloaded->indexOffset = old->indexOffset;
+	loadBuffer = old->buffer;
+	vertexDst = old->vertexDataOffset;
+	if(old->indexType == VK_INDEX_TYPE_UINT16) {
+	    shortIndexDst = old->indexDataOffset + old->indexOffset * sizeof(uint16_t);
+	    // without the padding, which may be past the old model's space
+	    shortIndexDataSize = sizeof(uint16_t) * reloaded->indexCount;
+	} else {
+	    indexDst = old->indexDataOffset + old->indexOffset * sizeof(uint32_t);
+	}
+    } else {
+	// placed as if appended, so only the reloaded model is moved
+	models.push_back(reloaded);
+	try {
+	    placeModelData(first, true);
+	} catch(std::exception &e) {
+	    models.pop_back();
+	    delete reloaded;
+	    endReload();
+	    endStaging();
+	    throw;
+	}
+	models.pop_back();
+    }
+    {
+	std::lock_guard<std::mutex> lock(stagingRing->mutex());
+	copyModelDataToGPU();
+	stagingRing->submit(true);
+    }
+    models[index] = reloaded;
+    delete old;
+    endReload();
+    endStaging();
+}
+
+void ModelLoaderVk::processModelData(size_t first) {
     uint32_t modelVertexOffset = 0;
-    models.resize(staged.size());
+    // size if every model used 32 bit indices, for the memory report
+    uint32_t fullIndexDataSize = 0;
+    vertexDataSize = 0;
+    shortIndexDataSize = 0;
+    indexDataSize = 0;
+    models.resize(first + staged.size());
     for(int i = 0; i < staged.size(); i++) {
 	GPUModelVk* model = new GPUModelVk(staged[i]);
 	// zero for now as may be multiple vertex types packed together
 	model->vertexOffset = 0;//modelVertexOffset;
 	model->vertexDataOffset = vertexDataSize;
-	model->indexOffset = indexDataSize / sizeof(staged[i]->meshes[0]->indices[0]);
+	uint32_t indexSize = staged[i]->indexSize;
+	uint32_t* regionSize = &indexDataSize;
+	model->indexType = VK_INDEX_TYPE_UINT32;
+	if(indexSize == sizeof(uint16_t)) {
+	    regionSize = &shortIndexDataSize;
+	    model->indexType = VK_INDEX_TYPE_UINT16;
+	}
+	model->indexOffset = *regionSize / indexSize;
 	model->meshes.resize(staged[i]->meshes.size());
 	for(int j = 0 ; j <  staged[i]->meshes.size(); j++) {
 	    MeshData* mesh = staged[i]->meshes[j];
@@ -198,83 +419,227 @@ void ModelLoaderVk::processModelData() {
 	    model->indexCount  += (uint32_t)mesh->indices.size();
 	    vertexDataSize += (uint32_t)(
 		    model->vertType.size * mesh->vertexCount);
-	    indexDataSize +=  (uint32_t)(
-		    sizeof(mesh->indices[0]) * mesh->indices.size());
+	    *regionSize += (uint32_t)(indexSize * mesh->indices.size());
+	    fullIndexDataSize += (uint32_t)(sizeof(uint32_t) * mesh->indices.size());
 	}
 	modelVertexOffset += model->vertexCount;
 	
-	models[i] = model;
+	models[first + i] = model;
     }
-    LOG("Loading model data - size: " << vertexDataSize + indexDataSize);
+    // keep the 32 bit region aligned
+    shortIndexDataSize += shortIndexDataSize % sizeof(uint32_t);
+    LOG("Loading model data - size: "
+	<< vertexDataSize + shortIndexDataSize + indexDataSize);
+    LOG("Model index memory - pool: " << pool.ID <<
+	" - all 32 bit: " << fullIndexDataSize <<
+	" - 16 bit: " << shortIndexDataSize <<
+	" - 32 bit: " << indexDataSize <<
+	" - saved: " << (int64_t)fullIndexDataSize - (shortIndexDataSize + indexDataSize));
 }
 
-void ModelLoaderVk::stageModelData(void* pMem) {
-    size_t vertexOffset = 0;
-    size_t indexOffset = vertexDataSize;
+void ModelLoaderVk::placeModelData(size_t first, bool append) {
+    VkDeviceSize size = vertexDataSize + shortIndexDataSize + indexDataSize;
+    if(bufferChunks.empty() || vkhelper::correctMemoryAlignment(
+	       bufferChunks.back().used, VERTEX_DATA_ALIGNMENT) + size > bufferChunks.back().size) {
+	// a load that replaces the models is usually all the pool will have,
+	// so only appends leave room for more
+	BufferChunk chunk;
+	chunk.size = append ? std::max(size, MODEL_BUFFER_CHUNK_SIZE) : size;
+	chunk.used = 0;
+	if(vkhelper::createBufferAndMemory(
+		   base, chunk.size, &chunk.buffer, &chunk.memory,
+		   VK_BUFFER_USAGE_VERTEX_BUFFER_BIT |
+		   VK_BUFFER_USAGE_INDEX_BUFFER_BIT |
+		   VK_BUFFER_USAGE_TRANSFER_DST_BIT,
+		   VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT) != VK_SUCCESS)
+	    throw std::runtime_error("Failed to create buffer for model data");
+	vkBindBufferMemory(base.device, chunk.buffer, chunk.memory, 0);
+	bufferChunks.push_back(chunk);
+    }
+    BufferChunk &chunk = bufferChunks.back();
+    loadBuffer = chunk.buffer;
+    VkDeviceSize loadOffset = vkhelper::correctMemoryAlignment(chunk.used, VERTEX_DATA_ALIGNMENT);
+    chunk.used = loadOffset + size;
+    vertexDst = loadOffset;
+    shortIndexDst = loadOffset + vertexDataSize;
+    indexDst = shortIndexDst + shortIndexDataSize;
+    for(size_t i = first; i < models.size(); i++) {
+	GPUModelVk* model = models[i];
+	model->buffer = loadBuffer;
+	model->vertexDataOffset += loadOffset;
+	model->indexDataOffset = loadOffset + vertexDataSize;
+	if(model->indexType == VK_INDEX_TYPE_UINT32)
+	    model->indexDataOffset += shortIndexDataSize;
+    }
+}
+
+// indices of each model are written into the staging ring and copied after the vertices
+void ModelLoaderVk::stageIndexData() {
+    VkDeviceSize shortIndexOffset = shortIndexDst;
+    VkDeviceSize indexOffset = indexDst;
+    std::vector<char> tooBig;
     for(auto model: staged) {
-	for(size_t i = 0; i < model->meshes.size(); i++) {
-	      
-	    std::memcpy(static_cast<char*>(pMem) + vertexOffset,
-			model->meshes[i]->vertices,
-			model->format.size * model->meshes[i]->vertexCount);
-	      
-	    vertexOffset += model->format.size * model->meshes[i]->vertexCount;
-	      
-	    std::memcpy(static_cast<char*>(pMem) + indexOffset,
-			model->meshes[i]->indices.data(),
-			sizeof(model->meshes[i]->indices[0])
-			* model->meshes[i]->indices.size());
-	      
-	    indexOffset += sizeof(model->meshes[i]->indices[0])
-		* model->meshes[i]->indices.size();	      
+	VkDeviceSize* modelIndexOffset = model->indexSize == sizeof(uint16_t) ?
+	    &shortIndexOffset : &indexOffset;
+	VkDeviceSize size = 0;
+	for(auto mesh: model->meshes)
+	    size += model->indexSize * mesh->indices.size();
+	if(size == 0)
+	    continue;
+	char* pMem;
+	StagingRing::Space space;
+	if(size <= stagingRing->capacity()) {
+	    space = stagingRing->allocate(size, sizeof(uint32_t));
+	    pMem = reinterpret_cast<char*>(space.data);
+	} else {
+	    tooBig.resize(size);
+	    pMem = tooBig.data();
+	}
+	VkDeviceSize offset = 0;
+	for(auto mesh: model->meshes) {
+	    mesh->copyIndices(pMem + offset, model->indexSize);
+	    offset += model->indexSize * mesh->indices.size();
 	}
+	if(size <= stagingRing->capacity()) {
+	    VkBufferCopy region{};
+	    region.srcOffset = space.offset;
+	    region.dstOffset = *modelIndexOffset;
+	    region.size = size;
+	    vkCmdCopyBuffer(stagingRing->commandBuffer(), space.buffer, loadBuffer, 1, &region);
+	} else {
+	    stagingRing->copyToBuffer(pMem, size, loadBuffer, *modelIndexOffset);
+	    std::vector<char>().swap(tooBig);
+	}
+	*modelIndexOffset += size;
     }
 }
 
-void ModelLoaderVk::copyModelDataToGPU(VkBuffer stagingBuffer) {
+void ModelLoaderVk::copyModelDataToGPU() {
     LOG("Copying Model Data to GPU");
-    // create final GPU memory
-    vkhelper::createBufferAndMemory(
-	    base, vertexDataSize + indexDataSize, &buffer, &memory,
-	    VK_BUFFER_USAGE_VERTEX_BUFFER_BIT |
-	    VK_BUFFER_USAGE_INDEX_BUFFER_BIT |
-	    VK_BUFFER_USAGE_TRANSFER_DST_BIT,
-	    VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT);
-    vkBindBufferMemory(base.device, buffer, memory, 0);
-
-    VkCommandBufferBeginInfo beginInfo{ VK_STRUCTURE_TYPE_COMMAND_BUFFER_BEGIN_INFO };
-    beginInfo.flags = VK_COMMAND_BUFFER_USAGE_ONE_TIME_SUBMIT_BIT;
-    vkBeginCommandBuffer(cmdbuff, &beginInfo);
-
-    VkBufferCopy copyRegion{};
-    copyRegion.srcOffset = 0;
-    copyRegion.dstOffset = 0;
-    copyRegion.size = vertexDataSize + indexDataSize;
-    vkCmdCopyBuffer(cmdbuff, stagingBuffer, buffer, 1, &copyRegion);
-    vkEndCommandBuffer(cmdbuff);
-
-    checkResultAndThrow(vkhelper::submitCmdBuffAndWait(
-				base.device,
-				base.queue.graphicsPresentQueue,
-				&cmdbuff, loadedFence,
-				&graphicsPresentMutex),
-			"failed to submit model load commands");
+
+    // copy each mesh's vertices from the staging block they were converted into
+    std::vector<std::vector<VkBufferCopy>> vertexRegions(vertexStaging.size());
+    VkDeviceSize vertexOffset = vertexDst;
+    for(auto model: staged) {
+	for(auto mesh: model->meshes) {
+	    VkDeviceSize size = model->format.size * mesh->vertexCount;
+	    if(size == 0)
+		continue;
+	    char* data = static_cast<char*>(mesh->vertices);
+	    for(size_t i = 0; i < vertexStaging.size(); i++) {
+		VertexStaging &staging = vertexStaging[i];
+		if(data < staging.data || data >= staging.data + staging.size)
+		    continue;
+		VkBufferCopy region{};
+		region.srcOffset = data - staging.data;
+		region.dstOffset = vertexOffset;
+		region.size = size;
+		std::vector<VkBufferCopy> &regions = vertexRegions[i];
+		// meshes of the same load are next to each other in both buffers
+		if(!regions.empty() &&
+		   regions.back().srcOffset + regions.back().size == region.srcOffset &&
+		   regions.back().dstOffset + regions.back().size == region.dstOffset)
+		    regions.back().size += size;
+		else
+		    regions.push_back(region);
+		break;
+	    }
+	    vertexOffset += size;
+	}
+    }
+    VkCommandBuffer cmdbuff = stagingRing->commandBuffer();
+    for(size_t i = 0; i < vertexStaging.size(); i++)
+	if(!vertexRegions[i].empty())
+	    vkCmdCopyBuffer(cmdbuff, vertexStaging[i].buffer, loadBuffer,
+			    (uint32_t)vertexRegions[i].size(), vertexRegions[i].data());
+
+    stageIndexData();
+
+    // only this load's parts, frames may be drawing from the rest of the chunk
+    VkBufferMemoryBarrier barrier{ VK_STRUCTURE_TYPE_BUFFER_MEMORY_BARRIER };
+    barrier.buffer = loadBuffer;
+    barrier.dstAccessMask = VK_ACCESS_VERTEX_ATTRIBUTE_READ_BIT | VK_ACCESS_INDEX_READ_BIT;
+    VkDeviceSize ranges[3][2] = {
+	{ vertexDst, vertexDataSize },
+	{ shortIndexDst, shortIndexDataSize },
+	{ indexDst, indexDataSize },
+    };
+    for(auto &range: ranges) {
+	if(range[1] == 0)
+	    continue;
+	barrier.offset = range[0];
+	barrier.size = range[1];
+	stagingRing->bufferReady(barrier, VK_PIPELINE_STAGE_VERTEX_INPUT_BIT);
+    }
 }
 
 Resource::ModelAnimation ModelLoaderVk::getAnimation(Resource::Model model, std::string animation) {
-    if(model.ID >= models.size()) {
+    size_t modelIndex = gpuIndex(model);
+    if(modelIndex >= models.size()) {
 	LOG_ERROR("in getAnimation with out of range model. id: "
                   << model.ID << " -  model count: " << models.size());
 	return Resource::ModelAnimation();
     }
-    return models[model.ID]->getAnimation(animation);
+    return models[modelIndex]->getAnimation(animation);
 }
 
 Resource::ModelAnimation ModelLoaderVk::getAnimation(Resource::Model model, int index) {
-    if(model.ID >= models.size()) {
+    size_t modelIndex = gpuIndex(model);
+    if(modelIndex >= models.size()) {
 	LOG_ERROR("in getAnimation with out of range model. id: "
                   << model.ID << " -  model count: " << models.size());
 	return Resource::ModelAnimation();
     }
-    return models[model.ID]->getAnimation(index);
+    return models[modelIndex]->getAnimation(index);
+}
+
+void* ModelLoaderVk::allocateVertexData(size_t size) {
+    if(size == 0)
+	return nullptr;
+    size = (size + VERTEX_DATA_ALIGNMENT - 1) & ~(VERTEX_DATA_ALIGNMENT - 1);
+    if(vertexStaging.empty() ||
+       vertexStaging.back().used + size > vertexStaging.back().size) {
+	VertexStaging staging;
+	staging.size = std::max(size, VERTEX_STAGING_BLOCK_SIZE);
+	staging.used = 0;
+	if(vkhelper::createBufferAndMemory(
+		   base, staging.size,
+		   &staging.buffer, &staging.memory,
+		   VK_BUFFER_USAGE_TRANSFER_SRC_BIT,
+		   VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT |
+		   VK_MEMORY_PROPERTY_HOST_COHERENT_BIT) != VK_SUCCESS)
+	    throw std::runtime_error("Failed to create staging buffer for vertex data");
+	vkBindBufferMemory(base.device, staging.buffer, staging.memory, 0);
+	void* data;
+	vkMapMemory(base.device, staging.memory, 0, staging.size, 0, &data);
+	staging.data = static_cast<char*>(data);
+	vertexStaging.push_back(staging);
+    }
+    VertexStaging &staging = vertexStaging.back();
+    void* data = staging.data + staging.used;
+    staging.used += size;
+    return data;
+}
+
+void ModelLoaderVk::freeVertexData() {
+    for(auto &staging: vertexStaging) {
+	vkDestroyBuffer(base.device, staging.buffer, nullptr);
+	vkFreeMemory(base.device, staging.memory, nullptr);
+    }
+    vertexStaging.clear();
+}
+
+void ModelLoaderVk::loadFinished() {
+    for(auto &staging: inFlightVertexStaging) {
+	vkDestroyBuffer(base.device, staging.buffer, nullptr);
+	vkFreeMemory(base.device, staging.memory, nullptr);
+    }
+    inFlightVertexStaging.clear();
+}
+
+unsigned int ModelLoaderVk::getLod(Resource::Model model, glm::mat4 modelView, glm::mat4 proj) {
+    size_t modelIndex = gpuIndex(model);
+    if(modelIndex >= models.size())
+	return 0;
+    return models[modelIndex]->selectLod(modelView, proj, lodScreenSize);
 }
@@ -3,21 +3,68 @@
 
 #include <render-internal/resource-loaders/model_loader.h>
 #include "../device_state.h"
+#include "staging_ring.h"
+#include "deletion_queue.h"
 
 struct GPUModelVk;
 
+/// mapped space for this frame's indirect draw commands
+struct IndirectDraws {
+    VkBuffer buffer;
+    /// the commands start at offset bytes into buffer
+    VkDrawIndexedIndirectCommand* commands;
+    VkDeviceSize offset;
+    uint32_t capacity;
+    uint32_t used;
+};
+
+/// passed to drawModel to only draw the meshlets each instance could see
+struct MeshletCullInfo {
+    meshopt::MeshletCuller* culler;
+    /// model matrix of the first instance drawn,
+    /// each instance's matrix is stride bytes after the last.
+    const void* modelMatrices;
+    size_t stride;
+    /// if not null, all the visible ranges of a mesh are drawn with one indirect draw.
+    /// falls back to a draw per range once it is full.
+    IndirectDraws* indirect;
+};
+
 class ModelLoaderVk : public InternalModelLoader {
 public:
-    ModelLoaderVk(DeviceState base, VkCommandPool cmdpool, VkCommandBuffer generalCmdBuff,
-		  Resource::Pool pool, BasePoolManager *pools);
+    ModelLoaderVk(DeviceState base, StagingRing* stagingRing, DeletionQueue* deletionQueue,
+		  Resource::Pool pool, BasePoolManager *pools, RenderConfig conf);
     ~ModelLoaderVk() override;
     void loadGPU() override;
+    /// record the uploads without waiting for them to finish,
+    /// returns the staging ring submit to call loadFinished after.
+    uint64_t loadGPUAsync();
+    /// free the vertex staging memory of an async load
+    void loadFinished();
+    /// load the staged models without touching the ones already loaded
+    void appendGPU() override;
+    /// the buffers are freed through the deletion queue, as frames in flight may use them
     void clearGPU() override;
 
+    /// Load the file of a model again, keeping its handle and its meshes' textures.
+    /// If the new data is no bigger it is written over the old data after calling
+    /// waitForFrames, otherwise it goes in new space and the old space is left
+    /// unused until the pool is loaded again.
+    void reload(Resource::Model model, std::function<void()> waitForFrames);
+
+    /// bytes of device memory allocated for the vertex and index buffers
+    VkDeviceSize gpuMemory();
+
+    /// call before drawing this pool's models, after other pools were drawn
     void bindBuffers(VkCommandBuffer cmdBuff);
 
+    /// if lodCounts is not null, it has MAX_MODEL_LODS entries giving the number of
+    /// instances to draw at each level of detail, in order from instanceOffset.
+    /// if cull is not null, meshes with meshlets are drawn per instance at full detail.
     void drawModel(VkCommandBuffer cmdBuff, VkPipelineLayout layout, Resource::Model model,
-		   uint32_t count, uint32_t instanceOffset);
+		   uint32_t count, uint32_t instanceOffset,
+		   const uint32_t *lodCounts = nullptr,
+		   MeshletCullInfo *cull = nullptr);
     
     void drawQuad(VkCommandBuffer cmdBuff,
 		  VkPipelineLayout layout,
@@ -29,13 +76,27 @@ public:
     Resource::ModelAnimation getAnimation(Resource::Model model,
 					  int index) override;
 
+    unsigned int getLod(Resource::Model model, glm::mat4 modelView, glm::mat4 proj);
+
+protected:
+
+    /// vertices are converted straight into mapped staging memory,
+    /// so loadGPU only has to copy them to the device buffer.
+    void* allocateVertexData(size_t size) override;
+    void freeVertexData() override;
+
 private:
+
+    uint64_t loadGPU(bool wait, bool append);
     
-    void processModelData();
+    void processModelData(size_t first);
+
+    /// pick where in the buffer chunks the staged models go
+    void placeModelData(size_t first, bool append);
 
-    void stageModelData(void* pMem);
+    void stageIndexData();
 
-    void copyModelDataToGPU(VkBuffer stagingBuffer);
+    void copyModelDataToGPU();
 
     GPUModelVk* getModel(VkCommandBuffer cmdBuff, Resource::Model model);
     
@@ -46,15 +107,43 @@ private:
 		  uint32_t instanceOffset);
 
     DeviceState base;
-    VkCommandPool cmdpool;
-    VkCommandBuffer cmdbuff;
-    VkFence loadedFence;
+    StagingRing* stagingRing;
+    DeletionQueue* deletionQueue;
     std::vector<GPUModelVk*> models;
-    VkBuffer buffer;
-    VkDeviceMemory memory;
 
+    /// each load is put in the space left in the last chunk if it fits
+    struct BufferChunk {
+	VkBuffer buffer;
+	VkDeviceMemory memory;
+	VkDeviceSize size;
+	VkDeviceSize used;
+    };
+    std::vector<BufferChunk> bufferChunks;
+
+    /// layout of a load: vertex data, then 16 bit indices, then 32 bit indices
     uint32_t vertexDataSize = 0;
+    uint32_t shortIndexDataSize = 0;
     uint32_t indexDataSize = 0;
+    /// where in loadBuffer each part of the load is copied to
+    VkBuffer loadBuffer;
+    VkDeviceSize vertexDst;
+    VkDeviceSize shortIndexDst;
+    VkDeviceSize indexDst;
+
+    VkBuffer boundIndexBuffer = VK_NULL_HANDLE;
+    VkDeviceSize boundIndexOffset;
+    VkIndexType boundIndexType;
+
+    struct VertexStaging {
+	VkBuffer buffer;
+	VkDeviceMemory memory;
+	char* data;
+	size_t size;
+	size_t used;
+    };
+    std::vector<VertexStaging> vertexStaging;
+    // staging blocks an async load is still copying from
+    std::vector<VertexStaging> inFlightVertexStaging;
 };
 
 
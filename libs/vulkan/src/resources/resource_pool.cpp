@@ -1,9 +1,12 @@
 #include "resource_pool.h"
 
-ResourcePoolVk::ResourcePoolVk(uint32_t poolID, BasePoolManager* pools, DeviceState base, VkCommandPool cmdpool, VkCommandBuffer cmdbuff, RenderConfig config) {
+#include <render-internal/resource-loaders/asset_pack.h>
+#include <algorithm>
+
+ResourcePoolVk::ResourcePoolVk(uint32_t poolID, BasePoolManager* pools, DeviceState base, StagingRing* stagingRing, DeletionQueue* deletionQueue, RenderConfig config) {
     this->pool = Resource::Pool(poolID);
-    texLoader = new TexLoaderVk(base, cmdpool, pool, config);
-    modelLoader = new ModelLoaderVk(base, cmdpool, cmdbuff, pool, pools);
+    texLoader = new TexLoaderVk(base, stagingRing, deletionQueue, pool, config, &pools->texCache);
+    modelLoader = new ModelLoaderVk(base, stagingRing, deletionQueue, pool, pools, config);
     fontLoader = new InternalFontLoader(pool, texLoader);
 }
 
@@ -25,6 +28,29 @@ void ResourcePoolVk::loadGpu() {
     usingGPUResources = false;
 }
 
+uint64_t ResourcePoolVk::loadGpuAsync() {
+    uint64_t submitted = texLoader->loadGPUAsync();
+    fontLoader->loadGPU();
+    if(useModelLoader)
+	submitted = std::max(submitted, modelLoader->loadGPUAsync());
+    usingGPUResources = false;
+    loading = true;
+    return submitted;
+}
+
+void ResourcePoolVk::loadFinished() {
+    if(useModelLoader)
+	modelLoader->loadFinished();
+    loading = false;
+}
+
+void ResourcePoolVk::appendGpu() {
+    texLoader->appendGPU();
+    fontLoader->appendGPU();
+    if(useModelLoader)
+	modelLoader->appendGPU();
+}
+
 void ResourcePoolVk::unloadStaged() {
     texLoader->clearStaged();
     if(useModelLoader)
@@ -39,3 +65,22 @@ void ResourcePoolVk::unloadGPU() {
     fontLoader->clearGPU();
     usingGPUResources = false;
 }
+
+Resource::PackedResources ResourcePoolVk::loadPack(std::string path) {
+    return assetpack::load(path, texLoader, modelLoader, fontLoader);
+}
+
+void ResourcePoolVk::decodeStaged() {
+    texLoader->decodeStaged();
+}
+
+Resource::PoolMemory ResourcePoolVk::memoryUsage() {
+    Resource::PoolMemory memory;
+    memory.staged = texLoader->stagedMemory();
+    memory.textures = texLoader->gpuMemory();
+    if(useModelLoader) {
+	memory.staged += modelLoader->stagedMemory();
+	memory.models = modelLoader->gpuMemory();
+    }
+    return memory;
+}
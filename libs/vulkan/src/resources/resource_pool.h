@@ -9,17 +9,25 @@
 
 class ResourcePoolVk : public ResourcePool {
  public:
-    ResourcePoolVk(uint32_t poolID, BasePoolManager* pools, DeviceState base, VkCommandPool cmdpool,
-		 VkCommandBuffer cmdbuff, RenderConfig config);
+    ResourcePoolVk(uint32_t poolID, BasePoolManager* pools, DeviceState base,
+		   StagingRing* stagingRing, DeletionQueue* deletionQueue, RenderConfig config);
     virtual ~ResourcePoolVk();
 
     void loadGpu();
+    /// returns the staging ring submit to call loadFinished after
+    uint64_t loadGpuAsync();
+    void loadFinished();
+    /// load the staged resources, keeping the ones already loaded
+    void appendGpu();
     void unloadStaged();
     void unloadGPU();
 
     ModelLoader* model() override { return modelLoader; }
     TextureLoader* tex() override { return texLoader; }
     FontLoader* font()   override { return fontLoader; }
+    Resource::PackedResources loadPack(std::string path) override;
+    void decodeStaged() override;
+    Resource::PoolMemory memoryUsage() override;
     
     void setUseGPUResources(bool value);
 
@@ -30,6 +38,8 @@ class ResourcePoolVk : public ResourcePool {
     bool UseGPUResources = true;
     bool usingGPUResources = false;
     bool useModelLoader = true;
+    // an async load hasn't finished, so the pool can't be used yet
+    bool loading = false;
 };
 
 MAKE_POOL_MANAGER(PoolManagerVk, ResourcePoolVk)
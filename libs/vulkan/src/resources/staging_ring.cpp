@@ -0,0 +1,335 @@
+#include "staging_ring.h"
+
+#include <cstring>
+#include <algorithm>
+#include <stdexcept>
+#include "../logger.h"
+#include "../vkhelper.h"
+#include "../parts/command.h"
+#include "../parts/threading.h"
+
+// the ring doubles in size up to this when uploads have to wait for space
+const VkDeviceSize MAX_STAGING_RING_SIZE = 256 * 1024 * 1024;
+
+VkCommandPool createStagingCommandPool(VkDevice device, uint32_t queueFamily) {
+    VkCommandPool pool;
+    VkCommandPoolCreateInfo poolInfo{VK_STRUCTURE_TYPE_COMMAND_POOL_CREATE_INFO};
+    poolInfo.queueFamilyIndex = queueFamily;
+    poolInfo.flags = VK_COMMAND_POOL_CREATE_RESET_COMMAND_BUFFER_BIT |
+	VK_COMMAND_POOL_CREATE_TRANSIENT_BIT;
+    checkResultAndThrow(vkCreateCommandPool(device, &poolInfo, nullptr, &pool),
+			"failed to create command pool for staging ring");
+    return pool;
+}
+
+StagingRing::StagingRing(DeviceState state, VkDeviceSize size) {
+    this->state = state;
+    this->size = size;
+    separateQueue = state.queue.transferFamilyIndex != state.queue.graphicsPresentFamilyIndex;
+    createBuffer();
+    cmdpool = createStagingCommandPool(state.device, state.queue.transferFamilyIndex);
+    if(separateQueue)
+	acquirePool = createStagingCommandPool(state.device,
+					       state.queue.graphicsPresentFamilyIndex);
+}
+
+StagingRing::~StagingRing() {
+    while(!inFlight.empty())
+	retire(true);
+    retireAcquires(true);
+    for(auto fence: freeFences)
+	vkDestroyFence(state.device, fence, nullptr);
+    vkDestroyCommandPool(state.device, cmdpool, nullptr);
+    if(separateQueue)
+	vkDestroyCommandPool(state.device, acquirePool, nullptr);
+    destroyBuffer();
+}
+
+void StagingRing::createBuffer() {
+    LOG("creating staging ring - size: " << size << " bytes");
+    checkResultAndThrow(vkhelper::createBufferAndMemory(
+				state, size, &buffer, &memory,
+				VK_BUFFER_USAGE_TRANSFER_SRC_BIT,
+				VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT |
+				VK_MEMORY_PROPERTY_HOST_COHERENT_BIT),
+			"Failed to create staging ring memory");
+    vkBindBufferMemory(state.device, buffer, memory, 0);
+    void* mapped;
+    checkResultAndThrow(vkMapMemory(state.device, memory, 0, size, 0, &mapped),
+			"Failed to map staging ring memory");
+    data = static_cast<unsigned char*>(mapped);
+}
+
+void StagingRing::destroyBuffer() {
+    vkUnmapMemory(state.device, memory);
+    vkDestroyBuffer(state.device, buffer, nullptr);
+    vkFreeMemory(state.device, memory, nullptr);
+}
+
+bool StagingRing::empty() {
+    return inFlight.empty() && !currentHasSpace;
+}
+
+bool StagingRing::fits(VkDeviceSize size, VkDeviceSize alignment, VkDeviceSize* offset) {
+    if(empty()) {
+	head = 0;
+	tail = 0;
+	*offset = 0;
+	return size <= this->size;
+    }
+    VkDeviceSize start = vkhelper::correctMemoryAlignment(head, alignment);
+    // the head can't catch up to the tail, or a full ring would look empty
+    if(head >= tail) {
+	if(start + size <= this->size) {
+	    *offset = start;
+	    return true;
+	}
+	if(size < tail) {
+	    *offset = 0;
+	    return true;
+	}
+	return false;
+    }
+    if(start + size < tail) {
+	*offset = start;
+	return true;
+    }
+    return false;
+}
+
+VkFence StagingRing::getFence() {
+    VkFence fence;
+    if(freeFences.empty()) {
+	checkResultAndThrow(part::create::Fence(state.device, &fence, false),
+			    "failed to create staging ring fence");
+    } else {
+	fence = freeFences.back();
+	freeFences.pop_back();
+    }
+    return fence;
+}
+
+void StagingRing::retire(bool wait) {
+    retireAcquires(false);
+    while(!inFlight.empty()) {
+	Batch &batch = inFlight.front();
+	if(wait)
+	    checkResultAndThrow(
+		    vkWaitForFences(state.device, 1, &batch.fence, VK_TRUE, UINT64_MAX),
+		    "failed to wait for staging ring upload");
+	else if(vkGetFenceStatus(state.device, batch.fence) != VK_SUCCESS)
+	    return;
+	vkResetFences(state.device, 1, &batch.fence);
+	freeCmdBuffs.push_back(batch.cmdbuff);
+	if(batch.acquire != VK_NULL_HANDLE) {
+	    // the copies are done, so the graphics queue can take ownership
+	    // without waiting on the transfer queue
+	    VkSubmitInfo submitInfo{ VK_STRUCTURE_TYPE_SUBMIT_INFO };
+	    submitInfo.commandBufferCount = 1;
+	    submitInfo.pCommandBuffers = &batch.acquire;
+	    checkResultAndThrow(vkhelper::submitQueue(state.queue.graphicsPresentQueue,
+						      &submitInfo, &graphicsPresentMutex,
+						      batch.fence),
+				"failed to submit staging ring ownership acquires");
+	    acquiring.push_back({ batch.acquire, batch.fence });
+	} else {
+	    freeFences.push_back(batch.fence);
+	}
+	tail = batch.end;
+	retireCount++;
+	inFlight.pop_front();
+	if(wait)
+	    return;
+    }
+}
+
+void StagingRing::retireAcquires(bool wait) {
+    while(!acquiring.empty()) {
+	Acquire &acquire = acquiring.front();
+	if(wait)
+	    checkResultAndThrow(
+		    vkWaitForFences(state.device, 1, &acquire.fence, VK_TRUE, UINT64_MAX),
+		    "failed to wait for staging ring ownership acquires");
+	else if(vkGetFenceStatus(state.device, acquire.fence) != VK_SUCCESS)
+	    return;
+	vkResetFences(state.device, 1, &acquire.fence);
+	freeFences.push_back(acquire.fence);
+	freeAcquireCmdBuffs.push_back(acquire.cmdbuff);
+	acquiring.pop_front();
+    }
+}
+
+StagingRing::Space StagingRing::allocate(VkDeviceSize size, VkDeviceSize alignment) {
+    if(size > this->size)
+	throw std::runtime_error("Staging ring allocation was bigger than the ring");
+    VkDeviceSize offset;
+    retire(false);
+    while(!fits(size, alignment, &offset)) {
+	stalled = true;
+	if(recording || currentHasSpace)
+	    submit(false);
+	retire(true);
+    }
+    head = offset + size;
+    currentHasSpace = true;
+    return { buffer, offset, data + offset };
+}
+
+bool StagingRing::tryAllocate(VkDeviceSize size, VkDeviceSize alignment, Space* space) {
+    VkDeviceSize offset;
+    retire(false);
+    if(!fits(size, alignment, &offset))
+	return false;
+    head = offset + size;
+    currentHasSpace = true;
+    *space = { buffer, offset, data + offset };
+    return true;
+}
+
+VkCommandBuffer StagingRing::beginCommandBuffer(VkCommandPool pool,
+						std::vector<VkCommandBuffer> &free) {
+    VkCommandBuffer cmdbuff;
+    if(free.empty()) {
+	checkResultAndThrow(part::create::CommandBuffer(state.device, pool, &cmdbuff),
+			    "failed to create staging ring command buffer");
+    } else {
+	cmdbuff = free.back();
+	free.pop_back();
+    }
+    VkCommandBufferBeginInfo beginInfo{ VK_STRUCTURE_TYPE_COMMAND_BUFFER_BEGIN_INFO };
+    beginInfo.flags = VK_COMMAND_BUFFER_USAGE_ONE_TIME_SUBMIT_BIT;
+    checkResultAndThrow(vkBeginCommandBuffer(cmdbuff, &beginInfo),
+			"failed to begin staging ring command buffer");
+    return cmdbuff;
+}
+
+VkCommandBuffer StagingRing::commandBuffer() {
+    if(!recording) {
+	current = beginCommandBuffer(cmdpool, freeCmdBuffs);
+	recording = true;
+    }
+    return current;
+}
+
+VkCommandBuffer StagingRing::acquireCommandBuffer() {
+    if(!recordingAcquire) {
+	currentAcquire = beginCommandBuffer(acquirePool, freeAcquireCmdBuffs);
+	recordingAcquire = true;
+    }
+    return currentAcquire;
+}
+
+void StagingRing::imageReady(VkImageMemoryBarrier barrier, VkPipelineStageFlags dstStage) {
+    barrier.srcAccessMask = VK_ACCESS_TRANSFER_WRITE_BIT;
+    if(!separateQueue) {
+	barrier.srcQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+	barrier.dstQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+	vkCmdPipelineBarrier(commandBuffer(), VK_PIPELINE_STAGE_TRANSFER_BIT, dstStage,
+			     0, 0, nullptr, 0, nullptr, 1, &barrier);
+	return;
+    }
+    // release on the transfer queue, then acquire with the same barrier on the graphics queue
+    barrier.srcQueueFamilyIndex = state.queue.transferFamilyIndex;
+    barrier.dstQueueFamilyIndex = state.queue.graphicsPresentFamilyIndex;
+    VkAccessFlags dstAccess = barrier.dstAccessMask;
+    barrier.dstAccessMask = 0;
+    vkCmdPipelineBarrier(commandBuffer(),
+			 VK_PIPELINE_STAGE_TRANSFER_BIT, VK_PIPELINE_STAGE_BOTTOM_OF_PIPE_BIT,
+			 0, 0, nullptr, 0, nullptr, 1, &barrier);
+    barrier.srcAccessMask = 0;
+    barrier.dstAccessMask = dstAccess;
+    vkCmdPipelineBarrier(acquireCommandBuffer(), VK_PIPELINE_STAGE_TOP_OF_PIPE_BIT, dstStage,
+			 0, 0, nullptr, 0, nullptr, 1, &barrier);
+}
+
+void StagingRing::bufferReady(VkBufferMemoryBarrier barrier, VkPipelineStageFlags dstStage) {
+    barrier.srcAccessMask = VK_ACCESS_TRANSFER_WRITE_BIT;
+    if(!separateQueue) {
+	barrier.srcQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+	barrier.dstQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+	vkCmdPipelineBarrier(commandBuffer(), VK_PIPELINE_STAGE_TRANSFER_BIT, dstStage,
+			     0, 0, nullptr, 1, &barrier, 0, nullptr);
+	return;
+    }
+    barrier.srcQueueFamilyIndex = state.queue.transferFamilyIndex;
+    barrier.dstQueueFamilyIndex = state.queue.graphicsPresentFamilyIndex;
+    VkAccessFlags dstAccess = barrier.dstAccessMask;
+    barrier.dstAccessMask = 0;
+    vkCmdPipelineBarrier(commandBuffer(),
+			 VK_PIPELINE_STAGE_TRANSFER_BIT, VK_PIPELINE_STAGE_BOTTOM_OF_PIPE_BIT,
+			 0, 0, nullptr, 1, &barrier, 0, nullptr);
+    barrier.srcAccessMask = 0;
+    barrier.dstAccessMask = dstAccess;
+    vkCmdPipelineBarrier(acquireCommandBuffer(), VK_PIPELINE_STAGE_TOP_OF_PIPE_BIT, dstStage,
+			 0, 0, nullptr, 1, &barrier, 0, nullptr);
+}
+
+uint64_t StagingRing::submit(bool wait) {
+    if(recording || currentHasSpace) {
+	VkCommandBuffer cmdbuff = commandBuffer();
+	checkResultAndThrow(vkEndCommandBuffer(cmdbuff),
+			    "failed to end staging ring command buffer");
+	Batch batch;
+	batch.cmdbuff = cmdbuff;
+	batch.acquire = VK_NULL_HANDLE;
+	if(recordingAcquire) {
+	    checkResultAndThrow(vkEndCommandBuffer(currentAcquire),
+				"failed to end staging ring acquire command buffer");
+	    batch.acquire = currentAcquire;
+	    recordingAcquire = false;
+	}
+	batch.end = head;
+	batch.fence = getFence();
+	VkSubmitInfo submitInfo{ VK_STRUCTURE_TYPE_SUBMIT_INFO };
+	submitInfo.commandBufferCount = 1;
+	submitInfo.pCommandBuffers = &batch.cmdbuff;
+	// only the ring submits to a separate transfer queue, and the ring's mutex is held
+	checkResultAndThrow(vkhelper::submitQueue(state.queue.transferQueue, &submitInfo,
+						  separateQueue ? nullptr : &graphicsPresentMutex,
+						  batch.fence),
+			    "failed to submit staging ring commands");
+	inFlight.push_back(batch);
+	submitCount++;
+	recording = false;
+	currentHasSpace = false;
+    }
+    if(!wait)
+	return submitCount;
+    while(!inFlight.empty())
+	retire(true);
+    retireAcquires(true);
+    if(stalled && size < MAX_STAGING_RING_SIZE) {
+	destroyBuffer();
+	size = std::min(size * 2, MAX_STAGING_RING_SIZE);
+	createBuffer();
+    }
+    stalled = false;
+    return submitCount;
+}
+
+bool StagingRing::finished(uint64_t submitted) {
+    retire(false);
+    return submitted <= retireCount;
+}
+
+void StagingRing::wait(uint64_t submitted) {
+    while(retireCount < submitted)
+	retire(true);
+}
+
+void StagingRing::copyToBuffer(const void* src, VkDeviceSize size,
+			       VkBuffer dst, VkDeviceSize dstOffset) {
+    const unsigned char* bytes = static_cast<const unsigned char*>(src);
+    VkDeviceSize copied = 0;
+    while(copied < size) {
+	VkDeviceSize part = std::min(size - copied, this->size);
+	Space space = allocate(part, 4);
+	std::memcpy(space.data, bytes + copied, part);
+	VkBufferCopy region{};
+	region.srcOffset = space.offset;
+	region.dstOffset = dstOffset + copied;
+	region.size = part;
+	vkCmdCopyBuffer(commandBuffer(), space.buffer, dst, 1, &region);
+	copied += part;
+    }
+}
@@ -0,0 +1,122 @@
+#ifndef VK_ENV_STAGING_RING_H
+#define VK_ENV_STAGING_RING_H
+
+#include "../device_state.h"
+#include <vector>
+#include <deque>
+#include <mutex>
+
+/// A mapped host visible buffer shared by every resource pool for copying data to the gpu.
+/// Space is handed out in order around the ring, and is reused once the
+/// commands that copy from it have finished. Uploads bigger than the ring
+/// are done in parts. Hold the ring's mutex while using it.
+/// Copies run on the transfer queue, if the device has a separate one
+/// the resources written are then handed over to the graphics queue.
+class StagingRing {
+public:
+    StagingRing(DeviceState state, VkDeviceSize size);
+    ~StagingRing();
+
+    struct Space {
+	VkBuffer buffer;
+	VkDeviceSize offset;
+	unsigned char* data;
+    };
+
+    /// only one thread can record uploads at once
+    std::mutex& mutex() { return ringMutex; }
+
+    /// Get size bytes of the ring, size can't be more than capacity().
+    /// If there isn't enough free, the commands recorded so far are submitted
+    /// and this waits for the oldest uploads to finish.
+    /// Commands that read the space must be recorded before the next allocate.
+    Space allocate(VkDeviceSize size, VkDeviceSize alignment);
+
+    /// Like allocate, but returns false instead of waiting.
+    /// This never submits, so commands for the space can be recorded after more tryAllocates.
+    bool tryAllocate(VkDeviceSize size, VkDeviceSize alignment, Space* space);
+
+    /// the command buffer to record copies into, begun if it wasn't already
+    VkCommandBuffer commandBuffer();
+
+    /// Make an image written by the copies usable by the graphics queue at dstStage.
+    /// barrier has the image, range, layouts and dstAccessMask filled in.
+    void imageReady(VkImageMemoryBarrier barrier, VkPipelineStageFlags dstStage);
+    /// Make a buffer written by the copies usable by the graphics queue at dstStage.
+    void bufferReady(VkBufferMemoryBarrier barrier, VkPipelineStageFlags dstStage);
+
+    /// Submit the recorded commands, if wait then block until every upload is done.
+    /// Returns an id to check the uploads with finished().
+    uint64_t submit(bool wait);
+
+    /// true once the uploads of a submit are done and anything
+    /// submitted to the graphics queue after this can use them.
+    bool finished(uint64_t submitted);
+    /// block until finished(submitted) would be true
+    void wait(uint64_t submitted);
+
+    /// Copy data to a buffer through the ring, in parts if it's bigger than the ring.
+    void copyToBuffer(const void* data, VkDeviceSize size, VkBuffer dst, VkDeviceSize dstOffset);
+
+    VkDeviceSize capacity() { return size; }
+
+private:
+    struct Batch {
+	VkCommandBuffer cmdbuff;
+	/// ownership acquires for the graphics queue, or null
+	VkCommandBuffer acquire;
+	VkFence fence;
+	/// end of the last space handed out for this batch
+	VkDeviceSize end;
+    };
+
+    void createBuffer();
+    void destroyBuffer();
+    bool empty();
+    bool fits(VkDeviceSize size, VkDeviceSize alignment, VkDeviceSize* offset);
+    /// free the space of batches that have finished, waiting for the oldest if wait
+    void retire(bool wait);
+    /// free acquires that the graphics queue has finished, or wait for all of them
+    void retireAcquires(bool wait);
+    VkCommandBuffer acquireCommandBuffer();
+    VkCommandBuffer beginCommandBuffer(VkCommandPool pool, std::vector<VkCommandBuffer> &free);
+    VkFence getFence();
+
+    DeviceState state;
+    bool separateQueue;
+    std::mutex ringMutex;
+    VkDeviceSize size;
+    VkBuffer buffer;
+    VkDeviceMemory memory;
+    unsigned char* data;
+
+    // [tail, head) is in use, wrapping around the end of the ring
+    VkDeviceSize head = 0;
+    VkDeviceSize tail = 0;
+    bool recording = false;
+    bool recordingAcquire = false;
+    bool currentHasSpace = false;
+    // had to wait for space, so the ring is made bigger once it's empty
+    bool stalled = false;
+
+    uint64_t submitCount = 0;
+    uint64_t retireCount = 0;
+
+    VkCommandPool cmdpool;
+    VkCommandBuffer current;
+    std::deque<Batch> inFlight;
+    std::vector<VkCommandBuffer> freeCmdBuffs;
+    std::vector<VkFence> freeFences;
+
+    // on the graphics queue family, only used with a separate transfer queue
+    VkCommandPool acquirePool;
+    VkCommandBuffer currentAcquire;
+    struct Acquire {
+	VkCommandBuffer cmdbuff;
+	VkFence fence;
+    };
+    std::deque<Acquire> acquiring;
+    std::vector<VkCommandBuffer> freeAcquireCmdBuffs;
+};
+
+#endif
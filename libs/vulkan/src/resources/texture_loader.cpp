@@ -1,15 +1,13 @@
 #include "texture_loader.h"
 
 #include <cstring>
+#include <algorithm>
 #include "../logger.h"
 #include "../vkhelper.h"
 #include "../parts/images.h"
-#include "../parts/command.h"
-#include "../parts/threading.h"
+#include <render-internal/worker_pool.h>
 
 
-const VkFilter MIPMAP_FILTER = VK_FILTER_LINEAR;
-
 struct StagedTexVk : public StagedTex {
     void deleteData() override {}
     TextureInfoVk info;
@@ -21,6 +19,8 @@ struct GPUTexture {
 	this->info = info;
 	this->width = tex->width;
 	this->height = tex->height;
+	this->mipSizes = tex->mipSizes;
+	compressed = tex->format != TextureFormat::RGBA8;
 	gpuOnly = tex->filesize == 0;
 	currentImageLayout = VK_IMAGE_LAYOUT_UNDEFINED;
 	currentImageAccessMask = 0;
@@ -43,29 +43,43 @@ struct GPUTexture {
     VkImageLayout currentImageLayout;
     VkAccessFlags currentImageAccessMask;
 
-    VkImage image;
-    VkImageView view;
+    VkImage image = VK_NULL_HANDLE;
+    VkImageView view = VK_NULL_HANDLE;
     VkDeviceSize imageMemSize;
     VkDeviceSize imageMemOffset;
+    std::vector<size_t> mipSizes;
+    bool compressed;
+    // mips before this are still being streamed, the view starts at it
+    uint32_t residentMip = 0;
+    // levels from this are copied or being copied
+    uint32_t copiedMip = 0;
+    // where the levels before copiedMip are read from, until they are all uploaded
+    std::shared_ptr<MipSource> mipSource;
     bool gpuOnly;
     
     VkResult createImage(VkDevice device, VkMemoryRequirements *pMemreq);
-    void createMipMaps(VkCommandBuffer &cmdBuff);
+    size_t mipOffset(uint32_t mip);
+    void transitionToTransferDst(VkCommandBuffer &cmdBuff);
+    void copyMips(VkCommandBuffer &cmdBuff, VkBuffer stagingBuffer, VkDeviceSize offset);
+    void mipReady(StagingRing* stagingRing, uint32_t mip);
+    void transitionToFinalLayout(StagingRing* stagingRing);
     VkResult createImageView(VkDevice device);
 };
 
+// compressed textures must start on a multiple of their block size
+const VkDeviceSize STAGING_ALIGNMENT = 16;
+// appended textures get memory at least this big, so the next appends can use the rest
+const VkDeviceSize TEXTURE_MEMORY_CHUNK_SIZE = 32 * 1024 * 1024;
   
-TexLoaderVk::TexLoaderVk(DeviceState base, VkCommandPool cmdpool,
-			 Resource::Pool pool, RenderConfig config)
-    : InternalTexLoader(pool, config) {
+TexLoaderVk::TexLoaderVk(DeviceState base, StagingRing* stagingRing, DeletionQueue* deletionQueue,
+			 Resource::Pool pool, RenderConfig config, TextureCache* cache)
+    : InternalTexLoader(pool, config, cache) {
     this->base = base;
-    this->cmdpool = cmdpool;
-    checkResultAndThrow(part::create::Fence(base.device, &loadedFence, false),
-			"failed to create finish load semaphore in texLoader");
+    this->stagingRing = stagingRing;
+    this->deletionQueue = deletionQueue;
 }
 
 TexLoaderVk::~TexLoaderVk() {
-    vkDestroyFence(base.device, loadedFence, nullptr);
     clearGPU();
 }
 
@@ -82,11 +96,26 @@ Resource::Texture TexLoaderVk::addGpuTexture(uint32_t width, uint32_t height, Te
 void TexLoaderVk::clearGPU() {
     if (textures.size() <= 0)
 	return;
+    // mips may still be copying to these textures, with ownership acquires to come
+    uint64_t submitted;
+    {
+	std::lock_guard<std::mutex> lock(stagingRing->mutex());
+	submitted = stagingRing->submit(false);
+    }
+    streamingMips.clear();
+    streaming = false;
     InternalTexLoader::clearGPU();
     for (auto& tex : textures)
-	delete tex;
-    vkFreeMemory(base.device, memory, nullptr);
+	deletionQueue->push([tex] { delete tex; }, submitted);
     textures.clear();
+    VkDevice device = base.device;
+    for(auto &chunk: memoryChunks) {
+	VkDeviceMemory memory = chunk.memory;
+	deletionQueue->push([device, memory] {
+	    vkFreeMemory(device, memory, nullptr);
+	}, submitted);
+    }
+    memoryChunks.clear();
 }
 
 float TexLoaderVk::getMinMipmapLevel() {
@@ -94,121 +123,433 @@ float TexLoaderVk::getMinMipmapLevel() {
 }
 
 void TexLoaderVk::loadGPU() {
+    loadGPU(true, false);
+}
+
+uint64_t TexLoaderVk::loadGPUAsync() {
+    return loadGPU(false, false);
+}
+
+void TexLoaderVk::appendGPU() {
+    loadGPU(true, true);
+}
+
+uint64_t TexLoaderVk::loadGPU(bool wait, bool append) {
     if(staged.size() <= 0)
-	return;
-    clearGPU();
-    InternalTexLoader::loadGPU();
-    textures.resize(staged.size());
+	return 0;
+    if(!append)
+	clearGPU();
+    GpuLoadState before = gpuLoadState();
+    if(append)
+	InternalTexLoader::appendGPU();
+    else
+	InternalTexLoader::loadGPU();
+    // only the staged textures are created and copied, the rest are left as they are
+    size_t first = textures.size();
+    textures.resize(first + staged.size());
     LOG("Loading " << staged.size() << " textures to GPU");
 
-    VkBuffer stagingBuffer;
-    VkDeviceMemory stagingMemory;
-    uint32_t memoryTypeBits;
-    bool stagingBufferCreated = false;
-    VkDeviceSize finalMemSize = stageTexDataCreateImages(
-	    stagingBuffer, stagingMemory, &memoryTypeBits, &stagingBufferCreated);
+    uint64_t submitted = 0;
+    MemoryChunk* chunk = nullptr;
+    VkDeviceSize chunkUsed = 0;
+    try {
+	uint32_t memoryTypeBits;
+	VkDeviceSize alignment;
+	VkDeviceSize memSize = createImages(first, &memoryTypeBits, &alignment);
+	chunk = getMemoryChunk(memSize, alignment, memoryTypeBits, append);
+	chunkUsed = chunk->used;
+	VkDeviceSize chunkOffset = vkhelper::correctMemoryAlignment(chunk->used, alignment);
+	chunk->used = chunkOffset + memSize;
+
+	LOG("binding images to GPU memory");
+	for(size_t i = first; i < textures.size(); i++) {
+	    textures[i]->imageMemOffset += chunkOffset;
+	    vkBindImageMemory(base.device, textures[i]->image, chunk->memory,
+			      textures[i]->imageMemOffset);
+	}
 
-    LOG("creating final memory buffer [" << finalMemSize << " bytes]");
-    
-    // create final memory
-    checkResultAndThrow(vkhelper::allocateMemory(base.device, base.physicalDevice,
-						 finalMemSize, &memory,
-						 VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT,
-						 memoryTypeBits),
-			"Failed to allocate memeory for final texture storage");
+	{
+	    std::lock_guard<std::mutex> lock(stagingRing->mutex());
+	    // decode the resident mip levels of the textures and copy them through the staging ring
+	    try {
+		uploadTextures(first);
+	    } catch(std::exception &e) {
+		// submit what was recorded so the ring space the decodes were given is freed
+		stagingRing->submit(true);
+		throw;
+	    }
+	    for(size_t i = first; i < textures.size(); i++)
+		textures[i]->transitionToFinalLayout(stagingRing);
+	    submitted = stagingRing->submit(wait);
+	}
+	LOG(wait ? "finished moving textures to final memory location" :
+	    "texture copies submitted");
 
-    VkCommandBuffer tempCmdBuffer;
-    checkResultAndThrow(part::create::CommandBuffer(base.device, cmdpool, &tempCmdBuffer),
-			"failed to create temporary command buffer in end texture loading");
-    VkCommandBufferBeginInfo cmdBeginInfo{ VK_STRUCTURE_TYPE_COMMAND_BUFFER_BEGIN_INFO };
-    cmdBeginInfo.flags = VK_COMMAND_BUFFER_USAGE_ONE_TIME_SUBMIT_BIT;
-    checkResultAndThrow(vkBeginCommandBuffer(tempCmdBuffer, &cmdBeginInfo),
-			"failed to begin staging texture data command buffer");
-
-    LOG("binding images to GPU memory");
-    // move texture data from staging memory to final memory
-    // and ready images for mipmapping
-    textureDataStagingToFinal(stagingBuffer, tempCmdBuffer);
-
-    checkResultAndThrow(vkEndCommandBuffer(tempCmdBuffer),
-			"failed to end cmdbuff for moving tex data");
+	for(size_t i = first; i < textures.size(); i++) {
+	    textures[i]->copiedMip = textures[i]->residentMip;
+	    if(textures[i]->mipSource != nullptr)
+		streaming = true;
+	}
     
-    checkResultAndThrow(vkhelper::submitCmdBuffAndWait(
-				base.device,
-				base.queue.graphicsPresentQueue, &tempCmdBuffer, loadedFence,
-				&graphicsPresentMutex),
-			"failed to move texture data to gpu");
+	LOG("creating image views");
     
-    LOG("finished moving textures to final memory location");
+	//create image views
+	for(size_t i = first; i < textures.size(); i++)
+	    checkResultAndThrow(
+		    textures[i]->createImageView(base.device), 
+		    "Failed to create image view from texture");
+    } catch(std::exception &e) {
+	// the failed load's textures were never drawn with, but copies may still be in flight
+	for(size_t i = first; i < textures.size(); i++) {
+	    GPUTexture* tex = textures[i];
+	    if(tex != nullptr)
+		deletionQueue->push([tex] { delete tex; }, submitted);
+	}
+	textures.resize(first);
+	// if no copies are in flight the images' space can go to the next load
+	if(chunk != nullptr && (submitted == 0 || wait))
+	    chunk->used = chunkUsed;
+	failedGpuLoad(before);
+	throw;
+    }
 
-    checkResultAndThrow(vkResetCommandPool(base.device, cmdpool, 0),
-			"Failed to reset command pool in end texture loading");
+    clearStaged();
+    LOG("texture loading complete");
+    return submitted;
+}
 
-    if(stagingBufferCreated) {
-	LOG("freeing staging buffer and memory");
-	vkUnmapMemory(base.device, stagingMemory);
-	vkDestroyBuffer(base.device, stagingBuffer, nullptr);
-	vkFreeMemory(base.device, stagingMemory, nullptr);
+TexLoaderVk::MemoryChunk* TexLoaderVk::getMemoryChunk(
+	VkDeviceSize size, VkDeviceSize alignment, uint32_t memoryTypeBits, bool append) {
+    if(!memoryChunks.empty()) {
+	MemoryChunk &last = memoryChunks.back();
+	if((memoryTypeBits & (1u << last.typeIndex)) &&
+	   vkhelper::correctMemoryAlignment(last.used, alignment) + size <= last.size)
+	    return &last;
     }
-    
-    checkResultAndThrow(vkBeginCommandBuffer(tempCmdBuffer, &cmdBeginInfo),
-			"Failed to begin mipmap creation command buffer");
+    // a load that replaces the textures is usually all the pool will have,
+    // so only appends leave room for more
+    MemoryChunk chunk;
+    chunk.size = append ? std::max(size, TEXTURE_MEMORY_CHUNK_SIZE) : size;
+    chunk.used = 0;
+    chunk.typeIndex = vkhelper::findMemoryIndex(base.physicalDevice, memoryTypeBits,
+						VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT);
+    LOG("creating final memory buffer [" << chunk.size << " bytes]");
+    checkResultAndThrow(vkhelper::allocateMemory(base.device, base.physicalDevice,
+						 chunk.size, &chunk.memory,
+						 VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT,
+						 1u << chunk.typeIndex),
+			"Failed to allocate memeory for final texture storage");
+    memoryChunks.push_back(chunk);
+    return &memoryChunks.back();
+}
 
-    LOG("Converting textures to final layout");    
-    for (auto& tex : textures)
-	tex->createMipMaps(tempCmdBuffer);
+void TexLoaderVk::uploadTextures(size_t first) {
+    VkCommandBuffer cmdbuff = stagingRing->commandBuffer();
+    for(size_t i = 0; i < staged.size(); i++)
+	if(staged[i]->filesize > 0)
+	    textures[first + i]->transitionToTransferDst(cmdbuff);
+
+    // as many textures as fit in the ring are decoded straight into it across the worker threads.
+    // streaming textures only decode the levels they start with,
+    // the bigger ones are read in the background as streamMips asks for them
+    std::vector<size_t> batch;
+    std::vector<StagingRing::Space> batchSpace;
+    auto uploadBatch = [&]() {
+	WorkerPool::get()->run(batch.size(), [&](size_t i) {
+	    StagedTex* tex = staged[batch[i]];
+	    GPUTexture* gpuTex = textures[first + batch[i]];
+	    gpuTex->mipSource = stageTexture(tex, batchSpace[i].data, gpuTex->residentMip);
+	    tex->deleteData();
+	});
+	// no allocates since the batch was started, so it is all in the same command buffer
+	VkCommandBuffer cmdbuff = stagingRing->commandBuffer();
+	for(size_t i = 0; i < batch.size(); i++)
+	    textures[first + batch[i]]->copyMips(cmdbuff, batchSpace[i].buffer, batchSpace[i].offset);
+	batch.clear();
+	batchSpace.clear();
+    };
+    std::vector<size_t> decodedFirst;
+    for(size_t i = 0; i < staged.size(); i++) {
+	if(staged[i]->filesize == 0)
+	    continue;
+	size_t size = residentSize(staged[i], textures[first + i]->residentMip);
+	if(size > stagingRing->capacity()) {
+	    decodedFirst.push_back(i);
+	    continue;
+	}
+	StagingRing::Space space;
+	if(!stagingRing->tryAllocate(size, STAGING_ALIGNMENT, &space)) {
+	    uploadBatch();
+	    space = stagingRing->allocate(size, STAGING_ALIGNMENT);
+	}
+	batch.push_back(i);
+	batchSpace.push_back(space);
+    }
+    uploadBatch();
+
+    // textures too big for the ring are decoded to memory
+    // and copied a level, or part of one, at a time
+    std::vector<std::vector<unsigned char>> pixels(decodedFirst.size());
+    WorkerPool::get()->run(decodedFirst.size(), [&](size_t i) {
+	StagedTex* tex = staged[decodedFirst[i]];
+	GPUTexture* gpuTex = textures[first + decodedFirst[i]];
+	pixels[i].resize(residentSize(tex, gpuTex->residentMip));
+	gpuTex->mipSource = stageTexture(tex, pixels[i].data(), gpuTex->residentMip);
+	tex->deleteData();
+    });
+    for(size_t i = 0; i < decodedFirst.size(); i++) {
+	GPUTexture* tex = textures[first + decodedFirst[i]];
+	size_t skipped = tex->mipOffset(tex->residentMip);
+	for(uint32_t mip = tex->residentMip; mip < tex->info.mipLevels; mip++)
+	    uploadMip(tex, mip, pixels[i].data() + tex->mipOffset(mip) - skipped, true);
+	std::vector<unsigned char>().swap(pixels[i]);
+    }
+    // start reading the first levels to stream
+    for(size_t i = first; i < textures.size(); i++)
+	if(textures[i]->mipSource != nullptr)
+	    textures[i]->mipSource->request(textures[i]->residentMip - 1);
+}
 
-    checkResultAndThrow(vkEndCommandBuffer(tempCmdBuffer),
-			"failed to end command buffer");
+bool TexLoaderVk::uploadMip(GPUTexture* tex, uint32_t mip, const unsigned char* data,
+			    bool wait) {
+    VkBufferImageCopy region{};
+    region.imageSubresource.aspectMask = tex->info.aspect;
+    region.imageSubresource.mipLevel = mip;
+    region.imageSubresource.baseArrayLayer = 0;
+    region.imageSubresource.layerCount = 1;
+    uint32_t mipW = std::max(tex->width >> mip, 1u);
+    uint32_t mipH = std::max(tex->height >> mip, 1u);
+    // split into rows of texels, or of 4x4 blocks if compressed
+    uint32_t rowHeight = tex->compressed ? 4 : 1;
+    uint32_t rows = (mipH + rowHeight - 1) / rowHeight;
+    VkDeviceSize rowSize = tex->mipSizes[mip] / rows;
+    VkDeviceSize rowsPerPart = std::max(stagingRing->capacity() / rowSize, (VkDeviceSize)1);
+    for(uint32_t row = 0; row < rows;) {
+	uint32_t count = (uint32_t)std::min((VkDeviceSize)(rows - row), rowsPerPart);
+	StagingRing::Space space;
+	if(count == rows && !wait) {
+	    if(!stagingRing->tryAllocate(tex->mipSizes[mip], STAGING_ALIGNMENT, &space))
+		return false;
+	} else {
+	    space = stagingRing->allocate(count * rowSize, STAGING_ALIGNMENT);
+	}
+	std::memcpy(space.data, data + row * rowSize, count * rowSize);
+	region.bufferOffset = space.offset;
+	region.imageOffset = { 0, (int32_t)(row * rowHeight), 0 };
+	region.imageExtent = { mipW, std::min(count * rowHeight, mipH - row * rowHeight), 1 };
+	vkCmdCopyBufferToImage(stagingRing->commandBuffer(), space.buffer, tex->image,
+			       VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL, 1, &region);
+	row += count;
+    }
+    return true;
+}
 
-    checkResultAndThrow(
-	    vkhelper::submitCmdBuffAndWait(base.device, base.queue.graphicsPresentQueue,
-					   &tempCmdBuffer, loadedFence,
-					   &graphicsPresentMutex),
-			"failed to sumbit mipmap creation commands");
+bool TexLoaderVk::streamMips(VkDeviceSize* budget) {
+    if(!streaming)
+	return false;
+    // another thread is loading through the ring, so try again next frame
+    std::unique_lock<std::mutex> lock(stagingRing->mutex(), std::try_to_lock);
+    if(!lock.owns_lock())
+	return false;
     
-    LOG("creating image views");
+    // views only move to levels once their copies are done,
+    // so frames don't wait on the uploads
+    std::vector<GPUTexture*> changed;
+    for(size_t i = 0; i < streamingMips.size();) {
+	StreamingMip &s = streamingMips[i];
+	if(!stagingRing->finished(s.submitted)) {
+	    i++;
+	    continue;
+	}
+	s.tex->residentMip = std::min(s.tex->residentMip, s.mip);
+	if(std::find(changed.begin(), changed.end(), s.tex) == changed.end())
+	    changed.push_back(s.tex);
+	streamingMips.erase(streamingMips.begin() + i);
+    }
     
-    //create image views
-    for (auto &tex: textures)
-	checkResultAndThrow(
-		tex->createImageView(base.device), 
-		"Failed to create image view from texture");
+    // the smallest missing level of any texture goes first,
+    // so every texture sharpens a bit each frame.
+    // levels still being read are skipped until they're ready.
+    std::vector<StreamingMip> copied;
+    while(*budget > 0) {
+	GPUTexture* next = nullptr;
+	const unsigned char* pixels = nullptr;
+	for(auto &tex: textures) {
+	    if(tex->copiedMip == 0 || tex->mipSource == nullptr ||
+	       (next != nullptr && tex->mipSizes[tex->copiedMip - 1]
+		>= next->mipSizes[next->copiedMip - 1]))
+		continue;
+	    try {
+		const unsigned char* read = tex->mipSource->get(tex->copiedMip - 1);
+		if(read != nullptr) {
+		    next = tex;
+		    pixels = read;
+		}
+	    } catch(std::exception &e) {
+		LOG_ERROR("Failed to read mip level of streaming texture, "
+			  "it stays at a lower resolution - " << e.what());
+		tex->mipSource = nullptr;
+	    }
+	}
+	if(next == nullptr)
+	    break;
+	uint32_t mip = next->copiedMip - 1;
+	// levels that fit in the ring wait for a frame with space,
+	// bigger ones have to wait for older uploads to go through in parts
+	if(!uploadMip(next, mip, pixels, false))
+	    break;
+	next->mipReady(stagingRing, mip);
+	next->copiedMip = mip;
+	next->mipSource->release(mip);
+	if(mip == 0)
+	    next->mipSource = nullptr;
+	else
+	    next->mipSource->request(mip - 1);
+	VkDeviceSize size = next->mipSizes[mip];
+	*budget -= size < *budget ? size : *budget;
+	copied.push_back({ next, mip, 0 });
+    }
+    if(copied.size() > 0) {
+	uint64_t submitted = stagingRing->submit(false);
+	for(auto &c: copied) {
+	    c.submitted = submitted;
+	    streamingMips.push_back(c);
+	}
+    }
+    VkDevice device = base.device;
+    for(auto &tex: changed) {
+	// views aren't touched by the copies, so only wait for the frames
+	VkImageView view = tex->view;
+	deletionQueue->push([device, view] {
+	    vkDestroyImageView(device, view, nullptr);
+	});
+	checkResultAndThrow(tex->createImageView(base.device),
+			    "Failed to create image view for streamed texture");
+    }
 
-    vkFreeCommandBuffers(base.device, cmdpool, 1, &tempCmdBuffer);
-    clearStaged();
-    LOG("texture loading complete");
+    streaming = streamingMips.size() > 0;
+    for(auto &tex: textures)
+	if(tex->copiedMip > 0 && tex->mipSource != nullptr)
+	    streaming = true;
+    if(!streaming)
+	LOG("finished streaming textures");
+    return changed.size() > 0;
+}
+
+bool TexLoaderVk::reload(Resource::Texture tex, std::function<void()> waitForFrames) {
+    checkPoolValid(tex, "reload");
+    StagedTex* staged = stageReload(tex);
+    if(staged == nullptr) {
+	LOG_ERROR("tex loader - reload: texture wasn't loaded from a file. id: " << tex.ID);
+	return false;
+    }
+    std::vector<unsigned char> pixels(staged->filesize);
+    try {
+	if(staged->format != TextureFormat::RGBA8 && !base.features.textureCompressionBC)
+	    throw std::runtime_error("reloaded texture is block compressed, "
+				     "but the GPU doesn't support BC textures");
+	stageTexture(staged, pixels.data());
+    } catch(std::exception &e) {
+	staged->deleteData();
+	delete staged;
+	throw;
+    }
+    size_t index = gpuIndex(tex);
+    GPUTexture* old = textures[index];
+    TextureInfoVk info = defaultShaderReadTextureInfo(staged);
+    if(!mipmapping)
+	info.mipLevels = 1;
+    // streaming textures are still being copied to, so get a new image
+    bool inPlace = old->copiedMip == 0 && old->residentMip == 0 &&
+	old->width == (uint32_t)staged->width && old->height == (uint32_t)staged->height &&
+	old->info.format == info.format && old->info.mipLevels == info.mipLevels;
+    GPUTexture* target = old;
+    if(inPlace) {
+	// frames in flight may still be sampling the old pixels
+	waitForFrames();
+	// the old contents aren't kept
+	old->currentImageLayout = VK_IMAGE_LAYOUT_UNDEFINED;
+	old->currentImageAccessMask = 0;
+    } else {
+	target = new GPUTexture(base.device, staged, info);
+	VkMemoryRequirements memreq;
+	checkResultAndThrow(target->createImage(base.device, &memreq),
+			    "failed to create image for reloaded texture");
+	// the old image's memory is only reused when the pool is loaded again
+	MemoryChunk* chunk = getMemoryChunk(memreq.size, memreq.alignment,
+					    memreq.memoryTypeBits, true);
+	target->imageMemOffset = vkhelper::correctMemoryAlignment(chunk->used, memreq.alignment);
+	target->imageMemSize = memreq.size;
+	chunk->used = target->imageMemOffset + target->imageMemSize;
+	vkBindImageMemory(base.device, target->image, chunk->memory, target->imageMemOffset);
+    }
+    staged->deleteData();
+    delete staged;
+
+    {
+	std::lock_guard<std::mutex> lock(stagingRing->mutex());
+	VkCommandBuffer cmdbuff = stagingRing->commandBuffer();
+	target->transitionToTransferDst(cmdbuff);
+	for(uint32_t mip = 0; mip < target->info.mipLevels; mip++)
+	    uploadMip(target, mip, pixels.data() + target->mipOffset(mip), true);
+	target->transitionToFinalLayout(stagingRing);
+	stagingRing->submit(true);
+    }
+    if(inPlace)
+	return false;
+
+    checkResultAndThrow(target->createImageView(base.device),
+			"Failed to create image view for reloaded texture");
+    target->imageViewIndex = old->imageViewIndex;
+    minimumMipmapLevel = std::min(minimumMipmapLevel, target->info.mipLevels);
+    for(size_t i = 0; i < streamingMips.size();) {
+	if(streamingMips[i].tex == old)
+	    streamingMips.erase(streamingMips.begin() + i);
+	else
+	    i++;
+    }
+    // the ring was waited on above, so no copies or acquires are left for it
+    deletionQueue->push([old] { delete old; });
+    textures[index] = target;
+    return true;
 }
 
 uint32_t TexLoaderVk::getImageCount() { return textures.size(); }
 
+VkDeviceSize TexLoaderVk::gpuMemory() {
+    VkDeviceSize size = 0;
+    for(auto &chunk: memoryChunks)
+	size += chunk.size;
+    return size;
+}
+
 void TexLoaderVk::checkPoolValid(Resource::Texture tex, std::string msg) {
     if(tex.pool != this->pool)
 	throw std::invalid_argument(
 		"tex loader - " + msg + " Vk: Texture does not belong to this resource pool");
-    if(tex.ID >= textures.size())
+    if(gpuIndex(tex) >= textures.size())
 	throw std::runtime_error(msg + " Vk: texture ID was out of range");
 }
 
 VkImageView TexLoaderVk::getImageView(Resource::Texture tex) {
     checkPoolValid(tex, "getImageView");
-    return textures[tex.ID]->view;
+    return textures[gpuIndex(tex)]->view;
 }
 
 VkImageLayout TexLoaderVk::getImageLayout(Resource::Texture tex) {
     checkPoolValid(tex, "getImageLayout");
-    return textures[tex.ID]->info.layout;
+    return textures[gpuIndex(tex)]->info.layout;
 }
 
 bool TexLoaderVk::sampledImage(Resource::Texture tex) {
     checkPoolValid(tex, "sampledImage");
-    GPUTexture* t = textures[tex.ID];
+    GPUTexture* t = textures[gpuIndex(tex)];
     return t->info.usage & VK_IMAGE_USAGE_SAMPLED_BIT;
 }
 
 void TexLoaderVk::setIndex(Resource::Texture tex, uint32_t index) {
     checkPoolValid(tex, "setIndex");
-    textures[tex.ID]->imageViewIndex = index;
+    textures[gpuIndex(tex)]->imageViewIndex = index;
 }
 
 unsigned int TexLoaderVk::getViewIndex(Resource::Texture tex) {
@@ -218,8 +559,8 @@ unsigned int TexLoaderVk::getViewIndex(Resource::Texture tex) {
     }
     if(tex.ID == Resource::NULL_ID)
 	return tex.ID;
-    if (tex.ID < textures.size())
-	return textures[tex.ID]->imageViewIndex;
+    if (gpuIndex(tex) < textures.size())
+	return textures[gpuIndex(tex)]->imageViewIndex;
       
     LOG_ERROR("View Index's texture was out of range. given id: " <<
 	      tex.ID << " , size: " << textures.size() << " . Returning 0.");
@@ -238,16 +579,6 @@ void addImagePipelineBarrier(VkCommandBuffer &cmdBuff,
 			 1, &barrier);
 }
 
-bool formatSupportsMipmapping(VkPhysicalDevice physicalDevice, VkFormat format) {
-    VkFormatProperties formatProperties;
-    vkGetPhysicalDeviceFormatProperties(physicalDevice, format,
-					&formatProperties);
-    return (formatProperties.optimalTilingFeatures &
-	    VK_FORMAT_FEATURE_SAMPLED_IMAGE_FILTER_LINEAR_BIT)
-	&& (formatProperties.optimalTilingFeatures &
-	    VK_FORMAT_FEATURE_BLIT_DST_BIT);
-}
-
 VkResult GPUTexture::createImage(VkDevice device, VkMemoryRequirements *pMemreq) {
     return part::create::Image(device, &this->image, pMemreq,
 			       info.usage,
@@ -256,228 +587,186 @@ VkResult GPUTexture::createImage(VkDevice device, VkMemoryRequirements *pMemreq)
 			       info.samples, info.mipLevels);
 }
 
-VkDeviceSize TexLoaderVk::stageTexDataCreateImages(VkBuffer &stagingBuffer,
-						   VkDeviceMemory &stagingMemory,
-						   uint32_t *pFinalMemType,
-						   bool *stagingBufferCreated) {
-    VkDeviceSize totalDataSize = 0;
-    for(const auto tex: staged)
-	totalDataSize += tex->filesize;
-
-    void* pMem = nullptr;
-    if(totalDataSize > 0) {
-	LOG("creating staging buffer for textures. size: " << totalDataSize << " bytes");
-	checkResultAndThrow(vkhelper::createBufferAndMemory(
-				    base, totalDataSize, &stagingBuffer, &stagingMemory,
-				    VK_BUFFER_USAGE_TRANSFER_SRC_BIT,
-				    VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT |
-				    VK_MEMORY_PROPERTY_HOST_COHERENT_BIT),
-			    "Failed to create staging memory for texture data");
-	*stagingBufferCreated = true;
-	vkBindBufferMemory(base.device, stagingBuffer, stagingMemory, 0);
-	vkMapMemory(base.device, stagingMemory, 0, totalDataSize, 0, &pMem);
-    } else {
-	LOG("No textures to load from RAM");
-	*stagingBufferCreated = false;
-    }
-
+// offsets are from the start of the staged textures' memory,
+// which has to be aligned to pAlignment
+VkDeviceSize TexLoaderVk::createImages(size_t first, uint32_t *pFinalMemType,
+				       VkDeviceSize *pAlignment) {
     VkDeviceSize finalMemSize = 0;
     VkMemoryRequirements memreq;
-    VkDeviceSize bufferOffset = 0;
 
-    *pFinalMemType = 0;
-    minimumMipmapLevel = UINT32_MAX;
+    *pFinalMemType = UINT32_MAX;
+    *pAlignment = 1;
+    if(first == 0)
+	minimumMipmapLevel = UINT32_MAX;
     for (size_t i = 0; i < staged.size(); i++) {
-	// move textures in RAM to staging buffer
-	if(staged[i]->filesize > 0) {
-	    if(pMem == nullptr)
-		throw std::runtime_error(
-			"Texture Load to GPU: Need to stage texture but "
-			"pointer to staging buffer was nullptr");
-	    std::memcpy(static_cast<char*>(pMem) + bufferOffset,
-			staged[i]->data,
-			staged[i]->filesize);
-	    staged[i]->deleteData();
-	    bufferOffset += staged[i]->filesize;
-	}
+	if(staged[i]->format != TextureFormat::RGBA8 && !base.features.textureCompressionBC)
+	    throw std::runtime_error("Texture at index " + std::to_string(i) + " is block "
+				     "compressed, but the GPU doesn't support BC textures");
 
 	TextureInfoVk texInfo = defaultShaderReadTextureInfo(staged[i]);		    
 	if(staged[i]->internalTex)
 	    texInfo = ((StagedTexVk*)staged[i])->info;
-	textures[i] = new GPUTexture(base.device, staged[i], texInfo);
+	GPUTexture* tex = new GPUTexture(base.device, staged[i], texInfo);
+	textures[first + i] = tex;
 	
-	if (!mipmapping ||
-	    !formatSupportsMipmapping(base.physicalDevice, textures[i]->info.format))
-	    textures[i]->info.mipLevels = 1;
+	if (!mipmapping)
+	    tex->info.mipLevels = 1;
+	else if(!tex->gpuOnly)
+	    tex->residentMip = std::min(firstResidentMip(staged[i]),
+					tex->info.mipLevels - 1);
 	
-	checkResultAndThrow(textures[i]->createImage(base.device, &memreq),
+	checkResultAndThrow(tex->createImage(base.device, &memreq),
 			    "failed to create image in texture loader"
 			    "for texture at index " + std::to_string(i));
 	
 	// update smallest mip levels of any texture
-	if (textures[i]->info.mipLevels < minimumMipmapLevel)
-	    minimumMipmapLevel = textures[i]->info.mipLevels;
-	
-	*pFinalMemType |= memreq.memoryTypeBits;
+	if (tex->info.mipLevels < minimumMipmapLevel)
+	    minimumMipmapLevel = tex->info.mipLevels;
+
+	// the memory has to suit every image bound to it
+	*pFinalMemType &= memreq.memoryTypeBits;
+	*pAlignment = std::max(*pAlignment, memreq.alignment);
 	finalMemSize = vkhelper::correctMemoryAlignment(finalMemSize, memreq.alignment);
-	textures[i]->imageMemOffset = finalMemSize;
-	textures[i]->imageMemSize = vkhelper::correctMemoryAlignment(
+	tex->imageMemOffset = finalMemSize;
+	tex->imageMemSize = vkhelper::correctMemoryAlignment(
 		memreq.size, memreq.alignment);
-	finalMemSize += textures[i]->imageMemSize;
+	finalMemSize += tex->imageMemSize;
     }
 
-    if(stagingBufferCreated)
-	LOG("successfully copied textures to staging buffer");
-    
     return finalMemSize;
 }
 
 TextureInfoVk TexLoaderVk::defaultShaderReadTextureInfo(StagedTex* t) {
     TextureInfoVk info;
-    info.mipLevels =
-	1 + (int)std::floor(
-		std::log2(t->width > t->height ? t->width : t->height));
-    if(srgb)
-	info.format = VK_FORMAT_R8G8B8A8_SRGB;
-    else
-	info.format = VK_FORMAT_R8G8B8A8_UNORM;
+    // mips are made on the cpu, or come with the file
+    info.mipLevels = t->mipSizes.size() > 1 ? (uint32_t)t->mipSizes.size() : 1;
+    switch(t->format) {
+    case TextureFormat::BC1:
+	info.format = t->srgb ? VK_FORMAT_BC1_RGBA_SRGB_BLOCK : VK_FORMAT_BC1_RGBA_UNORM_BLOCK;
+	break;
+    case TextureFormat::BC3:
+	info.format = t->srgb ? VK_FORMAT_BC3_SRGB_BLOCK : VK_FORMAT_BC3_UNORM_BLOCK;
+	break;
+    case TextureFormat::BC4:
+	info.format = VK_FORMAT_BC4_UNORM_BLOCK;
+	break;
+    case TextureFormat::BC5:
+	info.format = VK_FORMAT_BC5_UNORM_BLOCK;
+	break;
+    case TextureFormat::BC7:
+	info.format = t->srgb ? VK_FORMAT_BC7_SRGB_BLOCK : VK_FORMAT_BC7_UNORM_BLOCK;
+	break;
+    default:
+	info.format = t->srgb ? VK_FORMAT_R8G8B8A8_SRGB : VK_FORMAT_R8G8B8A8_UNORM;
+	break;
+    }
     info.layout = VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL;
     info.aspect = VK_IMAGE_ASPECT_COLOR_BIT;
     info.access = VK_ACCESS_SHADER_READ_BIT;
     info.usage = VK_IMAGE_USAGE_SAMPLED_BIT |
-	VK_IMAGE_USAGE_TRANSFER_DST_BIT |
-	VK_IMAGE_USAGE_TRANSFER_SRC_BIT;
+	VK_IMAGE_USAGE_TRANSFER_DST_BIT;
     info.samples = VK_SAMPLE_COUNT_1_BIT;
     return info;
 }
 
 VkImageMemoryBarrier initialBarrierSettings();
 
-// transition image to mipmapping format + copy data from staging buffer to gpu memory
-// and bind to texture image.
-void TexLoaderVk::textureDataStagingToFinal(VkBuffer stagingBuffer,
-					    VkCommandBuffer &cmdbuff) {
+/// --- copying to the gpu ---
+
+size_t GPUTexture::mipOffset(uint32_t mip) {
+    size_t offset = 0;
+    for(uint32_t i = 0; i < mip; i++)
+	offset += mipSizes[i];
+    return offset;
+}
+
+void GPUTexture::transitionToTransferDst(VkCommandBuffer &cmdBuff) {
     VkImageMemoryBarrier barrier = initialBarrierSettings();
-    barrier.newLayout = VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL; // this layout used for mipmapping
+    barrier.image = image;
+    barrier.subresourceRange.levelCount = info.mipLevels;
+    barrier.subresourceRange.aspectMask = info.aspect;
+    barrier.oldLayout = currentImageLayout;
+    barrier.newLayout = VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL;
+    barrier.srcAccessMask = currentImageAccessMask;
+    barrier.dstAccessMask = VK_ACCESS_TRANSFER_WRITE_BIT;
+    addImagePipelineBarrier(cmdBuff, barrier,
+			    VK_PIPELINE_STAGE_TOP_OF_PIPE_BIT,
+			    VK_PIPELINE_STAGE_TRANSFER_BIT);
+    currentImageLayout = barrier.newLayout;
+    currentImageAccessMask = barrier.dstAccessMask;
+}
 
+// every resident level, from the levels at offset in the staging buffer that start at residentMip
+void GPUTexture::copyMips(VkCommandBuffer &cmdBuff, VkBuffer stagingBuffer,
+			  VkDeviceSize offset) {
     VkBufferImageCopy region{};
     region.bufferRowLength = 0;
     region.bufferImageHeight = 0;
-    region.imageSubresource.mipLevel = 0;
+    region.imageSubresource.aspectMask = info.aspect;
     region.imageSubresource.baseArrayLayer = 0;
     region.imageSubresource.layerCount = 1;
     region.imageOffset = { 0, 0, 0 };
-      
-    VkDeviceSize bufferOffset = 0;
-    for (int i = 0; i < textures.size(); i++) {
-	vkBindImageMemory(base.device, textures[i]->image, memory, textures[i]->imageMemOffset);
-
-	if(staged[i]->filesize > 0) {
-	    barrier.image = textures[i]->image;
-	    barrier.subresourceRange.levelCount = textures[i]->info.mipLevels;
-	    barrier.subresourceRange.aspectMask = textures[i]->info.aspect;
-	    barrier.oldLayout = textures[i]->currentImageLayout;
-	    barrier.srcAccessMask = textures[i]->currentImageAccessMask;
-	    barrier.dstAccessMask = VK_ACCESS_TRANSFER_WRITE_BIT;
-	    addImagePipelineBarrier(cmdbuff, barrier,
-				    VK_PIPELINE_STAGE_TOP_OF_PIPE_BIT,
-				    VK_PIPELINE_STAGE_TRANSFER_BIT);
-	    textures[i]->currentImageLayout = barrier.newLayout;
-	    textures[i]->currentImageAccessMask = barrier.dstAccessMask;
-	    region.imageExtent = { textures[i]->width, textures[i]->height, 1 };
-	    region.bufferOffset = bufferOffset;
-	    region.imageSubresource.aspectMask = textures[i]->info.aspect;
-	    bufferOffset += staged[i]->filesize;
-	    
-	    vkCmdCopyBufferToImage(cmdbuff, stagingBuffer, textures[i]->image,
-				   VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL,
-				   1, &region);
+    // one region per mip level, all in the one copy
+    std::vector<VkBufferImageCopy> regions;
+    region.bufferOffset = offset;
+    uint32_t mipW = width, mipH = height;
+    for(uint32_t mip = 0; mip < info.mipLevels && mip < mipSizes.size(); mip++) {
+	region.imageSubresource.mipLevel = mip;
+	region.imageExtent = { mipW, mipH, 1 };
+	// levels before the resident one are streamed in later
+	if(mip >= residentMip) {
+	    regions.push_back(region);
+	    region.bufferOffset += mipSizes[mip];
 	}
+	if(mipW > 1) mipW /= 2;
+	if(mipH > 1) mipH /= 2;
     }
+    vkCmdCopyBufferToImage(cmdBuff, stagingBuffer, image,
+			   VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL,
+			   (uint32_t)regions.size(), regions.data());
 }
 
+// a streamed level has been copied, so it can be sampled
+void GPUTexture::mipReady(StagingRing* stagingRing, uint32_t mip) {
+    VkImageMemoryBarrier barrier = initialBarrierSettings();
+    barrier.image = image;
+    barrier.subresourceRange.aspectMask = info.aspect;
+    barrier.subresourceRange.baseMipLevel = mip;
+    barrier.oldLayout = VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL;
+    barrier.newLayout = info.layout;
+    barrier.dstAccessMask = info.access;
+    stagingRing->imageReady(barrier, VK_PIPELINE_STAGE_FRAGMENT_SHADER_BIT);
+}
 
-/// ----------- Mipmapping -----------
 
-  
-void dstToSrcBarrier(VkImageMemoryBarrier *barrier);
-  
-void dstSrcToLayoutBarrier(VkImageMemoryBarrier *barrier, VkImageLayout layout, VkAccessFlags accessMask);
-  
-VkImageBlit getMipmapBlit(int32_t currentW, int32_t currentH, int destMipLevel,
-			  VkImageAspectFlags aspect);
+/// ----------- Final Layout -----------
 
-void GPUTexture::createMipMaps(VkCommandBuffer &cmdBuff) {
+// also hands the image over to the graphics queue if the copies were on a transfer queue
+void GPUTexture::transitionToFinalLayout(StagingRing* stagingRing) {
     if(gpuOnly)
 	return;
     VkImageMemoryBarrier barrier = initialBarrierSettings();
     barrier.image = this->image;
     barrier.subresourceRange.aspectMask = info.aspect;
-    int mipW = this->width;
-    int mipH = this->height;
-    for(int i = 1; i < this->info.mipLevels; i++) { //start at 1 (0 would be full size)
-	// change image layout to be ready for mipmapping
-	barrier.subresourceRange.baseMipLevel = i - 1;
-	dstToSrcBarrier(&barrier);
-	addImagePipelineBarrier(cmdBuff, barrier,
-				VK_PIPELINE_STAGE_TRANSFER_BIT,
-				VK_PIPELINE_STAGE_TRANSFER_BIT);
-
-	VkImageBlit blit = getMipmapBlit(mipW, mipH, i, info.aspect);
-	vkCmdBlitImage(cmdBuff, this->image, VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL,
-		       this->image, VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL, 1, &blit,
-		       MIPMAP_FILTER);
-	  
-	dstSrcToLayoutBarrier(&barrier, info.layout, info.access);
-	addImagePipelineBarrier(cmdBuff, barrier,
-				VK_PIPELINE_STAGE_TRANSFER_BIT,
-				VK_PIPELINE_STAGE_FRAGMENT_SHADER_BIT);
-	if(mipW > 1) mipW /= 2;
-	if(mipH > 1) mipH /= 2;
-    }
-
-    
-    // Transition Image to final layout
-    
-    dstSrcToLayoutBarrier(&barrier, info.layout, info.access);
-    barrier.subresourceRange.baseMipLevel = info.mipLevels - 1;
+    // streamed levels stay as transfer dst until they are copied
+    barrier.subresourceRange.baseMipLevel = residentMip;
+    barrier.subresourceRange.levelCount = info.mipLevels - residentMip;
     barrier.oldLayout = currentImageLayout;
-    barrier.srcAccessMask = currentImageAccessMask;
-    addImagePipelineBarrier(cmdBuff, barrier,
-			    VK_PIPELINE_STAGE_TRANSFER_BIT,
-			    VK_PIPELINE_STAGE_FRAGMENT_SHADER_BIT);
+    barrier.newLayout = info.layout;
+    barrier.dstAccessMask = info.access;
+    stagingRing->imageReady(barrier, VK_PIPELINE_STAGE_FRAGMENT_SHADER_BIT);
     currentImageLayout = info.layout;
     currentImageAccessMask = info.access;
 }
 
-VkImageBlit getMipmapBlit(int32_t currentW, int32_t currentH, int destMipLevel,
-			  VkImageAspectFlags aspect) {
-    VkImageBlit blit{};
-    blit.srcOffsets[0] = {0, 0, 0};
-    blit.srcOffsets[1] = { currentW, currentH, 1 };
-    blit.srcSubresource.aspectMask = aspect;
-    blit.srcSubresource.mipLevel = destMipLevel - 1;
-    blit.srcSubresource.baseArrayLayer = 0;
-    blit.srcSubresource.layerCount = 1;
-    blit.dstOffsets[0] = { 0, 0, 0 };
-    blit.dstOffsets[1] = {
-	currentW > 1 ? currentW / 2 : 1,
-	currentH > 1 ? currentH / 2 : 1,
-	1 };
-    blit.dstSubresource.aspectMask = aspect;
-    blit.dstSubresource.mipLevel = destMipLevel;
-    blit.dstSubresource.baseArrayLayer = 0;
-    blit.dstSubresource.layerCount = 1;
-    return blit;
-}
-
 
 /// --- image view creation ---
 
 VkResult GPUTexture::createImageView(VkDevice device) {
     return part::create::ImageView(
 	    device, &this->view, this->image,
-	    this->info.format, this->info.aspect, this->info.mipLevels);
+	    this->info.format, this->info.aspect,
+	    this->info.mipLevels - residentMip, residentMip);
 }
 
 /// --- memory barriers ---
@@ -492,18 +781,3 @@ VkImageMemoryBarrier initialBarrierSettings() {
     barrier.subresourceRange.levelCount = 1;
     return barrier;
 }
-
-void dstToSrcBarrier(VkImageMemoryBarrier *barrier) {
-      barrier->oldLayout = VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL;
-      barrier->newLayout = VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL;
-      barrier->srcAccessMask = VK_ACCESS_TRANSFER_WRITE_BIT;
-      barrier->dstAccessMask = VK_ACCESS_TRANSFER_READ_BIT;
-  }
-
-void dstSrcToLayoutBarrier(VkImageMemoryBarrier *barrier, VkImageLayout layout,
-			   VkAccessFlags accessMask) {
-    barrier->oldLayout = VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL;
-    barrier->newLayout = layout;
-    barrier->srcAccessMask = VK_ACCESS_TRANSFER_READ_BIT;
-    barrier->dstAccessMask = accessMask;
-}
@@ -3,6 +3,8 @@
 
 #include <render-internal/resource-loaders/texture_loader.h>
 #include "../device_state.h"
+#include "staging_ring.h"
+#include "deletion_queue.h"
 
 struct GPUTexture;
 
@@ -18,11 +20,17 @@ struct TextureInfoVk {
 
 class TexLoaderVk : public InternalTexLoader {
 public:
-    TexLoaderVk(DeviceState base, VkCommandPool pool,
-		Resource::Pool resPool, RenderConfig config);
+    TexLoaderVk(DeviceState base, StagingRing* stagingRing, DeletionQueue* deletionQueue,
+		Resource::Pool resPool, RenderConfig config, TextureCache* cache);
     ~TexLoaderVk() override;
+    /// the images are freed through the deletion queue, as frames in flight may use them
     void clearGPU() override;
     void loadGPU() override;
+    /// load the staged textures without touching the ones already loaded
+    void appendGPU() override;
+    /// record the uploads without waiting for them to finish,
+    /// returns the staging ring submit to check for.
+    uint64_t loadGPUAsync();
 
     Resource::Texture addGpuTexture(uint32_t width, uint32_t height, TextureInfoVk info);
     
@@ -33,25 +41,63 @@ public:
     bool sampledImage(Resource::Texture tex);
     void setIndex(Resource::Texture texture, uint32_t index);
     unsigned int getViewIndex(Resource::Texture tex) override;
+
+    /// Copy the next mip levels of streaming textures through the staging ring,
+    /// taking the bytes copied from budget. Skips the frame if the ring is in use.
+    /// Views start using levels on a later call, once their copies are done.
+    /// Old image views are freed through the deletion queue.
+    /// Returns true if any image views changed, so descriptor sets need updating.
+    bool streamMips(VkDeviceSize* budget);
+
+    /// Load the file of a texture again, keeping its handle. Pixels the same size
+    /// and format as before are written over the old ones after calling waitForFrames,
+    /// otherwise the texture gets a new image, and the old one is freed
+    /// through the deletion queue.
+    /// Returns true if the texture's image view changed, so its descriptor needs updating.
+    bool reload(Resource::Texture tex, std::function<void()> waitForFrames);
+
+    /// bytes of device memory allocated for the images
+    VkDeviceSize gpuMemory();
     
 private:
-    VkDeviceSize stageTexDataCreateImages(VkBuffer &stagingBuffer,
-					  VkDeviceMemory &stagingMemory,
-					  uint32_t *pFinalMemType,
-					  bool* stagingBufferCreated);
-    void textureDataStagingToFinal(VkBuffer stagingBuffer,
-				   VkCommandBuffer &cmdbuff);
+    uint64_t loadGPU(bool wait, bool append);
+    /// make images for the staged textures, placed from first in textures
+    VkDeviceSize createImages(size_t first, uint32_t *pFinalMemType, VkDeviceSize *pAlignment);
+    void uploadTextures(size_t first);
+    /// copy one mip level, in parts if it's bigger than the ring.
+    /// if not wait, returns false when a level that fits in the ring has no space yet.
+    bool uploadMip(GPUTexture* tex, uint32_t mip, const unsigned char* data, bool wait);
 
     TextureInfoVk defaultShaderReadTextureInfo(StagedTex* t);
 
     void checkPoolValid(Resource::Texture tex, std::string msg);
             
     DeviceState base;
-    VkCommandPool cmdpool;
+    StagingRing* stagingRing;
+    DeletionQueue* deletionQueue;
     std::vector<GPUTexture*> textures;
-    VkDeviceMemory memory;
+
+    /// the images of each load are bound next to each other in a chunk
+    struct MemoryChunk {
+	VkDeviceMemory memory;
+	uint32_t typeIndex;
+	VkDeviceSize size;
+	VkDeviceSize used;
+    };
+    std::vector<MemoryChunk> memoryChunks;
+    MemoryChunk* getMemoryChunk(VkDeviceSize size, VkDeviceSize alignment,
+				uint32_t memoryTypeBits, bool append);
     uint32_t minimumMipmapLevel;
-    VkFence loadedFence;
+
+    // some textures still have mips to be copied
+    bool streaming = false;
+    // levels copied but not yet in the views of their textures
+    struct StreamingMip {
+	GPUTexture* tex;
+	uint32_t mip;
+	uint64_t submitted;
+    };
+    std::vector<StreamingMip> streamingMips;
 };
 
 #endif
@@ -89,6 +89,38 @@ void SetVk::updateTextures(size_t index, size_t arrayIndex,
     vkUpdateDescriptorSets(state.device, (uint32_t)writes.size(), writes.data(), 0, nullptr);
 }
 
+void SetVk::refreshTextureViews(size_t index) {
+    if(!gpuResourcesCreated || index >= bindings.size() ||
+       bindings[index].bindType != Binding::type::Texture)
+	return;
+    bindings[index].getImageViews(poolManager);
+    std::vector<VkWriteDescriptorSet> writes;
+    std::vector<std::vector<VkDescriptorImageInfo>> imageVecs;
+    std::vector<VkDescriptorSet> currentSet = { setHandles[currentSetIndex] };
+    bindings[index].writeTextures(SIZE_MAX, 0, writes, imageVecs, currentSet);
+    vkUpdateDescriptorSets(state.device, (uint32_t)writes.size(), writes.data(), 0, nullptr);
+}
+
+void SetVk::refreshTextureView(size_t index, size_t arrayIndex) {
+    if(!gpuResourcesCreated || index >= bindings.size() ||
+       bindings[index].bindType != Binding::type::Texture ||
+       arrayIndex >= bindings[index].textures.size())
+	return;
+    bindings[index].getImageViews(arrayIndex, arrayIndex + 1, poolManager);
+    std::vector<VkWriteDescriptorSet> writes;
+    std::vector<std::vector<VkDescriptorImageInfo>> imageVecs;
+    std::vector<VkDescriptorSet> currentSet = { setHandles[currentSetIndex] };
+    bindings[index].writeTextures(arrayIndex, 1, writes, imageVecs, currentSet);
+    vkUpdateDescriptorSets(state.device, (uint32_t)writes.size(), writes.data(), 0, nullptr);
+}
+
+void SetVk::updateTexturesPerFrame(size_t index, std::vector<Resource::Texture> textures) {
+    try{
+	InternalSet::updateTextures(index, 0, textures);
+    } catch(std::invalid_argument &e) {
+	LOG_ERROR(e.what());
+    }
+}
 
 VkDescriptorSetLayout SetVk::CreateSetLayout() {
     std::vector<VkDescriptorSetLayoutBinding> layoutBindings;
@@ -299,7 +331,7 @@ void ShaderPoolVk::createData() {
     VkPhysicalDeviceProperties deviceProps;
     vkGetPhysicalDeviceProperties(state.physicalDevice, &deviceProps);
     
-    VkDeviceSize memorySize = 0;
+    memorySize = 0;
     for(auto set: sets)
 	set->setupDescriptorSets(&memorySize, deviceProps);
 
@@ -103,6 +103,17 @@ public:
     void updateTextures(size_t index, size_t arrayIndex,
 			std::vector<Resource::Texture> textures) override;
 
+    /// Get the image views of the textures again, but only write them
+    /// to the set for the current frame, as other frames may still be using theirs.
+    void refreshTextureViews(size_t index);
+
+    /// Like refreshTextureViews, but only for the texture at arrayIndex.
+    void refreshTextureView(size_t index, size_t arrayIndex);
+
+    /// Change the textures without writing any sets,
+    /// they are written a frame at a time by refreshTextureViews.
+    void updateTexturesPerFrame(size_t index, std::vector<Resource::Texture> textures);
+
     VkDescriptorSetLayout getLayout();
     
     // for temp pipeline changes
@@ -183,6 +194,9 @@ public:
 	for(auto set: sets)
 	    set->setHandleIndex(handleIndex);
     }
+
+    /// bytes of the buffer holding every set's uniform and storage data
+    VkDeviceSize gpuMemory() { return memoryCreated ? memorySize : 0; }
     
 private:
 
@@ -199,6 +213,7 @@ private:
     bool memoryCreated = false;
     VkBuffer buffer;
     VkDeviceMemory memory;
+    VkDeviceSize memorySize = 0;
 };
 
 #endif
@@ -0,0 +1,200 @@
+#include <graphics/world_streamer.h>
+
+#include <graphics/logger.h>
+#include <chrono>
+#include <stdexcept>
+
+WorldStreamer::WorldStreamer(Render* render, StreamConfig config) {
+    this->render = render;
+    this->config = config;
+}
+
+WorldStreamer::~WorldStreamer() {
+    if(staging.valid())
+	staging.wait();
+    for(auto &region: regions)
+	if(region.pool != nullptr)
+	    render->DestroyResourcePool(region.pool->id());
+}
+
+size_t WorldStreamer::addRegion(StreamRegion region) {
+    Region r;
+    r.desc = region;
+    regions.push_back(r);
+    return regions.size() - 1;
+}
+
+float distanceToRegion(glm::vec3 pos, const StreamRegion &region) {
+    return glm::distance(pos, glm::clamp(pos, region.min, region.max));
+}
+
+void WorldStreamer::update(glm::vec3 cameraPos) {
+    updateCount++;
+    if(staging.valid() &&
+       staging.wait_for(std::chrono::seconds(0)) == std::future_status::ready)
+	finishStaging();
+
+    for(size_t i = 0; i < regions.size(); i++) {
+	Region &region = regions[i];
+	if(region.state == RegionState::uploading && render->LoadFinished(region.ticket)) {
+	    Resource::PoolMemory memory = region.pool->memoryUsage();
+	    region.memory = memory.textures + memory.models;
+	    region.state = RegionState::ready;
+	}
+	float distance = distanceToRegion(cameraPos, region.desc);
+	if(distance <= config.loadDistance)
+	    region.lastWanted = updateCount;
+	bool inside = distance == 0.0f;
+	if(inside && !region.cameraInside && region.state != RegionState::ready)
+	    hitches.push_back({ StreamHitch::Type::late, i, 0.0f });
+	region.cameraInside = inside;
+    }
+
+    // a region loaded for the first time may have gone over the budget
+    makeSpace(0);
+
+    if(staging.valid())
+	return;
+    // stage the nearest wanted region that isn't loaded
+    size_t next = regions.size();
+    float nextDistance = 0.0f;
+    for(size_t i = 0; i < regions.size(); i++) {
+	if(regions[i].state != RegionState::unloaded || regions[i].failed ||
+	   regions[i].lastWanted != updateCount)
+	    continue;
+	float distance = distanceToRegion(cameraPos, regions[i].desc);
+	if(next == regions.size() || distance < nextDistance) {
+	    next = i;
+	    nextDistance = distance;
+	}
+    }
+    if(next != regions.size() && makeSpace(regions[next].memory))
+	startStaging(next);
+}
+
+Resource::PackedResources stageRegion(ResourcePool* pool, const StreamRegion &region) {
+    Resource::PackedResources staged;
+    for(auto &path: region.packs) {
+	Resource::PackedResources pack = pool->loadPack(path);
+	staged.textures.insert(pack.textures.begin(), pack.textures.end());
+	staged.models.insert(pack.models.begin(), pack.models.end());
+	staged.fonts.insert(pack.fonts.begin(), pack.fonts.end());
+    }
+    for(auto &path: region.textures)
+	staged.textures[path] = pool->tex()->load(path);
+    for(auto &path: region.models)
+	staged.models[path] = pool->model()->load(path);
+    for(auto &path: region.fonts)
+	staged.fonts[path] = pool->font()->load(path);
+    if(region.stage)
+	region.stage(pool);
+    // so the render thread only has to copy the region to the gpu
+    pool->decodeStaged();
+    return staged;
+}
+
+void WorldStreamer::startStaging(size_t region) {
+    ResourcePool* pool = nullptr;
+    timed(region, [&] {
+	pool = render->CreateResourcePool();
+	// not used until it is on the gpu
+	render->setResourcePoolInUse(pool->id(), false);
+    });
+    // so GetMemoryUsage doesn't read it while it is staged
+    pool->setStaging(true);
+    regions[region].pool = pool;
+    regions[region].state = RegionState::staging;
+    stagingRegion = region;
+    StreamRegion desc = regions[region].desc;
+    staging = std::async(std::launch::async, [pool, desc] {
+	return stageRegion(pool, desc);
+    });
+}
+
+void WorldStreamer::finishStaging() {
+    Region &region = regions[stagingRegion];
+    try {
+	region.resources = staging.get();
+	region.pool->setStaging(false);
+    } catch(std::exception &e) {
+	LOG_ERROR("failed to stage region " << stagingRegion << " - " << e.what());
+	region.failed = true;
+	evict(stagingRegion);
+	return;
+    }
+    timed(stagingRegion, [&] {
+	render->setResourcePoolInUse(region.pool->id(), true);
+	region.ticket = render->LoadResourcesToGPUAsync(region.pool->id());
+    });
+    region.state = RegionState::uploading;
+}
+
+void WorldStreamer::evict(size_t region) {
+    Region &r = regions[region];
+    timed(region, [&] {
+	render->DestroyResourcePool(r.pool->id());
+    });
+    r.pool = nullptr;
+    r.resources = Resource::PackedResources();
+    r.state = RegionState::unloaded;
+}
+
+bool WorldStreamer::makeSpace(uint64_t size) {
+    if(config.memoryBudget == 0)
+	return true;
+    while(memoryUsed() + size > config.memoryBudget) {
+	// the least recently wanted region that is ready and not wanted now
+	size_t lru = regions.size();
+	for(size_t i = 0; i < regions.size(); i++)
+	    if(regions[i].state == RegionState::ready &&
+	       regions[i].lastWanted != updateCount &&
+	       (lru == regions.size() || regions[i].lastWanted < regions[lru].lastWanted))
+		lru = i;
+	if(lru == regions.size())
+	    return false;
+	evict(lru);
+    }
+    return true;
+}
+
+void WorldStreamer::timed(size_t region, std::function<void()> call) {
+    auto start = std::chrono::steady_clock::now();
+    call();
+    float ms = std::chrono::duration<float, std::milli>(
+	    std::chrono::steady_clock::now() - start).count();
+    if(ms > config.hitchThresholdMs)
+	hitches.push_back({ StreamHitch::Type::stall, region, ms });
+}
+
+bool WorldStreamer::ready(size_t region) {
+    if(region >= regions.size())
+	throw std::out_of_range("world streamer - region index out of range");
+    return regions[region].state == RegionState::ready;
+}
+
+const Resource::PackedResources* WorldStreamer::resources(size_t region) {
+    return ready(region) ? &regions[region].resources : nullptr;
+}
+
+ResourcePool* WorldStreamer::pool(size_t region) {
+    if(region >= regions.size())
+	throw std::out_of_range("world streamer - region index out of range");
+    // the streaming thread is still using it
+    if(regions[region].state == RegionState::staging)
+	return nullptr;
+    return regions[region].pool;
+}
+
+uint64_t WorldStreamer::memoryUsed() {
+    uint64_t used = 0;
+    for(auto &region: regions)
+	if(region.state == RegionState::ready || region.state == RegionState::uploading)
+	    used += region.memory;
+    return used;
+}
+
+std::vector<StreamHitch> WorldStreamer::takeHitches() {
+    std::vector<StreamHitch> taken;
+    taken.swap(hitches);
+    return taken;
+}